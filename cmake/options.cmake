@@ -1,6 +1,14 @@
 option(BUILD_EXECUTABLE "Build executable with Xboard interface" ON)
 option(BUILD_TESTS "Build test binaries" OFF)
+option(BUILD_TOOLS "Build opening book and analysis tools" OFF)
+option(ENABLE_TSAN "Build with ThreadSanitizer" OFF)
+option(USE_ZLIB "Compress position files with zlib if it is found" ON)
 
 if(BUILD_EXECUTABLE)
 set(TARGET_SUFFIX "" CACHE STRING "String to append to name of executables")
 endif()
+
+if(ENABLE_TSAN)
+set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -fsanitize=thread -g")
+set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -fsanitize=thread")
+endif()
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include "bitbase.h"
+
+/* Bitbases for the evaluation, generated in memory. One bit per position
+ * of an endgame, set if the stronger side wins. Only endgames where the
+ * weaker side cannot win fit in a bitbase, and they only know the result,
+ * not the distance. */
+
+typedef struct {
+    retrograde_material_t material;
+    uint64_t    *bits;
+} bitbase_table_t;
+
+struct bitbase_t {
+    bitbase_table_t tables[RETROGRADE_MAX_TABLES];
+    int         num_tables;
+};
+
+static int BITBASE_probe_generator(const void *arg, const chess_state_t *s, int *wdl)
+{
+    return BITBASE_probe((const bitbase_t*)arg, s, wdl);
+}
+
+/* Result from the side to move's point of view. Returns 0 if the position
+ * is not in the bitbases, or has castling rights or an en passant capture. */
+int BITBASE_probe(const bitbase_t *bb, const chess_state_t *s, int *wdl)
+{
+    const int num_pieces = BITBOARD_count_bits(s->bitboard[OCCUPIED]);
+    const bitboard_t minors = s->bitboard[WHITE_PIECES+KNIGHT] | s->bitboard[WHITE_PIECES+BISHOP] |
+                              s->bitboard[BLACK_PIECES+KNIGHT] | s->bitboard[BLACK_PIECES+BISHOP];
+    if(s->castling[WHITE] || s->castling[BLACK] || s->ep_file != STATE_EN_PASSANT_NONE) return 0;
+
+    /* Bare kings, or a lone bishop or knight, cannot mate */
+    if(num_pieces == 2 || (num_pieces == 3 && minors)) {
+        *wdl = RETROGRADE_DRAW;
+        return 1;
+    }
+    if(num_pieces > RETROGRADE_MAX_PIECES) return 0;
+
+    const uint32_t key = RETROGRADE_material_key(s);
+    for(int i = 0; i < bb->num_tables; i++) {
+        const bitbase_table_t *t = &bb->tables[i];
+        uint64_t index;
+        if(t->material.key != key || !RETROGRADE_index(&t->material, s, &index)) continue;
+
+        const int player = (int)(index & 1);
+        *wdl = !((t->bits[index / 64] >> (index % 64)) & 1) ? RETROGRADE_DRAW : (player == WHITE) ? RETROGRADE_WIN : RETROGRADE_LOSS;
+        return 1;
+    }
+    return 0;
+}
+
+/* Generates the bitbases of the endgames called names (like KRvKP). The
+ * endgames captures and promotions lead to come first, as in
+ * RETROGRADE_list, except for KBvK and KNvK which are drawn anyway.
+ * num_threads <= 0 uses one thread per core. Returns NULL on failure. */
+bitbase_t *BITBASE_create(const char * const *names, const int num_names, const int num_threads)
+{
+    bitbase_t *bb = (bitbase_t*)calloc(1, sizeof(bitbase_t));
+
+    BITBOARD_init();
+    for(int i = 0; i < num_names && i < RETROGRADE_MAX_TABLES; i++) {
+        bitbase_table_t *t = &bb->tables[bb->num_tables];
+        uint8_t *result;
+        int ok = 1;
+
+        if(!RETROGRADE_material(&t->material, names[i]) || !(result = RETROGRADE_generate(&t->material, BITBASE_probe_generator, bb, num_threads))) {
+            BITBASE_close(bb);
+            return NULL;
+        }
+
+        t->bits = (uint64_t*)calloc((t->material.size + 63) / 64, sizeof(uint64_t));
+        for(uint64_t index = 0; index < t->material.size; index++) {
+            int wdl, distance;
+            RETROGRADE_decode(result[index], &wdl, &distance);
+            if(wdl == RETROGRADE_DRAW) continue;
+
+            /* Won with white to move or lost with black to move */
+            if((wdl == RETROGRADE_WIN) != ((index & 1) == WHITE)) ok = 0;
+            t->bits[index / 64] |= (uint64_t)1 << (index % 64);
+        }
+        free(result);
+
+        bb->num_tables++;
+        if(!ok) {
+            BITBASE_close(bb);
+            return NULL;
+        }
+    }
+
+    return bb;
+}
+
+void BITBASE_close(bitbase_t *bb)
+{
+    if(!bb) return;
+    for(int i = 0; i < bb->num_tables; i++) {
+        free(bb->tables[i].bits);
+    }
+    free(bb);
+}
+
+int BITBASE_num_tables(const bitbase_t *bb)
+{
+    return bb->num_tables;
+}
@@ -0,0 +1,14 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "state.h"
+#include "retrograde.h"
+
+typedef struct bitbase_t bitbase_t;
+
+bitbase_t *BITBASE_create(const char * const *names, const int num_names, const int num_threads);
+void BITBASE_close(bitbase_t *bb);
+int  BITBASE_num_tables(const bitbase_t *bb);
+int  BITBASE_probe(const bitbase_t *bb, const chess_state_t *s, int *wdl);
+
+#endif
@@ -1,4 +1,5 @@
 #include "bitboard.h"
+#include "thread.h"
 #include <stdio.h>
 
 bitboard_t bitboard_file[NUM_POSITIONS];
@@ -25,7 +26,7 @@ bitboard_t bitboard_queen_castle_empty[NUM_COLORS];
 bitboard_t bitboard_start_position[NUM_COLORS][NUM_TYPES-1];
 char       distance[NUM_POSITIONS][NUM_POSITIONS];
 
-void BITBOARD_init()
+static void BITBOARD_init_tables()
 {
     bitboard_t bitboard_less_than[NUM_POSITIONS];
     bitboard_t bitboard_more_than[NUM_POSITIONS];
@@ -242,6 +243,13 @@ void BITBOARD_init()
     }
 }
 
+/* Safe to call from several threads, the tables are only computed once */
+void BITBOARD_init()
+{
+    static once_t once = THREAD_ONCE_INIT;
+    THREAD_once(&once, BITBOARD_init_tables);
+}
+
 void BITBOARD_print_debug(const bitboard_t bitboard)
 {
     int rank, file;
@@ -254,4 +262,3 @@ void BITBOARD_print_debug(const bitboard_t bitboard)
     }
     fprintf(stdout, "   A B C D E F G H\n");
 }
-
@@ -0,0 +1,260 @@
+#include <stdint.h>
+#include "endgame.h"
+#include "eval.h"
+#include "bitbase.h"
+#include "thread.h"
+
+/* Specialised evaluation of endgames the general evaluation misjudges: who
+ * can win, and how the winning side makes progress. The evaluators are
+ * found through the material of both sides, the number of pieces of each
+ * type packed into a key. Drawish endgames with more material, like
+ * opposite coloured bishops, scale the general evaluation instead. */
+
+#define ENDGAME_MAX_PIECES      5       /* Kings included */
+#define ENDGAME_TABLE_SIZE      64      /* Power of two, at least twice the number of entries */
+
+/* Score from the stronger side's point of view */
+typedef short (*endgame_function_t)(const chess_state_t *s, const int strong);
+
+typedef struct {
+    uint64_t           key;
+    endgame_function_t evaluate;
+    int                strong;          /* Color of the stronger side */
+} endgame_entry_t;
+
+/* Both written once by ENDGAME_init */
+static endgame_entry_t endgame_table[ENDGAME_TABLE_SIZE];
+static bitbase_t *endgame_bitbases = NULL;
+
+/* KBNK takes seconds to generate, only done by ENDGAME_load_kbnk_bitbase.
+ * Without it the evaluator does without. */
+static bitbase_t *endgame_kbnk_bitbase = NULL;
+static int endgame_kbnk_threads = 0;
+
+/* Four bits per color and piece type */
+static uint64_t ENDGAME_material_key(const chess_state_t *s)
+{
+    uint64_t key = 0;
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type <= QUEEN; type++) {
+            key |= (uint64_t)BITBOARD_count_bits(s->bitboard[NUM_TYPES*color+type]) << (4 * (KING*color + type));
+        }
+    }
+    return key;
+}
+
+/* Key of a name like KRvKP, with the first side as the given color */
+static uint64_t ENDGAME_material_key_of_name(const char *name, const int strong)
+{
+    static const char piece_chars[] = "PNBRQ";
+    uint64_t key = 0;
+    int color = strong;
+    for(; *name; name++) {
+        if(*name == 'v') color ^= 1;
+        for(int type = PAWN; type <= QUEEN; type++) {
+            if(*name == piece_chars[type]) key += (uint64_t)1 << (4 * (KING*color + type));
+        }
+    }
+    return key;
+}
+
+static int ENDGAME_slot(const uint64_t key)
+{
+    return (int)((key * 0x9E3779B97F4A7C15ULL) >> 58) & (ENDGAME_TABLE_SIZE - 1);
+}
+
+/* Drawn according to the bitbases, which know the three piece endgames */
+static int ENDGAME_bitbase_draw(const chess_state_t *s)
+{
+    int wdl;
+    return endgame_bitbases && BITBASE_probe(endgame_bitbases, s, &wdl) && wdl == RETROGRADE_DRAW;
+}
+
+static void ENDGAME_kbnk_generate()
+{
+    static const char * const names[] = { "KBNvK" };
+    endgame_kbnk_bitbase = BITBASE_create(names, 1, endgame_kbnk_threads);
+}
+
+/* 0 in the centre, 6 in the corners */
+static int ENDGAME_center_distance(const int pos)
+{
+    int file = BITBOARD_GET_FILE(pos);
+    int rank = BITBOARD_GET_RANK(pos);
+    return (file < 4 ? 3 - file : file - 4) + (rank < 4 ? 3 - rank : rank - 4);
+}
+
+/* Drive the lone king to the edge and follow it with the own king */
+static short ENDGAME_mate(const chess_state_t *s, const int strong, const short material)
+{
+    int strong_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*strong+KING]);
+    int weak_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KING]);
+    return ENDGAME_KNOWN_WIN + material + 4 * ENDGAME_center_distance(weak_king) + 2 * (7 - distance[strong_king][weak_king]);
+}
+
+static short ENDGAME_kqk(const chess_state_t *s, const int strong)
+{
+    if(ENDGAME_bitbase_draw(s)) return 0;
+    return ENDGAME_mate(s, strong, QUEEN_VALUE);
+}
+
+static short ENDGAME_krk(const chess_state_t *s, const int strong)
+{
+    if(ENDGAME_bitbase_draw(s)) return 0;
+    return ENDGAME_mate(s, strong, ROOK_VALUE);
+}
+
+/* Only registered with the bitbases, the pawn is pushed when it wins */
+static short ENDGAME_kpk(const chess_state_t *s, const int strong)
+{
+    int pawn = BITBOARD_find_bit(s->bitboard[NUM_TYPES*strong+PAWN]);
+    if(ENDGAME_bitbase_draw(s)) return 0;
+    return ENDGAME_KNOWN_WIN + PAWN_VALUE + 4 * BITBOARD_GET_RANK(pawn ^ (strong * 0x38));
+}
+
+/* The lone king can only be mated in a corner of the bishop's colour. It
+ * draws by taking a piece the other side cannot defend in time. */
+static short ENDGAME_kbnk(const chess_state_t *s, const int strong)
+{
+    int wdl;
+    if(endgame_kbnk_bitbase && BITBASE_probe(endgame_kbnk_bitbase, s, &wdl) && wdl == RETROGRADE_DRAW) return 0;
+
+    int strong_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*strong+KING]);
+    int weak_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KING]);
+    int corner_1 = A1, corner_2 = H8;
+    if(s->bitboard[NUM_TYPES*strong+BISHOP] & BITBOARD_WHITE_SQ) {
+        corner_1 = A8;
+        corner_2 = H1;
+    }
+    int corner_distance = distance[weak_king][corner_1] < distance[weak_king][corner_2] ? distance[weak_king][corner_1] : distance[weak_king][corner_2];
+    return ENDGAME_KNOWN_WIN + KNIGHT_VALUE + BISHOP_VALUE + 6 * (7 - corner_distance) +
+           2 * ENDGAME_center_distance(weak_king) + 2 * (7 - distance[strong_king][weak_king]);
+}
+
+/* Rook against pawn wins when the stronger king blocks the pawn or the weaker
+ * king is too far away. Otherwise it depends on how far the pawn got. */
+static short ENDGAME_krkp(const chess_state_t *s, const int strong)
+{
+    /* Seen from the stronger side, the pawn moves down */
+    const int flip = strong * 0x38;
+    int strong_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*strong+KING]) ^ flip;
+    int weak_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KING]) ^ flip;
+    int rook = BITBOARD_find_bit(s->bitboard[NUM_TYPES*strong+ROOK]) ^ flip;
+    int pawn = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+PAWN]) ^ flip;
+    int queening = BITBOARD_GET_FILE(pawn);
+    int weak_to_move = (s->player != strong);
+
+    if(strong_king < pawn && BITBOARD_GET_FILE(strong_king) == BITBOARD_GET_FILE(pawn)) {
+        return ROOK_VALUE - distance[strong_king][pawn];
+    }
+    if(distance[weak_king][pawn] >= 3 + weak_to_move && distance[weak_king][rook] >= 3) {
+        return ROOK_VALUE - distance[strong_king][pawn];
+    }
+    if(BITBOARD_GET_RANK(weak_king) <= 2 && distance[weak_king][pawn] == 1 &&
+       BITBOARD_GET_RANK(strong_king) >= 3 && distance[strong_king][pawn] > 2 + !weak_to_move) {
+        return PAWN_VALUE / 2;
+    }
+    return PAWN_VALUE - (distance[strong_king][pawn-8] - distance[weak_king][pawn-8] - distance[pawn][queening]);
+}
+
+/* Rook against a minor piece is mostly a draw, the rook can only try to
+ * drive the king to the edge and away from its piece */
+static short ENDGAME_krkb(const chess_state_t *s, const int strong)
+{
+    int weak_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KING]);
+    return 2 * ENDGAME_center_distance(weak_king);
+}
+
+static short ENDGAME_krkn(const chess_state_t *s, const int strong)
+{
+    int weak_king = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KING]);
+    int knight = BITBOARD_find_bit(s->bitboard[NUM_TYPES*(strong^1)+KNIGHT]);
+    return 2 * ENDGAME_center_distance(weak_king) + 2 * distance[weak_king][knight];
+}
+
+static void ENDGAME_add(const char *name, const endgame_function_t evaluate)
+{
+    for(int strong = WHITE; strong <= BLACK; strong++) {
+        uint64_t key = ENDGAME_material_key_of_name(name, strong);
+        int slot = ENDGAME_slot(key);
+        while(endgame_table[slot].evaluate) slot = (slot + 1) & (ENDGAME_TABLE_SIZE - 1);
+        endgame_table[slot].key = key;
+        endgame_table[slot].evaluate = evaluate;
+        endgame_table[slot].strong = strong;
+    }
+}
+
+static void ENDGAME_init_tables()
+{
+    static const char * const names[] = { "KQvK", "KRvK", "KPvK" };
+    endgame_bitbases = BITBASE_create(names, sizeof(names) / sizeof(names[0]), 0);
+
+    ENDGAME_add("KQvK", ENDGAME_kqk);
+    ENDGAME_add("KRvK", ENDGAME_krk);
+    ENDGAME_add("KBNvK", ENDGAME_kbnk);
+    ENDGAME_add("KRvKP", ENDGAME_krkp);
+    ENDGAME_add("KRvKB", ENDGAME_krkb);
+    ENDGAME_add("KRvKN", ENDGAME_krkn);
+    if(endgame_bitbases) ENDGAME_add("KPvK", ENDGAME_kpk);
+}
+
+/* Generates the bitbases and fills in the evaluators. Safe to call from
+ * several threads, it is only done once. */
+void ENDGAME_init()
+{
+    static once_t once = THREAD_ONCE_INIT;
+    BITBOARD_init();
+    THREAD_once(&once, ENDGAME_init_tables);
+}
+
+/* Generates the KBNK bitbase, which tells the positions where the lone
+ * king takes a piece. Opt-in, as it takes seconds. To be called before
+ * any evaluation, so that the evaluation never changes while the process
+ * runs. num_threads <= 0 uses one thread per core. */
+void ENDGAME_load_kbnk_bitbase(const int num_threads)
+{
+    static once_t once = THREAD_ONCE_INIT;
+    ENDGAME_init();
+    endgame_kbnk_threads = num_threads;
+    THREAD_once(&once, ENDGAME_kbnk_generate);
+}
+
+/* Returns non-zero and the score from the side to move's point of view if
+ * the material has an evaluator of its own */
+int ENDGAME_evaluate(const chess_state_t *s, short *score)
+{
+    if(BITBOARD_count_bits(s->bitboard[OCCUPIED]) > ENDGAME_MAX_PIECES) return 0;
+
+    uint64_t key = ENDGAME_material_key(s);
+    for(int slot = ENDGAME_slot(key); endgame_table[slot].evaluate; slot = (slot + 1) & (ENDGAME_TABLE_SIZE - 1)) {
+        const endgame_entry_t *entry = &endgame_table[slot];
+        if(entry->key == key) {
+            short strong_score = entry->evaluate(s, entry->strong);
+            *score = (s->player == entry->strong) ? strong_score : -strong_score;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Factor of the general evaluation, out of ENDGAME_SCALE_NORMAL */
+int ENDGAME_scale(const chess_state_t *s)
+{
+    const bitboard_t *b = s->bitboard;
+    bitboard_t white_bishop = b[WHITE_PIECES+BISHOP];
+    bitboard_t black_bishop = b[BLACK_PIECES+BISHOP];
+
+    /* Opposite coloured bishops and pawns only, drawish even a pawn or two down */
+    if(white_bishop && !(white_bishop & (white_bishop - 1)) &&
+       black_bishop && !(black_bishop & (black_bishop - 1)) &&
+       !(b[WHITE_PIECES+KNIGHT] | b[WHITE_PIECES+ROOK] | b[WHITE_PIECES+QUEEN] |
+         b[BLACK_PIECES+KNIGHT] | b[BLACK_PIECES+ROOK] | b[BLACK_PIECES+QUEEN]) &&
+       ((white_bishop & BITBOARD_WHITE_SQ) ? (black_bishop & BITBOARD_BLACK_SQ) : (black_bishop & BITBOARD_WHITE_SQ))) {
+        int pawn_difference = BITBOARD_count_bits(b[WHITE_PIECES+PAWN]) - BITBOARD_count_bits(b[BLACK_PIECES+PAWN]);
+        if(pawn_difference >= -1 && pawn_difference <= 1) return ENDGAME_SCALE_NORMAL / 4;
+        return ENDGAME_SCALE_NORMAL / 2;
+    }
+
+    return ENDGAME_SCALE_NORMAL;
+}
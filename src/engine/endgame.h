@@ -0,0 +1,17 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "state.h"
+
+/* Bonus for a won endgame, on top of the material */
+#define ENDGAME_KNOWN_WIN       200
+
+/* Scale factor of the general evaluation */
+#define ENDGAME_SCALE_NORMAL    256
+
+void ENDGAME_init();
+void ENDGAME_load_kbnk_bitbase(const int num_threads);
+int  ENDGAME_evaluate(const chess_state_t *s, short *score);
+int  ENDGAME_scale(const chess_state_t *s);
+
+#endif
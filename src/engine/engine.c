@@ -1,16 +1,24 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include "engine.h"
 #include "state.h"
 #include "hashtable.h"
 #include "history.h"
 #include "openingbook.h"
 #include "search.h"
+#include "search_quiescence.h"
 #include "san.h"
 #include "fen.h"
 #include "clock.h"
 #include "eval.h"
 #include "defines.h"
+#include "rng.h"
+#include "threadpool.h"
+#include "tablebase.h"
+#include "endgame.h"
 
 struct engine_state {
     chess_state_t       *chess_state;
@@ -18,44 +26,107 @@ struct engine_state {
     history_t           *history;
     openingbook_t       *obook;
     thinking_output_cb  think_cb;
-    search_state_t      search_state;
+    thinking_output_ex_cb think_cb_ex;
+    void                *think_arg;
+    unsigned int        max_nodes;
+    int                 mate_moves;
+    search_state_t      *search_state;
+    int                 hash_size_mb;
+    const eval_param_t  *eval_param;
+    const search_param_t *search_param;
+    tablebase_t         *tablebase;
+    int                 tablebase_probe_depth;
+    int                 search_algorithm;
+    rng_t               rng;
 };
 
-static void ENGINE_init()
+/* Allocate what is only needed for searching */
+static void ENGINE_alloc_search(engine_state_t *state)
 {
-    static int first_run = 1;
-    if(first_run) {
-        BITBOARD_init();
-        first_run = 0;
+    if(!state->hashtable) {
+        state->hashtable = HASHTABLE_create(state->hash_size_mb);
     }
+    if(!state->search_state) {
+        state->search_state = (search_state_t*)calloc(1, sizeof(search_state_t));
+    }
+    state->search_state->hashtable = state->hashtable;
+    state->search_state->history = state->history;
+    state->search_state->eval_param = state->eval_param;
+    state->search_state->search_param = state->search_param;
+    state->search_state->tablebase = state->tablebase;
+    state->search_state->tablebase_pieces = state->tablebase ? TABLEBASE_max_pieces(state->tablebase) : 0;
+    state->search_state->tablebase_probe_depth = (unsigned char)state->tablebase_probe_depth;
+    state->search_state->algorithm = (state->search_algorithm == ENGINE_ALGORITHM_PVS) ? SEARCH_ALGORITHM_PVS : SEARCH_ALGORITHM_MTDF;
+}
+
+void ENGINE_config_default(engine_config_t *config)
+{
+    config->hash_size_mb = 64;
+    config->book_path = "book.bin";
+    config->lazy_alloc = 0;
+    config->random_seed = 0;
+    config->eval_param = NULL;
+    config->search_param = NULL;
+    config->hashtable = NULL;
+    config->tablebase_path = NULL;
+    config->tablebase_probe_depth = 1;
+    config->search_algorithm = ENGINE_ALGORITHM_MTDF;
 }
+
 void ENGINE_create(engine_state_t **state)
 {
-    ENGINE_init();
+    engine_config_t config;
+    ENGINE_config_default(&config);
+    ENGINE_create_ex(state, &config);
+}
+
+void ENGINE_create_ex(engine_state_t **state, const engine_config_t *config)
+{
+    EVAL_init();
     *state = (engine_state_t*)calloc(1, sizeof(engine_state_t));
     (*state)->chess_state = (chess_state_t*)malloc(sizeof(chess_state_t));
-    (*state)->hashtable = HASHTABLE_create(64);
+    (*state)->hash_size_mb = config->hash_size_mb > 0 ? config->hash_size_mb : 0;
     (*state)->history = HISTORY_create();
-    (*state)->obook = OPENINGBOOK_create("book.bin");
+    (*state)->obook = config->book_path ? OPENINGBOOK_create(config->book_path) : NULL;
     (*state)->think_cb = NULL;
-    (*state)->search_state.hashtable = (*state)->hashtable;
-    (*state)->search_state.history = (*state)->history;
+    (*state)->think_cb_ex = NULL;
+    (*state)->think_arg = NULL;
+    (*state)->max_nodes = 0;
+    (*state)->mate_moves = 0;
+    if(config->hashtable) {
+        ENGINE_attach_hashtable(*state, config->hashtable);
+    }
+    (*state)->eval_param = config->eval_param ? config->eval_param : &EVAL_default_param;
+    (*state)->search_param = config->search_param ? config->search_param : &SEARCH_default_param;
+    ENGINE_set_tablebase_probe_depth(*state, config->tablebase_probe_depth);
+    ENGINE_set_tablebase_path(*state, config->tablebase_path);
+    (*state)->search_algorithm = config->search_algorithm;
+    RNG_seed(&(*state)->rng, config->random_seed ? config->random_seed : CLOCK_random_seed() ^ (uintptr_t)*state);
+    if(!config->lazy_alloc) {
+        ENGINE_alloc_search(*state);
+    }
     ENGINE_reset(*state);
 }
 
 void ENGINE_destroy(engine_state_t *state)
 {
-    HASHTABLE_destroy(state->hashtable);
+    if(state->hashtable) HASHTABLE_release(state->hashtable);
     HISTORY_destroy(state->history);
     OPENINGBOOK_destroy(state->obook);
+    TABLEBASE_close(state->tablebase);
+    free(state->search_state);
     free(state->chess_state);
     free(state);
 }
 
+/* A new game, the move ordering statistics of the old one are forgotten */
 void ENGINE_reset(engine_state_t *state)
 {
     STATE_reset(state->chess_state);
     HISTORY_reset(state->history);
+    if(state->search_state) {
+        memset(&state->search_state->stats, 0, sizeof(state->search_state->stats));
+    }
 }
 
 int ENGINE_apply_move(engine_state_t *state, const int pos_from, const int pos_to, const int promotion_type)
@@ -122,20 +193,26 @@ int ENGINE_search(engine_state_t *state, const int moves_left_in_period, const i
     if(time_for_move_ms < 0) time_for_move_ms = 1;
 
     /* Setup search state */
-    state->search_state.abort_search = 0;
-    state->search_state.next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
-    state->search_state.start_time_ms = CLOCK_now();
-    state->search_state.time_for_move_ms = time_for_move_ms;
-    state->search_state.max_depth = max_depth;
-    state->search_state.num_nodes_searched = 0;
-    state->search_state.think_cb = state->think_cb;
-
-    /* Look for a move in the opening book */
+    ENGINE_alloc_search(state);
+    state->search_state->abort_search = 0;
+    state->search_state->next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
+    state->search_state->start_time_ms = CLOCK_now();
+    state->search_state->time_for_move_ms = time_for_move_ms;
+    state->search_state->max_depth = max_depth;
+    state->search_state->num_nodes_searched = 0;
+    state->search_state->tablebase_hits = 0;
+    state->search_state->iir_reductions = 0;
+    state->search_state->max_nodes = state->max_nodes ? state->max_nodes : UINT_MAX;
+    state->search_state->mate_moves = state->mate_moves;
+    state->search_state->think_cb = state->think_cb_ex;
+    state->search_state->think_arg = state->think_arg;
+
+    /* Look for a move in the opening book, unless looking for a mate */
     short score = 0;
-    move_t move = OPENINGBOOK_get_move(state->obook, state->chess_state);
+    move_t move = (state->obook && !state->mate_moves) ? OPENINGBOOK_get_move(state->obook, state->chess_state, &state->rng) : 0;
     if(!move) {
         /* No move in the opening book. Search! */
-        move = SEARCH_perform_search(state->chess_state, &state->search_state, &score);
+        move = SEARCH_perform_search(state->chess_state, state->search_state, &score);
     }
 
     /* Translate move to: pos_from, pos_to, promotion_type */
@@ -173,18 +250,152 @@ int ENGINE_search(engine_state_t *state, const int moves_left_in_period, const i
 
 void ENGINE_search_stop(engine_state_t *state)
 {
-    state->search_state.abort_search = 1;
+    /* Nothing to stop before the first search */
+    if(state->search_state) {
+        state->search_state->abort_search = 1;
+    }
+}
+
+/* Forwards search output to a callback registered without an argument */
+static void ENGINE_search_output(void *arg, int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type)
+{
+    engine_state_t *state = (engine_state_t*)arg;
+    state->think_cb(ply, score, time_ms, nodes, pv_length, pos_from, pos_to, promotion_type);
 }
 
 void ENGINE_register_search_output_cb(engine_state_t *state, thinking_output_cb think_cb)
 {
     state->think_cb = think_cb;
+    state->think_cb_ex = think_cb ? ENGINE_search_output : NULL;
+    state->think_arg = state;
+}
+
+/* As ENGINE_register_search_output_cb, with arg passed on to every call */
+void ENGINE_register_search_output_cb_ex(engine_state_t *state, thinking_output_ex_cb think_cb, void *arg)
+{
+    state->think_cb = NULL;
+    state->think_cb_ex = think_cb;
+    state->think_arg = arg;
+}
+
+/* Stops searches after max_nodes nodes. 0 removes the limit. */
+void ENGINE_set_node_limit(engine_state_t *state, const unsigned int max_nodes)
+{
+    state->max_nodes = max_nodes;
+}
+
+/* Makes searches look for a mate in at most moves moves. Without one the
+ * move is picked by a search 2 * moves plies deep. 0 for normal searches. */
+void ENGINE_set_mate_search(engine_state_t *state, const int moves)
+{
+    state->mate_moves = moves;
+}
+
+/* Nodes searched by the latest search */
+unsigned int ENGINE_searched_nodes(engine_state_t *state)
+{
+    return state->search_state ? state->search_state->num_nodes_searched : 0;
 }
 
 void ENGINE_resize_hashtable(engine_state_t *state, const int size_mb)
 {
-    HASHTABLE_destroy(state->hashtable);
-    state->hashtable = HASHTABLE_create(size_mb);
+    state->hash_size_mb = size_mb > 0 ? size_mb : 0;
+
+    /* Not allocated yet: the new size is used on the first search */
+    if(!state->hashtable) return;
+
+    /* A shared table is left to the other engines, this one gets a private table */
+    HASHTABLE_release(state->hashtable);
+    state->hashtable = HASHTABLE_create(state->hash_size_mb);
+    if(state->search_state) {
+        state->search_state->hashtable = state->hashtable;
+    }
+}
+
+/* Creates a hashtable that can be attached to several engines. Engines may
+ * search concurrently while sharing it. The caller owns one reference. */
+struct hashtable_t *ENGINE_create_hashtable(const int size_mb)
+{
+    return HASHTABLE_create(size_mb > 0 ? size_mb : 0);
+}
+
+/* Drops the caller's reference, the table lives on while engines use it */
+void ENGINE_release_hashtable(struct hashtable_t *hashtable)
+{
+    HASHTABLE_release(hashtable);
+}
+
+/* Replaces the engine's hashtable. NULL detaches the engine, which then
+ * allocates a private table on its next search. Not to be called while the
+ * engine is searching. */
+void ENGINE_attach_hashtable(engine_state_t *state, struct hashtable_t *hashtable)
+{
+    if(hashtable) {
+        HASHTABLE_retain(hashtable);
+    }
+    if(state->hashtable) {
+        HASHTABLE_release(state->hashtable);
+    }
+    state->hashtable = hashtable;
+    if(state->search_state) {
+        state->search_state->hashtable = state->hashtable;
+    }
+}
+
+/* Finds the Syzygy endgame tables in the directories of path, separated
+ * by ':' (';' on Windows), replacing those found before. NULL or an empty path unloads them. Returns the number of tables
+ * found. Not to be called while the engine is searching. */
+int ENGINE_set_tablebase_path(engine_state_t *state, const char *path)
+{
+    TABLEBASE_close(state->tablebase);
+    state->tablebase = NULL;
+    if(path && path[0]) {
+        state->tablebase = TABLEBASE_open(path);
+        if(TABLEBASE_num_tables(state->tablebase) == 0) {
+            TABLEBASE_close(state->tablebase);
+            state->tablebase = NULL;
+        }
+    }
+    if(state->search_state) {
+        state->search_state->tablebase = state->tablebase;
+        state->search_state->tablebase_pieces = state->tablebase ? TABLEBASE_max_pieces(state->tablebase) : 0;
+    }
+    return state->tablebase ? TABLEBASE_num_tables(state->tablebase) : 0;
+}
+
+void ENGINE_set_tablebase_probe_depth(engine_state_t *state, const int depth)
+{
+    state->tablebase_probe_depth = depth < 0 ? 0 : depth > MAX_SEARCH_DEPTH ? MAX_SEARCH_DEPTH : depth;
+    if(state->search_state) {
+        state->search_state->tablebase_probe_depth = (unsigned char)state->tablebase_probe_depth;
+    }
+}
+
+/* Tablebase probes that found the position during the latest search */
+unsigned int ENGINE_tablebase_hits(engine_state_t *state)
+{
+    return state->search_state ? state->search_state->tablebase_hits : 0;
+}
+
+/* Internal iterative reductions during the latest search */
+unsigned int ENGINE_iir_reductions(engine_state_t *state)
+{
+    return state->search_state ? state->search_state->iir_reductions : 0;
+}
+
+/* Generates the KBNK bitbase of the evaluation, which takes seconds. Not
+ * to be called while the engine is searching. */
+void ENGINE_load_kbnk_bitbase()
+{
+    ENDGAME_load_kbnk_bitbase(0);
+}
+
+void ENGINE_set_search_algorithm(engine_state_t *state, const int algorithm)
+{
+    state->search_algorithm = algorithm;
+    if(state->search_state) {
+        state->search_state->algorithm = (algorithm == ENGINE_ALGORITHM_PVS) ? SEARCH_ALGORITHM_PVS : SEARCH_ALGORITHM_MTDF;
+    }
 }
 
 int ENGINE_set_board(engine_state_t *state, const char *fen)
@@ -202,3 +413,105 @@ int ENGINE_playing_side(engine_state_t *state)
 {
     return state->chess_state->player;
 }
+
+typedef struct {
+    hashtable_t         *hashtable;
+    history_t           *history;
+    search_state_t      *search_state;
+    int                 num_invalid;
+} batch_worker_t;
+
+typedef struct {
+    const char * const  *fens;
+    int                 depth;
+    int                 *scores;
+    batch_worker_t      *workers;
+} batch_t;
+
+static void ENGINE_evaluate_batch_job(void *arg, int worker, int first, int last)
+{
+    batch_t *batch = (batch_t*)arg;
+    batch_worker_t *w = &batch->workers[worker];
+    search_state_t *search_state = w->search_state;
+
+    /* Read the clock once per chunk, the time limit is never reached */
+    search_state->start_time_ms = CLOCK_now();
+    search_state->time_for_move_ms = INT64_MAX / 4;
+    search_state->next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
+
+    for(int i = first; i < last; i++) {
+        chess_state_t s;
+        if(!FEN_read(&s, batch->fens[i])) {
+            batch->scores[i] = 0;
+            w->num_invalid++;
+            continue;
+        }
+
+        short score;
+        if(batch->depth < 0) {
+            score = EVAL_evaluate_board(&s, search_state->eval_param);
+        } else if(batch->depth == 0) {
+            score = SEARCH_quiescence(&s, search_state, SEARCH_MIN_RESULT(1), SEARCH_MAX_RESULT(1), 0);
+        } else {
+            /* Start every search from scratch, results do not depend on the order of positions */
+            HASHTABLE_clear(search_state->hashtable);
+            HISTORY_reset_after_load(search_state->history, &s);
+            memset(search_state->killer_move, 0, sizeof(search_state->killer_move));
+            memset(&search_state->stats, 0, sizeof(search_state->stats));
+            search_state->abort_search = 0;
+            search_state->max_depth = batch->depth;
+            search_state->num_nodes_searched = 0;
+            SEARCH_perform_search(&s, search_state, &score);
+        }
+        batch->scores[i] = score;
+    }
+}
+
+/* Scores num_positions FENs from the side to move's point of view, in the
+ * same units as ENGINE_search. depth ENGINE_EVAL_STATIC gives the static
+ * evaluation, 0 the quiescence score and higher values a fixed depth search.
+ * No opening book, clock or output callback is involved. num_threads <= 0
+ * uses one thread per core. Positions that cannot be parsed score 0, and
+ * the number of them is returned. */
+int ENGINE_evaluate_batch(const char * const *fens, const int num_positions, const int depth, int *scores, const int num_threads)
+{
+    batch_t batch;
+    threadpool_t *pool;
+    int num_workers;
+    int num_invalid = 0;
+
+    EVAL_init();
+    pool = THREADPOOL_create(num_threads);
+    num_workers = THREADPOOL_num_threads(pool);
+
+    batch.fens = fens;
+    batch.depth = depth > MAX_SEARCH_DEPTH ? MAX_SEARCH_DEPTH : depth;
+    batch.scores = scores;
+    batch.workers = (batch_worker_t*)calloc(num_workers, sizeof(batch_worker_t));
+
+    /* Scratch state per worker. Only searches need a hashtable of some size. */
+    for(int i = 0; i < num_workers; i++) {
+        batch_worker_t *w = &batch.workers[i];
+        w->hashtable = HASHTABLE_create(batch.depth > 0 ? 1 : 0);
+        w->history = HISTORY_create();
+        w->search_state = (search_state_t*)calloc(1, sizeof(search_state_t));
+        w->search_state->hashtable = w->hashtable;
+        w->search_state->history = w->history;
+        w->search_state->eval_param = &EVAL_default_param;
+        w->search_state->search_param = &SEARCH_default_param;
+        w->search_state->max_nodes = UINT_MAX;
+    }
+
+    THREADPOOL_run(pool, num_positions, 256, ENGINE_evaluate_batch_job, &batch);
+
+    for(int i = 0; i < num_workers; i++) {
+        num_invalid += batch.workers[i].num_invalid;
+        HASHTABLE_release(batch.workers[i].hashtable);
+        HISTORY_destroy(batch.workers[i].history);
+        free(batch.workers[i].search_state);
+    }
+    free(batch.workers);
+    THREADPOOL_destroy(pool);
+
+    return num_invalid;
+}
@@ -14,10 +14,40 @@
 #define ENGINE_SEARCH_RUNNING       1
 #define ENGINE_SEARCH_COMPLETED     2
 
+#define ENGINE_EVAL_STATIC         -1
+
+#define ENGINE_ALGORITHM_MTDF       0
+#define ENGINE_ALGORITHM_PVS        1
+
+/* Search output score of a mate in n moves, negated when the side to move is mated */
+#define ENGINE_SCORE_MATE(n)        (100000 - (n))
+#define ENGINE_SCORE_IS_MATE(score) ((score) > ENGINE_SCORE_MATE(1000) || (score) < -ENGINE_SCORE_MATE(1000))
+/* Moves to the mate of a mate score, negative when the side to move is mated */
+#define ENGINE_SCORE_MATE_MOVES(score) (((score) > 0) ? ENGINE_SCORE_MATE(0) - (score) : -ENGINE_SCORE_MATE(0) - (score))
+
 typedef struct engine_state engine_state_t;
+struct hashtable_t;
+struct eval_param_t;
+struct search_param_t;
 typedef void (*thinking_output_cb)(int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type);
+typedef void (*thinking_output_ex_cb)(void *arg, int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type);
+
+typedef struct {
+    int         hash_size_mb;   /* Transposition table size. 0 gives a single entry table. */
+    const char  *book_path;     /* Opening book file. NULL for no opening book. */
+    int         lazy_alloc;     /* Allocate hashtable and search state on the first search */
+    unsigned int random_seed;   /* Seed for opening book move selection. 0 seeds from the clock. */
+    const struct eval_param_t *eval_param;  /* Evaluation parameters, not copied. NULL for the defaults. */
+    const struct search_param_t *search_param;  /* Search parameters, not copied. NULL for the defaults. */
+    struct hashtable_t *hashtable;          /* Shared hashtable to attach. NULL for a private table. */
+    const char  *tablebase_path;            /* Directories with Syzygy endgame tables. NULL for none. */
+    int         tablebase_probe_depth;      /* Least remaining depth for probing positions with as many pieces as the largest tables */
+    int         search_algorithm;           /* ENGINE_ALGORITHM_MTDF or ENGINE_ALGORITHM_PVS */
+} engine_config_t;
 
+void ENGINE_config_default(engine_config_t *config);
 void ENGINE_create(engine_state_t **state);
+void ENGINE_create_ex(engine_state_t **state, const engine_config_t *config);
 void ENGINE_destroy(engine_state_t *state);
 void ENGINE_reset(engine_state_t *state);
 int  ENGINE_apply_move(engine_state_t *state, const int pos_from, const int pos_to, const int promotion_type);
@@ -25,8 +55,22 @@ int  ENGINE_apply_move_san(engine_state_t *state, const char *san);
 int  ENGINE_search(engine_state_t *state, const int moves_left_in_period, const int time_left_ms, const int time_incremental_ms, const unsigned char max_depth, int *pos_from, int *pos_to, int *promotion_type);
 void ENGINE_search_stop(engine_state_t *state);
 void ENGINE_register_search_output_cb(engine_state_t *state, thinking_output_cb think_cb);
+void ENGINE_register_search_output_cb_ex(engine_state_t *state, thinking_output_ex_cb think_cb, void *arg);
+void ENGINE_set_node_limit(engine_state_t *state, const unsigned int max_nodes);
+void ENGINE_set_mate_search(engine_state_t *state, const int moves);
+unsigned int ENGINE_searched_nodes(engine_state_t *state);
 void ENGINE_resize_hashtable(engine_state_t *state, const int size_mb);
+struct hashtable_t *ENGINE_create_hashtable(const int size_mb);
+void ENGINE_release_hashtable(struct hashtable_t *hashtable);
+void ENGINE_attach_hashtable(engine_state_t *state, struct hashtable_t *hashtable);
+int  ENGINE_set_tablebase_path(engine_state_t *state, const char *path);
+void ENGINE_set_tablebase_probe_depth(engine_state_t *state, const int depth);
+unsigned int ENGINE_tablebase_hits(engine_state_t *state);
+unsigned int ENGINE_iir_reductions(engine_state_t *state);
+void ENGINE_set_search_algorithm(engine_state_t *state, const int algorithm);
+void ENGINE_load_kbnk_bitbase();
 int  ENGINE_set_board(engine_state_t *state, const char *fen);
 int  ENGINE_playing_side(engine_state_t *state);
+int  ENGINE_evaluate_batch(const char * const *fens, const int num_positions, const int depth, int *scores, const int num_threads);
 
 #endif
@@ -0,0 +1,122 @@
+#include <string.h>
+#include "epd.h"
+#include "fen.h"
+#include "san.h"
+
+/* Parse space separated SAN moves, annotations like "!" and "?" are ignored */
+static int EPD_read_moves(const chess_state_t *state, const char *operands, int length, move_t *moves, int *num_moves)
+{
+    int i = 0;
+
+    while(i < length) {
+        char san[16];
+        int san_length = 0;
+
+        while(i < length && operands[i] == ' ') i++;
+        while(i < length && operands[i] != ' ') {
+            char c = operands[i++];
+            if(c == '!' || c == '?') continue;
+            if(san_length >= (int)sizeof(san) - 1) return 0;
+            san[san_length++] = c;
+        }
+        if(san_length == 0) continue;
+        san[san_length] = '\0';
+
+        move_t move = SAN_parse_move(state, san);
+        if(!move || *num_moves >= EPD_MAX_MOVES) return 0;
+        moves[(*num_moves)++] = move;
+    }
+
+    return 1;
+}
+
+/* Create a position from an Extended Position Description line. The four
+ * FEN fields are followed by operations of the form: opcode operands; */
+int EPD_read(epd_position_t *epd, const char *line)
+{
+    int i = 0;
+    int field;
+
+    memset(epd, 0, sizeof(epd_position_t));
+
+    if(!FEN_read(&epd->state, line)) {
+        return 0;
+    }
+
+    /* Skip board, side to move, castling and en passant fields */
+    for(field = 0; field < 4; field++) {
+        while(line[i] == ' ') i++;
+        while(line[i] && line[i] != ' ') i++;
+    }
+
+    while(line[i]) {
+        const char *opcode;
+        const char *operands;
+        int opcode_length;
+        int length = 0;
+        int quoted = 0;
+
+        while(line[i] == ' ' || line[i] == '\t') i++;
+        if(!line[i] || line[i] == '\r' || line[i] == '\n') break;
+
+        opcode = &line[i];
+        while(line[i] && line[i] != ' ' && line[i] != ';') i++;
+        opcode_length = (int)(&line[i] - opcode);
+        while(line[i] == ' ') i++;
+
+        /* Operands end at the first semicolon outside a string */
+        operands = &line[i];
+        while(line[i] && (quoted || line[i] != ';')) {
+            if(line[i] == '"') quoted = !quoted;
+            if(line[i] == '\r' || line[i] == '\n') break;
+            i++;
+            length++;
+        }
+        if(line[i] == ';') i++;
+
+        if(opcode_length == 2 && strncmp(opcode, "bm", 2) == 0) {
+            if(!EPD_read_moves(&epd->state, operands, length, epd->best_moves, &epd->num_best_moves)) return 0;
+        } else if(opcode_length == 2 && strncmp(opcode, "am", 2) == 0) {
+            if(!EPD_read_moves(&epd->state, operands, length, epd->avoid_moves, &epd->num_avoid_moves)) return 0;
+        } else if(opcode_length == 2 && strncmp(opcode, "id", 2) == 0) {
+            if(length >= 2 && operands[0] == '"' && operands[length-1] == '"') {
+                operands++;
+                length -= 2;
+            }
+            if(length >= EPD_ID_SIZE) length = EPD_ID_SIZE - 1;
+            memcpy(epd->id, operands, length);
+            epd->id[length] = '\0';
+        }
+    }
+
+    return 1;
+}
+
+static int EPD_contains(const move_t *moves, const int num_moves, const int pos_from, const int pos_to, const int promotion_type)
+{
+    int i;
+
+    for(i = 0; i < num_moves; i++) {
+        if((int)MOVE_GET_POS_FROM(moves[i]) != pos_from) continue;
+        if((int)MOVE_GET_POS_TO(moves[i]) != pos_to) continue;
+        if((int)MOVE_PROMOTION_TYPE(moves[i]) != promotion_type) continue;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* A move solves the position if it is one of the best moves. Positions with
+ * moves to avoid only are solved by any other move. */
+int EPD_is_solution(const epd_position_t *epd, const int pos_from, const int pos_to, const int promotion_type)
+{
+    if(EPD_contains(epd->avoid_moves, epd->num_avoid_moves, pos_from, pos_to, promotion_type)) {
+        return 0;
+    }
+
+    if(epd->num_best_moves == 0) {
+        return epd->num_avoid_moves > 0;
+    }
+
+    return EPD_contains(epd->best_moves, epd->num_best_moves, pos_from, pos_to, promotion_type);
+}
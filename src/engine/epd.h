@@ -0,0 +1,21 @@
+#ifndef EPD_H
+#define EPD_H
+
+#include "state.h"
+
+#define EPD_MAX_MOVES   8
+#define EPD_ID_SIZE     64
+
+typedef struct {
+    chess_state_t   state;
+    move_t          best_moves[EPD_MAX_MOVES];      /* "bm" operands */
+    int             num_best_moves;
+    move_t          avoid_moves[EPD_MAX_MOVES];     /* "am" operands */
+    int             num_avoid_moves;
+    char            id[EPD_ID_SIZE];                /* "id" operand, empty if missing */
+} epd_position_t;
+
+int EPD_read(epd_position_t *epd, const char *line);
+int EPD_is_solution(const epd_position_t *epd, const int pos_from, const int pos_to, const int promotion_type);
+
+#endif
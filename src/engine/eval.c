@@ -1,7 +1,9 @@
+#include <string.h>
 #include "eval.h"
+#include "endgame.h"
 #include "movegen.h"
 
-eval_param_t param =
+const eval_param_t EVAL_default_param =
 {
     .psq = {
         .pawn =
@@ -131,6 +133,15 @@ eval_param_t param =
 
 static const short sign[2] = { 1, -1 };
 
+/* Prepares the endgame evaluation, see ENDGAME_init */
+void EVAL_init()
+{
+    ENDGAME_init();
+}
+
+/* Record the coefficient of a parameter when tracing */
+#define TRACE(field, phase, c) do { if(trace) trace->coeff[phase][(const int*)&param->field - (const int*)param] += (c); } while(0)
+
 /* Game progress: 256 = opening, 0 = endgame */
 static int EVAL_game_progress(short material[2])
 {
@@ -187,34 +198,47 @@ void EVAL_pawn_types(const chess_state_t *s, bitboard_t attack[NUM_COLORS], bitb
                      (pawns[BLACK] & ~attackFileFill[BLACK]);
 }
 
-static short EVAL_pawn_shield(const chess_state_t *s)
+static short EVAL_pawn_shield(const chess_state_t *s, const eval_param_t *param, eval_trace_t *trace)
 {
     const bitboard_t white_queenside = 0x000000000000000E;
     const bitboard_t white_kingside  = 0x00000000000000E0;
     const bitboard_t black_queenside = 0x0E00000000000000;
     const bitboard_t black_kingside  = 0xE000000000000000;
+    bitboard_t shield = 0;
+    int shield_1, shield_2;
     short score = 0;
 
     if(s->bitboard[WHITE_PIECES+KING] & white_queenside) {
-        score += BITBOARD_count_bits((white_queenside <<  8) & s->bitboard[WHITE_PIECES+PAWN]) * param.positional.pawn_shield_1;
-        score += BITBOARD_count_bits((white_queenside << 16) & s->bitboard[WHITE_PIECES+PAWN]) * param.positional.pawn_shield_2;
+        shield = white_queenside;
     } else if(s->bitboard[WHITE_PIECES+KING] & white_kingside) {
-        score += BITBOARD_count_bits((white_kingside <<  8) & s->bitboard[WHITE_PIECES+PAWN]) * param.positional.pawn_shield_1;
-        score += BITBOARD_count_bits((white_kingside << 16) & s->bitboard[WHITE_PIECES+PAWN]) * param.positional.pawn_shield_2;
+        shield = white_kingside;
+    }
+    if(shield) {
+        shield_1 = BITBOARD_count_bits((shield <<  8) & s->bitboard[WHITE_PIECES+PAWN]);
+        shield_2 = BITBOARD_count_bits((shield << 16) & s->bitboard[WHITE_PIECES+PAWN]);
+        score += shield_1 * param->positional.pawn_shield_1 + shield_2 * param->positional.pawn_shield_2;
+        TRACE(positional.pawn_shield_1, EVAL_TRACE_OPENING, shield_1);
+        TRACE(positional.pawn_shield_2, EVAL_TRACE_OPENING, shield_2);
     }
 
+    shield = 0;
     if(s->bitboard[BLACK_PIECES+KING] & black_queenside) {
-        score -= BITBOARD_count_bits((black_queenside >>  8) & s->bitboard[BLACK_PIECES+PAWN]) * param.positional.pawn_shield_1;
-        score -= BITBOARD_count_bits((black_queenside >> 16) & s->bitboard[BLACK_PIECES+PAWN]) * param.positional.pawn_shield_2;
+        shield = black_queenside;
     } else if(s->bitboard[BLACK_PIECES+KING] & black_kingside) {
-        score -= BITBOARD_count_bits((black_kingside >>  8) & s->bitboard[BLACK_PIECES+PAWN]) * param.positional.pawn_shield_1;
-        score -= BITBOARD_count_bits((black_kingside >> 16) & s->bitboard[BLACK_PIECES+PAWN]) * param.positional.pawn_shield_2;
+        shield = black_kingside;
+    }
+    if(shield) {
+        shield_1 = BITBOARD_count_bits((shield >>  8) & s->bitboard[BLACK_PIECES+PAWN]);
+        shield_2 = BITBOARD_count_bits((shield >> 16) & s->bitboard[BLACK_PIECES+PAWN]);
+        score -= shield_1 * param->positional.pawn_shield_1 + shield_2 * param->positional.pawn_shield_2;
+        TRACE(positional.pawn_shield_1, EVAL_TRACE_OPENING, -shield_1);
+        TRACE(positional.pawn_shield_2, EVAL_TRACE_OPENING, -shield_2);
     }
 
     return score;
 }
 
-short EVAL_evaluate_board(const chess_state_t *s)
+static short EVAL_evaluate(const chess_state_t *s, const eval_param_t *param, eval_trace_t *trace)
 {
     short pawn_material_score[NUM_COLORS] = { 0, 0 };
     short material_score[NUM_COLORS]      = { 0, 0 };
@@ -237,6 +261,9 @@ short EVAL_evaluate_board(const chess_state_t *s)
 
     if(EVAL_draw(s)) return 0;
 
+    /* Known endgames have evaluators of their own */
+    if(ENDGAME_evaluate(s, &score)) return score;
+
     rearmost_pawn[WHITE] = s->bitboard[WHITE_PIECES+PAWN] ? BITBOARD_GET_RANK(BITBOARD_find_bit(s->bitboard[WHITE_PIECES+PAWN])) : -1;
     rearmost_pawn[BLACK] = s->bitboard[BLACK_PIECES+PAWN] ? BITBOARD_GET_RANK(BITBOARD_find_bit_reversed(s->bitboard[BLACK_PIECES+PAWN])) : -1;
 
@@ -260,6 +287,8 @@ short EVAL_evaluate_board(const chess_state_t *s)
         bitboard_t straight_sliders = own[ROOK] | own[QUEEN];
         int num_king_attackers = 0;
         int king_pressure = 0;
+        int king_pressure_index[16];    /* Traced pressure terms, scaled when the number of attackers is known */
+        const short sg = sign[color];
 
         /* Pawns */
         pieces = own[PAWN];
@@ -269,45 +298,69 @@ short EVAL_evaluate_board(const chess_state_t *s)
             pos_bitboard = BITBOARD_POSITION(pos);
             rank = BITBOARD_GET_RANK(pos^pos_mask);
             pawn_material_score[color] += PAWN_VALUE;
-            positional_score[color] += param.psq.pawn[pos^pos_mask];
-            positional_score_o[color] += (pos_bitboard & pawnAttacks[color]) ? param.positional.pawn_guards_pawn : 0; /* Guarded by other pawn */
+            positional_score[color] += param->psq.pawn[pos^pos_mask];
+            TRACE(psq.pawn[pos^pos_mask], EVAL_TRACE_ALL, sg);
+            if(pos_bitboard & pawnAttacks[color]) {
+                /* Guarded by other pawn */
+                positional_score_o[color] += param->positional.pawn_guards_pawn;
+                TRACE(positional.pawn_guards_pawn, EVAL_TRACE_OPENING, sg);
+            }
             for(int type = PAWN; type <= QUEEN; type++) {
-                positional_score[color] += param.threat.pawn[type] * BITBOARD_count_bits(pawnAttacks[color] & opp[type]);
+                int num_threats = BITBOARD_count_bits(pawnAttacks[color] & opp[type]);
+                positional_score[color] += param->threat.pawn[type] * num_threats;
+                TRACE(threat.pawn[type], EVAL_TRACE_ALL, sg * num_threats);
             }
 
             /* Passed pawn */
             if(pos_bitboard & passedPawns) {
                 /* Initial bonus for passed pawn */
-                short bonus_o = (short)param.positional.pawn_passed_o;
-                short bonus_e = (short)param.positional.pawn_passed_e;
+                short bonus_o = (short)param->positional.pawn_passed_o;
+                short bonus_e = (short)param->positional.pawn_passed_e;
+                int unblocked = 0, unreachable = 0;
 
                 /* Distance to kings */
                 int dist_own_king = distance[king_pos[color]][pos];
                 int dist_opp_king = distance[king_pos[color^1]][pos];
-                bonus_e += (dist_opp_king - dist_own_king) * param.positional.pawn_passed_dist_kings_diff_e;
-                bonus_e += dist_own_king * param.positional.pawn_passed_dist_own_king_e;
+                bonus_e += (dist_opp_king - dist_own_king) * param->positional.pawn_passed_dist_kings_diff_e;
+                bonus_e += dist_own_king * param->positional.pawn_passed_dist_own_king_e;
 
                 /* Unblocked? */
                 if((bitboard_pawn_move[color][pos] & s->bitboard[OCCUPIED]) == 0) {
-                    bonus_e += param.positional.pawn_passed_unblocked;
+                    unblocked = 1;
+                    bonus_e += param->positional.pawn_passed_unblocked;
 
                     /* Unreachable by opponent king? */
                     int dist_prom = 7 - rank;
                     int prom_pos = (pos^pos_mask) + dist_prom * 8;
                     int dist_prom_opp_king = distance[king_pos[color^1]^pos_mask][prom_pos] - (color != s->player);
-                    bonus_e += param.positional.pawn_passed_unreachable_e * (dist_prom < dist_prom_opp_king);
+                    unreachable = (dist_prom < dist_prom_opp_king);
+                    bonus_e += param->positional.pawn_passed_unreachable_e * unreachable;
                 }
 
                 /* Scale bonus with rank */
-                int scale_factor = param.positional.pawn_passed_scaling[rank];
+                int scale_factor = param->positional.pawn_passed_scaling[rank];
                 positional_score_o[color] += (short)((int)bonus_o * scale_factor >> 8);
                 positional_score_e[color] += (short)((int)bonus_e * scale_factor >> 8);
+
+                if(trace) {
+                    float scale = sg * scale_factor / 256.0f;
+                    TRACE(positional.pawn_passed_o, EVAL_TRACE_OPENING, scale);
+                    TRACE(positional.pawn_passed_e, EVAL_TRACE_ENDGAME, scale);
+                    TRACE(positional.pawn_passed_dist_kings_diff_e, EVAL_TRACE_ENDGAME, scale * (dist_opp_king - dist_own_king));
+                    TRACE(positional.pawn_passed_dist_own_king_e, EVAL_TRACE_ENDGAME, scale * dist_own_king);
+                    TRACE(positional.pawn_passed_unblocked, EVAL_TRACE_ENDGAME, scale * unblocked);
+                    TRACE(positional.pawn_passed_unreachable_e, EVAL_TRACE_ENDGAME, scale * unreachable);
+                    TRACE(positional.pawn_passed_scaling[rank], EVAL_TRACE_OPENING, sg * bonus_o / 256.0f);
+                    TRACE(positional.pawn_passed_scaling[rank], EVAL_TRACE_ENDGAME, sg * bonus_e / 256.0f);
+                }
             }
 
             /* Isolated pawn */
             if(pos_bitboard & isolatedPawns) {
-                positional_score_o[color] += param.positional.pawn_isolated_o;
-                positional_score_e[color] += param.positional.pawn_isolated_e;
+                positional_score_o[color] += param->positional.pawn_isolated_o;
+                positional_score_e[color] += param->positional.pawn_isolated_e;
+                TRACE(positional.pawn_isolated_o, EVAL_TRACE_OPENING, sg);
+                TRACE(positional.pawn_isolated_e, EVAL_TRACE_ENDGAME, sg);
             }
 
             pieces ^= pos_bitboard;
@@ -319,17 +372,28 @@ short EVAL_evaluate_board(const chess_state_t *s)
         while(pieces) {
             pos = BITBOARD_find_bit(pieces);
             pos_bitboard = BITBOARD_POSITION(pos);
-            material_score[color] += KNIGHT_VALUE - (8 - num_opp_pawns) * param.positional.knight_reduction;
-            positional_score[color] += param.psq.knight[pos^pos_mask];
+            material_score[color] += KNIGHT_VALUE - (8 - num_opp_pawns) * param->positional.knight_reduction;
+            TRACE(positional.knight_reduction, EVAL_TRACE_ALL, -sg * (8 - num_opp_pawns));
+            positional_score[color] += param->psq.knight[pos^pos_mask];
+            TRACE(psq.knight[pos^pos_mask], EVAL_TRACE_ALL, sg);
             mobility_moves = bitboard_knight[pos] & ~(own_pieces | pawnAttacks[color^1]);
             piece_mobility = BITBOARD_count_bits(mobility_moves);
-            positional_score[color] += param.mobility.knight[piece_mobility];
-            positional_score_o[color] += (pos_bitboard & pawnAttacks[color]) ? param.positional.pawn_guards_minor : 0; /* Guarded by pawn */
+            positional_score[color] += param->mobility.knight[piece_mobility];
+            TRACE(mobility.knight[piece_mobility], EVAL_TRACE_ALL, sg);
+            if(pos_bitboard & pawnAttacks[color]) {
+                /* Guarded by pawn */
+                positional_score_o[color] += param->positional.pawn_guards_minor;
+                TRACE(positional.pawn_guards_minor, EVAL_TRACE_OPENING, sg);
+            }
             for(int type = PAWN; type <= QUEEN; type++) {
-                positional_score[color] += param.threat.knight[type] * BITBOARD_count_bits(bitboard_knight[pos] & opp[type]);
+                int num_threats = BITBOARD_count_bits(bitboard_knight[pos] & opp[type]);
+                positional_score[color] += param->threat.knight[type] * num_threats;
+                TRACE(threat.knight[type], EVAL_TRACE_ALL, sg * num_threats);
             }
             if(mobility_moves & king_zone[color^1]) {
-                king_pressure += param.pressure.knight[(int)distance[king_pos[color^1]][pos]];
+                int dist = distance[king_pos[color^1]][pos];
+                king_pressure += param->pressure.knight[dist];
+                if(trace) king_pressure_index[num_king_attackers] = &param->pressure.knight[dist] - (const int*)param;
                 ++num_king_attackers;
             }
             pieces ^= pos_bitboard;
@@ -345,17 +409,27 @@ short EVAL_evaluate_board(const chess_state_t *s)
             pos = BITBOARD_find_bit(pieces);
             pos_bitboard = BITBOARD_POSITION(pos);
             material_score[color] += BISHOP_VALUE;
-            positional_score[color] += param.psq.bishop[pos^pos_mask];
+            positional_score[color] += param->psq.bishop[pos^pos_mask];
+            TRACE(psq.bishop[pos^pos_mask], EVAL_TRACE_ALL, sg);
             MOVEGEN_bishop(pos, own_pieces & ~diagonal_sliders, opp_pieces, &moves, &captures);
             mobility_moves = (moves | captures) & ~pawnAttacks[color^1];
             piece_mobility = BITBOARD_count_bits(mobility_moves);
-            positional_score[color] += param.mobility.bishop[piece_mobility];
-            positional_score_o[color] += (pos_bitboard & pawnAttacks[color]) ? param.positional.pawn_guards_minor : 0; /* Guarded by pawn */
+            positional_score[color] += param->mobility.bishop[piece_mobility];
+            TRACE(mobility.bishop[piece_mobility], EVAL_TRACE_ALL, sg);
+            if(pos_bitboard & pawnAttacks[color]) {
+                /* Guarded by pawn */
+                positional_score_o[color] += param->positional.pawn_guards_minor;
+                TRACE(positional.pawn_guards_minor, EVAL_TRACE_OPENING, sg);
+            }
             for(int type = PAWN; type <= QUEEN; type++) {
-                positional_score[color] += param.threat.bishop[type] * BITBOARD_count_bits(captures & opp[type]);
+                int num_threats = BITBOARD_count_bits(captures & opp[type]);
+                positional_score[color] += param->threat.bishop[type] * num_threats;
+                TRACE(threat.bishop[type], EVAL_TRACE_ALL, sg * num_threats);
             }
             if(mobility_moves & king_zone[color^1]) {
-                king_pressure += param.pressure.bishop[(int)distance[king_pos[color^1]][pos]];
+                int dist = distance[king_pos[color^1]][pos];
+                king_pressure += param->pressure.bishop[dist];
+                if(trace) king_pressure_index[num_king_attackers] = &param->pressure.bishop[dist] - (const int*)param;
                 ++num_king_attackers;
             }
             pieces ^= pos_bitboard;
@@ -367,17 +441,24 @@ short EVAL_evaluate_board(const chess_state_t *s)
             bitboard_t file;
             pos = BITBOARD_find_bit(pieces);
             material_score[color] += ROOK_VALUE;
-            positional_score[color] += param.psq.rook[pos^pos_mask];
+            positional_score[color] += param->psq.rook[pos^pos_mask];
+            TRACE(psq.rook[pos^pos_mask], EVAL_TRACE_ALL, sg);
             MOVEGEN_rook(pos, own_pieces & ~straight_sliders, opp_pieces, &moves, &captures);
             mobility_moves = (moves | captures) & ~pawnAttacks[color^1];
             piece_mobility = BITBOARD_count_bits(mobility_moves);
-            positional_score_o[color] += param.mobility.rook_o[piece_mobility];
-            positional_score_e[color] += param.mobility.rook_e[piece_mobility];
+            positional_score_o[color] += param->mobility.rook_o[piece_mobility];
+            positional_score_e[color] += param->mobility.rook_e[piece_mobility];
+            TRACE(mobility.rook_o[piece_mobility], EVAL_TRACE_OPENING, sg);
+            TRACE(mobility.rook_e[piece_mobility], EVAL_TRACE_ENDGAME, sg);
             for(int type = PAWN; type <= QUEEN; type++) {
-                positional_score[color] += param.threat.rook[type] * BITBOARD_count_bits(captures & opp[type]);
+                int num_threats = BITBOARD_count_bits(captures & opp[type]);
+                positional_score[color] += param->threat.rook[type] * num_threats;
+                TRACE(threat.rook[type], EVAL_TRACE_ALL, sg * num_threats);
             }
             if(mobility_moves & king_zone[color^1]) {
-                king_pressure += param.pressure.rook[(int)distance[king_pos[color^1]][pos]];
+                int dist = distance[king_pos[color^1]][pos];
+                king_pressure += param->pressure.rook[dist];
+                if(trace) king_pressure_index[num_king_attackers] = &param->pressure.rook[dist] - (const int*)param;
                 ++num_king_attackers;
             }
 
@@ -386,19 +467,25 @@ short EVAL_evaluate_board(const chess_state_t *s)
             if((file & own[PAWN]) == 0) {
                 if((file & opp[PAWN]) == 0) {
                     /* Open file */
-                    positional_score_o[color] += param.positional.rook_open_file_o;
-                    positional_score_e[color] += param.positional.rook_open_file_e;
+                    positional_score_o[color] += param->positional.rook_open_file_o;
+                    positional_score_e[color] += param->positional.rook_open_file_e;
+                    TRACE(positional.rook_open_file_o, EVAL_TRACE_OPENING, sg);
+                    TRACE(positional.rook_open_file_e, EVAL_TRACE_ENDGAME, sg);
                 } else {
                     /* Half-open file */
-                    positional_score_o[color] += param.positional.rook_halfopen_file_o;
-                    positional_score_e[color] += param.positional.rook_halfopen_file_e;
+                    positional_score_o[color] += param->positional.rook_halfopen_file_o;
+                    positional_score_e[color] += param->positional.rook_halfopen_file_e;
+                    TRACE(positional.rook_halfopen_file_o, EVAL_TRACE_OPENING, sg);
+                    TRACE(positional.rook_halfopen_file_e, EVAL_TRACE_ENDGAME, sg);
                 }
             }
 
             /* Rooks on the rank of the opponents rearmost pawns */
             if(BITBOARD_GET_RANK(pos) == rearmost_pawn[color^1]) {
-                positional_score_o[color] += param.positional.rook_rearmost_pawn_o;
-                positional_score_e[color] += param.positional.rook_rearmost_pawn_e;
+                positional_score_o[color] += param->positional.rook_rearmost_pawn_o;
+                positional_score_e[color] += param->positional.rook_rearmost_pawn_e;
+                TRACE(positional.rook_rearmost_pawn_o, EVAL_TRACE_OPENING, sg);
+                TRACE(positional.rook_rearmost_pawn_e, EVAL_TRACE_ENDGAME, sg);
             }
 
             pieces ^= BITBOARD_POSITION(pos);
@@ -410,27 +497,44 @@ short EVAL_evaluate_board(const chess_state_t *s)
             bitboard_t moves_b, captures_b, moves_r, captures_r;
             pos = BITBOARD_find_bit(pieces);
             material_score[color] += QUEEN_VALUE;
-            positional_score[color] += param.psq.queen[pos^pos_mask];
+            positional_score[color] += param->psq.queen[pos^pos_mask];
+            TRACE(psq.queen[pos^pos_mask], EVAL_TRACE_ALL, sg);
             MOVEGEN_bishop(pos, own_pieces & ~diagonal_sliders, opp_pieces, &moves_b, &captures_b);
             MOVEGEN_rook(pos, own_pieces & ~straight_sliders, opp_pieces, &moves_r, &captures_r);
             mobility_moves = (moves_b | captures_b | moves_r | captures_r) & ~pawnAttacks[color^1];
             piece_mobility = BITBOARD_count_bits(mobility_moves);
-            positional_score_o[color] += param.mobility.queen_o[piece_mobility];
-            positional_score_e[color] += param.mobility.queen_e[piece_mobility];
+            positional_score_o[color] += param->mobility.queen_o[piece_mobility];
+            positional_score_e[color] += param->mobility.queen_e[piece_mobility];
+            TRACE(mobility.queen_o[piece_mobility], EVAL_TRACE_OPENING, sg);
+            TRACE(mobility.queen_e[piece_mobility], EVAL_TRACE_ENDGAME, sg);
             if(mobility_moves & king_zone[color^1]) {
-                king_pressure += param.pressure.queen[(int)distance[king_pos[color^1]][pos]];
+                int dist = distance[king_pos[color^1]][pos];
+                king_pressure += param->pressure.queen[dist];
+                if(trace) king_pressure_index[num_king_attackers] = &param->pressure.queen[dist] - (const int*)param;
                 ++num_king_attackers;
             }
             pieces ^= BITBOARD_POSITION(pos);
         }
 
         /* King */
-        positional_score_o[color] += param.psq.king_midgame[king_pos[color]^pos_mask];
-        positional_score_e[color] += param.psq.king_endgame[king_pos[color]^pos_mask];
+        positional_score_o[color] += param->psq.king_midgame[king_pos[color]^pos_mask];
+        positional_score_e[color] += param->psq.king_endgame[king_pos[color]^pos_mask];
+        TRACE(psq.king_midgame[king_pos[color]^pos_mask], EVAL_TRACE_OPENING, sg);
+        TRACE(psq.king_endgame[king_pos[color]^pos_mask], EVAL_TRACE_ENDGAME, sg);
+
+        if(trace) {
+            int n = num_king_attackers > 4 ? 4 : num_king_attackers;
+            for(int i = 0; i < num_king_attackers; i++) {
+                trace->coeff[EVAL_TRACE_OPENING][king_pressure_index[i]] += sg * param->pressure.scaling_midgame[n] / 16.0f;
+                trace->coeff[EVAL_TRACE_ENDGAME][king_pressure_index[i]] += sg * param->pressure.scaling_endgame[n] / 16.0f;
+            }
+            TRACE(pressure.scaling_midgame[n], EVAL_TRACE_OPENING, sg * king_pressure / 16.0f);
+            TRACE(pressure.scaling_endgame[n], EVAL_TRACE_ENDGAME, sg * king_pressure / 16.0f);
+        }
 
         if(num_king_attackers > 4) num_king_attackers = 4;
-        positional_score_o[color] += king_pressure * param.pressure.scaling_midgame[num_king_attackers] >> 4;
-        positional_score_e[color] += king_pressure * param.pressure.scaling_endgame[num_king_attackers] >> 4;
+        positional_score_o[color] += king_pressure * param->pressure.scaling_midgame[num_king_attackers] >> 4;
+        positional_score_e[color] += king_pressure * param->pressure.scaling_endgame[num_king_attackers] >> 4;
     }
 
     score += pawn_material_score[WHITE] - pawn_material_score[BLACK];
@@ -438,18 +542,70 @@ short EVAL_evaluate_board(const chess_state_t *s)
     score += positional_score[WHITE] - positional_score[BLACK];
 
     /* Pawn shield */
-    positional_score_o[WHITE] += EVAL_pawn_shield(s);
+    positional_score_o[WHITE] += EVAL_pawn_shield(s, param, trace);
 
     /* Add positional scores weighted by the progress of the game */
     game_progress = EVAL_game_progress(material_score);
+    if(trace) trace->game_progress = game_progress;
     score += (game_progress * (positional_score_o[WHITE] - positional_score_o[BLACK]) +
              (256 - game_progress) * (positional_score_e[WHITE] - positional_score_e[BLACK])) / 256;
 
+    /* Drawish endgames scale the score down */
+    int scale = ENDGAME_scale(s);
+    if(scale != ENDGAME_SCALE_NORMAL) {
+        score = (short)(score * scale / ENDGAME_SCALE_NORMAL);
+        if(trace) {
+            for(int i = 0; i < EVAL_NUM_PARAMS; i++) {
+                trace->coeff[EVAL_TRACE_ALL][i] *= scale / (float)ENDGAME_SCALE_NORMAL;
+                trace->coeff[EVAL_TRACE_OPENING][i] *= scale / (float)ENDGAME_SCALE_NORMAL;
+                trace->coeff[EVAL_TRACE_ENDGAME][i] *= scale / (float)ENDGAME_SCALE_NORMAL;
+            }
+        }
+    }
+
     /* Invert score for black player */
     score *= sign[(int)(s->player)];
 
     /* Add a bonus for the side with the right to move next */
-    score += param.positional.tempo;
+    score += param->positional.tempo;
+    TRACE(positional.tempo, EVAL_TRACE_ALL, sign[(int)(s->player)]);
+
+    return score;
+}
+
+short EVAL_evaluate_board(const chess_state_t *s, const eval_param_t *param)
+{
+    return EVAL_evaluate(s, param, NULL);
+}
+
+/* Evaluates the board and fills in the linearised evaluation. The returned
+ * score is from the side to move, the trace from white's perspective. */
+short EVAL_evaluate_board_trace(const chess_state_t *s, const eval_param_t *param, eval_trace_t *trace)
+{
+    const int *p = (const int*)param;
+    float dot = 0.0f;
+    short score;
+
+    memset(trace->coeff, 0, sizeof(trace->coeff));
+    trace->game_progress = 0;
+    trace->num_terms = 0;
+
+    score = EVAL_evaluate(s, param, trace);
+
+    for(int i = 0; i < EVAL_NUM_PARAMS; i++) {
+        float c = trace->coeff[EVAL_TRACE_ALL][i] +
+                  (trace->game_progress * trace->coeff[EVAL_TRACE_OPENING][i] +
+                  (256 - trace->game_progress) * trace->coeff[EVAL_TRACE_ENDGAME][i]) / 256.0f;
+        if(c != 0.0f) {
+            trace->terms[trace->num_terms].index = (short)i;
+            trace->terms[trace->num_terms].coeff = c;
+            trace->num_terms++;
+            dot += c * p[i];
+        }
+    }
+
+    /* Material, rounding and the linearisation offsets end up in the constant */
+    trace->constant = score * sign[(int)(s->player)] - dot;
 
     return score;
 }
@@ -525,3 +681,49 @@ int EVAL_draw(const chess_state_t *s)
 
     return (s->halfmove_clock >= 100);
 }
+
+/* Read parameters in the format written by the tuner, a C initializer of
+ * EVAL_default_param. Values are taken in declaration order, names and
+ * comments are skipped. Returns 0, leaving param untouched, if the number of
+ * values does not match. */
+int EVAL_read_param(eval_param_t *param, const char *text)
+{
+    eval_param_t read;
+    int *values = (int*)&read;
+    int num_values = 0;
+    const char *c = strchr(text, '=');
+
+    if(!c) return 0;
+
+    while(*c) {
+        if(c[0] == '/' && c[1] == '*') {
+            c = strstr(c + 2, "*/");
+            if(!c) return 0;
+            c += 2;
+        } else if(c[0] == '/' && c[1] == '/') {
+            while(*c && *c != '\n') c++;
+        } else if((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || *c == '_') {
+            /* Identifier, possibly containing digits */
+            while((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_') c++;
+        } else if((*c >= '0' && *c <= '9') || (*c == '-' && c[1] >= '0' && c[1] <= '9')) {
+            int sign = 1;
+            int v = 0;
+            if(*c == '-') {
+                sign = -1;
+                c++;
+            }
+            while(*c >= '0' && *c <= '9') {
+                v = 10 * v + (*(c++) - '0');
+            }
+            if(num_values == EVAL_NUM_PARAMS) return 0;
+            values[num_values++] = sign * v;
+        } else {
+            c++;
+        }
+    }
+
+    if(num_values != EVAL_NUM_PARAMS) return 0;
+
+    *param = read;
+    return 1;
+}
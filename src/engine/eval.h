@@ -13,7 +13,7 @@
 
 extern const short piecesquare[7][64];
 
-typedef struct {
+typedef struct eval_param_t {
     struct {
         int pawn[64];
         int knight[64];
@@ -70,9 +70,40 @@ typedef struct {
     } positional;
 } eval_param_t;
 
+/* Default evaluation parameters. Engines only read the parameters, so one
+ * set may be shared by any number of engine instances. */
+extern const eval_param_t EVAL_default_param;
+
+/* Number of int terms in eval_param_t */
+#define EVAL_NUM_PARAMS ((int)(sizeof(eval_param_t) / sizeof(int)))
+
+/* Phase classes used while tracing */
+#define EVAL_TRACE_ALL      0
+#define EVAL_TRACE_OPENING  1
+#define EVAL_TRACE_ENDGAME  2
+
+typedef struct {
+    short index;    /* Offset of the term in eval_param_t, in ints */
+    float coeff;
+} eval_trace_term_t;
+
+/* Linearised evaluation: score(white) = constant + sum(coeff * param[index]).
+ * Products of two parameters (passed pawn and king pressure scaling) are
+ * linearised around the current parameter values. */
+typedef struct {
+    float             constant;
+    int               num_terms;
+    eval_trace_term_t terms[EVAL_NUM_PARAMS];
+    int               game_progress;
+    float             coeff[3][EVAL_NUM_PARAMS];    /* Scratch, per phase class */
+} eval_trace_t;
+
+void  EVAL_init();
 void  EVAL_pawn_types(const chess_state_t *s, bitboard_t attack[NUM_COLORS], bitboard_t *passedPawns, bitboard_t *isolatedPawns);
-short EVAL_evaluate_board(const chess_state_t *s);
+short EVAL_evaluate_board(const chess_state_t *s, const eval_param_t *param);
+short EVAL_evaluate_board_trace(const chess_state_t *s, const eval_param_t *param, eval_trace_t *trace);
 int   EVAL_position_is_attacked(const chess_state_t *s, const int color, const int pos);
 int   EVAL_draw(const chess_state_t *s);
+int   EVAL_read_param(eval_param_t *param, const char *text);
 
 #endif
@@ -90,6 +90,15 @@ int FEN_read(chess_state_t *state, const char *fen)
         state->ep_file = STATE_EN_PASSANT_NONE;
     }
 
+    /* Half-move clock, if given. EPD has none. */
+    if(fen[i] == ' ' && fen[i+1] >= '0' && fen[i+1] <= '9') {
+        int halfmove_clock = 0;
+        for(i++; fen[i] >= '0' && fen[i] <= '9'; i++) {
+            if(halfmove_clock < 100) halfmove_clock = 10 * halfmove_clock + (fen[i] - '0');
+        }
+        state->halfmove_clock = (char)((halfmove_clock < 100) ? halfmove_clock : 100);
+    }
+
     /* Compute the hash of the state */
     STATE_compute_hash(state);
     state->last_move = 0;
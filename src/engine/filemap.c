@@ -0,0 +1,69 @@
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "filemap.h"
+
+/* Returns non-zero on success. An empty file is mapped as data = NULL, size = 0. */
+int FILEMAP_open(filemap_t *m, const char *filename)
+{
+    m->data = NULL;
+    m->size = 0;
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    m->mapping = NULL;
+    m->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(m->file == INVALID_HANDLE_VALUE) return 0;
+    if(!GetFileSizeEx(m->file, &size)) {
+        CloseHandle(m->file);
+        return 0;
+    }
+    m->size = (size_t)size.QuadPart;
+    if(m->size) {
+        m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(m->mapping) m->data = MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+        if(!m->data) {
+            FILEMAP_close(m);
+            return 0;
+        }
+    }
+#else
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return 0;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    m->size = (size_t)st.st_size;
+    if(m->size) {
+        void *data = mmap(NULL, m->size, PROT_READ, MAP_SHARED, fd, 0);
+        if(data == MAP_FAILED) {
+            close(fd);
+            m->size = 0;
+            return 0;
+        }
+        m->data = data;
+    }
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+#endif
+    return 1;
+}
+
+void FILEMAP_close(filemap_t *m)
+{
+#ifdef _WIN32
+    if(m->data) UnmapViewOfFile(m->data);
+    if(m->mapping) CloseHandle(m->mapping);
+    if(m->file != INVALID_HANDLE_VALUE) CloseHandle(m->file);
+    m->mapping = NULL;
+    m->file = INVALID_HANDLE_VALUE;
+#else
+    if(m->data) munmap((void*)m->data, m->size);
+#endif
+    m->data = NULL;
+    m->size = 0;
+}
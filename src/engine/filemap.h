@@ -0,0 +1,22 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/* Read-only memory mapping of a whole file */
+typedef struct {
+    const void  *data;
+    size_t      size;
+#ifdef _WIN32
+    HANDLE      file;
+    HANDLE      mapping;
+#endif
+} filemap_t;
+
+int  FILEMAP_open(filemap_t *m, const char *filename);
+void FILEMAP_close(filemap_t *m);
+
+#endif
@@ -1,4 +1,9 @@
+
 #include <stdlib.h>
+#include <string.h>
+#if !__GNUC__ && _MSC_VER
+#include <windows.h>
+#endif
 #include "hashtable.h"
 #include "search.h"
 
@@ -9,14 +14,35 @@ static int log2i(int n)
     return l;
 }
 
+/* Relaxed atomic accesses. Tearing is caught by the key check. */
+static inline uint64_t HASHTABLE_load(const uint64_t *p)
+{
+#if __GNUC__
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+    return *(volatile const uint64_t*)p;
+#endif
+}
+
+static inline void HASHTABLE_save(uint64_t *p, const uint64_t value)
+{
+#if __GNUC__
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+#else
+    *(volatile uint64_t*)p = value;
+#endif
+}
+
+/* Creates a table with a reference count of one */
 hashtable_t *HASHTABLE_create(const int size_mb)
 {
-    int num_entries = 1 << log2i(size_mb * 1024 * 1024 / sizeof(transposition_entry_t));
+    int num_entries = 1 << log2i(size_mb * 1024 * 1024 / sizeof(hashtable_slot_t));
 
     hashtable_t *h = (hashtable_t*)malloc(sizeof(hashtable_t));
     
-    h->entries = calloc(num_entries, sizeof(transposition_entry_t));
+    h->entries = calloc(num_entries, sizeof(hashtable_slot_t));
     h->key_mask = num_entries - 1;
+    h->refcount = 1;
 
     return h;
 }
@@ -27,24 +53,78 @@ void HASHTABLE_destroy(hashtable_t *h)
     free(h);
 }
 
+void HASHTABLE_clear(hashtable_t *h)
+{
+    memset(h->entries, 0, (size_t)(h->key_mask + 1) * sizeof(hashtable_slot_t));
+}
+
+void HASHTABLE_retain(hashtable_t *h)
+{
+#if __GNUC__
+    __atomic_add_fetch(&h->refcount, 1, __ATOMIC_RELAXED);
+#elif _MSC_VER
+    InterlockedIncrement(&h->refcount);
+#else
+    h->refcount++;
+#endif
+}
+
+/* Drops one reference, the table is destroyed when the last one is released */
+void HASHTABLE_release(hashtable_t *h)
+{
+    long refcount;
+#if __GNUC__
+    refcount = __atomic_sub_fetch(&h->refcount, 1, __ATOMIC_ACQ_REL);
+#elif _MSC_VER
+    refcount = InterlockedDecrement(&h->refcount);
+#else
+    refcount = --h->refcount;
+#endif
+    if(refcount == 0) {
+        HASHTABLE_destroy(h);
+    }
+}
+
 void HASHTABLE_transition_store(hashtable_t *h, const bitboard_t hash, const unsigned char depth, const unsigned char type, const short score, const move_t best_move)
 {
     int index = (int)(hash & h->key_mask);
-    transposition_entry_t *entry = &h->entries[index];
+    hashtable_slot_t *entry = &h->entries[index];
+    uint64_t data = (uint64_t)best_move |
+                    ((uint64_t)(uint16_t)score << 32) |
+                    ((uint64_t)depth << 48) |
+                    ((uint64_t)type << 56);
+
+    HASHTABLE_save(&entry->key, hash ^ data);
+    HASHTABLE_save(&entry->data, data);
+}
+
+/* Stores like HASHTABLE_transition_store, unless the slot holds a deeper
+ * entry of any position */
+void HASHTABLE_transition_store_shallow(hashtable_t *h, const bitboard_t hash, const unsigned char depth, const unsigned char type, const short score, const move_t best_move)
+{
+    int index = (int)(hash & h->key_mask);
+    uint64_t data = HASHTABLE_load(&h->entries[index].data);
 
-    entry->hash = hash;
-    entry->best_move = best_move;
-    entry->score = score;
-    entry->depth = depth;
-    entry->type = type;
+    if((unsigned char)(data >> 48) <= depth) {
+        HASHTABLE_transition_store(h, hash, depth, type, score, best_move);
+    }
 }
 
-transposition_entry_t *HASHTABLE_transition_retrieve(const hashtable_t *h, const bitboard_t hash)
+/* Returns non-zero and fills in entry if the position is found */
+int HASHTABLE_transition_retrieve(const hashtable_t *h, const bitboard_t hash, transposition_entry_t *entry)
 {
     int index = (int)(hash & h->key_mask);
-    if(h->entries[index].hash == hash) {
-        return &h->entries[index];
+    uint64_t key = HASHTABLE_load(&h->entries[index].key);
+    uint64_t data = HASHTABLE_load(&h->entries[index].data);
+
+    if((key ^ data) == hash) {
+        entry->hash = hash;
+        entry->best_move = (move_t)data;
+        entry->score = (short)(uint16_t)(data >> 32);
+        entry->depth = (unsigned char)(data >> 48);
+        entry->type = (unsigned char)(data >> 56);
+        return 1;
     }
 
-    return NULL;
+    return 0;
 }
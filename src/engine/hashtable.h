@@ -1,6 +1,7 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
+#include <stdint.h>
 #include "bitboard.h"
 #include "state.h"
 
@@ -12,9 +13,18 @@ typedef struct {
     unsigned char   type;
 } transposition_entry_t;
 
+/* Stored form of an entry. data packs move, score, depth and type, and key
+ * is hash ^ data. An entry torn by concurrent writers fails the key check,
+ * so a table can be shared by engines searching in parallel without locks. */
 typedef struct {
-    transposition_entry_t   *entries;
+    uint64_t        key;
+    uint64_t        data;
+} hashtable_slot_t;
+
+typedef struct hashtable_t {
+    hashtable_slot_t        *entries;
     bitboard_t              key_mask;
+    long                    refcount;
 } hashtable_t;
 
 #define TTABLE_TYPE_LOWER_BOUND     0
@@ -22,8 +32,12 @@ typedef struct {
 
 hashtable_t *HASHTABLE_create(const int size_mb);
 void HASHTABLE_destroy(hashtable_t *h);
+void HASHTABLE_clear(hashtable_t *h);
+void HASHTABLE_retain(hashtable_t *h);
+void HASHTABLE_release(hashtable_t *h);
 void HASHTABLE_transition_store(hashtable_t *h, const bitboard_t hash, const unsigned char depth, const unsigned char type, const short score, const move_t best_move);
-transposition_entry_t *HASHTABLE_transition_retrieve(const hashtable_t *h, const bitboard_t hash);
+void HASHTABLE_transition_store_shallow(hashtable_t *h, const bitboard_t hash, const unsigned char depth, const unsigned char type, const short score, const move_t best_move);
+int  HASHTABLE_transition_retrieve(const hashtable_t *h, const bitboard_t hash, transposition_entry_t *entry);
 
 static inline void HASHTABLE_transition_prefetch(const hashtable_t *h, const bitboard_t hash)
 {
@@ -36,4 +50,3 @@ static inline void HASHTABLE_transition_prefetch(const hashtable_t *h, const bit
 }
 
 #endif
-
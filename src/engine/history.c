@@ -1,14 +1,74 @@
 #include <stdlib.h>
 #include "history.h"
+#include "thread.h"
+
+/* Hashes are kept in a ring buffer. A repetition is never looked for
+ * further back than the half-move clock allows, which is far less. */
+#define HISTORY_SIZE        1024
+#define HISTORY_MASK        (HISTORY_SIZE-1)
 
 struct _history_t
 {
-    bitboard_t hash[1024];
+    bitboard_t hash[HISTORY_SIZE];
     int idx;
 };
 
+/* Cuckoo tables of all reversible moves, indexed by the hash difference
+ * between the positions before and after the move. Two hash functions
+ * give two possible slots for each move. */
+#define HISTORY_CUCKOO_SIZE     8192
+#define HISTORY_CUCKOO_H1(key)  ((int)((key) & (HISTORY_CUCKOO_SIZE-1)))
+#define HISTORY_CUCKOO_H2(key)  ((int)(((key) >> 16) & (HISTORY_CUCKOO_SIZE-1)))
+
+static bitboard_t cuckoo_key[HISTORY_CUCKOO_SIZE];
+static move_t cuckoo_move[HISTORY_CUCKOO_SIZE];
+
+static void HISTORY_init_cuckoo()
+{
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = KNIGHT; type <= KING; type++) {
+            for(int pos_from = 0; pos_from < NUM_POSITIONS; pos_from++) {
+                bitboard_t moves;
+                switch(type) {
+                case KNIGHT: moves = bitboard_knight[pos_from]; break;
+                case BISHOP: moves = bitboard_bishop[pos_from]; break;
+                case ROOK:   moves = bitboard_rook[pos_from]; break;
+                case QUEEN:  moves = bitboard_bishop[pos_from] | bitboard_rook[pos_from]; break;
+                default:     moves = bitboard_king[pos_from]; break;
+                }
+
+                /* Each move once, the hash difference is the same in both directions */
+                moves &= ~((BITBOARD_POSITION(pos_from) << 1) - 1);
+                while(moves) {
+                    int pos_to = BITBOARD_find_bit(moves);
+                    bitboard_t key = bitboard_zobrist[color][type][pos_from] ^ bitboard_zobrist[color][type][pos_to] ^ bitboard_zobrist_color;
+                    move_t move = pos_from | (pos_to << MOVE_POS_TO_SHIFT);
+
+                    /* Insert, pushing out whatever is in the way to its other slot */
+                    int i = HISTORY_CUCKOO_H1(key);
+                    for(;;) {
+                        bitboard_t tmp_key = cuckoo_key[i];
+                        move_t tmp_move = cuckoo_move[i];
+                        cuckoo_key[i] = key;
+                        cuckoo_move[i] = move;
+                        if(!tmp_move) break;
+                        key = tmp_key;
+                        move = tmp_move;
+                        i = (i == HISTORY_CUCKOO_H1(key)) ? HISTORY_CUCKOO_H2(key) : HISTORY_CUCKOO_H1(key);
+                    }
+
+                    moves ^= BITBOARD_POSITION(pos_to);
+                }
+            }
+        }
+    }
+}
+
 history_t *HISTORY_create()
 {
+    static once_t once = THREAD_ONCE_INIT;
+    THREAD_once(&once, HISTORY_init_cuckoo);
+
     history_t *h = (history_t*)malloc(sizeof(history_t));
     HISTORY_reset(h);
     return h;
@@ -39,7 +99,7 @@ void HISTORY_reset_after_load(history_t *h, const chess_state_t *s)
 
 void HISTORY_push(history_t *h, const bitboard_t hash)
 {
-    h->hash[++(h->idx)] = hash;
+    h->hash[++(h->idx) & HISTORY_MASK] = hash;
 }
 
 void HISTORY_pop(history_t *h)
@@ -47,15 +107,23 @@ void HISTORY_pop(history_t *h)
     h->idx--;
 }
 
+/* Index of the oldest hash a position may repeat */
+static int HISTORY_first(const history_t *h, const int halfmove_clock)
+{
+    int first = h->idx - halfmove_clock;
+    if(first < h->idx - HISTORY_MASK) first = h->idx - HISTORY_MASK;
+    return (first < 0) ? 0 : first;
+}
+
 int HISTORY_is_repetition(const history_t *h, const int halfmove_clock)
 {
     int i;
-    const bitboard_t hash = h->hash[h->idx];
-    const int first = h->idx - halfmove_clock;
+    const bitboard_t hash = h->hash[h->idx & HISTORY_MASK];
+    const int first = HISTORY_first(h, halfmove_clock);
     const int last = h->idx - 4;
-    
+
     for(i = last; i >= first; i -= 2) {
-        if(h->hash[i] == hash) {
+        if(h->hash[i & HISTORY_MASK] == hash) {
             return 1;
         }
     }
@@ -71,15 +139,45 @@ int HISTORY_is_threefold_repetition(const history_t *h, const int halfmove_clock
 {
     int i;
     int repetitions = 1;
-    const bitboard_t hash = h->hash[h->idx];
-    const int first = h->idx - halfmove_clock;
+    const bitboard_t hash = h->hash[h->idx & HISTORY_MASK];
+    const int first = HISTORY_first(h, halfmove_clock);
     const int last = h->idx - 4;
-    
+
     for(i = last; i >= first; i -= 2) {
-        if(h->hash[i] == hash) {
+        if(h->hash[i & HISTORY_MASK] == hash) {
             repetitions++;
         }
     }
 
     return (repetitions >= 3);
 }
+
+/* Whether the side to move has a move back to one of the positions in the
+ * last plies of the history, s being the newest. Such a draw is found a ply
+ * before HISTORY_is_repetition would. The caller limits plies to positions
+ * reached since the last null move in the search. */
+int HISTORY_is_upcoming_repetition(const history_t *h, const chess_state_t *s, int plies)
+{
+    if(plies > s->halfmove_clock) plies = s->halfmove_clock;
+    if(plies > h->idx) plies = h->idx;
+    if(plies > HISTORY_MASK) plies = HISTORY_MASK;
+
+    for(int i = 3; i <= plies; i += 2) {
+        bitboard_t key = s->hash ^ h->hash[(h->idx - i) & HISTORY_MASK];
+        int j = HISTORY_CUCKOO_H1(key);
+        if(cuckoo_key[j] != key) {
+            j = HISTORY_CUCKOO_H2(key);
+            if(cuckoo_key[j] != key) continue;
+        }
+
+        /* The piece must be the side to move's and able to get there */
+        int pos_from = MOVE_GET_POS_FROM(cuckoo_move[j]);
+        int pos_to = MOVE_GET_POS_TO(cuckoo_move[j]);
+        bitboard_t ends = BITBOARD_POSITION(pos_from) | BITBOARD_POSITION(pos_to);
+        if((s->bitboard[s->player*NUM_TYPES + ALL] & ends) && !(bitboard_between[pos_from][pos_to] & s->bitboard[OCCUPIED])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
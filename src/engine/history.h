@@ -14,5 +14,6 @@ void HISTORY_push(history_t *h, const bitboard_t hash);
 void HISTORY_pop(history_t *h);
 int HISTORY_is_repetition(const history_t *h, const int halfmove_clock);
 int HISTORY_is_threefold_repetition(const history_t *h, const int halfmove_clock);
+int HISTORY_is_upcoming_repetition(const history_t *h, const chess_state_t *s, int plies);
 
 #endif
@@ -4,8 +4,25 @@
 
 static const int piece_value[6] = { 1, 3, 3, 5, 9, 20 };
 
-void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move, const move_t *killer, const int history_heuristic[64][64])
+/* Sum of the history and both continuation histories of a quiet move,
+ * within +-3*MOVEORDER_HISTORY_MAX */
+int MOVEORDER_history_score(const chess_state_t *s, const move_t move, const moveorder_stats_t *stats, const move_t previous[2])
 {
+    const int type = MOVE_GET_TYPE(move);
+    const int pos_to = MOVE_GET_POS_TO(move);
+    int score = stats->history[s->player][MOVE_GET_POS_FROM(move)][pos_to];
+    for(int k = 0; k < 2; k++) {
+        if(previous[k]) {
+            score += stats->continuation[k][MOVE_GET_TYPE(previous[k])][MOVE_GET_POS_TO(previous[k])][type][pos_to];
+        }
+    }
+    return score;
+}
+
+void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move, const move_t *killer, const moveorder_stats_t *stats, const move_t previous[2])
+{
+    const move_t counter_move = previous[0] ? stats->counter_move[s->player][MOVE_GET_TYPE(previous[0])][MOVE_GET_POS_TO(previous[0])] : 0;
+
     /* Get score for each move */
     for(int i = 0; i < num_moves; i++) {
         int score = 0;
@@ -13,7 +30,6 @@ void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves,
             /* Hash move */
             score = 0x3FF;
         } else {
-            const int pos_from = MOVE_GET_POS_FROM(moves[i]);
             const int pos_to   = MOVE_GET_POS_TO(moves[i]);
 
             if(MOVE_IS_CAPTURE_OR_PROMOTION(moves[i])) {
@@ -40,13 +56,14 @@ void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves,
                     }
                 }
             } else { /* Quiet moves */
-                /* Killer moves */
+                /* Killer and counter moves */
                 if(moves[i] == killer[0]) score += 0x100;
                 else if(moves[i] == killer[1]) score += 0x0F0;
-
-                /* History heuristic */
-                int hist_val = history_heuristic[pos_from][pos_to];
-                score += BITBOARD_find_bit_reversed(hist_val | 1);
+                else if(moves[i] == counter_move) score += 0x0E0;
+                else {
+                    /* History and continuation history, 0 - 0xC0 */
+                    score += (MOVEORDER_history_score(s, moves[i], stats, previous) + 3 * MOVEORDER_HISTORY_MAX) >> 8;
+                }
             }
         }
 
@@ -54,12 +71,18 @@ void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves,
     }
 }
 
-void MOVEORDER_rate_moves_quiescence(const chess_state_t *s, move_t moves[], int num_moves)
+void MOVEORDER_rate_moves_quiescence(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move)
 {
     /* Get score for each move */
     for(int i = 0; i < num_moves; i++) {
         int score = 0;
 
+        if(moves[i] == hash_move) {
+            /* Hash move */
+            moves[i] |= 0x3FF << MOVE_SCORE_SHIFT;
+            continue;
+        }
+
         const int pos_to   = MOVE_GET_POS_TO(moves[i]);
         const int own_type = MOVE_GET_TYPE(moves[i]);
 
@@ -86,6 +109,36 @@ void MOVEORDER_rate_moves_quiescence(const chess_state_t *s, move_t moves[], int
     }
 }
 
+static inline void MOVEORDER_gravity(short *entry, const int bonus)
+{
+    *entry += (short)(bonus - *entry * (bonus < 0 ? -bonus : bonus) / MOVEORDER_HISTORY_MAX);
+}
+
+/* Rewards a quiet move that caused a cutoff and punishes the quiet moves
+ * searched before it */
+void MOVEORDER_update_stats(moveorder_stats_t *stats, const chess_state_t *s, const move_t previous[2], const move_t best_move, const move_t *quiets, const int num_quiets, const unsigned char depth)
+{
+    const int bonus = depth > 8 ? 2048 : 32 * depth * depth;
+
+    for(int i = -1; i < num_quiets; i++) {
+        const move_t move = (i < 0) ? best_move : quiets[i];
+        const int b = (i < 0) ? bonus : -bonus;
+        const int type = MOVE_GET_TYPE(move);
+        const int pos_to = MOVE_GET_POS_TO(move);
+
+        MOVEORDER_gravity(&stats->history[s->player][MOVE_GET_POS_FROM(move)][pos_to], b);
+        for(int k = 0; k < 2; k++) {
+            if(previous[k]) {
+                MOVEORDER_gravity(&stats->continuation[k][MOVE_GET_TYPE(previous[k])][MOVE_GET_POS_TO(previous[k])][type][pos_to], b);
+            }
+        }
+    }
+
+    if(previous[0]) {
+        stats->counter_move[s->player][MOVE_GET_TYPE(previous[0])][MOVE_GET_POS_TO(previous[0])] = best_move;
+    }
+}
+
 void MOVEORDER_best_move_first(move_t moves[], int num_moves)
 {
     move_t *best = moves + 0;
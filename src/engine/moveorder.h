@@ -3,8 +3,20 @@
 
 #include "state.h"
 
-void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move, const move_t *killer, const int history_heuristic[64][64]);
-void MOVEORDER_rate_moves_quiescence(const chess_state_t *s, move_t moves[], int num_moves);
+#define MOVEORDER_HISTORY_MAX   8192
+
+/* Statistics of quiet moves, kept between searches. The updates pull every
+ * entry towards +-MOVEORDER_HISTORY_MAX and never beyond. */
+typedef struct {
+    short   history[NUM_COLORS][64][64];                            /* By side to move, from and to */
+    short   continuation[2][NUM_TYPES-1][64][NUM_TYPES-1][64];      /* By the piece and target of the move one and two plies back */
+    move_t  counter_move[NUM_COLORS][NUM_TYPES-1][64];              /* Refutation of the piece and target of the previous move */
+} moveorder_stats_t;
+
+int  MOVEORDER_history_score(const chess_state_t *s, const move_t move, const moveorder_stats_t *stats, const move_t previous[2]);
+void MOVEORDER_rate_moves(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move, const move_t *killer, const moveorder_stats_t *stats, const move_t previous[2]);
+void MOVEORDER_update_stats(moveorder_stats_t *stats, const chess_state_t *s, const move_t previous[2], const move_t best_move, const move_t *quiets, const int num_quiets, const unsigned char depth);
+void MOVEORDER_rate_moves_quiescence(const chess_state_t *s, move_t moves[], int num_moves, const move_t hash_move);
 void MOVEORDER_best_move_first(move_t moves[], int num_moves);
 
 #endif
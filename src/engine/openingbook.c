@@ -1,7 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "openingbook.h"
-#include "clock.h"
 
 typedef struct _openingbook_node_t {
     uint64_t    hash;
@@ -47,10 +46,6 @@ openingbook_t *OPENINGBOOK_create(const char *filename)
         fclose(f);
     }
 
-
-    /* Seed random number generator */
-    srand(CLOCK_random_seed());
-    
     return o;
 }
 
@@ -63,7 +58,7 @@ void OPENINGBOOK_destroy(openingbook_t *o)
     }
 }
 
-move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s)
+move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s, rng_t *rng)
 {
     move_t move = 0;
     int first_node_index;
@@ -74,7 +69,7 @@ move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s)
 
     if(num_nodes) {
         /* Select one random node */
-        int offset = rand() % num_nodes;
+        int offset = RNG_next(rng) % num_nodes;
 
         /* Translate it to engines move syntax */
         move = OPENINGBOOK_translate_move(s, o->nodes[first_node_index+offset].move);
@@ -83,6 +78,21 @@ move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s)
     return move;
 }
 
+uint16_t OPENINGBOOK_polyglot_move(const move_t move)
+{
+    int pos_from = MOVE_GET_POS_FROM(move);
+    int pos_to = MOVE_GET_POS_TO(move);
+
+    /* Castling is encoded as the king capturing its own rook */
+    if(MOVE_GET_SPECIAL_FLAGS(move) == MOVE_KING_CASTLE) {
+        pos_to = pos_from + 3;
+    } else if(MOVE_GET_SPECIAL_FLAGS(move) == MOVE_QUEEN_CASTLE) {
+        pos_to = pos_from - 4;
+    }
+
+    return (uint16_t)(pos_to | (pos_from << 6) | (MOVE_PROMOTION_TYPE(move) << 12));
+}
+
 static void OPENINGBOOK_read_node(FILE *f, openingbook_node_t *node)
 {
     uint8_t buffer[16];
@@ -2,13 +2,15 @@
 #define OPENINGBOOK_H
 
 #include "state.h"
+#include "rng.h"
 
 struct _openingbook_t;
 typedef struct _openingbook_t openingbook_t;
 
 openingbook_t *OPENINGBOOK_create(const char *filename);
 void OPENINGBOOK_destroy(openingbook_t *o);
-move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s);
+move_t OPENINGBOOK_get_move(const openingbook_t *o, const chess_state_t *s, rng_t *rng);
+uint16_t OPENINGBOOK_polyglot_move(const move_t move);
 
 #endif
 
@@ -0,0 +1,75 @@
+#include <string.h>
+#include "pack.h"
+
+typedef char PACK_size_check[(sizeof(packed_position_t) == 32) ? 1 : -1];
+
+/* Pack the board, side to move, castling rights, en passant file and
+ * half-move clock. The result and score are left unknown. Returns 0 if
+ * the board has more pieces than fit. */
+int PACK_position(const chess_state_t *state, packed_position_t *p)
+{
+    memset(p, 0, sizeof(packed_position_t));
+    if(BITBOARD_count_bits(state->bitboard[OCCUPIED]) > 32) {
+        return 0;
+    }
+
+    p->occupied = state->bitboard[OCCUPIED];
+    p->player = state->player;
+    p->castling = (uint8_t)(state->castling[WHITE] | (state->castling[BLACK] << 2));
+    p->ep_file = state->ep_file;
+    p->halfmove_clock = (uint8_t)state->halfmove_clock;
+    p->result = PACK_RESULT_UNKNOWN;
+    p->score = PACK_SCORE_NONE;
+
+    bitboard_t pieces = state->bitboard[OCCUPIED];
+    int i = 0;
+    while(pieces) {
+        int pos = BITBOARD_find_bit(pieces);
+        int color = (state->bitboard[WHITE_PIECES+ALL] & BITBOARD_POSITION(pos)) ? WHITE : BLACK;
+        for(int type = PAWN; type <= KING; type++) {
+            if(state->bitboard[color*NUM_TYPES+type] & BITBOARD_POSITION(pos)) {
+                p->pieces[i/2] |= (color*NUM_TYPES+type) << (4*(i&1));
+                break;
+            }
+        }
+        i++;
+        pieces ^= BITBOARD_POSITION(pos);
+    }
+
+    return 1;
+}
+
+/* Restore a state, including its hash. Returns 0 if the packed data is invalid. */
+int PACK_unpack(const packed_position_t *p, chess_state_t *state)
+{
+    memset(state, 0, sizeof(chess_state_t));
+    if(BITBOARD_count_bits(p->occupied) > 32 || p->player > BLACK || p->castling > 0xF || p->ep_file > STATE_EN_PASSANT_NONE) {
+        return 0;
+    }
+
+    bitboard_t pieces = p->occupied;
+    int i = 0;
+    while(pieces) {
+        int pos = BITBOARD_find_bit(pieces);
+        int index = (p->pieces[i/2] >> (4*(i&1))) & 0xF;
+        if(index % NUM_TYPES == ALL || index >= NUM_COLORS*NUM_TYPES) return 0;
+        state->bitboard[index] |= BITBOARD_POSITION(pos);
+        i++;
+        pieces ^= BITBOARD_POSITION(pos);
+    }
+
+    for(int type = PAWN; type <= KING; type++) {
+        state->bitboard[WHITE_PIECES+ALL] |= state->bitboard[WHITE_PIECES+type];
+        state->bitboard[BLACK_PIECES+ALL] |= state->bitboard[BLACK_PIECES+type];
+    }
+    state->bitboard[OCCUPIED] = p->occupied;
+
+    state->player = p->player;
+    state->castling[WHITE] = p->castling & 0x3;
+    state->castling[BLACK] = (p->castling >> 2) & 0x3;
+    state->ep_file = p->ep_file;
+    state->halfmove_clock = (char)p->halfmove_clock;
+    STATE_compute_hash(state);
+
+    return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdint.h>
+#include "state.h"
+
+/* Game results from white's point of view */
+#define PACK_RESULT_BLACK_WINS      0
+#define PACK_RESULT_DRAW            1
+#define PACK_RESULT_WHITE_WINS      2
+#define PACK_RESULT_UNKNOWN         3
+
+#define PACK_SCORE_NONE             INT16_MIN
+
+/* A position in 32 bytes, host byte order */
+typedef struct {
+    uint64_t    occupied;
+    uint8_t     pieces[16];     /* One nibble per occupied square in ascending order: color * NUM_TYPES + type */
+    uint8_t     player;
+    uint8_t     castling;       /* White in bits 0-1, black in bits 2-3 */
+    uint8_t     ep_file;        /* STATE_EN_PASSANT_NONE if there is no en passant capture */
+    uint8_t     halfmove_clock;
+    uint8_t     result;         /* PACK_RESULT_* of the game the position is from */
+    uint8_t     reserved;
+    int16_t     score;          /* Search score from the side to move, PACK_SCORE_NONE if unknown */
+} packed_position_t;
+
+int  PACK_position(const chess_state_t *state, packed_position_t *p);
+int  PACK_unpack(const packed_position_t *p, chess_state_t *state);
+
+#endif
@@ -0,0 +1,321 @@
+#include <string.h>
+#include "pgn.h"
+#include "san.h"
+
+static int PGN_is_space(const char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/* Characters that end a move or other symbol */
+static int PGN_is_delimiter(const char c)
+{
+    return PGN_is_space(c) || c == '{' || c == '}' || c == '(' || c == ')' || c == '[' || c == ']' ||
+           c == ';' || c == '$' || c == '!' || c == '?' || c == '"';
+}
+
+static int PGN_is_digit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char *PGN_skip_line(const char *p, const char *end)
+{
+    const char *eol = (const char*)memchr(p, '\n', end - p);
+    return eol ? eol + 1 : end;
+}
+
+static int PGN_parse_result(const char *text, const int length)
+{
+    if(length == 3 && strncmp(text, "1-0", 3) == 0) return PGN_RESULT_WHITE_WINS;
+    if(length == 3 && strncmp(text, "0-1", 3) == 0) return PGN_RESULT_BLACK_WINS;
+    if(length == 7 && strncmp(text, "1/2-1/2", 7) == 0) return PGN_RESULT_DRAW;
+    return PGN_RESULT_UNKNOWN;
+}
+
+/* Length of a game termination marker at p, 0 if there is none */
+static int PGN_result_length(const char *p, const char *end)
+{
+    int length;
+    if(end - p >= 7 && strncmp(p, "1/2-1/2", 7) == 0) length = 7;
+    else if(end - p >= 3 && (strncmp(p, "1-0", 3) == 0 || strncmp(p, "0-1", 3) == 0)) length = 3;
+    else return 0;
+    return (p + length == end || PGN_is_delimiter(p[length])) ? length : 0;
+}
+
+/* Read the next token in [*pp, end). Move numbers and en passant suffixes are skipped. */
+static int PGN_scan(const char **pp, const char *end, pgn_token_t *token)
+{
+    const char *p = *pp;
+
+    while(1) {
+        while(p < end && PGN_is_space(*p)) p++;
+
+        token->text = p;
+        token->length = 0;
+        token->value = p;
+        token->value_length = 0;
+
+        if(p == end) {
+            token->type = PGN_TOKEN_END;
+            break;
+        }
+
+        const char *start = p;
+        const char c = *p;
+
+        if(c == '[') {
+            /* Tag pair: [Name "value"] */
+            p++;
+            while(p < end && PGN_is_space(*p)) p++;
+            token->text = p;
+            while(p < end && !PGN_is_space(*p) && *p != '"' && *p != ']') p++;
+            token->length = (int)(p - token->text);
+            while(p < end && *p != '"' && *p != ']' && *p != '\n') p++;
+            if(p < end && *p == '"') {
+                token->value = ++p;
+                while(p < end && *p != '"') {
+                    if(*p == '\\' && p + 1 < end) p++;
+                    p++;
+                }
+                token->value_length = (int)(p - token->value);
+                if(p < end) p++;
+            }
+            while(p < end && *p != ']' && *p != '\n') p++;
+            if(p < end && *p == ']') p++;
+            token->type = PGN_TOKEN_TAG;
+            break;
+        } else if(c == '{') {
+            const char *close = (const char*)memchr(p, '}', end - p);
+            token->text = p + 1;
+            p = close ? close + 1 : end;
+            token->length = (int)((close ? close : end) - token->text);
+            token->type = PGN_TOKEN_COMMENT;
+            break;
+        } else if(c == ';') {
+            token->text = p + 1;
+            p = PGN_skip_line(p, end);
+            token->length = (int)(p - token->text);
+            while(token->length > 0 && PGN_is_space(token->text[token->length-1])) token->length--;
+            token->type = PGN_TOKEN_COMMENT;
+            break;
+        } else if(c == '%') {
+            /* Escape mechanism, the rest of the line is ignored */
+            p = PGN_skip_line(p, end);
+            continue;
+        } else if(c == '(' || c == ')') {
+            p++;
+            token->length = 1;
+            token->type = (c == '(') ? PGN_TOKEN_VARIATION_START : PGN_TOKEN_VARIATION_END;
+            break;
+        } else if(c == '$' || c == '!' || c == '?') {
+            p++;
+            if(c == '$') {
+                while(p < end && PGN_is_digit(*p)) p++;
+            } else {
+                while(p < end && (*p == '!' || *p == '?')) p++;
+            }
+            token->length = (int)(p - start);
+            token->type = PGN_TOKEN_NAG;
+            break;
+        } else if(c == '*') {
+            p++;
+            token->length = 1;
+            token->type = PGN_TOKEN_RESULT;
+            break;
+        } else if(PGN_is_digit(c)) {
+            int length = PGN_result_length(p, end);
+            if(length) {
+                p += length;
+                token->length = length;
+                token->type = PGN_TOKEN_RESULT;
+                break;
+            }
+
+            /* Move number, unless it is castling written with zeros */
+            const char *q = p;
+            while(q < end && PGN_is_digit(*q)) q++;
+            if(q == end || *q == '.' || PGN_is_space(*q)) {
+                while(q < end && *q == '.') q++;
+                p = q;
+                continue;
+            }
+        } else if(c == '"' || c == ']' || c == '}') {
+            /* Stray character */
+            p++;
+            continue;
+        }
+
+        /* Symbol */
+        while(p < end && !PGN_is_delimiter(*p)) p++;
+        token->length = (int)(p - start);
+        if(token->length == 4 && strncmp(start, "e.p.", 4) == 0) continue;
+        token->type = PGN_TOKEN_MOVE;
+        break;
+    }
+
+    *pp = p;
+    return token->type;
+}
+
+/* Returns non-zero on success */
+int PGN_open(pgn_reader_t *reader, const char *filename)
+{
+    if(!FILEMAP_open(&reader->map, filename)) return 0;
+    reader->mapped = 1;
+    reader->p = (const char*)reader->map.data;
+    reader->end = reader->p + reader->map.size;
+    return 1;
+}
+
+/* Read from a buffer that must stay valid while the reader and its games are used */
+void PGN_open_buffer(pgn_reader_t *reader, const char *data, const size_t size)
+{
+    memset(&reader->map, 0, sizeof(filemap_t));
+    reader->mapped = 0;
+    reader->p = data;
+    reader->end = data + size;
+}
+
+void PGN_close(pgn_reader_t *reader)
+{
+    if(reader->mapped) FILEMAP_close(&reader->map);
+    reader->mapped = 0;
+    reader->p = reader->end = NULL;
+}
+
+int PGN_next_token(pgn_reader_t *reader, pgn_token_t *token)
+{
+    return PGN_scan(&reader->p, reader->end, token);
+}
+
+/* Read the tag pairs of the next game and find its end. The movetext is
+ * only tokenized, moves are read afterwards with PGN_next_move. A game ends
+ * at its termination marker or, if that is missing, at the tag pairs of the
+ * next game. Returns 0 when there are no more games. */
+int PGN_next_game(pgn_reader_t *reader, pgn_game_t *game)
+{
+    pgn_token_t token;
+    const char *p = reader->p;
+    const char *q;
+
+    game->result = PGN_RESULT_UNKNOWN;
+    game->has_fen = 0;
+    game->fen[0] = '\0';
+
+    while(p < reader->end && PGN_is_space(*p)) p++;
+    if(p == reader->end) {
+        reader->p = p;
+        return 0;
+    }
+    game->text = p;
+
+    /* Tag pairs */
+    q = p;
+    while(PGN_scan(&q, reader->end, &token) == PGN_TOKEN_TAG) {
+        if(token.length == 6 && strncmp(token.text, "Result", 6) == 0) {
+            game->result = PGN_parse_result(token.value, token.value_length);
+        } else if(token.length == 3 && strncmp(token.text, "FEN", 3) == 0) {
+            int length = token.value_length < PGN_FEN_SIZE ? token.value_length : PGN_FEN_SIZE - 1;
+            memcpy(game->fen, token.value, length);
+            game->fen[length] = '\0';
+            game->has_fen = 1;
+        }
+        p = q;
+    }
+    game->movetext = p;
+
+    /* Movetext */
+    q = p;
+    while(1) {
+        int type = PGN_scan(&q, reader->end, &token);
+        if(type == PGN_TOKEN_END || type == PGN_TOKEN_TAG) break;
+        p = q;
+        if(type == PGN_TOKEN_RESULT) {
+            if(game->result == PGN_RESULT_UNKNOWN) game->result = PGN_parse_result(token.text, token.length);
+            break;
+        }
+    }
+
+    game->p = game->movetext;
+    game->end = p;
+    game->length = (size_t)(p - game->text);
+    reader->p = p;
+    return 1;
+}
+
+/* Next move of the main line, comments, NAGs and variations are skipped.
+ * san must hold SAN_MAX_SIZE characters, longer symbols are returned as an
+ * empty string. Returns 0 at the end of the game. */
+int PGN_next_move(pgn_game_t *game, char *san)
+{
+    pgn_token_t token;
+    int depth = 0;
+
+    while(1) {
+        switch(PGN_scan(&game->p, game->end, &token)) {
+        case PGN_TOKEN_END:
+        case PGN_TOKEN_RESULT:
+            return 0;
+        case PGN_TOKEN_VARIATION_START:
+            depth++;
+            break;
+        case PGN_TOKEN_VARIATION_END:
+            if(depth > 0) depth--;
+            break;
+        case PGN_TOKEN_MOVE:
+            if(depth == 0) {
+                int length = token.length < SAN_MAX_SIZE ? token.length : 0;
+                memcpy(san, token.text, length);
+                san[length] = '\0';
+                return 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Copy the value of a tag pair, escapes removed. Returns 0 if the game has no such tag. */
+int PGN_read_tag(const pgn_game_t *game, const char *name, char *value, const int size)
+{
+    pgn_token_t token;
+    const char *p = game->text;
+    const int name_length = (int)strlen(name);
+
+    while(p < game->movetext && PGN_scan(&p, game->movetext, &token) == PGN_TOKEN_TAG) {
+        if(token.length == name_length && strncmp(token.text, name, name_length) == 0) {
+            int length = 0;
+            for(int i = 0; i < token.value_length && length < size - 1; i++) {
+                if(token.value[i] == '\\' && i + 1 < token.value_length) i++;
+                value[length++] = token.value[i];
+            }
+            if(size > 0) value[length] = '\0';
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Offset of the first game starting at or after pos, or size if there is
+ * none. A game starts with a tag pair at the beginning of a line that does
+ * not follow another tag pair. Used to split files into chunks of whole
+ * games without parsing them. */
+size_t PGN_find_game_start(const char *data, const size_t size, size_t pos)
+{
+    while(pos < size) {
+        const char *c = (const char*)memchr(data + pos, '[', size - pos);
+        if(!c) break;
+        pos = (size_t)(c - data);
+        if(pos == 0) return 0;
+        if(data[pos-1] == '\n') {
+            size_t i = pos - 1;
+            while(i > 0 && PGN_is_space(data[i-1])) i--;
+            if(i == 0 || data[i-1] != ']') return pos;
+        }
+        pos++;
+    }
+    return size;
+}
@@ -0,0 +1,61 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stddef.h>
+#include "filemap.h"
+
+/* Game results from white's point of view */
+#define PGN_RESULT_UNKNOWN          -1
+#define PGN_RESULT_BLACK_WINS       0
+#define PGN_RESULT_DRAW             1
+#define PGN_RESULT_WHITE_WINS       2
+
+#define PGN_TOKEN_END               0
+#define PGN_TOKEN_TAG               1   /* text is the tag name, value the tag value */
+#define PGN_TOKEN_MOVE              2   /* SAN without move number and annotation */
+#define PGN_TOKEN_COMMENT           3   /* Text of a {} or ; comment */
+#define PGN_TOKEN_NAG               4   /* $n or an annotation such as "!?" */
+#define PGN_TOKEN_VARIATION_START   5
+#define PGN_TOKEN_VARIATION_END     6
+#define PGN_TOKEN_RESULT            7   /* Game termination marker */
+
+#define PGN_FEN_SIZE                128
+
+/* Token text points into the PGN data and is not NUL terminated */
+typedef struct {
+    int         type;
+    const char  *text;
+    int         length;
+    const char  *value;
+    int         value_length;
+} pgn_token_t;
+
+/* Reader over a memory mapped file or a buffer owned by the caller */
+typedef struct {
+    filemap_t   map;
+    int         mapped;
+    const char  *p;
+    const char  *end;
+} pgn_reader_t;
+
+typedef struct {
+    int         result;             /* PGN_RESULT_*, from the Result tag or the termination marker */
+    int         has_fen;
+    char        fen[PGN_FEN_SIZE];  /* Value of the FEN tag */
+    const char  *text;              /* The whole game, tag pairs and movetext */
+    size_t      length;
+    const char  *movetext;
+    const char  *p;                 /* Main line cursor of PGN_next_move */
+    const char  *end;
+} pgn_game_t;
+
+int    PGN_open(pgn_reader_t *reader, const char *filename);
+void   PGN_open_buffer(pgn_reader_t *reader, const char *data, const size_t size);
+void   PGN_close(pgn_reader_t *reader);
+int    PGN_next_token(pgn_reader_t *reader, pgn_token_t *token);
+int    PGN_next_game(pgn_reader_t *reader, pgn_game_t *game);
+int    PGN_next_move(pgn_game_t *game, char *san);
+int    PGN_read_tag(const pgn_game_t *game, const char *name, char *value, const int size);
+size_t PGN_find_game_start(const char *data, const size_t size, size_t pos);
+
+#endif
@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "positionfile.h"
+
+/* File layout, integers in little-endian byte order:
+ *
+ *   Header    "DROPOS01", chunk size (u32), number of chunks (u32),
+ *             number of positions (u64), index offset (u64)
+ *   Chunks    packed_position_t arrays, each stored raw or zlib compressed
+ *   Index     Per chunk: offset (u64), stored size (u32), number of
+ *             positions (u32), compression (u32), reserved (u32)
+ *
+ * The header is rewritten with the index offset when a file is closed. */
+
+#define POSITIONFILE_MAGIC          "DROPOS01"
+#define POSITIONFILE_HEADER_SIZE    32
+#define POSITIONFILE_INDEX_SIZE     24
+
+typedef struct {
+    uint64_t    offset;
+    uint32_t    stored_size;
+    uint32_t    num_positions;
+    uint32_t    compression;
+    uint64_t    first_position;     /* Not stored, sum of the preceding chunks */
+} positionfile_chunk_t;
+
+struct positionfile_t {
+    FILE                    *f;
+    int                     writing;
+    int                     compression;
+    int                     error;
+
+    positionfile_chunk_t    *chunks;
+    uint32_t                num_chunks;
+    uint32_t                max_chunks;
+    uint64_t                num_positions;
+
+    /* Current chunk */
+    packed_position_t       *buffer;
+    uint32_t                buffer_count;
+    uint32_t                buffer_pos;
+    uint32_t                next_chunk;
+    unsigned char           *stored;
+    size_t                  stored_capacity;
+};
+
+static void POSITIONFILE_put_u32(unsigned char *b, const uint32_t v)
+{
+    for(int i = 0; i < 4; i++) b[i] = (unsigned char)(v >> (8*i));
+}
+
+static void POSITIONFILE_put_u64(unsigned char *b, const uint64_t v)
+{
+    for(int i = 0; i < 8; i++) b[i] = (unsigned char)(v >> (8*i));
+}
+
+static uint32_t POSITIONFILE_get_u32(const unsigned char *b)
+{
+    uint32_t v = 0;
+    for(int i = 3; i >= 0; i--) v = (v << 8) | b[i];
+    return v;
+}
+
+static uint64_t POSITIONFILE_get_u64(const unsigned char *b)
+{
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; i--) v = (v << 8) | b[i];
+    return v;
+}
+
+static int POSITIONFILE_fseek(FILE *f, const uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t POSITIONFILE_ftell(FILE *f)
+{
+#ifdef _WIN32
+    return (uint64_t)_ftelli64(f);
+#else
+    return (uint64_t)ftello(f);
+#endif
+}
+
+static void POSITIONFILE_reserve_stored(positionfile_t *f, const size_t size)
+{
+    if(size > f->stored_capacity) {
+        f->stored = (unsigned char*)realloc(f->stored, size);
+        f->stored_capacity = size;
+    }
+}
+
+static int POSITIONFILE_write_header(positionfile_t *f, const uint64_t index_offset)
+{
+    unsigned char header[POSITIONFILE_HEADER_SIZE];
+    memcpy(header, POSITIONFILE_MAGIC, 8);
+    POSITIONFILE_put_u32(header + 8, POSITIONFILE_CHUNK_SIZE);
+    POSITIONFILE_put_u32(header + 12, f->num_chunks);
+    POSITIONFILE_put_u64(header + 16, f->num_positions);
+    POSITIONFILE_put_u64(header + 24, index_offset);
+    return POSITIONFILE_fseek(f->f, 0) && fwrite(header, POSITIONFILE_HEADER_SIZE, 1, f->f) == 1;
+}
+
+/* Compress and append the buffered positions as a new chunk */
+static void POSITIONFILE_flush_chunk(positionfile_t *f)
+{
+    const size_t raw_size = f->buffer_count * sizeof(packed_position_t);
+    const unsigned char *data = (const unsigned char*)f->buffer;
+    size_t stored_size = raw_size;
+    uint32_t compression = POSITIONFILE_COMPRESSION_NONE;
+
+    if(f->buffer_count == 0) return;
+
+#ifdef HAVE_ZLIB
+    if(f->compression == POSITIONFILE_COMPRESSION_ZLIB) {
+        uLongf size = compressBound((uLong)raw_size);
+        POSITIONFILE_reserve_stored(f, size);
+        if(compress2(f->stored, &size, data, (uLong)raw_size, Z_DEFAULT_COMPRESSION) == Z_OK && size < raw_size) {
+            data = f->stored;
+            stored_size = size;
+            compression = POSITIONFILE_COMPRESSION_ZLIB;
+        }
+    }
+#endif
+
+    if(f->num_chunks == f->max_chunks) {
+        f->max_chunks = f->max_chunks ? 2 * f->max_chunks : 256;
+        f->chunks = (positionfile_chunk_t*)realloc(f->chunks, f->max_chunks * sizeof(positionfile_chunk_t));
+    }
+    positionfile_chunk_t *chunk = &f->chunks[f->num_chunks++];
+    chunk->offset = POSITIONFILE_ftell(f->f);
+    chunk->stored_size = (uint32_t)stored_size;
+    chunk->num_positions = f->buffer_count;
+    chunk->compression = compression;
+    chunk->first_position = f->num_positions;
+
+    if(fwrite(data, 1, stored_size, f->f) != stored_size) f->error = 1;
+    f->num_positions += f->buffer_count;
+    f->buffer_count = 0;
+}
+
+/* Load a chunk into the buffer. Returns 0 if it cannot be read. */
+static int POSITIONFILE_load_chunk(positionfile_t *f, const uint32_t index)
+{
+    const positionfile_chunk_t *chunk = &f->chunks[index];
+    const size_t raw_size = chunk->num_positions * sizeof(packed_position_t);
+
+    f->buffer_count = 0;
+    f->buffer_pos = 0;
+    if(!POSITIONFILE_fseek(f->f, chunk->offset)) return 0;
+
+    if(chunk->compression == POSITIONFILE_COMPRESSION_NONE) {
+        if(chunk->stored_size != raw_size) return 0;
+        if(fread(f->buffer, 1, raw_size, f->f) != raw_size) return 0;
+    } else {
+#ifdef HAVE_ZLIB
+        uLongf size = (uLongf)raw_size;
+        POSITIONFILE_reserve_stored(f, chunk->stored_size);
+        if(fread(f->stored, 1, chunk->stored_size, f->f) != chunk->stored_size) return 0;
+        if(uncompress((Bytef*)f->buffer, &size, f->stored, chunk->stored_size) != Z_OK || size != raw_size) return 0;
+#else
+        /* Built without zlib */
+        return 0;
+#endif
+    }
+
+    f->buffer_count = chunk->num_positions;
+    f->next_chunk = index + 1;
+    return 1;
+}
+
+static positionfile_t *POSITIONFILE_alloc(FILE *file, const int writing)
+{
+    positionfile_t *f = (positionfile_t*)calloc(1, sizeof(positionfile_t));
+    f->f = file;
+    f->writing = writing;
+    f->buffer = (packed_position_t*)malloc(POSITIONFILE_CHUNK_SIZE * sizeof(packed_position_t));
+    return f;
+}
+
+static void POSITIONFILE_free(positionfile_t *f)
+{
+    if(f->f) fclose(f->f);
+    free(f->chunks);
+    free(f->buffer);
+    free(f->stored);
+    free(f);
+}
+
+/* Create a new file for writing, NULL on failure */
+positionfile_t *POSITIONFILE_create(const char *filename, const int compression)
+{
+    unsigned char header[POSITIONFILE_HEADER_SIZE];
+    FILE *file = fopen(filename, "wb");
+    if(!file) return NULL;
+
+    positionfile_t *f = POSITIONFILE_alloc(file, 1);
+    f->compression = compression;
+
+    /* Placeholder until the file is closed */
+    memset(header, 0, sizeof(header));
+    if(fwrite(header, sizeof(header), 1, file) != 1) {
+        POSITIONFILE_free(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+/* Open a file for reading, NULL if it is missing or not a position file */
+positionfile_t *POSITIONFILE_open(const char *filename)
+{
+    unsigned char header[POSITIONFILE_HEADER_SIZE];
+    unsigned char entry[POSITIONFILE_INDEX_SIZE];
+    FILE *file = fopen(filename, "rb");
+    if(!file) return NULL;
+
+    positionfile_t *f = POSITIONFILE_alloc(file, 0);
+    if(fread(header, sizeof(header), 1, file) != 1 || memcmp(header, POSITIONFILE_MAGIC, 8) != 0 ||
+       POSITIONFILE_get_u32(header + 8) != POSITIONFILE_CHUNK_SIZE) {
+        POSITIONFILE_free(f);
+        return NULL;
+    }
+
+    f->num_chunks = f->max_chunks = POSITIONFILE_get_u32(header + 12);
+    f->chunks = (positionfile_chunk_t*)malloc((f->num_chunks + 1) * sizeof(positionfile_chunk_t));
+    if(!POSITIONFILE_fseek(file, POSITIONFILE_get_u64(header + 24))) {
+        POSITIONFILE_free(f);
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < f->num_chunks; i++) {
+        positionfile_chunk_t *chunk = &f->chunks[i];
+        if(fread(entry, sizeof(entry), 1, file) != 1) {
+            POSITIONFILE_free(f);
+            return NULL;
+        }
+        chunk->offset = POSITIONFILE_get_u64(entry);
+        chunk->stored_size = POSITIONFILE_get_u32(entry + 8);
+        chunk->num_positions = POSITIONFILE_get_u32(entry + 12);
+        chunk->compression = POSITIONFILE_get_u32(entry + 16);
+        chunk->first_position = f->num_positions;
+        if(chunk->num_positions > POSITIONFILE_CHUNK_SIZE) {
+            POSITIONFILE_free(f);
+            return NULL;
+        }
+        f->num_positions += chunk->num_positions;
+    }
+
+    if(f->num_positions != POSITIONFILE_get_u64(header + 16)) {
+        POSITIONFILE_free(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+/* Close a file. A written file is only complete after this, returns 0 if
+ * any write failed. */
+int POSITIONFILE_close(positionfile_t *f)
+{
+    int success = 1;
+
+    if(f->writing) {
+        unsigned char entry[POSITIONFILE_INDEX_SIZE];
+
+        POSITIONFILE_flush_chunk(f);
+        uint64_t index_offset = POSITIONFILE_ftell(f->f);
+        for(uint32_t i = 0; i < f->num_chunks; i++) {
+            POSITIONFILE_put_u64(entry, f->chunks[i].offset);
+            POSITIONFILE_put_u32(entry + 8, f->chunks[i].stored_size);
+            POSITIONFILE_put_u32(entry + 12, f->chunks[i].num_positions);
+            POSITIONFILE_put_u32(entry + 16, f->chunks[i].compression);
+            POSITIONFILE_put_u32(entry + 20, 0);
+            if(fwrite(entry, sizeof(entry), 1, f->f) != 1) f->error = 1;
+        }
+        if(!POSITIONFILE_write_header(f, index_offset)) f->error = 1;
+        if(fclose(f->f) != 0) f->error = 1;
+        f->f = NULL;
+        success = !f->error;
+    }
+
+    POSITIONFILE_free(f);
+    return success;
+}
+
+/* Append positions, returns 0 on write errors */
+int POSITIONFILE_write(positionfile_t *f, const packed_position_t *positions, const int num_positions)
+{
+    for(int i = 0; i < num_positions; i++) {
+        f->buffer[f->buffer_count++] = positions[i];
+        if(f->buffer_count == POSITIONFILE_CHUNK_SIZE) {
+            POSITIONFILE_flush_chunk(f);
+        }
+    }
+    return !f->error;
+}
+
+/* Read up to max_positions from the current position. Returns the number
+ * read, 0 at the end of the file and -1 if a chunk is corrupt. */
+int POSITIONFILE_read(positionfile_t *f, packed_position_t *positions, const int max_positions)
+{
+    int num_read = 0;
+
+    while(num_read < max_positions) {
+        if(f->buffer_pos == f->buffer_count) {
+            if(f->next_chunk >= f->num_chunks) break;
+            if(!POSITIONFILE_load_chunk(f, f->next_chunk)) return -1;
+        }
+
+        int n = (int)(f->buffer_count - f->buffer_pos);
+        if(n > max_positions - num_read) n = max_positions - num_read;
+        memcpy(&positions[num_read], &f->buffer[f->buffer_pos], n * sizeof(packed_position_t));
+        f->buffer_pos += n;
+        num_read += n;
+    }
+
+    return num_read;
+}
+
+/* Continue reading at position number index. Only the chunk holding it is
+ * read. Returns 0 if index is out of range or the chunk is corrupt. */
+int POSITIONFILE_seek(positionfile_t *f, const uint64_t index)
+{
+    uint32_t low = 0, high = f->num_chunks;
+
+    if(f->writing || index >= f->num_positions) return 0;
+
+    /* Last chunk starting at or before index */
+    while(high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        if(f->chunks[mid].first_position <= index) low = mid;
+        else high = mid;
+    }
+
+    if(!(f->next_chunk == low + 1 && f->buffer_count == f->chunks[low].num_positions)) {
+        if(!POSITIONFILE_load_chunk(f, low)) return 0;
+    }
+    f->buffer_pos = (uint32_t)(index - f->chunks[low].first_position);
+    return 1;
+}
+
+uint64_t POSITIONFILE_num_positions(const positionfile_t *f)
+{
+    return f->writing ? f->num_positions + f->buffer_count : f->num_positions;
+}
@@ -0,0 +1,22 @@
+#ifndef POSITIONFILE_H
+#define POSITIONFILE_H
+
+#include <stdint.h>
+#include "pack.h"
+
+#define POSITIONFILE_COMPRESSION_NONE   0
+#define POSITIONFILE_COMPRESSION_ZLIB   1   /* Stored uncompressed when built without zlib */
+
+#define POSITIONFILE_CHUNK_SIZE         4096
+
+typedef struct positionfile_t positionfile_t;
+
+positionfile_t *POSITIONFILE_create(const char *filename, const int compression);
+positionfile_t *POSITIONFILE_open(const char *filename);
+int      POSITIONFILE_close(positionfile_t *f);
+int      POSITIONFILE_write(positionfile_t *f, const packed_position_t *positions, const int num_positions);
+int      POSITIONFILE_read(positionfile_t *f, packed_position_t *positions, const int max_positions);
+int      POSITIONFILE_seek(positionfile_t *f, const uint64_t index);
+uint64_t POSITIONFILE_num_positions(const positionfile_t *f);
+
+#endif
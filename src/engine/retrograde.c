@@ -0,0 +1,616 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "retrograde.h"
+#include "movegen.h"
+#include "eval.h"
+#include "threadpool.h"
+
+/* Retrograde analysis of endgames with up to RETROGRADE_MAX_PIECES pieces.
+ * Every position of a material gets one result byte:
+ *
+ *   0           Draw (or an invalid position)
+ *   1 - 127     Won, the distance in plies
+ *   128 - 255   Lost, the distance in plies is the byte - 128
+ *
+ * The distance is to mate or the next capture or pawn move, after which
+ * the 50 move counter starts over. Positions are indexed with the white
+ * king on the queen side, and without pawns below the a1-h8 diagonal as
+ * well. The stronger side is white. Castling rights and en passant
+ * captures are not covered.
+ *
+ * The bitbases of the evaluation and the Syzygy tables written for tests
+ * are made from the results. */
+
+#define RETROGRADE_RESULT_WIN(distance)     ((uint8_t)(distance))
+#define RETROGRADE_RESULT_LOSS(distance)    ((uint8_t)(128 + (distance)))
+
+/* Generator flags */
+#define RETROGRADE_INVALID          0x1
+#define RETROGRADE_DECIDED          0x2
+#define RETROGRADE_DRAWING_MOVE     0x4     /* A capture or pawn move holds the draw */
+
+static const char retrograde_piece_chars[] = "PNBRQ";
+
+typedef struct {
+    retrograde_material_t material;
+    retrograde_probe_t probe;               /* Materials reached by captures and promotions */
+    const void  *probe_arg;
+    const uint8_t *pawn_result;             /* Results of the first pass, NULL while pawn moves stay in the table */
+    uint8_t     *result;
+    uint8_t     *count;                     /* Moves within the table not yet known to lose */
+    uint8_t     *flags;
+    int         failed;
+} retrograde_generator_t;
+
+static uint32_t RETROGRADE_key(const int count[NUM_COLORS][NUM_TYPES])
+{
+    uint32_t key = 0;
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type < KING; type++) {
+            key |= (uint32_t)count[color][type] << (3 * (color * KING + type));
+        }
+    }
+    return key;
+}
+
+/* Positive if white has the stronger pieces, the tables are stored from the stronger side's view */
+static int RETROGRADE_compare_sides(const int count[NUM_COLORS][NUM_TYPES])
+{
+    int total[NUM_COLORS] = { 0, 0 };
+    for(int type = PAWN; type < KING; type++) {
+        total[WHITE] += count[WHITE][type];
+        total[BLACK] += count[BLACK][type];
+    }
+    if(total[WHITE] != total[BLACK]) return total[WHITE] - total[BLACK];
+
+    for(int type = QUEEN; type >= PAWN; type--) {
+        if(count[WHITE][type] != count[BLACK][type]) return count[WHITE][type] - count[BLACK][type];
+    }
+    return 0;
+}
+
+static void RETROGRADE_set_material(retrograde_material_t *m, const int count[NUM_COLORS][NUM_TYPES])
+{
+    char *name = m->name;
+
+    memset(m, 0, sizeof(retrograde_material_t));
+    m->pieces[m->num_pieces++] = WHITE_PIECES + KING;
+    m->pieces[m->num_pieces++] = BLACK_PIECES + KING;
+    for(int color = WHITE; color <= BLACK; color++) {
+        *name++ = 'K';
+        for(int type = QUEEN; type >= PAWN; type--) {
+            for(int i = 0; i < count[color][type]; i++) {
+                m->pieces[m->num_pieces++] = color * NUM_TYPES + type;
+                *name++ = retrograde_piece_chars[type];
+            }
+        }
+        if(color == WHITE) *name++ = 'v';
+    }
+    *name = '\0';
+
+    m->has_pawns = count[WHITE][PAWN] || count[BLACK][PAWN];
+    m->key = RETROGRADE_key(count);
+
+    m->size = m->has_pawns ? 32 : 10;
+    for(int i = 1; i < m->num_pieces; i++) {
+        m->size *= 64;
+    }
+    m->size *= 2;
+}
+
+/* Piece counts of a name like KRvKP. Returns 0 if the name is malformed. */
+static int RETROGRADE_parse_name(const char *name, int count[NUM_COLORS][NUM_TYPES])
+{
+    int color = WHITE;
+    int num_pieces = 2;
+
+    memset(count, 0, NUM_COLORS * NUM_TYPES * sizeof(int));
+    if(name[0] != 'K') return 0;
+    for(const char *p = name + 1; *p; p++) {
+        if(*p == 'v') {
+            if(color == BLACK || p[1] != 'K') return 0;
+            color = BLACK;
+            p++;
+            continue;
+        }
+        const char *c = strchr(retrograde_piece_chars, *p);
+        if(!c || ++num_pieces > RETROGRADE_MAX_PIECES) return 0;
+        count[color][c - retrograde_piece_chars]++;
+    }
+    return color == BLACK;
+}
+
+/* Material of a name like KRvKP, with the stronger side first. Returns 0
+ * if the name is malformed or not a material of three or more pieces. */
+int RETROGRADE_material(retrograde_material_t *m, const char *name)
+{
+    int count[NUM_COLORS][NUM_TYPES];
+    if(!RETROGRADE_parse_name(name, count) || RETROGRADE_compare_sides(count) < 0) return 0;
+    RETROGRADE_set_material(m, count);
+    return m->num_pieces >= 3;
+}
+
+/* Key of the material of a position, with the stronger side as white */
+uint32_t RETROGRADE_material_key(const chess_state_t *s)
+{
+    int count[NUM_COLORS][NUM_TYPES];
+    int flipped[NUM_COLORS][NUM_TYPES];
+
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type < KING; type++) {
+            count[color][type] = BITBOARD_count_bits(s->bitboard[color * NUM_TYPES + type]);
+            flipped[color ^ 1][type] = count[color][type];
+        }
+    }
+
+    return RETROGRADE_key(RETROGRADE_compare_sides(count) < 0 ? flipped : count);
+}
+
+static inline int RETROGRADE_transform(const int t, int pos)
+{
+    if(t & 1) pos ^= 7;
+    if(t & 2) pos ^= 56;
+    if(t & 4) pos = ((pos & 7) << 3) | (pos >> 3);
+    return pos;
+}
+
+/* Index of the white king square, -1 if it is mirrored away */
+static inline int RETROGRADE_king_index(const int has_pawns, const int pos)
+{
+    const int file = pos & 7;
+    const int rank = pos >> 3;
+    if(has_pawns) {
+        return file < 4 ? 4 * rank + file : -1;
+    }
+    if(file >= 4 || rank > file) return -1;
+    return file * (file + 1) / 2 + rank;
+}
+
+static inline int RETROGRADE_king_square(const int has_pawns, const int index)
+{
+    int file = 0;
+    if(has_pawns) {
+        return 8 * (index / 4) + index % 4;
+    }
+    while((file + 1) * (file + 2) / 2 <= index) file++;
+    return 8 * (index - file * (file + 1) / 2) + file;
+}
+
+/* The lowest index of the symmetric versions of the position */
+static uint64_t RETROGRADE_squares_index(const retrograde_material_t *m, const int *squares, const int player)
+{
+    uint64_t best = UINT64_MAX;
+    const int num_transforms = m->has_pawns ? 2 : 8;
+
+    for(int t = 0; t < num_transforms; t++) {
+        int king = RETROGRADE_king_index(m->has_pawns, RETROGRADE_transform(t, squares[0]));
+        if(king < 0) continue;
+
+        int pos[RETROGRADE_MAX_PIECES];
+        for(int i = 1; i < m->num_pieces; i++) {
+            pos[i] = RETROGRADE_transform(t, squares[i]);
+        }
+
+        /* Identical pieces (at most two of them) are kept in ascending order */
+        for(int i = 2; i < m->num_pieces; i++) {
+            if(m->pieces[i] == m->pieces[i-1] && pos[i] < pos[i-1]) {
+                int tmp = pos[i];
+                pos[i] = pos[i-1];
+                pos[i-1] = tmp;
+            }
+        }
+
+        uint64_t index = king;
+        for(int i = 1; i < m->num_pieces; i++) {
+            index = 64 * index + pos[i];
+        }
+        index = 2 * index + player;
+        if(index < best) best = index;
+    }
+
+    return best;
+}
+
+static int RETROGRADE_decode_index(const retrograde_material_t *m, uint64_t index, int *squares)
+{
+    const int player = (int)(index & 1);
+    index >>= 1;
+    for(int i = m->num_pieces - 1; i > 0; i--) {
+        squares[i] = (int)(index & 63);
+        index >>= 6;
+    }
+    squares[0] = RETROGRADE_king_square(m->has_pawns, (int)index);
+    return player;
+}
+
+/* Result byte to the result from the side to move's point of view and the distance in plies */
+void RETROGRADE_decode(const uint8_t result, int *wdl, int *distance)
+{
+    if(result == 0) {
+        *wdl = RETROGRADE_DRAW;
+        *distance = 0;
+    } else if(result < 128) {
+        *wdl = RETROGRADE_WIN;
+        *distance = result;
+    } else {
+        *wdl = RETROGRADE_LOSS;
+        *distance = result - 128;
+    }
+}
+
+static void RETROGRADE_squares_state(const retrograde_material_t *m, const int *squares, const int player, chess_state_t *s)
+{
+    memset(s, 0, sizeof(chess_state_t));
+    for(int i = 0; i < m->num_pieces; i++) {
+        const bitboard_t b = BITBOARD_POSITION(squares[i]);
+        s->bitboard[m->pieces[i]] |= b;
+        s->bitboard[(m->pieces[i] / NUM_TYPES) * NUM_TYPES + ALL] |= b;
+        s->bitboard[OCCUPIED] |= b;
+    }
+    s->ep_file = STATE_EN_PASSANT_NONE;
+    s->player = (unsigned char)player;
+}
+
+/* Squares of the pieces in table order, with the colors swapped if flip is set. Returns the player to move. */
+static int RETROGRADE_squares(const retrograde_material_t *m, const chess_state_t *s, const int flip, int *squares)
+{
+    bitboard_t taken = 0;
+    for(int i = 0; i < m->num_pieces; i++) {
+        const int color = (m->pieces[i] / NUM_TYPES) ^ flip;
+        const int type = m->pieces[i] % NUM_TYPES;
+        const int pos = BITBOARD_find_bit(s->bitboard[color * NUM_TYPES + type] & ~taken);
+        taken |= BITBOARD_POSITION(pos);
+        squares[i] = flip ? pos ^ 56 : pos;
+    }
+    return s->player ^ flip;
+}
+
+static int RETROGRADE_valid(const retrograde_material_t *m, const int *squares)
+{
+    bitboard_t occupied = 0;
+    for(int i = 0; i < m->num_pieces; i++) {
+        const bitboard_t b = BITBOARD_POSITION(squares[i]);
+        if(occupied & b) return 0;
+        if(m->pieces[i] % NUM_TYPES == PAWN && (squares[i] < A2 || squares[i] > H7)) return 0;
+        occupied |= b;
+    }
+    return 1;
+}
+
+static inline int RETROGRADE_in_check(const chess_state_t *s, const int color)
+{
+    return EVAL_position_is_attacked(s, color, BITBOARD_find_bit(s->bitboard[color * NUM_TYPES + KING]));
+}
+
+/* Index of a position of the material, seen from the stronger side. The
+ * player to move by the table is the lowest bit. Returns 0 if the position
+ * has another material. */
+int RETROGRADE_index(const retrograde_material_t *m, const chess_state_t *s, uint64_t *index)
+{
+    int count[NUM_COLORS][NUM_TYPES];
+    int squares[RETROGRADE_MAX_PIECES];
+
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type < KING; type++) {
+            count[color][type] = BITBOARD_count_bits(s->bitboard[color * NUM_TYPES + type]);
+        }
+    }
+    if(RETROGRADE_material_key(s) != m->key) return 0;
+
+    const int flip = RETROGRADE_compare_sides(count) < 0;
+    const int player = RETROGRADE_squares(m, s, flip, squares);
+    *index = RETROGRADE_squares_index(m, squares, player);
+    return 1;
+}
+
+/* The position of an index, seen from the stronger side. Returns 0 if the
+ * index is not that of a legal position. */
+int RETROGRADE_state(const retrograde_material_t *m, const uint64_t index, chess_state_t *s)
+{
+    int squares[RETROGRADE_MAX_PIECES];
+    const int player = RETROGRADE_decode_index(m, index, squares);
+    if(!RETROGRADE_valid(m, squares) || RETROGRADE_squares_index(m, squares, player) != index) return 0;
+    RETROGRADE_squares_state(m, squares, player, s);
+    return !RETROGRADE_in_check(s, player ^ 1);
+}
+
+/* Sorts a short list and drops duplicates */
+static int RETROGRADE_unique(uint64_t *list, const int n)
+{
+    int num_unique = 0;
+    for(int i = 1; i < n; i++) {
+        uint64_t v = list[i];
+        int j = i;
+        while(j > 0 && list[j-1] > v) {
+            list[j] = list[j-1];
+            j--;
+        }
+        list[j] = v;
+    }
+    for(int i = 0; i < n; i++) {
+        if(i == 0 || list[i] != list[i-1]) list[num_unique++] = list[i];
+    }
+    return num_unique;
+}
+
+/* Names of all materials with up to max_pieces pieces, in an order where
+ * the materials reached by captures and promotions come first */
+int RETROGRADE_list(char (*names)[RETROGRADE_NAME_SIZE], const int max_pieces)
+{
+    /* The pieces of one side besides the king */
+    int sets[21][2];
+    int set_size[21];
+    int num_sets = 0;
+    int num_names = 0;
+
+    set_size[num_sets++] = 0;
+    for(int a = QUEEN; a >= PAWN; a--) {
+        sets[num_sets][0] = a;
+        set_size[num_sets++] = 1;
+    }
+    for(int a = QUEEN; a >= PAWN; a--) {
+        for(int b = a; b >= PAWN; b--) {
+            sets[num_sets][0] = a;
+            sets[num_sets][1] = b;
+            set_size[num_sets++] = 2;
+        }
+    }
+
+    for(int num_pieces = 3; num_pieces <= max_pieces && num_pieces <= RETROGRADE_MAX_PIECES; num_pieces++) {
+        for(int num_pawns = 0; num_pawns <= num_pieces - 2; num_pawns++) {
+            for(int w = 0; w < num_sets; w++) {
+                for(int b = 0; b < num_sets; b++) {
+                    int count[NUM_COLORS][NUM_TYPES];
+                    retrograde_material_t m;
+
+                    if(2 + set_size[w] + set_size[b] != num_pieces) continue;
+                    memset(count, 0, sizeof(count));
+                    for(int i = 0; i < set_size[w]; i++) count[WHITE][sets[w][i]]++;
+                    for(int i = 0; i < set_size[b]; i++) count[BLACK][sets[b][i]]++;
+                    if(count[WHITE][PAWN] + count[BLACK][PAWN] != num_pawns) continue;
+                    if(RETROGRADE_compare_sides(count) < 0) continue;
+
+                    RETROGRADE_set_material(&m, count);
+                    strcpy(names[num_names++], m.name);
+                }
+            }
+        }
+    }
+
+    return num_names;
+}
+
+/* Whether a move leaves the positions of the pass: captures and promotions,
+ * and in the second pass of a table with pawns all pawn moves */
+static inline int RETROGRADE_is_exit(const retrograde_generator_t *g, const move_t move)
+{
+    return MOVE_IS_CAPTURE_OR_PROMOTION(move) || (g->pawn_result && MOVE_GET_TYPE(move) == PAWN);
+}
+
+/* First pass: mates, stalemates and the positions decided by a move which
+ * leaves the pass. The other moves are counted. */
+static void RETROGRADE_generate_init(void *arg, int worker, int first, int last)
+{
+    retrograde_generator_t *g = (retrograde_generator_t*)arg;
+    const retrograde_material_t *m = &g->material;
+    (void)worker;
+
+    for(int index = first; index < last; index++) {
+        int squares[RETROGRADE_MAX_PIECES];
+        const int player = RETROGRADE_decode_index(m, (uint64_t)index, squares);
+        chess_state_t s;
+
+        g->flags[index] = RETROGRADE_INVALID;
+        g->result[index] = 0;
+        g->count[index] = 0;
+        if(!RETROGRADE_valid(m, squares) || RETROGRADE_squares_index(m, squares, player) != (uint64_t)index) continue;
+
+        RETROGRADE_squares_state(m, squares, player, &s);
+        if(RETROGRADE_in_check(&s, player ^ 1)) continue;
+        g->flags[index] = 0;
+
+        move_t moves[256];
+        uint64_t children[256];
+        int num_children = 0;
+        int win = 0;
+        const int num_moves = STATE_generate_moves_simple(&s, moves);
+        for(int i = 0; i < num_moves && !win; i++) {
+            chess_state_t next_state = s;
+            STATE_apply_move(&next_state, moves[i]);
+
+            int next_squares[RETROGRADE_MAX_PIECES];
+            int wdl, distance;
+            if(MOVE_IS_CAPTURE_OR_PROMOTION(moves[i])) {
+                if(!g->probe(g->probe_arg, &next_state, &wdl)) {
+                    g->failed = 1;
+                    continue;
+                }
+            } else {
+                const int next_player = RETROGRADE_squares(m, &next_state, 0, next_squares);
+                const uint64_t child = RETROGRADE_squares_index(m, next_squares, next_player);
+                if(!RETROGRADE_is_exit(g, moves[i])) {
+                    children[num_children++] = child;
+                    continue;
+                }
+                RETROGRADE_decode(g->pawn_result[child], &wdl, &distance);
+            }
+
+            if(wdl == RETROGRADE_LOSS) {
+                win = 1;
+            } else if(wdl == RETROGRADE_DRAW) {
+                g->flags[index] |= RETROGRADE_DRAWING_MOVE;
+            }
+        }
+
+        if(win) {
+            g->result[index] = RETROGRADE_RESULT_WIN(1);
+            g->flags[index] |= RETROGRADE_DECIDED;
+        } else if(num_moves == 0) {
+            g->result[index] = RETROGRADE_in_check(&s, player) ? RETROGRADE_RESULT_LOSS(0) : 0;
+            g->flags[index] |= RETROGRADE_DECIDED;
+        } else {
+            g->count[index] = (uint8_t)RETROGRADE_unique(children, num_children);
+            if(g->count[index] == 0) {
+                g->result[index] = (g->flags[index] & RETROGRADE_DRAWING_MOVE) ? 0 : RETROGRADE_RESULT_LOSS(1);
+                g->flags[index] |= RETROGRADE_DECIDED;
+            }
+        }
+    }
+}
+
+/* Positions the previous player could have come from by a move which stays in the pass */
+static int RETROGRADE_unmoves(const retrograde_generator_t *g, const int *squares, const int player, uint64_t *parents)
+{
+    const retrograde_material_t *m = &g->material;
+    const int mover = player ^ 1;
+    bitboard_t occupied = 0;
+    int num_parents = 0;
+
+    for(int i = 0; i < m->num_pieces; i++) {
+        occupied |= BITBOARD_POSITION(squares[i]);
+    }
+
+    for(int i = 0; i < m->num_pieces; i++) {
+        const int color = m->pieces[i] / NUM_TYPES;
+        const int type = m->pieces[i] % NUM_TYPES;
+        bitboard_t from = 0;
+        bitboard_t captures;
+
+        if(color != mover) continue;
+
+        if(type == PAWN) {
+            const int back = (mover == WHITE) ? -8 : 8;
+            const int pos = squares[i] + back;
+            if(g->pawn_result) continue;
+            if(pos >= A2 && pos <= H7 && !(occupied & BITBOARD_POSITION(pos))) {
+                from |= BITBOARD_POSITION(pos);
+                if((squares[i] >> 3) == (mover == WHITE ? 3 : 4) && !(occupied & BITBOARD_POSITION(pos + back))) {
+                    from |= BITBOARD_POSITION(pos + back);
+                }
+            }
+        } else {
+            MOVEGEN_piece(type, squares[i], occupied, 0, &from, &captures);
+        }
+
+        while(from) {
+            int parent_squares[RETROGRADE_MAX_PIECES];
+            const int pos = BITBOARD_find_bit(from);
+            memcpy(parent_squares, squares, sizeof(parent_squares));
+            parent_squares[i] = pos;
+            parents[num_parents++] = RETROGRADE_squares_index(m, parent_squares, mover);
+            from ^= BITBOARD_POSITION(pos);
+        }
+    }
+
+    return num_parents;
+}
+
+/* Second pass: results spread backwards from the decided positions, in
+ * order of distance. What is left undecided is drawn. */
+static int RETROGRADE_spread(retrograde_generator_t *g)
+{
+    const retrograde_material_t *m = &g->material;
+    uint32_t *queue = (uint32_t*)malloc(m->size * sizeof(uint32_t));
+    uint64_t head = 0, tail = 0;
+
+    if(!queue) return 0;
+
+    /* Mates first, then the distance 1 results of the first pass */
+    for(uint64_t index = 0; index < m->size; index++) {
+        if((g->flags[index] & RETROGRADE_DECIDED) && g->result[index] == RETROGRADE_RESULT_LOSS(0)) {
+            queue[tail++] = (uint32_t)index;
+        }
+    }
+    for(uint64_t index = 0; index < m->size; index++) {
+        if((g->flags[index] & RETROGRADE_DECIDED) && g->result[index] != 0 && g->result[index] != RETROGRADE_RESULT_LOSS(0)) {
+            queue[tail++] = (uint32_t)index;
+        }
+    }
+
+    while(head < tail) {
+        const uint32_t index = queue[head++];
+        int squares[RETROGRADE_MAX_PIECES];
+        uint64_t parents[256];
+        int wdl, distance;
+
+        RETROGRADE_decode(g->result[index], &wdl, &distance);
+        if(distance >= RETROGRADE_MAX_DISTANCE) {
+            free(queue);
+            return 0;
+        }
+
+        const int player = RETROGRADE_decode_index(m, index, squares);
+        const int num_parents = RETROGRADE_unique(parents, RETROGRADE_unmoves(g, squares, player, parents));
+        for(int i = 0; i < num_parents; i++) {
+            const uint64_t parent = parents[i];
+            if(g->flags[parent] & (RETROGRADE_INVALID | RETROGRADE_DECIDED)) continue;
+
+            if(wdl == RETROGRADE_LOSS) {
+                g->result[parent] = RETROGRADE_RESULT_WIN(distance + 1);
+            } else if(--g->count[parent] == 0 && !(g->flags[parent] & RETROGRADE_DRAWING_MOVE)) {
+                g->result[parent] = RETROGRADE_RESULT_LOSS(distance + 1);
+            } else {
+                continue;
+            }
+            g->flags[parent] |= RETROGRADE_DECIDED;
+            queue[tail++] = (uint32_t)parent;
+        }
+    }
+
+    free(queue);
+    return 1;
+}
+
+static int RETROGRADE_pass(retrograde_generator_t *g, const int num_threads)
+{
+    threadpool_t *pool = THREADPOOL_create(num_threads);
+    THREADPOOL_run(pool, (int)g->material.size, 4096, RETROGRADE_generate_init, g);
+    THREADPOOL_destroy(pool);
+    return !g->failed && RETROGRADE_spread(g);
+}
+
+/* Results of all positions of the material, NULL on failure. The results
+ * of the captures and promotions come from probe. Pawn moves stay in the
+ * table until the results are known, then a second pass counts the
+ * distances from them. num_threads <= 0 uses one thread per core. */
+uint8_t *RETROGRADE_generate(const retrograde_material_t *m, const retrograde_probe_t probe, const void *probe_arg, const int num_threads)
+{
+    retrograde_generator_t g;
+    uint8_t *pawn_result = NULL;
+    int ok = 0;
+
+    memset(&g, 0, sizeof(g));
+    g.material = *m;
+    g.probe = probe;
+    g.probe_arg = probe_arg;
+    g.result = (uint8_t*)malloc(m->size);
+    g.count = (uint8_t*)malloc(m->size);
+    g.flags = (uint8_t*)malloc(m->size);
+    if(g.result && g.count && g.flags) {
+        ok = RETROGRADE_pass(&g, num_threads);
+        if(ok && m->has_pawns) {
+            pawn_result = g.result;
+            g.pawn_result = pawn_result;
+            g.result = (uint8_t*)malloc(m->size);
+            ok = g.result && RETROGRADE_pass(&g, num_threads);
+
+            /* The second pass only changes the distances */
+            for(uint64_t index = 0; ok && index < m->size; index++) {
+                int wdl, pawn_wdl, distance;
+                RETROGRADE_decode(g.result[index], &wdl, &distance);
+                RETROGRADE_decode(pawn_result[index], &pawn_wdl, &distance);
+                ok = (wdl == pawn_wdl);
+            }
+        }
+    }
+
+    free(pawn_result);
+    free(g.flags);
+    free(g.count);
+    if(!ok) {
+        free(g.result);
+        return NULL;
+    }
+    return g.result;
+}
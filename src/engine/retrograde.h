@@ -0,0 +1,38 @@
+#ifndef RETROGRADE_H
+#define RETROGRADE_H
+
+#include <stdint.h>
+#include "state.h"
+
+#define RETROGRADE_MAX_PIECES       4       /* Kings included */
+#define RETROGRADE_MAX_DISTANCE     127
+#define RETROGRADE_NAME_SIZE        16
+#define RETROGRADE_MAX_TABLES       64
+
+/* Results from the side to move's point of view */
+#define RETROGRADE_LOSS             -1
+#define RETROGRADE_DRAW             0
+#define RETROGRADE_WIN              1
+
+typedef struct {
+    char        name[RETROGRADE_NAME_SIZE];
+    int         num_pieces;
+    int         pieces[RETROGRADE_MAX_PIECES];  /* color * NUM_TYPES + type: the kings, then white and black from the queen down */
+    int         has_pawns;
+    uint32_t    key;
+    uint64_t    size;
+} retrograde_material_t;
+
+/* Result of a position after a capture or promotion, which leads to
+ * another material. Returns 0 if it is not known. */
+typedef int (*retrograde_probe_t)(const void *arg, const chess_state_t *s, int *wdl);
+
+int      RETROGRADE_list(char (*names)[RETROGRADE_NAME_SIZE], const int max_pieces);
+int      RETROGRADE_material(retrograde_material_t *m, const char *name);
+uint32_t RETROGRADE_material_key(const chess_state_t *s);
+int      RETROGRADE_index(const retrograde_material_t *m, const chess_state_t *s, uint64_t *index);
+int      RETROGRADE_state(const retrograde_material_t *m, const uint64_t index, chess_state_t *s);
+uint8_t *RETROGRADE_generate(const retrograde_material_t *m, const retrograde_probe_t probe, const void *probe_arg, const int num_threads);
+void     RETROGRADE_decode(const uint8_t result, int *wdl, int *distance);
+
+#endif
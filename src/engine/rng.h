@@ -0,0 +1,24 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* Small pseudo random number generator (splitmix64), one per engine instance */
+typedef struct {
+    uint64_t state;
+} rng_t;
+
+static inline void RNG_seed(rng_t *r, const uint64_t seed)
+{
+    r->state = seed;
+}
+
+static inline uint32_t RNG_next(rng_t *r)
+{
+    uint64_t z = (r->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+#endif
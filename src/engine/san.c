@@ -1,159 +1,164 @@
 #include <string.h>
 #include "san.h"
 #include "search.h"
+#include "movegen.h"
 
-/* TODO: rewrite this dirty code */
-move_t SAN_parse_move(const chess_state_t *state, const char *san)
+static int SAN_piece_type(const char c)
+{
+    switch(c) {
+    case 'N': return KNIGHT;
+    case 'B': return BISHOP;
+    case 'R': return ROOK;
+    case 'Q': return QUEEN;
+    case 'K': return KING;
+    default:  return -1;
+    }
+}
+
+static move_t SAN_castle(const chess_state_t *state, const int special)
 {
     move_t moves[256];
-    move_t candidate = 0;
-    move_t num_candidates = 0;
-    int num_moves;
-    int i;
-    int len;
-    int is_capture = 0;
-    int promotion_type = 0;
+    int num_moves = STATE_generate_moves_simple(state, moves);
+    for(int i = 0; i < num_moves; i++) {
+        if((int)MOVE_GET_SPECIAL_FLAGS(moves[i]) == special) {
+            return moves[i];
+        }
+    }
+    return 0;
+}
+
+/* Resolve a move in Standard Algebraic Notation. Check marks, annotations
+ * and missing capture marks are tolerated. Only pieces of the moving type
+ * that reach the target square are considered, so no move list is generated
+ * except for castling. Returns 0 if the move is illegal or ambiguous. */
+move_t SAN_parse_move(const chess_state_t *state, const char *san)
+{
+    const int player = state->player;
+    const int player_index = player * NUM_TYPES;
+    const int opponent_index = NUM_TYPES - player_index;
+    int len = (int)strnlen(san, SAN_MAX_SIZE);
     int type = PAWN;
-    int pos_to = 0;
-    int rank = -1;
+    int promotion_type = 0;
+    int is_capture = 0;
     int file = -1;
-    
-    len = (int)strlen(san);
-    
-    /* Generate all possible moves */
-    num_moves = STATE_generate_moves_simple(state, moves);
-    
-    /* What type of piece is moving? */
-    switch(san[0]) {
-    case 'N':
-        type = KNIGHT;
-        break;
-    case 'B':
-        type = BISHOP;
-        break;
-    case 'R':
-        type = ROOK;
-        break;
-    case 'Q':
-        type = QUEEN;
-        break;
-    case 'K':
-    case 'O':
-        type = KING;
-        break;
-    default:
-        type = PAWN;
-        break;
+    int rank = -1;
+    int pos_to;
+
+    /* Suffixes */
+    if(len > 4 && strncmp(san+len-4, "e.p.", 4) == 0) {
+        len -= 4;
+        if(san[len-1] == ' ') len--;
     }
-    
-    if(type == KING) {
-        /* Is this a kingside castling? */
-        if(strncmp(san, "O-O-O", 5) == 0) {
-            for(i = 0; i < num_moves; i++) {
-                if(MOVE_GET_SPECIAL_FLAGS(moves[i]) == MOVE_QUEEN_CASTLE) {
-                    return moves[i];
-                }
-            }
-            /* Failure */
-            return 0;
-        }
-        
-        /* Is this a queenside castling? */
-        if(strncmp(san, "O-O", 3) == 0) {
-            for(i = 0; i < num_moves; i++) {
-                if(MOVE_GET_SPECIAL_FLAGS(moves[i]) == MOVE_KING_CASTLE) {
-                    return moves[i];
-                }
-            }
-            /* Failure */
-            return 0;
-        }
+    while(len > 0 && (san[len-1] == '+' || san[len-1] == '#' || san[len-1] == '!' || san[len-1] == '?')) len--;
+
+    /* Castling */
+    if((len == 3 && (strncmp(san, "O-O", 3) == 0 || strncmp(san, "0-0", 3) == 0))) {
+        return SAN_castle(state, MOVE_KING_CASTLE);
     }
-    
-    /* Is this move a capture? */
-    is_capture = (strchr(san, 'x') != 0);
-    
-    /* Is this move an en passant capture? */
-    if(type == PAWN && is_capture && len > 5) {
-        if(strcmp(san+len-5, " e.p.") == 0) {
-            len -= 5;
-        }
+    if((len == 5 && (strncmp(san, "O-O-O", 5) == 0 || strncmp(san, "0-0-0", 5) == 0))) {
+        return SAN_castle(state, MOVE_QUEEN_CASTLE);
     }
-    
-    /* Is this move a check? */
-    if(san[len-1] == '+') {
-        len -= 1;
+
+    const char *s = san;
+    const char *end = san + len;
+
+    /* Moving piece */
+    if(s < end && SAN_piece_type(*s) > 0) {
+        type = SAN_piece_type(*s++);
     }
 
-    /* Is this move a check mate? */
-    if(san[len-1] == '#') {
-        len -= 1;
+    /* Promotion, with or without '=' */
+    if(type == PAWN && end - s >= 3 && SAN_piece_type(end[-1]) > 0 && SAN_piece_type(end[-1]) != KING) {
+        promotion_type = SAN_piece_type(end[-1]);
+        end -= (end[-2] == '=') ? 2 : 1;
     }
-    
-    /* Is this move a pawn promotion? */
-    if(type == PAWN && strchr(san, '=')) {
-        /* To what piece? */
-        switch(san[len-1]) {
-        case 'N':
-            promotion_type = KNIGHT;
-            break;
-        case 'B':
-            promotion_type = BISHOP;
-            break;
-        case 'R':
-            promotion_type = ROOK;
-            break;
-        case 'Q':
-            promotion_type = QUEEN;
-            break;
-        default:
-        /* Failure */
-            return 0;
-        }
-        
-        len -= 2;
+
+    /* Target square */
+    if(end - s < 2) return 0;
+    if(end[-2] < 'a' || end[-2] > 'h' || end[-1] < '1' || end[-1] > '8') return 0;
+    pos_to = (end[-2] - 'a') + (end[-1] - '1') * 8;
+    end -= 2;
+
+    if(s < end && (end[-1] == 'x' || end[-1] == ':')) {
+        is_capture = 1;
+        end--;
     }
-    
-    /* To what square is the piece moving? */
-    pos_to = (san[len-2]-'a') + (san[len-1]-'1') * 8;
-    len -= 2;
-    
-    if(is_capture) {
-        len -= 1;
+
+    /* Disambiguation by file and/or rank */
+    for(; s < end; s++) {
+        if(*s >= 'a' && *s <= 'h') file = *s - 'a';
+        else if(*s >= '1' && *s <= '8') rank = *s - '1';
+        else return 0;
+    }
+
+    const bitboard_t to_bb = BITBOARD_POSITION(pos_to);
+    if(to_bb & state->bitboard[player_index + ALL]) return 0;
+
+    /* Captured piece */
+    int capture_type = -1;
+    int special = MOVE_QUIET;
+    if(to_bb & state->bitboard[opponent_index + ALL]) {
+        for(capture_type = PAWN; capture_type < KING; capture_type++) {
+            if(to_bb & state->bitboard[opponent_index + capture_type]) break;
+        }
+        if(capture_type == KING) return 0;
+        special = MOVE_CAPTURE;
     }
-    
-    /* Check from file/rank/square */
-    if((type == PAWN && len > 0 ) || (type != PAWN && len > 1)) {
-        const char *s = san;
-        if(type != PAWN) {
-            s += 1;
-            len -= 1;
+
+    /* Pieces of the moving type that reach the target square */
+    bitboard_t candidates;
+    if(type == PAWN) {
+        const int step = (player == WHITE) ? 8 : -8;
+        const int ep_rank = (player == WHITE) ? 5 : 2;
+        const int last_rank = (player == WHITE) ? 7 : 0;
+
+        if((pos_to / 8 == last_rank) != (promotion_type != 0)) return 0;
+
+        if(capture_type < 0 && state->ep_file != STATE_EN_PASSANT_NONE && pos_to == ep_rank * 8 + state->ep_file) {
+            capture_type = PAWN;
+            special = MOVE_EP_CAPTURE;
         }
-        
-        for(i = 0; i < len; i++) {
-            if(s[i] >= 'a' && s[i] <= 'h') {
-                file = s[i] - 'a';
-            } else if(s[i] >= '1' && s[i] <= '8') {
-                rank = s[i] - '1';
+
+        if(capture_type >= 0) {
+            /* Pawn captures always name the file moved from */
+            if(file < 0) return 0;
+            candidates = bitboard_pawn_capture[player ^ 1][pos_to];
+        } else {
+            const int pos_behind = pos_to - step;
+            if(is_capture || pos_behind < 0 || pos_behind >= NUM_POSITIONS) return 0;
+            candidates = BITBOARD_POSITION(pos_behind);
+            if(!(candidates & state->bitboard[OCCUPIED]) && pos_to / 8 == ep_rank + ((player == WHITE) ? -2 : 2)) {
+                candidates = BITBOARD_POSITION(pos_behind - step);
+                special = MOVE_DOUBLE_PAWN_PUSH;
             }
         }
+        if(promotion_type) {
+            special = (special == MOVE_CAPTURE) ? (MOVE_KNIGHT_PROMOTION_CAPTURE + promotion_type - KNIGHT) : (MOVE_KNIGHT_PROMOTION + promotion_type - KNIGHT);
+        }
+    } else {
+        bitboard_t quiet;
+        MOVEGEN_piece(type, pos_to, 0, state->bitboard[OCCUPIED], &quiet, &candidates);
     }
+    if(is_capture && capture_type < 0) return 0;
+    if(capture_type < 0) capture_type = 0;
+
+    candidates &= state->bitboard[player_index + type];
+    if(file >= 0) candidates &= bitboard_file[file];
+    if(rank >= 0) candidates &= bitboard_rank[rank * 8];
 
-    /* Find candidate move */
-    for(i = 0; i < num_moves; i++) {
-        int pos_from;
-        move_t move = moves[i];
-        
-        if(MOVE_GET_TYPE(move) != type) continue;
-        if((MOVE_IS_CAPTURE(move) != 0) != is_capture) continue;
-        if(promotion_type && promotion_type != MOVE_PROMOTION_TYPE(move)) continue;
-        if(MOVE_GET_POS_TO(move) != pos_to) continue;
-        pos_from = MOVE_GET_POS_FROM(move);
-        if(rank >= 0 && pos_from / 8 != rank) continue;
-        if(file >= 0 && pos_from % 8 != file) continue;
-
-        num_candidates++;
-        candidate = move;
+    /* Keep the legal one, SAN omits disambiguation from pinned pieces */
+    move_t candidate = 0;
+    int num_candidates = 0;
+    while(candidates) {
+        int pos_from = BITBOARD_find_bit(candidates);
+        move_t move = pos_from | (pos_to << MOVE_POS_TO_SHIFT) | (type << MOVE_TYPE_SHIFT) | (capture_type << MOVE_CAPTURE_TYPE_SHIFT) | (special << MOVE_SPECIAL_FLAGS_SHIFT);
+        chess_state_t next_state = *state;
+        STATE_apply_move(&next_state, move);
+        if(!SEARCH_is_check(&next_state, player)) {
+            candidate = move;
+            num_candidates++;
+        }
+        candidates ^= BITBOARD_POSITION(pos_from);
     }
 
     if(num_candidates == 1) {
@@ -163,3 +168,79 @@ move_t SAN_parse_move(const chess_state_t *state, const char *san)
         return 0;
     }
 }
+
+/* Write a move in Standard Algebraic Notation, including check and mate
+ * marks. san must hold at least SAN_MAX_SIZE characters. */
+void SAN_write_move(const chess_state_t *state, const move_t move, char *san)
+{
+    const char piece_letter[] = { 0, 'N', 'B', 'R', 'Q', 'K' };
+    move_t moves[256];
+    chess_state_t next_state;
+    int num_moves;
+    int i;
+    int len = 0;
+    int type = MOVE_GET_TYPE(move);
+    int pos_from = MOVE_GET_POS_FROM(move);
+    int pos_to = MOVE_GET_POS_TO(move);
+    int flags = MOVE_GET_SPECIAL_FLAGS(move);
+
+    if(flags == MOVE_KING_CASTLE) {
+        strcpy(san, "O-O");
+        len = 3;
+    } else if(flags == MOVE_QUEEN_CASTLE) {
+        strcpy(san, "O-O-O");
+        len = 5;
+    } else {
+        if(type == PAWN) {
+            /* Pawn captures name the file moved from */
+            if(MOVE_IS_CAPTURE(move)) {
+                san[len++] = 'a' + pos_from % 8;
+            }
+        } else {
+            int same_file = 0, same_rank = 0, ambiguous = 0;
+            san[len++] = piece_letter[type];
+
+            /* Other pieces of the same type that can move to the same square */
+            num_moves = STATE_generate_moves_simple(state, moves);
+            for(i = 0; i < num_moves; i++) {
+                int other_from = MOVE_GET_POS_FROM(moves[i]);
+                if((int)MOVE_GET_TYPE(moves[i]) != type) continue;
+                if((int)MOVE_GET_POS_TO(moves[i]) != pos_to) continue;
+                if(other_from == pos_from) continue;
+                ambiguous = 1;
+                if(other_from % 8 == pos_from % 8) same_file = 1;
+                if(other_from / 8 == pos_from / 8) same_rank = 1;
+            }
+
+            if(ambiguous) {
+                if(!same_file) {
+                    san[len++] = 'a' + pos_from % 8;
+                } else if(!same_rank) {
+                    san[len++] = '1' + pos_from / 8;
+                } else {
+                    san[len++] = 'a' + pos_from % 8;
+                    san[len++] = '1' + pos_from / 8;
+                }
+            }
+        }
+
+        if(MOVE_IS_CAPTURE(move)) {
+            san[len++] = 'x';
+        }
+        san[len++] = 'a' + pos_to % 8;
+        san[len++] = '1' + pos_to / 8;
+
+        if(MOVE_IS_PROMOTION(move)) {
+            san[len++] = '=';
+            san[len++] = piece_letter[MOVE_PROMOTION_TYPE(move)];
+        }
+    }
+
+    /* Check or check mate? */
+    next_state = *state;
+    STATE_apply_move(&next_state, move);
+    if(SEARCH_is_check(&next_state, next_state.player)) {
+        san[len++] = SEARCH_is_mate(&next_state) ? '#' : '+';
+    }
+    san[len] = '\0';
+}
@@ -3,7 +3,10 @@
 
 #include "state.h"
 
+#define SAN_MAX_SIZE 16
+
 move_t SAN_parse_move(const chess_state_t *state, const char *san);
+void SAN_write_move(const chess_state_t *state, const move_t move, char *san);
 
 #endif
 
@@ -1,16 +1,170 @@
 #include <stdio.h>
+#include <math.h>
 #include "search.h"
 #include "search_mtdf.h"
+#include "search_pvs.h"
+#include "search_mate.h"
 #include "eval.h"
 #include "clock.h"
+#include "thread.h"
+
+const search_param_t SEARCH_default_param =
+{
+    .razor_margin               = { 0, 60, 80, 100 },
+    .probcut_depth              = 5,
+    .probcut_margin             = 30,
+    .probcut_reduction          = 4,
+    .lmr_base                   = 50,
+    .lmr_scale                  = 45,
+    .lmr_history                = 100,
+    .lmr_not_improving          = 50,
+    .lmr_cut_node               = 50,
+    .lmr_pv_node                = 100,
+    .iir_depth                  = 0,
+    .quiescence_checks          = 1,
+};
+
+/* 100 * ln(depth) * ln(move number), both capped at 63 */
+static short reduction_table[64][64];
+
+static void SEARCH_init_reduction_table()
+{
+    for(int depth = 1; depth < 64; depth++) {
+        for(int move_number = 1; move_number < 64; move_number++) {
+            reduction_table[depth][move_number] = (short)(100.0 * log(depth) * log(move_number) + 0.5);
+        }
+    }
+}
+
+/* Picks the move from the tablebases without searching, 0 if the position is not covered */
+static move_t SEARCH_tablebase_root(const chess_state_t *s, search_state_t *search_state, short *score)
+{
+    int wdl, distance;
+    move_t move = TABLEBASE_probe_root(search_state->tablebase, s, &wdl, &distance);
+    if(!move) return 0;
+
+    search_state->tablebase_hits++;
+    if(wdl == TABLEBASE_WIN) *score = SEARCH_TABLEBASE_WIN(distance);
+    else if(wdl == TABLEBASE_LOSS) *score = -SEARCH_TABLEBASE_WIN(distance);
+    else *score = 0;
+
+    search_state->pv.moves[0] = move;
+    search_state->pv.size = 1;
+    if(search_state->think_cb) {
+        int pos_from = MOVE_GET_POS_FROM(move);
+        int pos_to = MOVE_GET_POS_TO(move);
+        int promotion_type = MOVE_PROMOTION_TYPE(move);
+        (*search_state->think_cb)(search_state->think_arg, 1, 5 * (int)*score, (int)CLOCK_time_passed(search_state->start_time_ms), search_state->num_nodes_searched, 1, &pos_from, &pos_to, &promotion_type);
+    }
+
+    return move;
+}
 
 move_t SEARCH_perform_search(const chess_state_t *s, search_state_t *search_state, short *score)
 {
+    static once_t once = THREAD_ONCE_INIT;
     move_t move = 0;
-    *score = SEARCH_mtdf_iterative(s, search_state, &move);
+
+    THREAD_once(&once, SEARCH_init_reduction_table);
+    if(search_state->tablebase && (move = SEARCH_tablebase_root(s, search_state, score))) {
+        return move;
+    }
+    if(search_state->mate_moves) {
+        if(SEARCH_mate_iterative(s, search_state, &move, score) || search_state->abort_search) {
+            return move;
+        }
+
+        /* No mate, the move is picked by a search as deep as the mate search */
+        if(search_state->max_depth > 2 * search_state->mate_moves) {
+            search_state->max_depth = (unsigned char)(2 * search_state->mate_moves);
+        }
+    }
+    if(search_state->algorithm == SEARCH_ALGORITHM_PVS) {
+        *score = SEARCH_pvs_iterative(s, search_state, &move);
+    } else {
+        *score = SEARCH_mtdf_iterative(s, search_state, &move);
+    }
     return move;
 }
 
+/* Reports the principal variation with a score in output units */
+static void SEARCH_output_score(const search_state_t *search_state, const unsigned char depth, const int output_score)
+{
+    int pos_from[MAX_SEARCH_DEPTH];
+    int pos_to[MAX_SEARCH_DEPTH];
+    int promotion_type[MAX_SEARCH_DEPTH];
+    int pv_length = search_state->pv.size;
+
+    if(!search_state->think_cb) return;
+
+    for(int i = 0; i < pv_length; i++) {
+        move_t pv_move = search_state->pv.moves[i];
+        pos_from[i] = MOVE_GET_POS_FROM(pv_move);
+        pos_to[i] = MOVE_GET_POS_TO(pv_move);
+        promotion_type[i] = MOVE_PROMOTION_TYPE(pv_move);
+    }
+    (*search_state->think_cb)(search_state->think_arg, depth, output_score, (int)CLOCK_time_passed(search_state->start_time_ms), search_state->num_nodes_searched, pv_length, pos_from, pos_to, promotion_type);
+}
+
+/* Reports a finished iteration and its principal variation. A mate score
+ * only holds the depth left at the mated node, so the plies to the mate are
+ * at least the depth searched to there, and at least the principal variation. */
+void SEARCH_output(const search_state_t *search_state, const unsigned char depth, const short score)
+{
+    if(score >= SEARCH_MAX_RESULT(0) || score <= SEARCH_MIN_RESULT(0)) {
+        int plies = depth - ((score > 0) ? score - SEARCH_MAX_RESULT(0) : SEARCH_MIN_RESULT(0) - score);
+        if(plies < search_state->pv.size) plies = search_state->pv.size;
+        int moves = (plies + 1) / 2;
+        if(moves < 1) moves = 1;
+        SEARCH_output_score(search_state, depth, (score > 0) ? ENGINE_SCORE_MATE(moves) : -ENGINE_SCORE_MATE(moves));
+        return;
+    }
+    SEARCH_output_score(search_state, depth, 5 * (int)score);
+}
+
+/* Reports a mate in moves moves found by the mate search */
+void SEARCH_output_mate(const search_state_t *search_state, const int moves)
+{
+    SEARCH_output_score(search_state, (unsigned char)(2 * moves - 1), ENGINE_SCORE_MATE(moves));
+}
+
+/* Late move reduction of a move, in plies. Captures, promotions and the
+ * first move are searched to full depth, and the reduced search is always
+ * at least one ply deep. node is a combination of the SEARCH_NODE flags. */
+unsigned char SEARCH_reduction(const search_state_t *search_state, const chess_state_t *state, const unsigned char depth, const int move_number, const move_t move, const move_t previous[2], const int node)
+{
+    const search_param_t *param = search_state->search_param;
+
+    if(move_number == 0 || depth < 3 || MOVE_IS_CAPTURE_OR_PROMOTION(move)) return 0;
+
+    int r = param->lmr_base + param->lmr_scale * reduction_table[depth < 64 ? depth : 63][move_number < 64 ? move_number : 63] / 100;
+    r -= param->lmr_history * MOVEORDER_history_score(state, move, &search_state->stats, previous) / (3 * MOVEORDER_HISTORY_MAX);
+    if(!(node & SEARCH_NODE_IMPROVING)) r += param->lmr_not_improving;
+    if(node & SEARCH_NODE_CUT) r += param->lmr_cut_node;
+    if(node & SEARCH_NODE_PV) r -= param->lmr_pv_node;
+
+    if(r < 100) return 0;
+    if(r / 100 > depth - 2) return depth - 2;
+    return (unsigned char)(r / 100);
+}
+
+/* Whether the side to move can go back to an earlier position of the game
+ * or the search, which would be scored as a draw. Positions before a null
+ * move on the searched line are not reachable. */
+int SEARCH_is_upcoming_repetition(const search_state_t *search_state, const chess_state_t *state, const unsigned char ply)
+{
+    int plies = state->halfmove_clock;
+    for(int i = ply - 1; i >= 0; i--) {
+        if(!search_state->current_move[i]) {
+            /* Null move at ply i, the position after it is not in the history */
+            plies = ply - i - 2;
+            break;
+        }
+    }
+
+    return plies >= 3 && HISTORY_is_upcoming_repetition(search_state->history, state, plies);
+}
+
 int SEARCH_is_check(const chess_state_t *s, const int color)
 {
     const int king_bitboard_index = color*NUM_TYPES + KING;
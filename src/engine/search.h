@@ -5,13 +5,55 @@
 #include "state.h"
 #include "hashtable.h"
 #include "history.h"
+#include "moveorder.h"
+#include "eval.h"
 #include "engine.h"
+#include "tablebase.h"
 
 #define SEARCH_MIN_RESULT(depth) (-1000-((short)depth))
 #define SEARCH_MAX_RESULT(depth) (1000+((short)depth))
+#define SEARCH_TABLEBASE_WIN(distance) (800-((short)distance))
 
 #define SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK 10000
 
+/* Depth of quiescence search entries in the transposition table, the
+ * search itself only stores depths of one or more */
+#define SEARCH_DEPTH_QUIESCENCE 0
+
+/* Root search drivers */
+#define SEARCH_ALGORITHM_MTDF   0
+#define SEARCH_ALGORITHM_PVS    1
+
+/* Razoring is done up to this depth */
+#define SEARCH_RAZOR_DEPTH      3
+
+/* Selectivity of the search. Like the evaluation parameters, engines only
+ * read them, and tuner -search adjusts them. */
+typedef struct search_param_t {
+    int razor_margin[SEARCH_RAZOR_DEPTH+1];     /* Static evaluation below beta by this much drops to quiescence, by depth */
+    int probcut_depth;                          /* Least depth for ProbCut */
+    int probcut_margin;                         /* ProbCut looks for captures beating beta by this much */
+    int probcut_reduction;                      /* Depth reduction of the ProbCut verification search */
+    int lmr_base;                               /* Late move reduction in hundredths of a ply is lmr_base + */
+    int lmr_scale;                              /*   lmr_scale * ln(depth) * ln(move number), adjusted by: */
+    int lmr_history;                            /* Less for the best history, more for the worst */
+    int lmr_not_improving;                      /* More if the static evaluation is worse than two plies earlier */
+    int lmr_cut_node;                           /* More at expected cut nodes, see cut_node */
+    int lmr_pv_node;                            /* Less on the principal variation */
+    int iir_depth;                              /* Least depth of PV and expected cut nodes reduced by a ply when there is no hash move, 0 for never */
+    int quiescence_checks;                      /* Nonzero to search quiet checks in the first ply of quiescence search */
+} search_param_t;
+
+extern const search_param_t SEARCH_default_param;
+
+/* Kind of node, for late move reductions */
+#define SEARCH_NODE_PV          1
+#define SEARCH_NODE_CUT         2
+#define SEARCH_NODE_IMPROVING   4
+
+/* Number of int terms in search_param_t */
+#define SEARCH_NUM_PARAMS ((int)(sizeof(search_param_t) / sizeof(int)))
+
 typedef struct {
     move_t              moves[MAX_SEARCH_DEPTH];
     int                 size;
@@ -20,20 +62,40 @@ typedef struct {
 typedef struct {
     hashtable_t         *hashtable;
     history_t           *history;
+    const eval_param_t  *eval_param;
+    const search_param_t *search_param;
+    const tablebase_t   *tablebase;
+    int                 tablebase_pieces;
+    unsigned char       tablebase_probe_depth;
+    unsigned int        tablebase_hits;
+    unsigned int        iir_reductions;     /* Nodes searched a ply shallower for lack of a hash move */
+    int                 algorithm;
     int                 abort_search;
     int                 next_clock_check;
     int64_t             start_time_ms;
     int64_t             time_for_move_ms;
     unsigned char       max_depth;
+    unsigned char       root_depth;         /* Depth of the current iteration, singular extensions stop at twice it */
     unsigned int        num_nodes_searched;
-    thinking_output_cb  think_cb;
+    unsigned int        max_nodes;
+    int                 mate_moves;         /* Only look for a mate in this many moves, 0 for a normal search */
+    thinking_output_ex_cb think_cb;
+    void                *think_arg;
     move_t              killer_move[MAX_SEARCH_DEPTH+1][2];
-    int                 history_heuristic[2][64][64];
+    moveorder_stats_t   stats;
+    move_t              current_move[MAX_SEARCH_DEPTH+1];   /* Move searched at each ply */
+    move_t              excluded_move[MAX_SEARCH_DEPTH+1];  /* Skipped by singular extension verification searches */
+    unsigned char       cut_node[MAX_SEARCH_DEPTH+2];       /* Whether the null window search at each ply is expected to fail high */
+    short               static_eval[MAX_SEARCH_DEPTH+1];    /* Static evaluation at each ply, SEARCH_MIN_RESULT(0) in check */
     pv_line_t           pv;
-    pv_line_t           pv_table[MAX_SEARCH_DEPTH];
+    pv_line_t           pv_table[MAX_SEARCH_DEPTH+2];
 } search_state_t;
 
 move_t SEARCH_perform_search(const chess_state_t *s, search_state_t *search_state, short *score);
+void SEARCH_output(const search_state_t *search_state, const unsigned char depth, const short score);
+void SEARCH_output_mate(const search_state_t *search_state, const int moves);
+unsigned char SEARCH_reduction(const search_state_t *search_state, const chess_state_t *state, const unsigned char depth, const int move_number, const move_t move, const move_t previous[2], const int node);
+int SEARCH_is_upcoming_repetition(const search_state_t *search_state, const chess_state_t *state, const unsigned char ply);
 int SEARCH_is_check(const chess_state_t *s, const int color);
 int SEARCH_is_mate(const chess_state_t *state);
 
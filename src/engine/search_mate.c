@@ -0,0 +1,179 @@
+#include <string.h>
+#include "search_mate.h"
+#include "search.h"
+#include "clock.h"
+
+/* Depth-first mate solver. There is no evaluation, pruning or quiescence
+ * search: the attacker looks for a move after which every reply leads to
+ * a mate with one move less. Only checks can mate with the last move,
+ * which keeps the tree far smaller than that of the general search. The
+ * move which decided the previous node at a ply is tried first. A line
+ * through a repetition or past the 50 move limit is a draw, unless the
+ * move reaching the limit mates. */
+
+static int SEARCH_mate_defend(const chess_state_t *state, search_state_t *search_state, const int moves, const unsigned char ply);
+
+static int SEARCH_mate_time_is_up(search_state_t *search_state)
+{
+    search_state->num_nodes_searched++;
+    search_state->next_clock_check--;
+    if(search_state->next_clock_check <= 0) {
+        search_state->next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
+        if(CLOCK_time_passed(search_state->start_time_ms) >= search_state->time_for_move_ms) {
+            search_state->abort_search = 1;
+        }
+    }
+    if(search_state->num_nodes_searched >= search_state->max_nodes) {
+        search_state->abort_search = 1;
+    }
+    return search_state->abort_search;
+}
+
+/* Legal moves, with the killer move of the ply first */
+static int SEARCH_mate_generate(const chess_state_t *state, const search_state_t *search_state, const unsigned char ply, int *num_checkers, move_t *moves)
+{
+    bitboard_t block_check, pinners, pinned;
+    *num_checkers = STATE_checkers_and_pinners(state, &block_check, &pinners, &pinned);
+    int num_moves = *num_checkers ? STATE_generate_evasions(state, *num_checkers, block_check, pinned, moves) :
+                                    STATE_generate_moves(state, *num_checkers, block_check, pinners, pinned, moves);
+
+    for(int i = 1; i < num_moves; i++) {
+        if(moves[i] == search_state->killer_move[ply][0]) {
+            moves[i] = moves[0];
+            moves[0] = search_state->killer_move[ply][0];
+            break;
+        }
+    }
+
+    return num_moves;
+}
+
+/* Whether the side to move mates in at most moves moves */
+static int SEARCH_mate_attack(const chess_state_t *state, search_state_t *search_state, const int moves, const unsigned char ply)
+{
+    move_t list[256];
+    int num_checkers;
+
+    search_state->pv_table[ply].size = 0;
+    if(SEARCH_mate_time_is_up(search_state)) {
+        return 0;
+    }
+
+    const int num_moves = SEARCH_mate_generate(state, search_state, ply, &num_checkers, list);
+
+    /* Checks first, the other moves only if a move is left after them */
+    for(int quiet = 0; quiet <= (moves > 1); quiet++) {
+        for(int i = 0; i < num_moves; i++) {
+            chess_state_t next_state = *state;
+            STATE_apply_move(&next_state, list[i]);
+            const int check = (SEARCH_is_check(&next_state, next_state.player) != 0);
+            if(check == quiet) continue;
+
+            HISTORY_push(search_state->history, next_state.hash);
+            const int mate = SEARCH_mate_defend(&next_state, search_state, moves - 1, ply + 1);
+            HISTORY_pop(search_state->history);
+
+            if(mate) {
+                search_state->killer_move[ply][0] = list[i];
+                search_state->pv_table[ply].moves[0] = list[i];
+                memcpy(&search_state->pv_table[ply].moves[1], search_state->pv_table[ply+1].moves, search_state->pv_table[ply+1].size * sizeof(move_t));
+                search_state->pv_table[ply].size = 1 + search_state->pv_table[ply+1].size;
+                return 1;
+            }
+            if(search_state->abort_search) {
+                return 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Whether the side to move is mated within moves moves whatever it plays.
+ * The principal variation follows the first reply. */
+static int SEARCH_mate_defend(const chess_state_t *state, search_state_t *search_state, const int moves, const unsigned char ply)
+{
+    move_t list[256];
+    int num_checkers;
+
+    search_state->pv_table[ply].size = 0;
+    if(SEARCH_mate_time_is_up(search_state)) {
+        return 0;
+    }
+
+    const int num_moves = SEARCH_mate_generate(state, search_state, ply, &num_checkers, list);
+
+    /* Checkmate or stalemate, then draws */
+    if(num_moves == 0) {
+        return num_checkers != 0;
+    }
+    if(moves == 0 || HISTORY_is_repetition(search_state->history, state->halfmove_clock)) {
+        return 0;
+    }
+
+    for(int i = 0; i < num_moves; i++) {
+        chess_state_t next_state = *state;
+        STATE_apply_move(&next_state, list[i]);
+
+        HISTORY_push(search_state->history, next_state.hash);
+        const int mate = !HISTORY_is_repetition(search_state->history, next_state.halfmove_clock) &&
+                         SEARCH_mate_attack(&next_state, search_state, moves, ply + 1);
+        HISTORY_pop(search_state->history);
+
+        if(!mate) {
+            if(!search_state->abort_search) {
+                search_state->killer_move[ply][0] = list[i];
+            }
+            return 0;
+        }
+
+        if(i == 0) {
+            search_state->pv_table[ply].moves[0] = list[i];
+            memcpy(&search_state->pv_table[ply].moves[1], search_state->pv_table[ply+1].moves, search_state->pv_table[ply+1].size * sizeof(move_t));
+            search_state->pv_table[ply].size = 1 + search_state->pv_table[ply+1].size;
+        }
+    }
+
+    return 1;
+}
+
+/* Whether the side to move mates in at most moves moves, and with which move */
+int SEARCH_mate(const chess_state_t *state, search_state_t *search_state, const int moves, move_t *move)
+{
+    const int mate = SEARCH_mate_attack(state, search_state, moves, 0);
+    *move = mate ? search_state->pv_table[0].moves[0] : 0;
+    return mate;
+}
+
+/* Looks for the shortest mate in at most search_state->mate_moves moves.
+ * Returns the number of moves to mate, or 0 if there is no such mate or
+ * the search was stopped, in which case move is just some legal move. The
+ * score is the one a search as deep as the mate search would give. */
+int SEARCH_mate_iterative(const chess_state_t *s, search_state_t *search_state, move_t *move, short *score)
+{
+    move_t moves[256];
+    int max_moves = search_state->mate_moves;
+    if(max_moves > MAX_SEARCH_DEPTH / 2) max_moves = MAX_SEARCH_DEPTH / 2;
+
+    *move = STATE_generate_moves_simple(s, moves) ? moves[0] : 0;
+    *score = 0;
+    search_state->pv.size = 0;
+    memset(search_state->killer_move, 0, sizeof(search_state->killer_move));
+
+    for(int mate_moves = 1; mate_moves <= max_moves; mate_moves++) {
+        move_t mate_move;
+        if(SEARCH_mate(s, search_state, mate_moves, &mate_move)) {
+            *move = mate_move;
+            *score = SEARCH_MAX_RESULT(2 * (max_moves - mate_moves) + 1);
+            search_state->pv.size = search_state->pv_table[0].size;
+            memcpy(search_state->pv.moves, search_state->pv_table[0].moves, search_state->pv.size * sizeof(move_t));
+            SEARCH_output_mate(search_state, mate_moves);
+            return mate_moves;
+        }
+        if(search_state->abort_search) {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef SEARCH_MATE_H
+#define SEARCH_MATE_H
+
+#include "state.h"
+#include "search.h"
+
+int SEARCH_mate(const chess_state_t *state, search_state_t *search_state, const int moves, move_t *move);
+int SEARCH_mate_iterative(const chess_state_t *s, search_state_t *search_state, move_t *move, short *score);
+
+#endif
@@ -16,6 +16,8 @@ short SEARCH_mtdf(const chess_state_t *s, search_state_t *search_state, const un
     
     /* Trick to disable null-move pruning on the first level of search */
     state.last_move = 0;
+    search_state->cut_node[0] = 0;
+    search_state->root_depth = depth;
     
     bounds[0] = SEARCH_MIN_RESULT(depth+1);
     bounds[1] = SEARCH_MAX_RESULT(depth+1);
@@ -55,9 +57,6 @@ short SEARCH_mtdf_iterative(const chess_state_t *s, search_state_t *search_state
     int64_t time_passed_ms = 0;
     m = 0;
 
-    /* Clear history heuristic */
-    memset(search_state->history_heuristic, 0, sizeof(search_state->history_heuristic));
-    
     /* Limit maximum search depth */
     if(search_state->max_depth > MAX_SEARCH_DEPTH) search_state->max_depth = MAX_SEARCH_DEPTH;
 
@@ -88,19 +87,7 @@ short SEARCH_mtdf_iterative(const chess_state_t *s, search_state_t *search_state
         *move = m;
         
         time_passed_ms = CLOCK_time_passed(search_state->start_time_ms);
-        if(search_state->think_cb) {
-            int pos_from[MAX_SEARCH_DEPTH];
-            int pos_to[MAX_SEARCH_DEPTH];
-            int promotion_type[MAX_SEARCH_DEPTH];
-            int pv_length = search_state->pv.size;
-            for(int i = 0; i < pv_length; i++) {
-                move_t pv_move = search_state->pv.moves[i];
-                pos_from[i] = MOVE_GET_POS_FROM(pv_move);
-                pos_to[i] = MOVE_GET_POS_TO(pv_move);
-                promotion_type[i] = MOVE_PROMOTION_TYPE(pv_move);
-            }
-            (*search_state->think_cb)(depth, 5 * (int)results[depth], (int)time_passed_ms, search_state->num_nodes_searched, pv_length, pos_from, pos_to, promotion_type);
-        }
+        SEARCH_output(search_state, depth, results[depth]);
 
         /* No need to search deeper if checkmate is detected */
         if(results[depth] <= SEARCH_MIN_RESULT(0) || results[depth] >= SEARCH_MAX_RESULT(0)) {
@@ -6,10 +6,14 @@
 #include "clock.h"
 #include "see.h"
 
+/* Singular extension: the verification search excludes the hash move */
+#define SEARCH_SINGULAR_DEPTH       8   /* Minimum depth of the node */
+#define SEARCH_SINGULAR_TT_DEPTH    3   /* The hash entry may be this much shallower */
+
 static inline short SEARCH_transpositiontable_retrieve(const hashtable_t *hashtable, const bitboard_t hash, const unsigned char depth, short beta, move_t *best_move, int *cutoff);
 static inline void SEARCH_transpositiontable_store(hashtable_t *hashtable, const bitboard_t hash, const unsigned char depth, const short best_score, move_t best_move, const short beta);
 
-static short SEARCH_move(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t move, int move_number, int do_futility_pruning, short best_score, short beta)
+static short SEARCH_move(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t move, int move_number, unsigned char R, int do_futility_pruning, short best_score, short beta)
 {
     short score;
     move_t next_move;
@@ -17,6 +21,8 @@ static short SEARCH_move(const chess_state_t *state, search_state_t *search_stat
     /* Apply move */
     chess_state_t next_state = *state;
     STATE_apply_move(&next_state, move);
+    search_state->current_move[ply] = move;
+    search_state->cut_node[ply+1] = !search_state->cut_node[ply];
 
     /* Futility pruning */
     if(do_futility_pruning) {
@@ -31,13 +37,6 @@ static short SEARCH_move(const chess_state_t *state, search_state_t *search_stat
         score = 0;
         search_state->pv_table[ply+1].size = 0;
     } else {
-        /* Late move reduction */
-        unsigned char R;
-        if(move_number < 4 || depth < 3 || MOVE_IS_CAPTURE_OR_PROMOTION(move)) R = 0;
-        else if(move_number < 12 || depth <= 3) R = 1;
-        else if(move_number < 18 || depth <= 4) R = 2;
-        else R = 3;
-
         /* Reduced search */
         if(R) {
             score = -SEARCH_nullwindow(&next_state, search_state, depth-1-R, ply+1, &next_move, -beta+1);
@@ -56,6 +55,7 @@ static short SEARCH_move(const chess_state_t *state, search_state_t *search_stat
 /* Alpha-Beta search with Nega Max and null-window */
 short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t *move, short beta)
 {
+    if(ply >= MAX_SEARCH_DEPTH) ply = MAX_SEARCH_DEPTH - 1;
     *move = 0;
     search_state->pv_table[ply].size = 0;
 
@@ -67,11 +67,17 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
             search_state->abort_search = 1;
         }
     }
+    if(search_state->num_nodes_searched >= search_state->max_nodes) {
+        search_state->abort_search = 1;
+    }
     if(search_state->abort_search) {
         return 0;
     }
 
-    if(ply > MAX_SEARCH_DEPTH) ply = MAX_SEARCH_DEPTH;
+    /* At least a draw if the side to move can go back to an earlier position */
+    if(ply && beta <= 0 && state->halfmove_clock >= 3 && SEARCH_is_upcoming_repetition(search_state, state, ply)) {
+        return 0;
+    }
 
     /* We will query the transition table soon, time to prefetch */
     HASHTABLE_transition_prefetch(search_state->hashtable, state->hash);
@@ -87,25 +93,80 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
 
     /* Quiescence search */
     if(depth == 0) {
-        return SEARCH_nullwindow_quiescence(state, search_state, beta);
+        return SEARCH_nullwindow_quiescence(state, search_state, beta, search_state->search_param->quiescence_checks);
     }
 
+    /* Mate distance pruning. No line scores better than mating with the
+     * next move, or worse than being mated here. */
+    if(ply) {
+        if(beta > SEARCH_MAX_RESULT(depth)) {
+            return SEARCH_MAX_RESULT(depth);
+        }
+        if(beta <= SEARCH_MIN_RESULT(depth)) {
+            return SEARCH_MIN_RESULT(depth);
+        }
+    }
+
+    /* Move excluded by a singular extension verification search at this ply */
+    const move_t excluded_move = search_state->excluded_move[ply];
+
     /* Query the transposition table */
     int cutoff = 0;
     short ttable_score = SEARCH_transpositiontable_retrieve(search_state->hashtable, state->hash, depth, beta, move, &cutoff);
-    if(cutoff) {
+    if(cutoff && !excluded_move) {
         if(*move || state->last_move) {
             return ttable_score;
         }
     }
 
+    /* Tablebase probe. The results only hold right after a capture or pawn
+     * move. With as many pieces as the largest tables only if deep enough.
+     * Cursed wins and blessed losses are draws. */
+    if(search_state->tablebase && ply && state->halfmove_clock == 0) {
+        int num_pieces = BITBOARD_count_bits(state->bitboard[OCCUPIED]);
+        int wdl;
+        if(num_pieces <= search_state->tablebase_pieces && (num_pieces < search_state->tablebase_pieces || depth >= search_state->tablebase_probe_depth)
+            && TABLEBASE_probe_wdl(search_state->tablebase, state, &wdl)) {
+            search_state->tablebase_hits++;
+            if(wdl == TABLEBASE_WIN) return SEARCH_TABLEBASE_WIN(ply);
+            if(wdl == TABLEBASE_LOSS) return -SEARCH_TABLEBASE_WIN(ply);
+            return 0;
+        }
+    }
+
+    /* Internal iterative reduction. Without a hash move the move ordering is
+     * poor, and the node is likely new to the search. Only at PV nodes (in
+     * SEARCH_pvs) and expected cut nodes, where a good move is all that is
+     * needed. Done after the tablebase probe in both searches. */
+    const search_param_t *param = search_state->search_param;
+    if(!*move && param->iir_depth && depth >= param->iir_depth && depth > 1 && !excluded_move && search_state->cut_node[ply]) {
+        depth--;
+        search_state->iir_reductions++;
+    }
+
+    const short static_eval = num_checkers ? 0 : EVAL_evaluate_board(state, search_state->eval_param);
+    search_state->static_eval[ply] = num_checkers ? SEARCH_MIN_RESULT(0) : static_eval;
+    const int mate_window = (beta <= SEARCH_MIN_RESULT(0) || beta >= SEARCH_MAX_RESULT(0));
+
+    /* Razoring. Far below beta near the horizon only a capture can help,
+     * which the quiescence search finds. */
+    if(ply && depth <= SEARCH_RAZOR_DEPTH && !num_checkers && !excluded_move && !mate_window &&
+       static_eval + param->razor_margin[depth] < beta) {
+        short score = SEARCH_nullwindow_quiescence(state, search_state, beta, param->quiescence_checks);
+        if(score < beta) {
+            return score;
+        }
+    }
+
     short best_score = SEARCH_MIN_RESULT(depth);
 
     /* Null move pruning */
-    if(depth > 4 && state->last_move && !num_checkers && !STATE_risk_zugzwang(state)) {
+    if(depth > 4 && state->last_move && !excluded_move && !num_checkers && !STATE_risk_zugzwang(state)) {
         unsigned char R_plus_1 = ((depth > 5) ? 4 : 3);
         chess_state_t next_state = *state;
         STATE_apply_move(&next_state, 0);
+        search_state->current_move[ply] = 0;
+        search_state->cut_node[ply+1] = 0;
         move_t next_move;
         short score = -SEARCH_nullwindow(&next_state, search_state, depth-R_plus_1, ply+1, &next_move, -beta+1);
         if(score >= beta) {
@@ -113,27 +174,111 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
         }
     }
 
+    /* ProbCut. A capture beating beta by a margin in a reduced search is
+     * taken to beat beta at full depth as well. */
+    if(best_score < beta && ply && depth >= param->probcut_depth && depth > param->probcut_reduction &&
+       !num_checkers && !excluded_move && !mate_window && beta + param->probcut_margin < SEARCH_MAX_RESULT(0)) {
+        const short probcut_beta = beta + param->probcut_margin;
+        move_t moves[256];
+        int num_moves = STATE_generate_moves_quiescence(state, num_checkers, block_check, pinners, pinned, moves);
+        MOVEORDER_rate_moves_quiescence(state, moves, num_moves, *move);
+
+        for(int i = 0; i < num_moves; i++) {
+            MOVEORDER_best_move_first(&moves[i], num_moves - i);
+
+            /* Only captures winning enough material by exchange */
+            if(!MOVE_IS_PROMOTION(moves[i]) && static_eval + PAWN_VALUE * see(state, moves[i]) < probcut_beta) {
+                continue;
+            }
+
+            chess_state_t next_state = *state;
+            STATE_apply_move(&next_state, moves[i]);
+            if(EVAL_draw(&next_state)) continue;
+            search_state->current_move[ply] = moves[i];
+            search_state->cut_node[ply+1] = 0;
+
+            /* Quiescence search first, the reduced search only if it holds */
+            move_t next_move;
+            HISTORY_push(search_state->history, next_state.hash);
+            short score = -SEARCH_nullwindow_quiescence(&next_state, search_state, -probcut_beta+1, 0);
+            if(score >= probcut_beta) {
+                score = -SEARCH_nullwindow(&next_state, search_state, depth-param->probcut_reduction, ply+1, &next_move, -probcut_beta+1);
+            }
+            HISTORY_pop(search_state->history);
+
+            if(search_state->abort_search) {
+                return 0;
+            }
+            if(score >= probcut_beta) {
+                *move = moves[i];
+                HASHTABLE_transition_store(search_state->hashtable, state->hash, depth-param->probcut_reduction+1, TTABLE_TYPE_LOWER_BOUND, score, *move);
+                return score;
+            }
+        }
+    }
+
+    /* Singular extension. The hash move is extended if all other moves fail
+     * low against a margin below its score. If another move reaches beta
+     * as well, several moves beat beta and the node is cut (multi-cut).
+     * In check the node is extended already. Chains of extensions keep the
+     * depth from falling, so they stop at twice the depth of the iteration. */
+    move_t singular_move = 0;
+    if(best_score < beta && depth >= SEARCH_SINGULAR_DEPTH && ply && ply < 2 * search_state->root_depth && *move && !excluded_move && !num_checkers && !mate_window) {
+        transposition_entry_t ttentry;
+        if(HASHTABLE_transition_retrieve(search_state->hashtable, state->hash, &ttentry) &&
+           ttentry.type == TTABLE_TYPE_LOWER_BOUND && ttentry.depth + SEARCH_SINGULAR_TT_DEPTH >= depth &&
+           ttentry.score > SEARCH_MIN_RESULT(0) && ttentry.score < SEARCH_MAX_RESULT(0)) {
+            const short singular_beta = ttentry.score - 2 * depth;
+            move_t next_move;
+
+            search_state->excluded_move[ply] = ttentry.best_move;
+            short score = SEARCH_nullwindow(state, search_state, (depth - 1) / 2, ply, &next_move, singular_beta);
+            search_state->excluded_move[ply] = 0;
+            *move = ttentry.best_move;
+            if(search_state->abort_search) {
+                return 0;
+            }
+
+            if(score < singular_beta) {
+                singular_move = ttentry.best_move;
+            } else if(singular_beta >= beta) {
+                return singular_beta;
+            }
+        }
+    }
+
     if(best_score < beta) {
         /* Generate and rate moves */
         move_t moves[256];
-        int num_moves = STATE_generate_moves(state, num_checkers, block_check, pinners, pinned, moves);
-        MOVEORDER_rate_moves(state, moves, num_moves, *move, search_state->killer_move[ply], search_state->history_heuristic[state->player]);
+        move_t quiets[64];
+        int num_quiets = 0;
+        const move_t previous[2] = { state->last_move, (ply >= 2) ? search_state->current_move[ply-2] : 0 };
+        int num_moves = num_checkers ? STATE_generate_evasions(state, num_checkers, block_check, pinned, moves) :
+                                       STATE_generate_moves(state, num_checkers, block_check, pinners, pinned, moves);
+        MOVEORDER_rate_moves(state, moves, num_moves, *move, search_state->killer_move[ply], &search_state->stats, previous);
 
         /* Check if node is eligible for futility pruning */
         int do_futility_pruning = 0;
         if(depth <= 3 && !num_checkers) {
             const int margin[4] = { 0, 20, 25, 30 };
-            if(beta > EVAL_evaluate_board(state) + margin[depth]) {
+            if(beta > static_eval + margin[depth]) {
                 do_futility_pruning = 1;
             }
         }
 
+        /* Kind of node for late move reductions */
+        int node = 0;
+        if(search_state->cut_node[ply]) node |= SEARCH_NODE_CUT;
+        if(!num_checkers && (ply < 2 || static_eval > search_state->static_eval[ply-2])) node |= SEARCH_NODE_IMPROVING;
+
         /* Iterate over all moves */
         for(int i = 0; i < num_moves; i++) {
             /* Pick move with the highest score */
             MOVEORDER_best_move_first(&moves[i], num_moves - i);
+            if(moves[i] == excluded_move) continue;
 
-            short score = SEARCH_move(state, search_state, depth, ply, moves[i], i, do_futility_pruning, best_score, beta);
+            unsigned char R = SEARCH_reduction(search_state, state, depth, i, moves[i], previous, node);
+            short score = SEARCH_move(state, search_state, depth + (moves[i] == singular_move), ply, moves[i], i, R, do_futility_pruning, best_score, beta);
 
             /* Check if score improved by this move */
             if(score > best_score) {
@@ -152,12 +297,16 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
                             search_state->killer_move[ply][1] = search_state->killer_move[ply][0];
                             search_state->killer_move[ply][0] = *move;
                         }
-                        /* History heuristic */
-                        search_state->history_heuristic[state->player][MOVE_GET_POS_FROM(*move)][MOVE_GET_POS_TO(*move)] += depth*depth;
+                        /* History, continuation history and counter move */
+                        MOVEORDER_update_stats(&search_state->stats, state, previous, *move, quiets, num_quiets, depth);
                     }
                     break;
                 }
             }
+
+            if(!MOVE_IS_CAPTURE_OR_PROMOTION(moves[i]) && !do_futility_pruning && num_quiets < 64) {
+                quiets[num_quiets++] = moves[i];
+            }
         }
 
         /* Detect checkmate and stalemate */
@@ -171,8 +320,8 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
         }
     }
 
-    /* Store the result in the transposition table */
-    if(!search_state->abort_search) {
+    /* Store the result in the transposition table, not of a search without the hash move */
+    if(!search_state->abort_search && !excluded_move) {
         SEARCH_transpositiontable_store(search_state->hashtable, state->hash, depth, best_score, *move, beta);
     }
 
@@ -180,16 +329,31 @@ short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state
     return best_score;
 }
 
-/* Alpha-Beta quiescence search with Nega Max and null-window */
-short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *search_state, short beta)
+/* Alpha-Beta quiescence search with Nega Max and null-window. With checks,
+ * quiet moves giving check are searched as well, which is only done in the
+ * first ply. */
+short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *search_state, short beta, const int checks)
 {
     int num_moves;
     int i;
     short score;
     short best_score;
+    move_t best_move = 0;
     chess_state_t next_state;
     move_t moves[256];
 
+    /* Query the transposition table. Entries of any depth will do, mate scores are left to the search. */
+    transposition_entry_t ttentry;
+    if(HASHTABLE_transition_retrieve(search_state->hashtable, state->hash, &ttentry)) {
+        best_move = ttentry.best_move;
+        if(ttentry.score > SEARCH_MIN_RESULT(0) && ttentry.score < SEARCH_MAX_RESULT(0)) {
+            if((ttentry.type == TTABLE_TYPE_UPPER_BOUND) ? (ttentry.score < beta) : (ttentry.score >= beta)) {
+                return ttentry.score;
+            }
+        }
+    }
+    move_t hash_move = best_move;
+
     /* Is playing side in check? */
     bitboard_t block_check, pinners, pinned;
     int num_checkers = STATE_checkers_and_pinners(state, &block_check, &pinners, &pinned);
@@ -197,26 +361,29 @@ short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *s
     if(num_checkers) best_score = SEARCH_MIN_RESULT(0);
     else {
         /* Stand-pat */
-        best_score = EVAL_evaluate_board(state);
+        best_score = EVAL_evaluate_board(state, search_state->eval_param);
         search_state->num_nodes_searched++;
         if(best_score >= beta) {
             return best_score;
         }
     }
 
-    /* Generate and rate moves (captures and promotions only) */
+    /* Generate and rate moves (captures and promotions only, and maybe quiet checks) */
     if(num_checkers) {
-        num_moves = STATE_generate_moves(state, num_checkers, block_check, pinners, pinned, moves);
+        num_moves = STATE_generate_evasions(state, num_checkers, block_check, pinned, moves);
     } else {
         num_moves = STATE_generate_moves_quiescence(state, num_checkers, block_check, pinners, pinned, moves);
+        if(checks) {
+            num_moves += STATE_generate_checks(state, pinners, pinned, moves + num_moves);
+        }
     }
-    MOVEORDER_rate_moves_quiescence(state, moves, num_moves);
+    MOVEORDER_rate_moves_quiescence(state, moves, num_moves, hash_move);
 
     for(i = 0; i < num_moves; i++) {
         /* Pick move with the highest score */
         MOVEORDER_best_move_first(&moves[i], num_moves - i);
 
-        /* Prune all captures with SEE < 0 */
+        /* Prune all captures and checks with SEE < 0 */
         if(!MOVE_IS_PROMOTION(moves[i]) && !num_checkers) {
             if(SEE_capture_less_valuable(moves[i]) && see(state, moves[i]) < 0) {
                 continue;
@@ -226,9 +393,10 @@ short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *s
         next_state = *state;
         STATE_apply_move(&next_state, moves[i]);
 
-        score = -SEARCH_nullwindow_quiescence(&next_state, search_state, -beta+1);
+        score = -SEARCH_nullwindow_quiescence(&next_state, search_state, -beta+1, 0);
         if(score > best_score) {
             best_score = score;
+            best_move = moves[i];
             if(best_score >= beta) {
                 /* Beta-cuttoff */
                 break;
@@ -236,28 +404,31 @@ short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *s
         }
     }
 
+    /* Store the result unless it would replace a search entry */
+    HASHTABLE_transition_store_shallow(search_state->hashtable, state->hash, SEARCH_DEPTH_QUIESCENCE, (best_score < beta) ? TTABLE_TYPE_UPPER_BOUND : TTABLE_TYPE_LOWER_BOUND, best_score, best_move);
+
     return best_score;
 }
 
 static inline short SEARCH_transpositiontable_retrieve(const hashtable_t *hashtable, const bitboard_t hash, const unsigned char depth, short beta, move_t *best_move, int *cutoff)
 {
-    transposition_entry_t *ttentry = HASHTABLE_transition_retrieve(hashtable, hash);
-    if(ttentry) {
-        *best_move = ttentry->best_move;
+    transposition_entry_t ttentry;
+    if(HASHTABLE_transition_retrieve(hashtable, hash, &ttentry)) {
+        *best_move = ttentry.best_move;
 
-        if(ttentry->depth >= depth) {
-            short score = ttentry->score;
-            if(ttentry->type == TTABLE_TYPE_UPPER_BOUND) {
+        if(ttentry.depth >= depth) {
+            short score = ttentry.score;
+            if(ttentry.type == TTABLE_TYPE_UPPER_BOUND) {
                 if(score < beta) {
                     short min = SEARCH_MIN_RESULT(0);
                     *cutoff = 1;
-                    return (score <= min) ? score + ttentry->depth - depth : score;
+                    return (score <= min) ? score + ttentry.depth - depth : score;
                 }
             } else { /* TTABLE_TYPE_LOWER_BOUND */
                 if(score >= beta) {
                     short max = SEARCH_MAX_RESULT(0);
                     *cutoff = 1;
-                    return (score >= max) ? score - ttentry->depth + depth : score;
+                    return (score >= max) ? score - ttentry.depth + depth : score;
                 }
             }
         }
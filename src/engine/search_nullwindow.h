@@ -5,6 +5,6 @@
 #include "search.h"
 
 short SEARCH_nullwindow(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t *move, short beta);
-short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *search_state, short beta);
+short SEARCH_nullwindow_quiescence(const chess_state_t *state, search_state_t *search_state, short beta, const int checks);
 
 #endif
@@ -0,0 +1,265 @@
+#include <string.h>
+#include "search_pvs.h"
+#include "search_nullwindow.h"
+#include "search_quiescence.h"
+#include "search.h"
+#include "eval.h"
+#include "moveorder.h"
+#include "clock.h"
+
+/* Half width of the first aspiration window, doubled on every fail */
+#define SEARCH_ASPIRATION_WINDOW    5
+#define SEARCH_ASPIRATION_DEPTH     4
+
+static short SEARCH_pvs_move(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t move, int move_number, unsigned char R, short alpha, short beta)
+{
+    short score;
+    move_t next_move;
+
+    /* Apply move */
+    chess_state_t next_state = *state;
+    STATE_apply_move(&next_state, move);
+    search_state->current_move[ply] = move;
+
+    HISTORY_push(search_state->history, next_state.hash);
+    if(HISTORY_is_repetition(search_state->history, next_state.halfmove_clock) || EVAL_draw(&next_state)) {
+        /* Draw detected */
+        score = 0;
+        search_state->pv_table[ply+1].size = 0;
+    } else if(move_number == 0) {
+        /* The first move is expected to be best, full window */
+        score = -SEARCH_pvs(&next_state, search_state, depth-1, ply+1, &next_move, -beta, -alpha);
+    } else {
+        /* Null window around alpha, reduced first. The move is expected to
+         * fail low, which makes the reply an expected cut node. */
+        score = alpha + 1;
+        search_state->cut_node[ply+1] = 1;
+        if(R) {
+            score = -SEARCH_nullwindow(&next_state, search_state, depth-1-R, ply+1, &next_move, -alpha);
+        }
+        if(score > alpha) {
+            score = -SEARCH_nullwindow(&next_state, search_state, depth-1, ply+1, &next_move, -alpha);
+        }
+
+        /* Better than the first move, find the exact score */
+        if(score > alpha && score < beta) {
+            score = -SEARCH_pvs(&next_state, search_state, depth-1, ply+1, &next_move, -beta, -alpha);
+        }
+    }
+    HISTORY_pop(search_state->history);
+
+    return score;
+}
+
+/* Principal variation search. Only nodes on the principal variation are
+ * searched with a full window, all others with SEARCH_nullwindow. */
+short SEARCH_pvs(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t *move, short alpha, short beta)
+{
+    if(ply >= MAX_SEARCH_DEPTH) ply = MAX_SEARCH_DEPTH - 1;
+    *move = 0;
+    search_state->pv_table[ply].size = 0;
+
+    /* Check if time is up */
+    search_state->next_clock_check--;
+    if(search_state->next_clock_check <= 0) {
+        search_state->next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
+        if(CLOCK_time_passed(search_state->start_time_ms) >= search_state->time_for_move_ms) {
+            search_state->abort_search = 1;
+        }
+    }
+    if(search_state->num_nodes_searched >= search_state->max_nodes) {
+        search_state->abort_search = 1;
+    }
+    if(search_state->abort_search) {
+        return 0;
+    }
+
+    /* At least a draw if the side to move can go back to an earlier position, as in SEARCH_nullwindow */
+    if(ply && beta <= 0 && state->halfmove_clock >= 3 && SEARCH_is_upcoming_repetition(search_state, state, ply)) {
+        return 0;
+    }
+
+    HASHTABLE_transition_prefetch(search_state->hashtable, state->hash);
+
+    /* Is playing side in check? */
+    bitboard_t block_check, pinners, pinned;
+    int num_checkers = STATE_checkers_and_pinners(state, &block_check, &pinners, &pinned);
+
+    /* Check extension */
+    if(num_checkers) {
+        depth += 1;
+    }
+
+    /* Quiescence search */
+    if(depth == 0) {
+        return SEARCH_quiescence(state, search_state, alpha, beta, search_state->search_param->quiescence_checks);
+    }
+
+    /* Only the move is taken from the transposition table, a cutoff would cut the principal variation short */
+    transposition_entry_t ttentry;
+    if(HASHTABLE_transition_retrieve(search_state->hashtable, state->hash, &ttentry)) {
+        *move = ttentry.best_move;
+    }
+
+    /* Tablebase probe, like in SEARCH_nullwindow */
+    if(search_state->tablebase && ply && state->halfmove_clock == 0) {
+        int num_pieces = BITBOARD_count_bits(state->bitboard[OCCUPIED]);
+        int wdl;
+        if(num_pieces <= search_state->tablebase_pieces && (num_pieces < search_state->tablebase_pieces || depth >= search_state->tablebase_probe_depth)
+            && TABLEBASE_probe_wdl(search_state->tablebase, state, &wdl)) {
+            search_state->tablebase_hits++;
+            if(wdl == TABLEBASE_WIN) return SEARCH_TABLEBASE_WIN(ply);
+            if(wdl == TABLEBASE_LOSS) return -SEARCH_TABLEBASE_WIN(ply);
+            return 0;
+        }
+    }
+
+    /* Internal iterative reduction, as in SEARCH_nullwindow. Every node here is a PV node. */
+    if(!*move && search_state->search_param->iir_depth && depth >= search_state->search_param->iir_depth && depth > 1) {
+        depth--;
+        search_state->iir_reductions++;
+    }
+
+    /* Static evaluation, only needed to tell if the position improved for the late move reductions */
+    const short static_eval = num_checkers ? SEARCH_MIN_RESULT(0) : EVAL_evaluate_board(state, search_state->eval_param);
+    search_state->static_eval[ply] = static_eval;
+    int node = SEARCH_NODE_PV;
+    if(!num_checkers && (ply < 2 || static_eval > search_state->static_eval[ply-2])) node |= SEARCH_NODE_IMPROVING;
+
+    const short original_alpha = alpha;
+    short best_score = SEARCH_MIN_RESULT(depth);
+
+    /* Generate and rate moves */
+    move_t moves[256];
+    move_t quiets[64];
+    int num_quiets = 0;
+    const move_t previous[2] = { state->last_move, (ply >= 2) ? search_state->current_move[ply-2] : 0 };
+    int num_moves = num_checkers ? STATE_generate_evasions(state, num_checkers, block_check, pinned, moves) :
+                                   STATE_generate_moves(state, num_checkers, block_check, pinners, pinned, moves);
+    MOVEORDER_rate_moves(state, moves, num_moves, *move, search_state->killer_move[ply], &search_state->stats, previous);
+
+    /* Iterate over all moves */
+    for(int i = 0; i < num_moves; i++) {
+        /* Pick move with the highest score */
+        MOVEORDER_best_move_first(&moves[i], num_moves - i);
+
+        unsigned char R = SEARCH_reduction(search_state, state, depth, i, moves[i], previous, node);
+        short score = SEARCH_pvs_move(state, search_state, depth, ply, moves[i], i, R, alpha, beta);
+        if(search_state->abort_search) {
+            return 0;
+        }
+
+        /* Check if score improved by this move */
+        if(score > best_score) {
+            best_score = score;
+            *move = moves[i];
+
+            search_state->pv_table[ply].moves[0] = *move;
+            memcpy(&search_state->pv_table[ply].moves[1], search_state->pv_table[ply+1].moves, search_state->pv_table[ply+1].size * sizeof(move_t));
+            search_state->pv_table[ply].size = 1 + search_state->pv_table[ply+1].size;
+
+            if(best_score > alpha) {
+                alpha = best_score;
+            }
+
+            /* Beta-cuttoff */
+            if(best_score >= beta) {
+                if(!MOVE_IS_CAPTURE_OR_PROMOTION(*move)) {
+                    /* Killer move */
+                    if(*move != search_state->killer_move[ply][0]) {
+                        search_state->killer_move[ply][1] = search_state->killer_move[ply][0];
+                        search_state->killer_move[ply][0] = *move;
+                    }
+                    /* History, continuation history and counter move */
+                    MOVEORDER_update_stats(&search_state->stats, state, previous, *move, quiets, num_quiets, depth);
+                }
+                break;
+            }
+        }
+
+        if(!MOVE_IS_CAPTURE_OR_PROMOTION(moves[i]) && num_quiets < 64) {
+            quiets[num_quiets++] = moves[i];
+        }
+    }
+
+    /* Detect checkmate and stalemate */
+    if(num_moves == 0 && !num_checkers) {
+        best_score = 0;
+    }
+
+    /* An exact score is stored as a lower bound, the null window searches only need bounds */
+    HASHTABLE_transition_store(search_state->hashtable, state->hash, depth, (best_score > original_alpha) ? TTABLE_TYPE_LOWER_BOUND : TTABLE_TYPE_UPPER_BOUND, best_score, *move);
+
+    return best_score;
+}
+
+short SEARCH_pvs_iterative(const chess_state_t *s, search_state_t *search_state, move_t *move)
+{
+    unsigned char depth;
+    short result = 0;
+    move_t m;
+    int64_t time_passed_ms = 0;
+    chess_state_t state = *s;
+    *move = 0;
+
+    /* Limit maximum search depth */
+    if(search_state->max_depth > MAX_SEARCH_DEPTH) search_state->max_depth = MAX_SEARCH_DEPTH;
+
+    search_state->pv.size = 0;
+
+    for(depth = 1; depth <= search_state->max_depth; depth++) {
+        short window = SEARCH_ASPIRATION_WINDOW;
+        short alpha = SEARCH_MIN_RESULT(depth+1);
+        short beta = SEARCH_MAX_RESULT(depth+1);
+        short score;
+
+        /* Aspiration window around the previous result, unless it is a mate */
+        if(depth >= SEARCH_ASPIRATION_DEPTH && result > SEARCH_MIN_RESULT(0) && result < SEARCH_MAX_RESULT(0)) {
+            alpha = result - window;
+            beta = result + window;
+        }
+
+        /* Widen the window on the side it failed until the score lies within */
+        search_state->root_depth = depth;
+        for(;;) {
+            score = SEARCH_pvs(&state, search_state, depth, 0, &m, alpha, beta);
+            if(search_state->abort_search) break;
+
+            if(score > alpha) {
+                *move = m;
+                search_state->pv.size = search_state->pv_table[0].size;
+                memcpy(search_state->pv.moves, search_state->pv_table[0].moves, search_state->pv.size * sizeof(move_t));
+            }
+
+            window *= 2;
+            if(score <= alpha && alpha > SEARCH_MIN_RESULT(depth+1)) {
+                alpha = (score - window > SEARCH_MIN_RESULT(depth+1)) ? score - window : SEARCH_MIN_RESULT(depth+1);
+            } else if(score >= beta && beta < SEARCH_MAX_RESULT(depth+1)) {
+                beta = (score + window < SEARCH_MAX_RESULT(depth+1)) ? score + window : SEARCH_MAX_RESULT(depth+1);
+            } else {
+                break;
+            }
+        }
+
+        if(search_state->abort_search) {
+            /* Better than nothing if the first iteration did not finish */
+            if(!*move) *move = m;
+            break;
+        }
+
+        result = score;
+        time_passed_ms = CLOCK_time_passed(search_state->start_time_ms);
+        SEARCH_output(search_state, depth, result);
+
+        /* No need to search deeper if checkmate is detected */
+        if(result <= SEARCH_MIN_RESULT(0) || result >= SEARCH_MAX_RESULT(0)) {
+            break;
+        }
+
+        if(2 * time_passed_ms > search_state->time_for_move_ms) {
+            break;
+        }
+    }
+
+    return result;
+}
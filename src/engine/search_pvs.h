@@ -0,0 +1,10 @@
+#ifndef SEARCH_PVS_H
+#define SEARCH_PVS_H
+
+#include "state.h"
+#include "search.h"
+
+short SEARCH_pvs(const chess_state_t *state, search_state_t *search_state, unsigned char depth, unsigned char ply, move_t *move, short alpha, short beta);
+short SEARCH_pvs_iterative(const chess_state_t *s, search_state_t *search_state, move_t *move);
+
+#endif
@@ -0,0 +1,75 @@
+#include "search_quiescence.h"
+#include "search.h"
+#include "eval.h"
+#include "moveorder.h"
+#include "see.h"
+
+/* Alpha-Beta quiescence search with Nega Max and a full window. Prunes and
+ * orders moves like SEARCH_nullwindow_quiescence, but finds the exact score
+ * in a single pass when it lies within the window. */
+short SEARCH_quiescence(const chess_state_t *state, search_state_t *search_state, short alpha, short beta, const int checks)
+{
+    int num_moves;
+    int i;
+    short score;
+    short best_score;
+    chess_state_t next_state;
+    move_t moves[256];
+
+    /* Is playing side in check? */
+    bitboard_t block_check, pinners, pinned;
+    int num_checkers = STATE_checkers_and_pinners(state, &block_check, &pinners, &pinned);
+
+    if(num_checkers) best_score = SEARCH_MIN_RESULT(0);
+    else {
+        /* Stand-pat */
+        best_score = EVAL_evaluate_board(state, search_state->eval_param);
+        search_state->num_nodes_searched++;
+        if(best_score >= beta) {
+            return best_score;
+        }
+        if(best_score > alpha) {
+            alpha = best_score;
+        }
+    }
+
+    /* Generate and rate moves (captures and promotions only, and maybe quiet checks) */
+    if(num_checkers) {
+        num_moves = STATE_generate_evasions(state, num_checkers, block_check, pinned, moves);
+    } else {
+        num_moves = STATE_generate_moves_quiescence(state, num_checkers, block_check, pinners, pinned, moves);
+        if(checks) {
+            num_moves += STATE_generate_checks(state, pinners, pinned, moves + num_moves);
+        }
+    }
+    MOVEORDER_rate_moves_quiescence(state, moves, num_moves, 0);
+
+    for(i = 0; i < num_moves; i++) {
+        /* Pick move with the highest score */
+        MOVEORDER_best_move_first(&moves[i], num_moves - i);
+
+        /* Prune all captures and checks with SEE < 0 */
+        if(!MOVE_IS_PROMOTION(moves[i]) && !num_checkers) {
+            if(SEE_capture_less_valuable(moves[i]) && see(state, moves[i]) < 0) {
+                continue;
+            }
+        }
+
+        next_state = *state;
+        STATE_apply_move(&next_state, moves[i]);
+
+        score = -SEARCH_quiescence(&next_state, search_state, -beta, -alpha, 0);
+        if(score > best_score) {
+            best_score = score;
+            if(best_score >= beta) {
+                /* Beta-cuttoff */
+                break;
+            }
+            if(best_score > alpha) {
+                alpha = best_score;
+            }
+        }
+    }
+
+    return best_score;
+}
@@ -0,0 +1,9 @@
+#ifndef SEARCH_QUIESCENCE_H
+#define SEARCH_QUIESCENCE_H
+
+#include "state.h"
+#include "search.h"
+
+short SEARCH_quiescence(const chess_state_t *state, search_state_t *search_state, short alpha, short beta, const int checks);
+
+#endif
@@ -1,7 +1,7 @@
 #include "see.h"
 #include "eval.h"
 
-static short piece_value[] = { 1, 3, 3, 5, 9, 20 };
+static const short piece_value[] = { 1, 3, 3, 5, 9, 20 };
 
 static bitboard_t SEE_find_all_attackers(const chess_state_t *s, const bitboard_t occupied, const int pos, bitboard_t *blocked_attackers)
 {
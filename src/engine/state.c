@@ -592,6 +592,221 @@ int STATE_generate_moves_quiescence(const chess_state_t *s, int num_checkers, bi
     return num_moves;
 }
 
+static int STATE_piece_type(const chess_state_t *s, int color_index, bitboard_t pos_bb)
+{
+    int type = PAWN;
+    while(type < KING && !(s->bitboard[color_index + type] & pos_bb)) type++;
+    return type;
+}
+
+/* Moves out of check, the same moves as STATE_generate_moves but only the
+ * king and pieces able to reach a square in block_check are looked at */
+int STATE_generate_evasions(const chess_state_t *s, int num_checkers, bitboard_t block_check, bitboard_t pinned, move_t *moves)
+{
+    int num_moves = 0;
+    const int player = s->player;
+    const int opponent = player ^ 1;
+    const int player_index = NUM_TYPES*player;
+    const int opponent_index = NUM_TYPES*opponent;
+    const bitboard_t player_pieces = s->bitboard[player_index + ALL];
+    const bitboard_t opponent_pieces = s->bitboard[opponent_index + ALL];
+    const int king_pos = BITBOARD_find_bit(s->bitboard[player_index + KING]);
+
+    /* King */
+    {
+        bitboard_t possible_moves, possible_captures;
+        MOVEGEN_king(king_pos, player_pieces, opponent_pieces, &possible_moves, &possible_captures);
+
+        while(possible_captures) {
+            int pos_to = BITBOARD_find_bit(possible_captures);
+            bitboard_t pos_to_bb = BITBOARD_POSITION(pos_to);
+            if(!EVAL_position_is_attacked(s, player, pos_to)) {
+                STATE_add_move_to_list(pos_to, king_pos, KING, STATE_piece_type(s, opponent_index, pos_to_bb), MOVE_CAPTURE, moves + num_moves++);
+            }
+            possible_captures ^= pos_to_bb;
+        }
+
+        while(possible_moves) {
+            int pos_to = BITBOARD_find_bit(possible_moves);
+            if(!EVAL_position_is_attacked(s, player, pos_to)) {
+                STATE_add_move_to_list(pos_to, king_pos, KING, 0, MOVE_QUIET, moves + num_moves++);
+            }
+            possible_moves ^= BITBOARD_POSITION(pos_to);
+        }
+    }
+
+    /* Only the king can move during double check */
+    if(num_checkers > 1) return num_moves;
+
+    /* The checker is the only piece in block_check, the rest are empty squares between it and the king */
+    const bitboard_t checker_bb = block_check & opponent_pieces;
+    const int checker_pos = BITBOARD_find_bit(checker_bb);
+    const int checker_type = STATE_piece_type(s, opponent_index, checker_bb);
+    const bitboard_t block = block_check ^ checker_bb;
+
+    /* Pinned pieces can not move during check */
+    const bitboard_t pawns = s->bitboard[player_index + PAWN] & ~pinned;
+    const int step = (player == WHITE) ? -8 : 8;
+
+    /* Pawn captures of the checker */
+    bitboard_t pieces = bitboard_pawn_capture[opponent][checker_pos] & pawns;
+    while(pieces) {
+        int pos_from = BITBOARD_find_bit(pieces);
+        if(checker_bb & BITBOARD_PROMOTION) {
+            num_moves += STATE_add_move_to_list_promotion_capture(checker_pos, pos_from, checker_type, moves + num_moves);
+        } else {
+            STATE_add_move_to_list(checker_pos, pos_from, PAWN, checker_type, MOVE_CAPTURE, moves + num_moves++);
+        }
+        pieces ^= BITBOARD_POSITION(pos_from);
+    }
+
+    /* A pawn giving check right after a double push can also be taken en passant */
+    if(s->ep_file != STATE_EN_PASSANT_NONE) {
+        const int ep_pos = ((player == WHITE) ? 40 : 16) + s->ep_file;
+        pieces = (bitboard_ep_capture[ep_pos] & checker_bb) ? bitboard_ep_capturers[player][s->ep_file] & pawns : 0;
+        while(pieces) {
+            int pos_from = BITBOARD_find_bit(pieces);
+            STATE_add_move_to_list(ep_pos, pos_from, PAWN, PAWN, MOVE_EP_CAPTURE, moves + num_moves++);
+            pieces ^= BITBOARD_POSITION(pos_from);
+        }
+    }
+
+    /* Pawn pushes in between */
+    bitboard_t targets = block;
+    while(targets) {
+        int pos_to = BITBOARD_find_bit(targets);
+        bitboard_t pos_to_bb = BITBOARD_POSITION(pos_to);
+        bitboard_t pos_from_bb = (player == WHITE) ? pos_to_bb >> 8 : pos_to_bb << 8;
+        if(pawns & pos_from_bb) {
+            if(pos_to_bb & BITBOARD_PROMOTION) {
+                num_moves += STATE_add_move_to_list_promotion(pos_to, pos_to + step, moves + num_moves);
+            } else {
+                STATE_add_move_to_list(pos_to, pos_to + step, PAWN, 0, MOVE_QUIET, moves + num_moves++);
+            }
+        } else if(BITBOARD_GET_RANK(pos_to) == ((player == WHITE) ? 3 : 4) && !(s->bitboard[OCCUPIED] & pos_from_bb) &&
+                  (pawns & BITBOARD_POSITION(pos_to + 2 * step))) {
+            STATE_add_move_to_list(pos_to, pos_to + 2 * step, PAWN, 0, MOVE_DOUBLE_PAWN_PUSH, moves + num_moves++);
+        }
+        targets ^= pos_to_bb;
+    }
+
+    /* Knights, bishops, rooks and queens, found by looking back from the squares in block_check */
+    const bitboard_t knights = s->bitboard[player_index + KNIGHT] & ~pinned;
+    const bitboard_t diagonal = (s->bitboard[player_index + BISHOP] | s->bitboard[player_index + QUEEN]) & ~pinned;
+    const bitboard_t straight = (s->bitboard[player_index + ROOK] | s->bitboard[player_index + QUEEN]) & ~pinned;
+    targets = block_check;
+    while(targets) {
+        int pos_to = BITBOARD_find_bit(targets);
+        bitboard_t pos_to_bb = BITBOARD_POSITION(pos_to);
+        bitboard_t empty, reached, attackers;
+        int special = (pos_to_bb & checker_bb) ? MOVE_CAPTURE : MOVE_QUIET;
+        int captured_type = (pos_to_bb & checker_bb) ? checker_type : 0;
+
+        attackers = bitboard_knight[pos_to] & knights;
+        MOVEGEN_bishop(pos_to, 0, s->bitboard[OCCUPIED], &empty, &reached);
+        attackers |= reached & diagonal;
+        MOVEGEN_rook(pos_to, 0, s->bitboard[OCCUPIED], &empty, &reached);
+        attackers |= reached & straight;
+
+        while(attackers) {
+            int pos_from = BITBOARD_find_bit(attackers);
+            bitboard_t pos_from_bb = BITBOARD_POSITION(pos_from);
+            STATE_add_move_to_list(pos_to, pos_from, STATE_piece_type(s, player_index, pos_from_bb), captured_type, special, moves + num_moves++);
+            attackers ^= pos_from_bb;
+        }
+
+        targets ^= pos_to_bb;
+    }
+
+    return num_moves;
+}
+
+/* Quiet moves giving direct check, for the first ply of quiescence search.
+ * Must not be called in check. Castling, promotions and discovered checks
+ * are left out. */
+int STATE_generate_checks(const chess_state_t *s, bitboard_t pinners, bitboard_t pinned, move_t *moves)
+{
+    int num_moves = 0;
+    const int player = s->player;
+    const int opponent = player ^ 1;
+    const int player_index = NUM_TYPES*player;
+    const bitboard_t player_pieces = s->bitboard[player_index + ALL];
+    const bitboard_t opponent_pieces = s->bitboard[NUM_TYPES*opponent + ALL];
+    const bitboard_t empty = ~s->bitboard[OCCUPIED];
+    const int king_pos = BITBOARD_find_bit(s->bitboard[player_index + KING]);
+    const int opponent_king_pos = BITBOARD_find_bit(s->bitboard[NUM_TYPES*opponent + KING]);
+
+    /* Empty squares from where each kind of piece would attack the opponent king */
+    bitboard_t check_squares[NUM_TYPES];
+    bitboard_t reached;
+    check_squares[PAWN] = bitboard_pawn_capture[opponent][opponent_king_pos] & empty & ~BITBOARD_PROMOTION;
+    check_squares[KNIGHT] = bitboard_knight[opponent_king_pos] & empty;
+    MOVEGEN_bishop(opponent_king_pos, 0, s->bitboard[OCCUPIED], &check_squares[BISHOP], &reached);
+    MOVEGEN_rook(opponent_king_pos, 0, s->bitboard[OCCUPIED], &check_squares[ROOK], &reached);
+    check_squares[QUEEN] = check_squares[BISHOP] | check_squares[ROOK];
+
+    /* Pawns, the pinned ones one by one */
+    if(check_squares[PAWN]) {
+        const int step = (player == WHITE) ? -8 : 8;
+        bitboard_t push, push2, dummy;
+        MOVEGEN_all_pawns(player, s->bitboard[player_index + PAWN] & ~pinned, player_pieces, opponent_pieces, &push, &push2, &dummy, &dummy, &dummy, &dummy, &dummy);
+        push &= check_squares[PAWN];
+        push2 &= check_squares[PAWN];
+
+        bitboard_t pieces = s->bitboard[player_index + PAWN] & pinned;
+        while(pieces) {
+            int pos_from = BITBOARD_find_bit(pieces);
+            bitboard_t pos_from_bb = BITBOARD_POSITION(pos_from);
+            bitboard_t pin_mask = STATE_pin_mask(pos_from_bb, king_pos, pinners) & check_squares[PAWN];
+            bitboard_t push_piece, push2_piece;
+
+            MOVEGEN_all_pawns(player, pos_from_bb, player_pieces, opponent_pieces, &push_piece, &push2_piece, &dummy, &dummy, &dummy, &dummy, &dummy);
+            push |= push_piece & pin_mask;
+            push2 |= push2_piece & pin_mask;
+
+            pieces ^= pos_from_bb;
+        }
+
+        while(push) {
+            int pos_to = BITBOARD_find_bit(push);
+            STATE_add_move_to_list(pos_to, pos_to + step, PAWN, 0, MOVE_QUIET, moves + num_moves++);
+            push ^= BITBOARD_POSITION(pos_to);
+        }
+
+        while(push2) {
+            int pos_to = BITBOARD_find_bit(push2);
+            STATE_add_move_to_list(pos_to, pos_to + 2 * step, PAWN, 0, MOVE_DOUBLE_PAWN_PUSH, moves + num_moves++);
+            push2 ^= BITBOARD_POSITION(pos_to);
+        }
+    }
+
+    /* Knights, bishops, rooks and queens */
+    for(int type = KNIGHT; type <= QUEEN; type++) {
+        bitboard_t pieces = s->bitboard[player_index + type];
+        if(type == KNIGHT) pieces &= ~pinned;
+
+        while(pieces && check_squares[type]) {
+            int pos_from = BITBOARD_find_bit(pieces);
+            bitboard_t pos_from_bb = BITBOARD_POSITION(pos_from);
+
+            bitboard_t possible_moves, possible_captures;
+            MOVEGEN_piece(type, pos_from, player_pieces, opponent_pieces, &possible_moves, &possible_captures);
+            possible_moves &= check_squares[type];
+            if(pos_from_bb & pinned) possible_moves &= STATE_pin_mask(pos_from_bb, king_pos, pinners);
+
+            while(possible_moves) {
+                int pos_to = BITBOARD_find_bit(possible_moves);
+                STATE_add_move_to_list(pos_to, pos_from, type, 0, MOVE_QUIET, moves + num_moves++);
+                possible_moves ^= BITBOARD_POSITION(pos_to);
+            }
+
+            pieces ^= pos_from_bb;
+        }
+    }
+
+    return num_moves;
+}
+
 int STATE_generate_moves_simple(const chess_state_t *s, move_t *moves)
 {
     bitboard_t block_check, pinners, pinned;
@@ -0,0 +1,1514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "tablebase.h"
+#include "retrograde.h"
+#include "filemap.h"
+#include "thread.h"
+#include "eval.h"
+
+/* Probing of Syzygy endgame tables, ported from the published format as
+ * read by Stockfish and Fathom. Each material has a WDL file (.rtbw) with
+ * the result of every position, and a DTZ file (.rtbz) with the distance
+ * in plies to the next capture or pawn move, which resets the 50 move
+ * counter. The first side of a name like KRvKP is white in the tables.
+ * The results take the 50 move rule into account, and are only right
+ * right after a capture or pawn move.
+ *
+ * Positions are indexed by the squares of groups of pieces, with the
+ * board mirrored so that the leading pawn or piece is in the a1-d1-d4
+ * triangle (on files a to d with pawns). The results are compressed with
+ * canonical Huffman codes of symbols that stand for pairs of symbols.
+ * Tables with pawns have one part per file of the leading pawn.
+ *
+ * The files are found in the directories of the path and mapped the first
+ * time they are probed. Castling rights are not covered, en passant
+ * captures are searched when probing.
+ *
+ * TABLEBASE_generate writes tables with up to RETROGRADE_MAX_PIECES
+ * pieces, for tests. The codes are of fixed length without pairs, and
+ * cursed wins are not covered. */
+
+#define TABLEBASE_NAME_SIZE         16
+
+#ifdef _WIN32
+#define TABLEBASE_PATH_SEPARATOR    ';'
+#else
+#define TABLEBASE_PATH_SEPARATOR    ':'
+#endif
+
+/* Header flags */
+#define TABLEBASE_SPLIT             0x1     /* Both sides to move, the sides have different pieces */
+#define TABLEBASE_HAS_PAWNS         0x2
+
+/* Flags of the compressed parts */
+#define TABLEBASE_STM               0x1     /* DTZ of black to move */
+#define TABLEBASE_MAPPED            0x2
+#define TABLEBASE_WIN_PLIES         0x4     /* Wins in plies, not moves */
+#define TABLEBASE_LOSS_PLIES        0x8
+#define TABLEBASE_WIDE              0x10    /* 16 bit map */
+#define TABLEBASE_SINGLE_VALUE      0x80
+
+/* Outcome of a probe */
+#define TABLEBASE_PROBE_FAIL        0
+#define TABLEBASE_PROBE_OK          1
+#define TABLEBASE_PROBE_CHANGE_STM  -1      /* The DTZ table has the other side to move */
+#define TABLEBASE_PROBE_ZEROING     2       /* The best move is a capture or pawn move */
+
+#define TABLEBASE_MAX_SYMBOL_LENGTHS 32
+#define TABLEBASE_UNSET             0xFF
+
+/* Written tables */
+#define TABLEBASE_BLOCK_SIZE_LOG2   6
+#define TABLEBASE_SPAN_LOG2         10
+
+static const uint8_t tablebase_wdl_magic[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t tablebase_dtz_magic[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+static const char tablebase_piece_chars[] = "PNBRQ";
+
+/* Index tables, see TABLEBASE_init_tables */
+static int tablebase_map_pawns[64];
+static int tablebase_map_b1h1h7[64];
+static int tablebase_map_a1d1d4[64];
+static int tablebase_map_kk[10][64];
+static int tablebase_binomial[6][64];
+static int tablebase_lead_pawn_idx[6][64];
+static int tablebase_lead_pawns_size[6][4];
+static once_t tablebase_once = THREAD_ONCE_INIT;
+
+/* Compressed results of one side to move and leading pawn file */
+typedef struct {
+    uint8_t     flags;
+    int         pieces[TABLEBASE_MAX_PIECES];       /* color * 8 + type + 1, in index order */
+    int         group_len[TABLEBASE_MAX_PIECES + 1];    /* Zero terminated */
+    uint64_t    group_idx[TABLEBASE_MAX_PIECES + 1];    /* Factor of each group, then the number of indices */
+    uint64_t    size;
+    int         single_value;
+    uint64_t    block_size;
+    uint64_t    span;
+    uint64_t    sparse_index_size;
+    uint64_t    block_length_size;
+    uint32_t    num_blocks;
+    int         min_sym_len;
+    const uint8_t *lowest_sym;
+    uint64_t    base64[TABLEBASE_MAX_SYMBOL_LENGTHS];
+    int         num_syms;
+    uint8_t     *symlen;                /* Symbols each symbol stands for, less one */
+    const uint8_t *btree;
+    const uint8_t *sparse_index;
+    const uint8_t *block_length;
+    const uint8_t *data;
+    int         map_idx[4];
+} tablebase_pairs_t;
+
+typedef struct {
+    filemap_t   map;
+    int         loaded;                 /* 1 when mapped, -1 if it could not be */
+    int         dir;                    /* Directory of the file, -1 if there is none */
+    const uint8_t *dtz_map;
+    tablebase_pairs_t pairs[NUM_COLORS][4];
+} tablebase_file_t;
+
+typedef struct {
+    char        name[TABLEBASE_NAME_SIZE];
+    uint32_t    key;                    /* Material with the first side as white */
+    uint32_t    key2;                   /* And as black */
+    int         num_pieces;
+    int         has_pawns;
+    int         has_unique_pieces;
+    int         pawn_count[NUM_COLORS]; /* Of the leading color, then of the other */
+    tablebase_file_t wdl;
+    tablebase_file_t dtz;
+} tablebase_table_t;
+
+struct tablebase_t {
+    char        **dirs;
+    int         num_dirs;
+    tablebase_table_t **tables;
+    int         num_tables;
+    int         *slots;                 /* Table number + 1, by both keys */
+    int         slot_mask;
+    int         max_pieces;
+    mutex_t     *mutex;                 /* Held while mapping a file */
+};
+
+/* Bytes of a file written by TABLEBASE_generate */
+typedef struct {
+    uint8_t     *data;
+    size_t      size;
+    size_t      capacity;
+    int         failed;
+} tablebase_buffer_t;
+
+static inline int TABLEBASE_off_diagonal(const int pos)
+{
+    return (pos >> 3) - (pos & 7);
+}
+
+static inline int TABLEBASE_sign(const int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+static inline uint32_t TABLEBASE_read_le16(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static inline uint32_t TABLEBASE_read_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t TABLEBASE_read_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t TABLEBASE_read_be64(const uint8_t *p)
+{
+    return ((uint64_t)TABLEBASE_read_be32(p) << 32) | TABLEBASE_read_be32(p + 4);
+}
+
+static void TABLEBASE_init_tables()
+{
+    int both_on_diagonal[64][2];
+    int num_both_on_diagonal = 0;
+    int diagonal[4];
+    int num_diagonal = 0;
+    int code = 0;
+
+    /* The squares below the a1-h8 diagonal */
+    for(int pos = A1; pos <= H8; pos++) {
+        if(TABLEBASE_off_diagonal(pos) < 0) tablebase_map_b1h1h7[pos] = code++;
+    }
+
+    /* The a1-d1-d4 triangle, the diagonal last */
+    code = 0;
+    for(int pos = A1; pos <= D4; pos++) {
+        if((pos & 7) > 3) continue;
+        if(TABLEBASE_off_diagonal(pos) < 0) tablebase_map_a1d1d4[pos] = code++;
+        else if(TABLEBASE_off_diagonal(pos) == 0) diagonal[num_diagonal++] = pos;
+    }
+    for(int i = 0; i < num_diagonal; i++) {
+        tablebase_map_a1d1d4[diagonal[i]] = code++;
+    }
+
+    /* The 462 legal placements of two kings with the first in the triangle.
+     * With the first on the diagonal the second is not above it. Both on
+     * the diagonal come last. */
+    code = 0;
+    for(int idx = 0; idx < 10; idx++) {
+        for(int pos1 = A1; pos1 <= D4; pos1++) {
+            if(tablebase_map_a1d1d4[pos1] != idx || (idx == 0 && pos1 != B1)) continue;
+            for(int pos2 = A1; pos2 <= H8; pos2++) {
+                const int file_distance = abs((pos1 & 7) - (pos2 & 7));
+                const int rank_distance = abs((pos1 >> 3) - (pos2 >> 3));
+                if(file_distance <= 1 && rank_distance <= 1) continue;
+                if(!TABLEBASE_off_diagonal(pos1) && TABLEBASE_off_diagonal(pos2) > 0) continue;
+                if(!TABLEBASE_off_diagonal(pos1) && !TABLEBASE_off_diagonal(pos2)) {
+                    both_on_diagonal[num_both_on_diagonal][0] = idx;
+                    both_on_diagonal[num_both_on_diagonal++][1] = pos2;
+                } else {
+                    tablebase_map_kk[idx][pos2] = code++;
+                }
+            }
+        }
+    }
+    for(int i = 0; i < num_both_on_diagonal; i++) {
+        tablebase_map_kk[both_on_diagonal[i][0]][both_on_diagonal[i][1]] = code++;
+    }
+
+    /* Ways to choose k of n squares */
+    tablebase_binomial[0][0] = 1;
+    for(int n = 1; n < 64; n++) {
+        for(int k = 0; k < 6 && k <= n; k++) {
+            tablebase_binomial[k][n] = (k > 0 ? tablebase_binomial[k-1][n-1] : 0) + (k < n ? tablebase_binomial[k][n-1] : 0);
+        }
+    }
+
+    /* Pawns nearer the edge, and lower on the same file, get higher numbers.
+     * The pawn with the highest number leads, and the others can only be on
+     * the squares with lower numbers. */
+    int available_squares = 47;
+    for(int lead_pawns = 1; lead_pawns <= 5; lead_pawns++) {
+        for(int file = 0; file < 4; file++) {
+            int idx = 0;
+            for(int rank = 1; rank <= 6; rank++) {
+                const int pos = 8 * rank + file;
+                if(lead_pawns == 1) {
+                    tablebase_map_pawns[pos] = available_squares--;
+                    tablebase_map_pawns[pos ^ 7] = available_squares--;
+                }
+                tablebase_lead_pawn_idx[lead_pawns][pos] = idx;
+                idx += tablebase_binomial[lead_pawns - 1][tablebase_map_pawns[pos]];
+            }
+            tablebase_lead_pawns_size[lead_pawns][file] = idx;
+        }
+    }
+}
+
+/* Three bits per color and piece type */
+static uint32_t TABLEBASE_key(const int count[NUM_COLORS][KING])
+{
+    uint32_t key = 0;
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type < KING; type++) {
+            key |= (uint32_t)count[color][type] << (3 * (color * KING + type));
+        }
+    }
+    return key;
+}
+
+static uint32_t TABLEBASE_state_key(const chess_state_t *s)
+{
+    int count[NUM_COLORS][KING];
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type < KING; type++) {
+            count[color][type] = BITBOARD_count_bits(s->bitboard[color * NUM_TYPES + type]) & 7;
+        }
+    }
+    return TABLEBASE_key(count);
+}
+
+/* Positive if white has the stronger pieces, which come first in the names */
+static int TABLEBASE_compare_sides(const int count[NUM_COLORS][KING])
+{
+    int total[NUM_COLORS] = { 0, 0 };
+    for(int type = PAWN; type < KING; type++) {
+        total[WHITE] += count[WHITE][type];
+        total[BLACK] += count[BLACK][type];
+    }
+    if(total[WHITE] != total[BLACK]) return total[WHITE] - total[BLACK];
+
+    for(int type = QUEEN; type >= PAWN; type--) {
+        if(count[WHITE][type] != count[BLACK][type]) return count[WHITE][type] - count[BLACK][type];
+    }
+    return 0;
+}
+
+static void TABLEBASE_set_table(tablebase_table_t *t, const int count[NUM_COLORS][KING])
+{
+    int swapped[NUM_COLORS][KING];
+    char *name = t->name;
+
+    memset(t, 0, sizeof(tablebase_table_t));
+    t->num_pieces = 2;
+    for(int color = WHITE; color <= BLACK; color++) {
+        *name++ = 'K';
+        for(int type = QUEEN; type >= PAWN; type--) {
+            for(int i = 0; i < count[color][type]; i++) {
+                *name++ = tablebase_piece_chars[type];
+            }
+            swapped[color ^ 1][type] = count[color][type];
+            t->num_pieces += count[color][type];
+            if(count[color][type] == 1) t->has_unique_pieces = 1;
+        }
+        if(color == WHITE) *name++ = 'v';
+    }
+    *name = '\0';
+
+    t->key = TABLEBASE_key(count);
+    t->key2 = TABLEBASE_key(swapped);
+    t->has_pawns = count[WHITE][PAWN] || count[BLACK][PAWN];
+
+    /* The side with fewer pawns leads, white if they have as many */
+    const int lead = (!count[BLACK][PAWN] || (count[WHITE][PAWN] && count[BLACK][PAWN] >= count[WHITE][PAWN])) ? WHITE : BLACK;
+    t->pawn_count[0] = count[lead][PAWN];
+    t->pawn_count[1] = count[lead ^ 1][PAWN];
+    t->wdl.dir = -1;
+    t->dtz.dir = -1;
+}
+
+static void TABLEBASE_filename(char *filename, const size_t size, const char *dir, const char *name, const int dtz)
+{
+    if(dir[0]) {
+        snprintf(filename, size, "%s/%s%s", dir, name, dtz ? ".rtbz" : ".rtbw");
+    } else {
+        snprintf(filename, size, "%s%s", name, dtz ? ".rtbz" : ".rtbw");
+    }
+}
+
+/* The first directory of the path with the file, -1 if none has it */
+static int TABLEBASE_find_file(const tablebase_t *tb, const char *name, const int dtz)
+{
+    for(int i = 0; i < tb->num_dirs; i++) {
+        char filename[4096];
+        FILE *f;
+        TABLEBASE_filename(filename, sizeof(filename), tb->dirs[i], name, dtz);
+        if((f = fopen(filename, "rb"))) {
+            fclose(f);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static char **TABLEBASE_split_path(const char *path, int *num_dirs)
+{
+    char **dirs;
+    *num_dirs = 1;
+    for(const char *p = path; *p; p++) {
+        if(*p == TABLEBASE_PATH_SEPARATOR) (*num_dirs)++;
+    }
+
+    dirs = (char**)calloc(*num_dirs, sizeof(char*));
+    for(int i = 0; i < *num_dirs; i++) {
+        const size_t length = strcspn(path, (const char[]){ TABLEBASE_PATH_SEPARATOR, '\0' });
+        dirs[i] = (char*)malloc(length + 1);
+        memcpy(dirs[i], path, length);
+        dirs[i][length] = '\0';
+        path += length + (path[length] != '\0');
+    }
+    return dirs;
+}
+
+static void TABLEBASE_add_table(tablebase_t *tb, const int count[NUM_COLORS][KING])
+{
+    tablebase_table_t t;
+
+    TABLEBASE_set_table(&t, count);
+    if(t.num_pieces < 3 || TABLEBASE_compare_sides(count) < 0) return;
+
+    /* Sides with as many pieces may be named the other way round */
+    if((t.wdl.dir = TABLEBASE_find_file(tb, t.name, 0)) < 0) {
+        int swapped[NUM_COLORS][KING];
+        if(t.key == t.key2) return;
+        for(int type = PAWN; type < KING; type++) {
+            swapped[WHITE][type] = count[BLACK][type];
+            swapped[BLACK][type] = count[WHITE][type];
+        }
+        TABLEBASE_set_table(&t, (const int (*)[KING])swapped);
+        if((t.wdl.dir = TABLEBASE_find_file(tb, t.name, 0)) < 0) return;
+    }
+    t.dtz.dir = TABLEBASE_find_file(tb, t.name, 1);
+
+    if((tb->num_tables & (tb->num_tables - 1)) == 0) {
+        tb->tables = (tablebase_table_t**)realloc(tb->tables, (tb->num_tables ? 2 * tb->num_tables : 1) * sizeof(tablebase_table_t*));
+    }
+    tb->tables[tb->num_tables] = (tablebase_table_t*)malloc(sizeof(tablebase_table_t));
+    *tb->tables[tb->num_tables++] = t;
+    if(t.num_pieces > tb->max_pieces) tb->max_pieces = t.num_pieces;
+}
+
+/* All materials with up to the given number of pieces besides the kings */
+static void TABLEBASE_add_tables(tablebase_t *tb, int count[NUM_COLORS][KING], const int slot, const int pieces_left)
+{
+    if(slot == NUM_COLORS * KING) {
+        TABLEBASE_add_table(tb, (const int (*)[KING])count);
+        return;
+    }
+    for(int n = 0; n <= pieces_left; n++) {
+        count[slot / KING][slot % KING] = n;
+        TABLEBASE_add_tables(tb, count, slot + 1, pieces_left - n);
+    }
+    count[slot / KING][slot % KING] = 0;
+}
+
+static inline int TABLEBASE_slot(const tablebase_t *tb, const uint32_t key)
+{
+    return (int)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 40) & tb->slot_mask;
+}
+
+static void TABLEBASE_insert(tablebase_t *tb, const uint32_t key, const int table)
+{
+    int slot = TABLEBASE_slot(tb, key);
+    while(tb->slots[slot]) slot = (slot + 1) & tb->slot_mask;
+    tb->slots[slot] = table + 1;
+}
+
+static tablebase_table_t *TABLEBASE_find(const tablebase_t *tb, const uint32_t key)
+{
+    for(int slot = TABLEBASE_slot(tb, key); tb->slots[slot]; slot = (slot + 1) & tb->slot_mask) {
+        tablebase_table_t *t = tb->tables[tb->slots[slot] - 1];
+        if(t->key == key || t->key2 == key) return t;
+    }
+    return NULL;
+}
+
+/* Splits the pieces into groups that are indexed together. The pieces of
+ * the first group are the leading pawns, or three unique pieces, or the
+ * kings. Then come the other pawns and runs of the same piece. order
+ * gives the order of the factors of the first group and the other pawns.
+ * Returns 0 if the order is broken. */
+static int TABLEBASE_set_groups(const tablebase_table_t *t, tablebase_pairs_t *d, const int *order, const int file)
+{
+    const int pp = t->has_pawns && t->pawn_count[1];
+    int first_len = t->has_pawns ? 0 : t->has_unique_pieces ? 3 : 2;
+    int n = 0;
+
+    d->group_len[n] = 1;
+    for(int i = 1; i < t->num_pieces; i++) {
+        if(--first_len > 0 || d->pieces[i] == d->pieces[i-1]) {
+            d->group_len[n]++;
+        } else {
+            d->group_len[++n] = 1;
+        }
+    }
+    d->group_len[++n] = 0;
+    if(order[0] >= n || (pp && order[1] >= n) || d->group_len[0] > 5) return 0;
+
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+    for(int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if(k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= t->has_pawns ? tablebase_lead_pawns_size[d->group_len[0]][file] : t->has_unique_pieces ? 31332 : 462;
+        } else if(k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= tablebase_binomial[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= tablebase_binomial[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+    d->size = idx;
+    return 1;
+}
+
+/* The per file piece orders after the header flags. Returns the offset
+ * after them, 0 if the file is too short or broken. */
+static size_t TABLEBASE_parse_pieces(const tablebase_table_t *t, tablebase_file_t *f, const uint8_t *base, const size_t size, size_t pos, const int sides)
+{
+    const int pp = t->has_pawns && t->pawn_count[1];
+    for(int file = 0; file < (t->has_pawns ? 4 : 1); file++) {
+        int order[NUM_COLORS][2];
+        if(pos + 1 + pp + t->num_pieces > size) return 0;
+        order[0][0] = base[pos] & 0xF;
+        order[0][1] = pp ? base[pos+1] & 0xF : 0xF;
+        order[1][0] = base[pos] >> 4;
+        order[1][1] = pp ? base[pos+1] >> 4 : 0xF;
+        pos += 1 + pp;
+
+        for(int k = 0; k < t->num_pieces; k++, pos++) {
+            for(int side = 0; side < sides; side++) {
+                f->pairs[side][file].pieces[k] = side ? base[pos] >> 4 : base[pos] & 0xF;
+            }
+        }
+        for(int side = 0; side < sides; side++) {
+            if(t->has_pawns && (f->pairs[side][file].pieces[0] & 7) != PAWN + 1) return 0;
+            if(!TABLEBASE_set_groups(t, &f->pairs[side][file], order[side], file)) return 0;
+        }
+    }
+    return pos;
+}
+
+static inline int TABLEBASE_btree_left(const tablebase_pairs_t *d, const int sym)
+{
+    const uint8_t *lr = d->btree + 3 * sym;
+    return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+static inline int TABLEBASE_btree_right(const tablebase_pairs_t *d, const int sym)
+{
+    const uint8_t *lr = d->btree + 3 * sym;
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+static int TABLEBASE_set_symlen(tablebase_pairs_t *d, const int sym, uint8_t *visited)
+{
+    const int right = TABLEBASE_btree_right(d, sym);
+    visited[sym] = 1;
+    if(right == 0xFFF) return 0;
+
+    const int left = TABLEBASE_btree_left(d, sym);
+    if(!visited[left]) d->symlen[left] = (uint8_t)TABLEBASE_set_symlen(d, left, visited);
+    if(!visited[right]) d->symlen[right] = (uint8_t)TABLEBASE_set_symlen(d, right, visited);
+    return d->symlen[left] + d->symlen[right] + 1;
+}
+
+/* Sizes of the compressed part and the decoding tables. Returns the offset
+ * after them, 0 if the file is too short or broken. */
+static size_t TABLEBASE_parse_sizes(tablebase_pairs_t *d, const uint8_t *base, const size_t size, size_t pos)
+{
+    if(pos + 2 > size) return 0;
+    d->flags = base[pos++];
+    if(d->flags & TABLEBASE_SINGLE_VALUE) {
+        d->single_value = base[pos++];
+        return pos;
+    }
+
+    if(pos + 9 > size || base[pos] > 32 || base[pos+1] > 32) return 0;
+    d->block_size = (uint64_t)1 << base[pos];
+    d->span = (uint64_t)1 << base[pos+1];
+    d->sparse_index_size = (d->size + d->span - 1) / d->span;
+    d->num_blocks = TABLEBASE_read_le32(base + pos + 3);
+    d->block_length_size = (uint64_t)d->num_blocks + base[pos+2];
+    const int max_sym_len = base[pos+7];
+    d->min_sym_len = base[pos+8];
+    pos += 9;
+
+    /* The canonical code has lower values for longer symbols. base64 has
+     * the lowest code of each length, padded to 64 bits. */
+    const int num_lengths = max_sym_len - d->min_sym_len + 1;
+    if(d->min_sym_len < 1 || max_sym_len > TABLEBASE_MAX_SYMBOL_LENGTHS || num_lengths < 1 || pos + 2 * num_lengths + 2 > size) return 0;
+    d->lowest_sym = base + pos;
+    d->base64[num_lengths - 1] = 0;
+    for(int i = num_lengths - 2; i >= 0; i--) {
+        d->base64[i] = (d->base64[i+1] + TABLEBASE_read_le16(d->lowest_sym + 2 * i) - TABLEBASE_read_le16(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for(int i = 0; i < num_lengths; i++) {
+        d->base64[i] <<= 64 - i - d->min_sym_len;
+    }
+    pos += 2 * num_lengths;
+
+    /* Each symbol is a value or a pair of symbols */
+    d->num_syms = (int)TABLEBASE_read_le16(base + pos);
+    pos += 2;
+    if(d->num_syms == 0 || pos + 3 * d->num_syms + (d->num_syms & 1) > size) return 0;
+    d->btree = base + pos;
+    for(int sym = 0; sym < d->num_syms; sym++) {
+        if(TABLEBASE_btree_right(d, sym) != 0xFFF && (TABLEBASE_btree_right(d, sym) >= d->num_syms || TABLEBASE_btree_left(d, sym) >= d->num_syms)) return 0;
+    }
+    d->symlen = (uint8_t*)calloc(d->num_syms, 1);
+    uint8_t *visited = (uint8_t*)calloc(d->num_syms, 1);
+    for(int sym = 0; sym < d->num_syms; sym++) {
+        if(!visited[sym]) d->symlen[sym] = (uint8_t)TABLEBASE_set_symlen(d, sym, visited);
+    }
+    free(visited);
+
+    return pos + 3 * d->num_syms + (d->num_syms & 1);
+}
+
+static void TABLEBASE_free_file(tablebase_file_t *f)
+{
+    for(int side = 0; side < NUM_COLORS; side++) {
+        for(int file = 0; file < 4; file++) {
+            free(f->pairs[side][file].symlen);
+            f->pairs[side][file].symlen = NULL;
+        }
+    }
+    FILEMAP_close(&f->map);
+}
+
+/* Reads the header and finds the parts of a mapped file */
+static int TABLEBASE_parse(const tablebase_table_t *t, tablebase_file_t *f, const int dtz)
+{
+    const uint8_t *base = (const uint8_t*)f->map.data;
+    const size_t size = f->map.size;
+    const int sides = (!dtz && t->key != t->key2) ? 2 : 1;
+    const int num_files = t->has_pawns ? 4 : 1;
+    size_t pos = 4;
+
+    if(size < 5 || memcmp(base, dtz ? tablebase_dtz_magic : tablebase_wdl_magic, 4) != 0) return 0;
+    if(!(base[pos] & TABLEBASE_HAS_PAWNS) != !t->has_pawns || !(base[pos] & TABLEBASE_SPLIT) != (t->key == t->key2)) return 0;
+    if(!(pos = TABLEBASE_parse_pieces(t, f, base, size, pos + 1, sides))) return 0;
+    pos += pos & 1;
+
+    for(int file = 0; file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            if(!(pos = TABLEBASE_parse_sizes(&f->pairs[side][file], base, size, pos))) return 0;
+        }
+    }
+
+    /* DTZ values may be mapped, by the result */
+    if(dtz) {
+        f->dtz_map = base + pos;
+        for(int file = 0; file < num_files; file++) {
+            tablebase_pairs_t *d = &f->pairs[0][file];
+            if(!(d->flags & TABLEBASE_MAPPED)) continue;
+            if(d->flags & TABLEBASE_WIDE) {
+                pos += pos & 1;
+                for(int i = 0; i < 4; i++) {
+                    if(pos + 2 > size) return 0;
+                    d->map_idx[i] = (int)((base + pos - f->dtz_map) / 2 + 1);
+                    pos += 2 * TABLEBASE_read_le16(base + pos) + 2;
+                }
+            } else {
+                for(int i = 0; i < 4; i++) {
+                    if(pos + 1 > size) return 0;
+                    d->map_idx[i] = (int)(base + pos - f->dtz_map + 1);
+                    pos += base[pos] + 1;
+                }
+            }
+        }
+        pos += pos & 1;
+    }
+
+    for(int file = 0; file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            f->pairs[side][file].sparse_index = base + pos;
+            pos += 6 * f->pairs[side][file].sparse_index_size;
+            if(pos > size) return 0;
+        }
+    }
+    for(int file = 0; file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            f->pairs[side][file].block_length = base + pos;
+            pos += 2 * f->pairs[side][file].block_length_size;
+            if(pos > size) return 0;
+        }
+    }
+    for(int file = 0; file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            pos = (pos + 63) & ~(size_t)63;
+            f->pairs[side][file].data = base + pos;
+            pos += f->pairs[side][file].num_blocks * f->pairs[side][file].block_size;
+            if(pos > size) return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Maps the WDL or DTZ file of a table the first time it is needed */
+static int TABLEBASE_ready(const tablebase_t *tb, tablebase_table_t *t, const int dtz)
+{
+    tablebase_file_t *f = dtz ? &t->dtz : &t->wdl;
+#if __GNUC__
+    int loaded = __atomic_load_n(&f->loaded, __ATOMIC_ACQUIRE);
+#else
+    int loaded = *(volatile int*)&f->loaded;
+#endif
+
+    if(!loaded) {
+        MUTEX_lock(tb->mutex);
+        loaded = f->loaded;
+        if(!loaded) {
+            char filename[4096];
+            loaded = -1;
+            if(f->dir >= 0) {
+                TABLEBASE_filename(filename, sizeof(filename), tb->dirs[f->dir], t->name, dtz);
+                if(FILEMAP_open(&f->map, filename)) {
+                    if(TABLEBASE_parse(t, f, dtz)) loaded = 1;
+                    else TABLEBASE_free_file(f);
+                }
+            }
+#if __GNUC__
+            __atomic_store_n(&f->loaded, loaded, __ATOMIC_RELEASE);
+#else
+            *(volatile int*)&f->loaded = loaded;
+#endif
+        }
+        MUTEX_unlock(tb->mutex);
+    }
+
+    return loaded > 0;
+}
+
+/* The value at an index of a compressed part, -1 if the file is broken */
+static int TABLEBASE_decompress(const tablebase_pairs_t *d, const uint64_t index)
+{
+    if(d->flags & TABLEBASE_SINGLE_VALUE) return d->single_value;
+    if(index >= d->size) return -1;
+
+    /* The sparse index has the block and offset of every span'th index,
+     * from the middle of the span */
+    const uint64_t k = index / d->span;
+    uint64_t block = TABLEBASE_read_le32(d->sparse_index + 6 * k);
+    int offset = (int)TABLEBASE_read_le16(d->sparse_index + 6 * k + 4);
+    offset += (int)(index % d->span) - (int)(d->span / 2);
+
+    /* A block has one value more than its length */
+    while(offset < 0) {
+        if(block == 0) return -1;
+        offset += (int)TABLEBASE_read_le16(d->block_length + 2 * --block) + 1;
+    }
+    while(offset > (int)TABLEBASE_read_le16(d->block_length + 2 * block)) {
+        offset -= (int)TABLEBASE_read_le16(d->block_length + 2 * block++) + 1;
+        if(block >= d->num_blocks) return -1;
+    }
+
+    /* Symbols until the one the offset is in */
+    const uint8_t *p = d->data + block * d->block_size;
+    uint64_t buf64 = TABLEBASE_read_be64(p);
+    int buf64_size = 64;
+    int sym;
+    p += 8;
+    for(;;) {
+        int len = 0;
+        while(buf64 < d->base64[len]) len++;
+        sym = (int)((buf64 - d->base64[len]) >> (64 - len - d->min_sym_len));
+        sym += (int)TABLEBASE_read_le16(d->lowest_sym + 2 * len);
+        if(sym >= d->num_syms) return -1;
+        if(offset < d->symlen[sym] + 1) break;
+
+        offset -= d->symlen[sym] + 1;
+        len += d->min_sym_len;
+        buf64 <<= len;
+        buf64_size -= len;
+        if(buf64_size <= 32) {
+            buf64_size += 32;
+            buf64 |= (uint64_t)TABLEBASE_read_be32(p) << (64 - buf64_size);
+            p += 4;
+        }
+    }
+
+    /* Then down the pairs to the value */
+    while(d->symlen[sym]) {
+        const int left = TABLEBASE_btree_left(d, sym);
+        if(offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = TABLEBASE_btree_right(d, sym);
+        }
+    }
+    return TABLEBASE_btree_left(d, sym);
+}
+
+/* Index of a position in a table. Returns the part it is in, NULL if the
+ * DTZ table only has the other side to move. */
+static const tablebase_pairs_t *TABLEBASE_encode(const tablebase_table_t *t, const tablebase_file_t *f, const int dtz, const chess_state_t *s, uint64_t *index)
+{
+    int squares[TABLEBASE_MAX_PIECES] = { 0 };
+    int pieces[TABLEBASE_MAX_PIECES];
+    int size = 0, lead_pawns = 0, tb_file = 0;
+    bitboard_t lead = 0;
+    uint64_t idx;
+
+    /* The first side of the name is white, and with the same pieces on
+     * both sides white is to move */
+    const int flip = (t->key == t->key2 && s->player == BLACK) || TABLEBASE_state_key(s) != t->key;
+    const int flip_color = flip ? 8 : 0;
+    const int flip_squares = flip ? 56 : 0;
+    const int stm = flip ^ s->player;
+
+    /* The leading pawn is the one nearest the edge, and the lowest of those */
+    if(t->has_pawns) {
+        const int lead_color = (f->pairs[0][0].pieces[0] ^ flip_color) >> 3;
+        bitboard_t b = lead = s->bitboard[lead_color * NUM_TYPES + PAWN];
+        while(b) {
+            const int pos = BITBOARD_find_bit(b);
+            b ^= BITBOARD_POSITION(pos);
+            squares[size++] = pos ^ flip_squares;
+        }
+        lead_pawns = size;
+
+        for(int i = 1; i < lead_pawns; i++) {
+            if(tablebase_map_pawns[squares[i]] > tablebase_map_pawns[squares[0]]) {
+                const int tmp = squares[0];
+                squares[0] = squares[i];
+                squares[i] = tmp;
+            }
+        }
+        tb_file = squares[0] & 7;
+        if(tb_file > 3) tb_file = 7 - tb_file;
+    }
+
+    if(dtz && (f->pairs[0][tb_file].flags & TABLEBASE_STM) != stm && !(t->key == t->key2 && !t->has_pawns)) return NULL;
+    const tablebase_pairs_t *d = &f->pairs[dtz ? 0 : stm][tb_file];
+
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type <= KING; type++) {
+            bitboard_t b = s->bitboard[color * NUM_TYPES + type] & ~lead;
+            while(b) {
+                const int pos = BITBOARD_find_bit(b);
+                b ^= BITBOARD_POSITION(pos);
+                squares[size] = pos ^ flip_squares;
+                pieces[size++] = (color * 8 + type + 1) ^ flip_color;
+            }
+        }
+    }
+
+    /* The pieces in the order of the table */
+    for(int i = lead_pawns; i < size; i++) {
+        for(int j = i; j < size; j++) {
+            if(d->pieces[i] == pieces[j]) {
+                int tmp = pieces[i];
+                pieces[i] = pieces[j];
+                pieces[j] = tmp;
+                tmp = squares[i];
+                squares[i] = squares[j];
+                squares[j] = tmp;
+                break;
+            }
+        }
+    }
+
+    if((squares[0] & 7) > 3) {
+        for(int i = 0; i < size; i++) squares[i] ^= 7;
+    }
+
+    if(t->has_pawns) {
+        /* The other leading pawns by increasing number */
+        idx = tablebase_lead_pawn_idx[lead_pawns][squares[0]];
+        for(int i = 2; i < lead_pawns; i++) {
+            for(int j = i; j > 1 && tablebase_map_pawns[squares[j]] < tablebase_map_pawns[squares[j-1]]; j--) {
+                const int tmp = squares[j];
+                squares[j] = squares[j-1];
+                squares[j-1] = tmp;
+            }
+        }
+        for(int i = 1; i < lead_pawns; i++) {
+            idx += tablebase_binomial[i][tablebase_map_pawns[squares[i]]];
+        }
+    } else {
+        if((squares[0] >> 3) > 3) {
+            for(int i = 0; i < size; i++) squares[i] ^= 56;
+        }
+
+        /* The first piece of the group off the a1-h8 diagonal goes below it */
+        for(int i = 0; i < d->group_len[0]; i++) {
+            if(!TABLEBASE_off_diagonal(squares[i])) continue;
+            if(TABLEBASE_off_diagonal(squares[i]) > 0) {
+                for(int j = i; j < size; j++) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+
+        if(t->has_unique_pieces) {
+            const int adjust1 = squares[1] > squares[0];
+            const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if(TABLEBASE_off_diagonal(squares[0])) {
+                idx = ((uint64_t)tablebase_map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if(TABLEBASE_off_diagonal(squares[1])) {
+                idx = ((uint64_t)6 * 63 + (squares[0] >> 3) * 28 + tablebase_map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if(TABLEBASE_off_diagonal(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28 + tablebase_map_b1h1h7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 + ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+            }
+        } else {
+            idx = tablebase_map_kk[tablebase_map_a1d1d4[squares[0]]][squares[1]];
+        }
+    }
+
+    /* The other groups by increasing squares, skipping those taken by the groups before */
+    idx *= d->group_idx[0];
+    int remaining_pawns = t->has_pawns && t->pawn_count[1];
+    int first = d->group_len[0];
+    for(int next = 1; d->group_len[next]; next++) {
+        int *group = squares + first;
+        uint64_t n = 0;
+        for(int i = 1; i < d->group_len[next]; i++) {
+            for(int j = i; j > 0 && group[j] < group[j-1]; j--) {
+                const int tmp = group[j];
+                group[j] = group[j-1];
+                group[j-1] = tmp;
+            }
+        }
+        for(int i = 0; i < d->group_len[next]; i++) {
+            int adjust = 0;
+            for(int j = 0; j < first; j++) adjust += group[i] > squares[j];
+            n += tablebase_binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = 0;
+        idx += n * d->group_idx[next];
+        first += d->group_len[next];
+    }
+
+    *index = idx;
+    return d;
+}
+
+/* WDL, or DTZ in plies less one, of a position with the given WDL */
+static int TABLEBASE_probe_table(const tablebase_t *tb, const chess_state_t *s, const int dtz, const int wdl, int *result)
+{
+    static const int wdl_map[] = { 1, 3, 0, 2, 0 };
+    tablebase_table_t *t;
+    uint64_t index;
+
+    if(BITBOARD_count_bits(s->bitboard[OCCUPIED]) == 2) return TABLEBASE_DRAW;
+    if(!(t = TABLEBASE_find(tb, TABLEBASE_state_key(s))) || !TABLEBASE_ready(tb, t, dtz)) {
+        *result = TABLEBASE_PROBE_FAIL;
+        return 0;
+    }
+
+    const tablebase_file_t *f = dtz ? &t->dtz : &t->wdl;
+    const tablebase_pairs_t *d = TABLEBASE_encode(t, f, dtz, s, &index);
+    if(!d) {
+        *result = TABLEBASE_PROBE_CHANGE_STM;
+        return 0;
+    }
+    int value = TABLEBASE_decompress(d, index);
+    if(value < 0) {
+        *result = TABLEBASE_PROBE_FAIL;
+        return 0;
+    }
+    if(!dtz) return value - 2;
+
+    if(d->flags & TABLEBASE_MAPPED) {
+        const size_t width = (d->flags & TABLEBASE_WIDE) ? 2 : 1;
+        const size_t offset = width * (size_t)(d->map_idx[wdl_map[wdl + 2]] + value);
+        if(f->dtz_map + offset + width > (const uint8_t*)f->map.data + f->map.size) {
+            *result = TABLEBASE_PROBE_FAIL;
+            return 0;
+        }
+        value = (d->flags & TABLEBASE_WIDE) ? (int)TABLEBASE_read_le16(f->dtz_map + offset) : f->dtz_map[offset];
+    }
+    if((wdl == TABLEBASE_WIN && !(d->flags & TABLEBASE_WIN_PLIES)) || (wdl == TABLEBASE_LOSS && !(d->flags & TABLEBASE_LOSS_PLIES)) ||
+       wdl == TABLEBASE_CURSED_WIN || wdl == TABLEBASE_BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+static int TABLEBASE_is_mate(const chess_state_t *s)
+{
+    move_t moves[256];
+    return STATE_generate_moves_simple(s, moves) == 0 &&
+           EVAL_position_is_attacked(s, s->player, BITBOARD_find_bit(s->bitboard[s->player * NUM_TYPES + KING]));
+}
+
+/* WDL after searching the captures, and the pawn moves if zeroing is set.
+ * The tables may have any value where a capture is best. */
+static int TABLEBASE_search(const tablebase_t *tb, const chess_state_t *s, const int zeroing, int *result)
+{
+    move_t moves[256];
+    const int num_moves = STATE_generate_moves_simple(s, moves);
+    int best_value = TABLEBASE_LOSS;
+    int num_searched = 0;
+    int value;
+
+    for(int i = 0; i < num_moves; i++) {
+        if(!MOVE_IS_CAPTURE(moves[i]) && (!zeroing || MOVE_GET_TYPE(moves[i]) != PAWN)) continue;
+
+        chess_state_t next_state = *s;
+        STATE_apply_move(&next_state, moves[i]);
+        num_searched++;
+        value = -TABLEBASE_search(tb, &next_state, 0, result);
+        if(*result == TABLEBASE_PROBE_FAIL) return TABLEBASE_DRAW;
+        if(value > best_value) {
+            best_value = value;
+            if(value >= TABLEBASE_WIN) {
+                *result = TABLEBASE_PROBE_ZEROING;
+                return value;
+            }
+        }
+    }
+
+    /* With all moves searched, the tables are not needed */
+    const int all_searched = num_searched && num_searched == num_moves;
+    if(all_searched) {
+        value = best_value;
+    } else {
+        value = TABLEBASE_probe_table(tb, s, 0, 0, result);
+        if(*result == TABLEBASE_PROBE_FAIL) return TABLEBASE_DRAW;
+    }
+
+    if(best_value >= value) {
+        *result = (best_value > TABLEBASE_DRAW || all_searched) ? TABLEBASE_PROBE_ZEROING : TABLEBASE_PROBE_OK;
+        return best_value;
+    }
+    *result = TABLEBASE_PROBE_OK;
+    return value;
+}
+
+/* DTZ of a capture or pawn move with the given WDL after it */
+static int TABLEBASE_dtz_before_zeroing(const int wdl)
+{
+    return wdl == TABLEBASE_WIN ? 1 : wdl == TABLEBASE_CURSED_WIN ? 101 :
+           wdl == TABLEBASE_BLESSED_LOSS ? -101 : wdl == TABLEBASE_LOSS ? -1 : 0;
+}
+
+/* Plies to the next capture or pawn move, negative when losing. Cursed
+ * wins and blessed losses are 100 plies further. */
+static int TABLEBASE_dtz(const tablebase_t *tb, const chess_state_t *s, int *wdl, int *result)
+{
+    move_t moves[256];
+
+    *result = TABLEBASE_PROBE_OK;
+    *wdl = TABLEBASE_search(tb, s, 1, result);
+    if(*result == TABLEBASE_PROBE_FAIL || *wdl == TABLEBASE_DRAW) return 0;
+    if(*result == TABLEBASE_PROBE_ZEROING) return TABLEBASE_dtz_before_zeroing(*wdl);
+
+    int dtz = TABLEBASE_probe_table(tb, s, 1, *wdl, result);
+    if(*result == TABLEBASE_PROBE_FAIL) return 0;
+    if(*result != TABLEBASE_PROBE_CHANGE_STM) {
+        return (dtz + 100 * (*wdl == TABLEBASE_BLESSED_LOSS || *wdl == TABLEBASE_CURSED_WIN)) * TABLEBASE_sign(*wdl);
+    }
+
+    /* The table has the other side to move, the best move is searched */
+    int min_dtz = 0xFFFF;
+    const int num_moves = STATE_generate_moves_simple(s, moves);
+    for(int i = 0; i < num_moves; i++) {
+        const int zeroing = MOVE_IS_CAPTURE(moves[i]) || MOVE_GET_TYPE(moves[i]) == PAWN;
+        chess_state_t next_state = *s;
+        int next_wdl;
+        STATE_apply_move(&next_state, moves[i]);
+
+        dtz = zeroing ? -TABLEBASE_dtz_before_zeroing(TABLEBASE_search(tb, &next_state, 0, result)) : -TABLEBASE_dtz(tb, &next_state, &next_wdl, result);
+        if(*result == TABLEBASE_PROBE_FAIL) return 0;
+        if(dtz == 1 && TABLEBASE_is_mate(&next_state)) min_dtz = 1;
+        if(!zeroing) dtz += TABLEBASE_sign(dtz);
+        if(dtz < min_dtz && TABLEBASE_sign(dtz) == TABLEBASE_sign(*wdl)) min_dtz = dtz;
+    }
+
+    /* Without legal moves it is mate */
+    return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+/* Whether the tables may have the position */
+static int TABLEBASE_covered(const tablebase_t *tb, const chess_state_t *s)
+{
+    const int num_pieces = BITBOARD_count_bits(s->bitboard[OCCUPIED]);
+    return !s->castling[WHITE] && !s->castling[BLACK] && (num_pieces == 2 || num_pieces <= tb->max_pieces);
+}
+
+/* Result as if the 50 move counter was 0. Returns 0 if the position is
+ * not in the tables. */
+int TABLEBASE_probe_wdl(const tablebase_t *tb, const chess_state_t *s, int *wdl)
+{
+    int result = TABLEBASE_PROBE_OK;
+    if(!TABLEBASE_covered(tb, s)) return 0;
+    *wdl = TABLEBASE_search(tb, s, 0, &result);
+    return result != TABLEBASE_PROBE_FAIL;
+}
+
+/* Result and plies to the next capture or pawn move, as if the 50 move
+ * counter was 0. Returns 0 if the position is not in the tables. */
+int TABLEBASE_probe_dtz(const tablebase_t *tb, const chess_state_t *s, int *wdl, int *distance)
+{
+    int result;
+    if(!TABLEBASE_covered(tb, s)) return 0;
+    const int dtz = TABLEBASE_dtz(tb, s, wdl, &result);
+    *distance = dtz < 0 ? -dtz : dtz;
+    return result != TABLEBASE_PROBE_FAIL;
+}
+
+/* The best move by the tables and its result with the 50 move counter of
+ * the position. Winning, the shortest way to the next capture or pawn move
+ * is picked, losing the longest. 0 if the position is not covered or there
+ * are no legal moves. */
+move_t TABLEBASE_probe_root(const tablebase_t *tb, const chess_state_t *s, int *wdl, int *distance)
+{
+    move_t moves[256];
+    move_t best_move = 0;
+    int best_wdl = TABLEBASE_LOSS, best_dtz = 0;
+
+    if(!TABLEBASE_covered(tb, s)) return 0;
+
+    const int num_moves = STATE_generate_moves_simple(s, moves);
+    for(int i = 0; i < num_moves; i++) {
+        chess_state_t next_state = *s;
+        int result = TABLEBASE_PROBE_OK;
+        int next_wdl, dtz;
+        STATE_apply_move(&next_state, moves[i]);
+
+        if(MOVE_IS_CAPTURE(moves[i]) || MOVE_GET_TYPE(moves[i]) == PAWN) {
+            dtz = TABLEBASE_dtz_before_zeroing(-TABLEBASE_search(tb, &next_state, 0, &result));
+        } else {
+            dtz = -TABLEBASE_dtz(tb, &next_state, &next_wdl, &result);
+            dtz += TABLEBASE_sign(dtz);
+        }
+        if(result == TABLEBASE_PROBE_FAIL) return 0;
+        if(dtz == 2 && TABLEBASE_is_mate(&next_state)) dtz = 1;
+
+        /* The win or loss must come before the 50 move rule draws */
+        int w = TABLEBASE_DRAW;
+        if(dtz > 0) w = (dtz + s->halfmove_clock <= 100) ? TABLEBASE_WIN : TABLEBASE_CURSED_WIN;
+        else if(dtz < 0) w = (-dtz + s->halfmove_clock <= 100) ? TABLEBASE_LOSS : TABLEBASE_BLESSED_LOSS;
+        if(!best_move || w > best_wdl || (w == best_wdl && dtz < best_dtz)) {
+            best_move = moves[i];
+            best_wdl = w;
+            best_dtz = dtz;
+        }
+    }
+
+    *wdl = best_wdl;
+    *distance = best_dtz < 0 ? -best_dtz : best_dtz;
+    return best_move;
+}
+
+/* Finds the tables in the directories of path, separated by ':' (';' on
+ * Windows). The files are mapped when they are first probed. The result is
+ * never NULL, TABLEBASE_num_tables tells if anything was found. */
+tablebase_t *TABLEBASE_open(const char *path)
+{
+    tablebase_t *tb = (tablebase_t*)calloc(1, sizeof(tablebase_t));
+    int count[NUM_COLORS][KING];
+
+    THREAD_once(&tablebase_once, TABLEBASE_init_tables);
+    tb->dirs = TABLEBASE_split_path(path ? path : "", &tb->num_dirs);
+    tb->mutex = (mutex_t*)malloc(sizeof(mutex_t));
+    MUTEX_create(tb->mutex);
+
+    memset(count, 0, sizeof(count));
+    TABLEBASE_add_tables(tb, count, 0, TABLEBASE_MAX_PIECES - 2);
+
+    /* At most a quarter full */
+    int num_slots = 16;
+    while(num_slots < 8 * tb->num_tables) num_slots *= 2;
+    tb->slots = (int*)calloc(num_slots, sizeof(int));
+    tb->slot_mask = num_slots - 1;
+    for(int i = 0; i < tb->num_tables; i++) {
+        TABLEBASE_insert(tb, tb->tables[i]->key, i);
+        if(tb->tables[i]->key2 != tb->tables[i]->key) TABLEBASE_insert(tb, tb->tables[i]->key2, i);
+    }
+
+    return tb;
+}
+
+void TABLEBASE_close(tablebase_t *tb)
+{
+    if(!tb) return;
+    for(int i = 0; i < tb->num_tables; i++) {
+        if(tb->tables[i]->wdl.loaded > 0) TABLEBASE_free_file(&tb->tables[i]->wdl);
+        if(tb->tables[i]->dtz.loaded > 0) TABLEBASE_free_file(&tb->tables[i]->dtz);
+        free(tb->tables[i]);
+    }
+    for(int i = 0; i < tb->num_dirs; i++) {
+        free(tb->dirs[i]);
+    }
+    MUTEX_destroy(tb->mutex);
+    free(tb->mutex);
+    free(tb->dirs);
+    free(tb->tables);
+    free(tb->slots);
+    free(tb);
+}
+
+int TABLEBASE_num_tables(const tablebase_t *tb)
+{
+    return tb->num_tables;
+}
+
+/* Most pieces of a position that may be found, kings included */
+int TABLEBASE_max_pieces(const tablebase_t *tb)
+{
+    return tb->max_pieces;
+}
+
+static void TABLEBASE_put(tablebase_buffer_t *b, const uint8_t byte)
+{
+    if(b->size == b->capacity) {
+        uint8_t *data = (uint8_t*)realloc(b->data, b->capacity ? 2 * b->capacity : 4096);
+        if(!data) {
+            b->failed = 1;
+            return;
+        }
+        b->data = data;
+        b->capacity = b->capacity ? 2 * b->capacity : 4096;
+    }
+    b->data[b->size++] = byte;
+}
+
+static void TABLEBASE_put_le16(tablebase_buffer_t *b, const uint32_t value)
+{
+    TABLEBASE_put(b, (uint8_t)value);
+    TABLEBASE_put(b, (uint8_t)(value >> 8));
+}
+
+static void TABLEBASE_put_le32(tablebase_buffer_t *b, const uint32_t value)
+{
+    TABLEBASE_put_le16(b, value & 0xFFFF);
+    TABLEBASE_put_le16(b, value >> 16);
+}
+
+static void TABLEBASE_align(tablebase_buffer_t *b, const size_t alignment)
+{
+    while(b->size % alignment) TABLEBASE_put(b, 0);
+}
+
+static int TABLEBASE_probe_generator(const void *arg, const chess_state_t *s, int *wdl)
+{
+    int value;
+
+    /* The generator knows nothing of the 50 move rule */
+    if(!TABLEBASE_probe_wdl((const tablebase_t*)arg, s, &value) || value == TABLEBASE_CURSED_WIN || value == TABLEBASE_BLESSED_LOSS) return 0;
+    *wdl = value / 2;
+    return 1;
+}
+
+static void TABLEBASE_transform_state(const chess_state_t *s, const int t, chess_state_t *transformed)
+{
+    memset(transformed, 0, sizeof(chess_state_t));
+    for(int color = WHITE; color <= BLACK; color++) {
+        for(int type = PAWN; type <= KING; type++) {
+            bitboard_t b = s->bitboard[color * NUM_TYPES + type];
+            while(b) {
+                int pos = BITBOARD_find_bit(b);
+                b ^= BITBOARD_POSITION(pos);
+                if(t & 1) pos ^= 7;
+                if(t & 2) pos ^= 56;
+                if(t & 4) pos = ((pos & 7) << 3) | (pos >> 3);
+                transformed->bitboard[color * NUM_TYPES + type] |= BITBOARD_POSITION(pos);
+                transformed->bitboard[color * NUM_TYPES + ALL] |= BITBOARD_POSITION(pos);
+                transformed->bitboard[OCCUPIED] |= BITBOARD_POSITION(pos);
+            }
+        }
+    }
+    transformed->ep_file = STATE_EN_PASSANT_NONE;
+    transformed->player = s->player;
+}
+
+/* Header of a written table: the leading pawns, the other pawns, then the
+ * kings and the other pieces. Without pawns, three unique pieces or the
+ * kings come first. One order for both sides. */
+static void TABLEBASE_write_header(tablebase_buffer_t *b, const tablebase_table_t *t, const retrograde_material_t *m, const int dtz)
+{
+    const int pp = t->has_pawns && t->pawn_count[1];
+    int pieces[TABLEBASE_MAX_PIECES];
+    int count[NUM_COLORS][NUM_TYPES];
+    int num_pieces = 0;
+
+    memset(count, 0, sizeof(count));
+    for(int i = 0; i < m->num_pieces; i++) {
+        count[m->pieces[i] / NUM_TYPES][m->pieces[i] % NUM_TYPES]++;
+    }
+    if(t->has_pawns) {
+        const int lead = (!count[BLACK][PAWN] || (count[WHITE][PAWN] && count[BLACK][PAWN] >= count[WHITE][PAWN])) ? WHITE : BLACK;
+        for(int i = 0; i < count[lead][PAWN]; i++) pieces[num_pieces++] = lead * 8 + PAWN + 1;
+        for(int i = 0; i < count[lead ^ 1][PAWN]; i++) pieces[num_pieces++] = (lead ^ 1) * 8 + PAWN + 1;
+    } else if(t->has_unique_pieces) {
+        pieces[num_pieces++] = WHITE * 8 + KING + 1;
+        pieces[num_pieces++] = BLACK * 8 + KING + 1;
+        for(int i = 2; i < m->num_pieces; i++) {
+            if(count[m->pieces[i] / NUM_TYPES][m->pieces[i] % NUM_TYPES] == 1) {
+                pieces[num_pieces++] = (m->pieces[i] / NUM_TYPES) * 8 + m->pieces[i] % NUM_TYPES + 1;
+                break;
+            }
+        }
+    }
+    for(int i = 0; i < m->num_pieces; i++) {
+        const int code = (m->pieces[i] / NUM_TYPES) * 8 + m->pieces[i] % NUM_TYPES + 1;
+        int placed = 0;
+        for(int j = 0; j < num_pieces; j++) {
+            if(pieces[j] == code) placed++;
+        }
+        if(placed < count[m->pieces[i] / NUM_TYPES][m->pieces[i] % NUM_TYPES]) pieces[num_pieces++] = code;
+    }
+
+    for(int i = 0; i < 4; i++) {
+        TABLEBASE_put(b, dtz ? tablebase_dtz_magic[i] : tablebase_wdl_magic[i]);
+    }
+    TABLEBASE_put(b, (uint8_t)((t->key != t->key2 ? TABLEBASE_SPLIT : 0) | (t->has_pawns ? TABLEBASE_HAS_PAWNS : 0)));
+    for(int file = 0; file < (t->has_pawns ? 4 : 1); file++) {
+        TABLEBASE_put(b, 0x00);
+        if(pp) TABLEBASE_put(b, 0x11);
+        for(int i = 0; i < num_pieces; i++) {
+            TABLEBASE_put(b, (uint8_t)(pieces[i] | (pieces[i] << 4)));
+        }
+    }
+}
+
+/* Values of one part, by index. TABLEBASE_UNSET where no position is. */
+typedef struct {
+    uint8_t     *values;
+    uint64_t    size;
+    int         single;
+    int         bits;
+    int         per_block;
+    uint32_t    num_blocks;
+} tablebase_part_t;
+
+static void TABLEBASE_write_part(tablebase_buffer_t *b, const tablebase_part_t *p)
+{
+    for(uint32_t block = 0; block < p->num_blocks; block++) {
+        uint8_t bytes[1 << TABLEBASE_BLOCK_SIZE_LOG2];
+        uint64_t first = (uint64_t)block * p->per_block;
+        int bit = 0;
+
+        memset(bytes, 0, sizeof(bytes));
+        for(uint64_t index = first; index < first + p->per_block && index < p->size; index++) {
+            for(int j = p->bits - 1; j >= 0; j--, bit++) {
+                if((p->values[index] >> j) & 1) bytes[bit >> 3] |= (uint8_t)(0x80 >> (bit & 7));
+            }
+        }
+        for(size_t i = 0; i < sizeof(bytes); i++) {
+            TABLEBASE_put(b, bytes[i]);
+        }
+    }
+}
+
+/* Writes the WDL or DTZ file of the results. Every position is stored in
+ * all its symmetric forms, which the index does not tell apart everywhere.
+ * The codes are of fixed length, each symbol a value. */
+static int TABLEBASE_write(const char *dir, const retrograde_material_t *m, const uint8_t *result, const int dtz)
+{
+    tablebase_table_t t;
+    tablebase_file_t *f;
+    tablebase_part_t parts[NUM_COLORS][4];
+    tablebase_buffer_t b;
+    int count[NUM_COLORS][KING];
+    char filename[4096];
+    int ok = 1;
+
+    memset(count, 0, sizeof(count));
+    for(int i = 2; i < m->num_pieces; i++) {
+        count[m->pieces[i] / NUM_TYPES][m->pieces[i] % NUM_TYPES]++;
+    }
+    TABLEBASE_set_table(&t, count);
+    f = dtz ? &t.dtz : &t.wdl;
+    const int sides = (!dtz && t.key != t.key2) ? 2 : 1;
+    const int num_files = t.has_pawns ? 4 : 1;
+
+    memset(&b, 0, sizeof(b));
+    memset(parts, 0, sizeof(parts));
+    TABLEBASE_write_header(&b, &t, m, dtz);
+    if(b.failed || !TABLEBASE_parse_pieces(&t, f, b.data, b.size, 5, sides)) {
+        free(b.data);
+        return 0;
+    }
+    TABLEBASE_align(&b, 2);
+
+    for(int file = 0; file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            tablebase_part_t *p = &parts[side][file];
+            f->pairs[side][file].flags = dtz ? TABLEBASE_WIN_PLIES | TABLEBASE_LOSS_PLIES : 0;
+            p->size = f->pairs[side][file].size;
+            p->values = (uint8_t*)malloc(p->size);
+            if(!p->values) ok = 0;
+            else memset(p->values, TABLEBASE_UNSET, p->size);
+        }
+    }
+
+    for(uint64_t index = 0; ok && index < m->size; index++) {
+        chess_state_t s;
+        int wdl, distance, value;
+
+        if(!RETROGRADE_state(m, index, &s)) continue;
+        RETROGRADE_decode(result[index], &wdl, &distance);
+        if(!dtz) {
+            value = 2 + 2 * wdl;
+        } else if(distance > 100) {
+            ok = 0;
+            break;
+        } else {
+            value = (distance > 1) ? distance - 1 : 0;
+        }
+
+        for(int transform = 0; transform < (t.has_pawns ? 2 : 8); transform++) {
+            chess_state_t transformed;
+            uint64_t idx;
+            TABLEBASE_transform_state(&s, transform, &transformed);
+            const tablebase_pairs_t *d = TABLEBASE_encode(&t, f, dtz, &transformed, &idx);
+            if(!d) continue;
+
+            const int part = (int)(d - &f->pairs[0][0]);
+            uint8_t *values = parts[part / 4][part % 4].values;
+            if(idx >= d->size || (values[idx] != TABLEBASE_UNSET && values[idx] != value)) ok = 0;
+            else values[idx] = (uint8_t)value;
+        }
+    }
+
+    /* The sizes, with the indices no position has taking the first value */
+    for(int file = 0; ok && file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            tablebase_part_t *p = &parts[side][file];
+            int first = -1, max_value = 0;
+            p->single = !dtz;
+            for(uint64_t index = 0; index < p->size; index++) {
+                if(p->values[index] == TABLEBASE_UNSET) continue;
+                if(first < 0) first = p->values[index];
+                if(p->values[index] != first) p->single = 0;
+                if(p->values[index] > max_value) max_value = p->values[index];
+            }
+            for(uint64_t index = 0; index < p->size; index++) {
+                if(p->values[index] == TABLEBASE_UNSET) p->values[index] = (uint8_t)(first < 0 ? 0 : first);
+            }
+
+            if(p->single) {
+                TABLEBASE_put(&b, TABLEBASE_SINGLE_VALUE);
+                TABLEBASE_put(&b, (uint8_t)(first < 0 ? 0 : first));
+                continue;
+            }
+            p->bits = 1;
+            while((1 << p->bits) <= max_value) p->bits++;
+            p->per_block = (8 << TABLEBASE_BLOCK_SIZE_LOG2) / p->bits;
+            p->num_blocks = (uint32_t)((p->size + p->per_block - 1) / p->per_block);
+
+            TABLEBASE_put(&b, f->pairs[side][file].flags);
+            TABLEBASE_put(&b, TABLEBASE_BLOCK_SIZE_LOG2);
+            TABLEBASE_put(&b, TABLEBASE_SPAN_LOG2);
+            TABLEBASE_put(&b, 0);
+            TABLEBASE_put_le32(&b, p->num_blocks);
+            TABLEBASE_put(&b, (uint8_t)p->bits);
+            TABLEBASE_put(&b, (uint8_t)p->bits);
+            TABLEBASE_put_le16(&b, 0);
+
+            /* Every symbol a leaf with its own value */
+            TABLEBASE_put_le16(&b, (uint32_t)(max_value + 1));
+            for(int sym = 0; sym <= max_value; sym++) {
+                TABLEBASE_put(&b, (uint8_t)sym);
+                TABLEBASE_put(&b, (uint8_t)(0xF0 | (sym >> 8)));
+                TABLEBASE_put(&b, 0xFF);
+            }
+            if((max_value + 1) & 1) TABLEBASE_put(&b, 0);
+        }
+    }
+    if(dtz) TABLEBASE_align(&b, 2);
+
+    /* The block and offset of the middle of each span */
+    for(int file = 0; ok && file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            const tablebase_part_t *p = &parts[side][file];
+            const uint64_t span = (uint64_t)1 << TABLEBASE_SPAN_LOG2;
+            if(p->single) continue;
+            for(uint64_t k = 0; k < (p->size + span - 1) / span; k++) {
+                const uint64_t index = k * span + span / 2;
+                uint64_t block = index / p->per_block;
+                if(block >= p->num_blocks) block = p->num_blocks - 1;
+                TABLEBASE_put_le32(&b, (uint32_t)block);
+                TABLEBASE_put_le16(&b, (uint32_t)(index - block * p->per_block));
+            }
+        }
+    }
+    for(int file = 0; ok && file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            const tablebase_part_t *p = &parts[side][file];
+            for(uint32_t block = 0; block < p->num_blocks; block++) {
+                const uint64_t first = (uint64_t)block * p->per_block;
+                const uint64_t last = (first + p->per_block < p->size) ? first + p->per_block : p->size;
+                TABLEBASE_put_le16(&b, (uint32_t)(last - first - 1));
+            }
+        }
+    }
+    for(int file = 0; ok && file < num_files; file++) {
+        for(int side = 0; side < sides; side++) {
+            TABLEBASE_align(&b, 1 << TABLEBASE_BLOCK_SIZE_LOG2);
+            TABLEBASE_write_part(&b, &parts[side][file]);
+        }
+    }
+
+    /* Decoding reads a little past the last block */
+    for(int i = 0; i < (1 << TABLEBASE_BLOCK_SIZE_LOG2); i++) {
+        TABLEBASE_put(&b, 0);
+    }
+
+    if(ok && !b.failed) {
+        FILE *file;
+        TABLEBASE_filename(filename, sizeof(filename), dir, t.name, dtz);
+        file = fopen(filename, "wb");
+        ok = file && fwrite(b.data, 1, b.size, file) == b.size;
+        if(file && fclose(file) != 0) ok = 0;
+        if(!ok) remove(filename);
+    } else {
+        ok = 0;
+    }
+
+    for(int side = 0; side < NUM_COLORS; side++) {
+        for(int file = 0; file < 4; file++) {
+            free(parts[side][file].values);
+        }
+    }
+    free(b.data);
+    return ok;
+}
+
+/* Writes the WDL and DTZ files of the table called name (like KRvKP) to the
+ * first directory of path, for tests. The tables its captures and
+ * promotions lead to must be there already, see RETROGRADE_list.
+ * num_threads <= 0 uses one thread per core. Returns 0 on failure, also
+ * if a win takes more than 100 plies to the next capture or pawn move. */
+int TABLEBASE_generate(const char *path, const char *name, const int num_threads)
+{
+    retrograde_material_t m;
+    tablebase_t *tb;
+    uint8_t *result;
+    int ok = 0;
+
+    if(!RETROGRADE_material(&m, name)) return 0;
+
+    BITBOARD_init();
+    tb = TABLEBASE_open(path);
+    result = RETROGRADE_generate(&m, TABLEBASE_probe_generator, tb, num_threads);
+    if(result) {
+        ok = TABLEBASE_write(tb->dirs[0], &m, result, 0) && TABLEBASE_write(tb->dirs[0], &m, result, 1);
+        if(!ok) {
+            char filename[4096];
+            TABLEBASE_filename(filename, sizeof(filename), tb->dirs[0], m.name, 0);
+            remove(filename);
+        }
+        free(result);
+    }
+    TABLEBASE_close(tb);
+    return ok;
+}
@@ -0,0 +1,27 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "state.h"
+
+#define TABLEBASE_MAX_PIECES        7       /* Kings included */
+
+/* Results from the side to move's point of view. Cursed wins and blessed
+ * losses are drawn by the 50 move rule. */
+#define TABLEBASE_LOSS              -2
+#define TABLEBASE_BLESSED_LOSS      -1
+#define TABLEBASE_DRAW              0
+#define TABLEBASE_CURSED_WIN        1
+#define TABLEBASE_WIN               2
+
+typedef struct tablebase_t tablebase_t;
+
+tablebase_t *TABLEBASE_open(const char *path);
+void   TABLEBASE_close(tablebase_t *tb);
+int    TABLEBASE_num_tables(const tablebase_t *tb);
+int    TABLEBASE_max_pieces(const tablebase_t *tb);
+int    TABLEBASE_probe_wdl(const tablebase_t *tb, const chess_state_t *s, int *wdl);
+int    TABLEBASE_probe_dtz(const tablebase_t *tb, const chess_state_t *s, int *wdl, int *distance);
+move_t TABLEBASE_probe_root(const tablebase_t *tb, const chess_state_t *s, int *wdl, int *distance);
+int    TABLEBASE_generate(const char *path, const char *name, const int num_threads);
+
+#endif
@@ -1,4 +1,7 @@
 #include <stddef.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "thread.h"
 
 void THREAD_create(thread_t *thread, void *(*thread_function)(void*), void *arg)
@@ -19,6 +22,38 @@ void THREAD_join(thread_t thread)
 #endif
 }
 
+#ifdef _WIN32
+static BOOL CALLBACK THREAD_once_callback(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+    void (*init_function)(void) = (void (*)(void))parameter;
+    init_function();
+    return TRUE;
+}
+#endif
+
+/* Runs init_function exactly once, other callers block until it has completed */
+void THREAD_once(once_t *once, void (*init_function)(void))
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(once, THREAD_once_callback, (PVOID)init_function, NULL);
+#else
+    pthread_once(once, init_function);
+#endif
+}
+
+int THREAD_num_cores()
+{
+    int num_cores;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    num_cores = (int)info.dwNumberOfProcessors;
+#else
+    num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (num_cores > 0) ? num_cores : 1;
+}
+
 void MUTEX_create(mutex_t *mutex)
 {
 #ifdef _WIN32
@@ -88,3 +123,12 @@ void MUTEX_cond_signal(cond_t *cv)
     pthread_cond_signal(cv);
 #endif
 }
+
+void MUTEX_cond_broadcast(cond_t *cv)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cv);
+#else
+    pthread_cond_broadcast(cv);
+#endif
+}
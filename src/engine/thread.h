@@ -6,15 +6,21 @@
 typedef HANDLE thread_t;
 typedef CRITICAL_SECTION mutex_t;
 typedef CONDITION_VARIABLE cond_t;
+typedef INIT_ONCE once_t;
+#define THREAD_ONCE_INIT INIT_ONCE_STATIC_INIT
 #else
 #include <pthread.h>
 typedef pthread_t thread_t;
 typedef pthread_mutex_t mutex_t;
 typedef pthread_cond_t cond_t;
+typedef pthread_once_t once_t;
+#define THREAD_ONCE_INIT PTHREAD_ONCE_INIT
 #endif
 
 void THREAD_create(thread_t *thread, void *(*thread_function)(void*), void *arg);
 void THREAD_join(thread_t thread);
+int  THREAD_num_cores();
+void THREAD_once(once_t *once, void (*init_function)(void));
 void MUTEX_create(mutex_t *mutex);
 void MUTEX_destroy(mutex_t *mutex);
 void MUTEX_lock(mutex_t *mutex);
@@ -23,5 +29,6 @@ void MUTEX_cond_create(cond_t *cv);
 void MUTEX_cond_destroy(cond_t *cv);
 void MUTEX_cond_wait(mutex_t *mutex, cond_t *cv);
 void MUTEX_cond_signal(cond_t *cv);
+void MUTEX_cond_broadcast(cond_t *cv);
 
 #endif
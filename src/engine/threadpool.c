@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include "threadpool.h"
+#include "thread.h"
+
+typedef struct {
+    threadpool_t *pool;
+    int          index;
+} worker_t;
+
+struct threadpool_t {
+    int               num_threads;
+    thread_t          *threads;
+    worker_t          *workers;
+    mutex_t           lock;
+    cond_t            cv_work;
+    cond_t            cv_done;
+
+    /* Current job */
+    threadpool_job_cb job;
+    void              *arg;
+    int               num_items;
+    int               chunk_size;
+    int               next_item;
+    int               num_busy;
+    unsigned int      generation;
+    int               quit;
+};
+
+static void *THREADPOOL_worker(void *arg)
+{
+    worker_t *worker = (worker_t*)arg;
+    threadpool_t *pool = worker->pool;
+    unsigned int generation = 0;
+
+    MUTEX_lock(&pool->lock);
+    while(1) {
+        while(!pool->quit && pool->generation == generation) {
+            MUTEX_cond_wait(&pool->lock, &pool->cv_work);
+        }
+        if(pool->quit) break;
+        generation = pool->generation;
+
+        /* Grab chunks until the job is exhausted */
+        while(pool->next_item < pool->num_items) {
+            int first = pool->next_item;
+            int last = first + pool->chunk_size;
+            if(last > pool->num_items) last = pool->num_items;
+            pool->next_item = last;
+
+            MUTEX_unlock(&pool->lock);
+            pool->job(pool->arg, worker->index, first, last);
+            MUTEX_lock(&pool->lock);
+        }
+
+        if(--pool->num_busy == 0) {
+            MUTEX_cond_signal(&pool->cv_done);
+        }
+    }
+    MUTEX_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Creates a pool of worker threads. num_threads <= 0 uses one thread per core. */
+threadpool_t *THREADPOOL_create(const int num_threads)
+{
+    threadpool_t *pool = (threadpool_t*)malloc(sizeof(threadpool_t));
+    pool->num_threads = num_threads > 0 ? num_threads : THREAD_num_cores();
+    pool->threads = (thread_t*)malloc(pool->num_threads * sizeof(thread_t));
+    pool->workers = (worker_t*)malloc(pool->num_threads * sizeof(worker_t));
+    pool->job = NULL;
+    pool->arg = NULL;
+    pool->num_items = 0;
+    pool->chunk_size = 1;
+    pool->next_item = 0;
+    pool->num_busy = 0;
+    pool->generation = 0;
+    pool->quit = 0;
+    MUTEX_create(&pool->lock);
+    MUTEX_cond_create(&pool->cv_work);
+    MUTEX_cond_create(&pool->cv_done);
+
+    for(int i = 0; i < pool->num_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        THREAD_create(&pool->threads[i], THREADPOOL_worker, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+void THREADPOOL_destroy(threadpool_t *pool)
+{
+    MUTEX_lock(&pool->lock);
+    pool->quit = 1;
+    MUTEX_cond_broadcast(&pool->cv_work);
+    MUTEX_unlock(&pool->lock);
+
+    for(int i = 0; i < pool->num_threads; i++) {
+        THREAD_join(pool->threads[i]);
+    }
+
+    MUTEX_cond_destroy(&pool->cv_done);
+    MUTEX_cond_destroy(&pool->cv_work);
+    MUTEX_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+int THREADPOOL_num_threads(const threadpool_t *pool)
+{
+    return pool->num_threads;
+}
+
+/* Runs job over [0, num_items) in chunks of chunk_size, handed out to the
+ * workers as they become idle. Returns when all items are processed. */
+void THREADPOOL_run(threadpool_t *pool, const int num_items, const int chunk_size, threadpool_job_cb job, void *arg)
+{
+    if(num_items <= 0) return;
+
+    MUTEX_lock(&pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->num_items = num_items;
+    pool->chunk_size = chunk_size > 0 ? chunk_size : 1;
+    pool->next_item = 0;
+    pool->num_busy = pool->num_threads;
+    pool->generation++;
+    MUTEX_cond_broadcast(&pool->cv_work);
+
+    while(pool->num_busy) {
+        MUTEX_cond_wait(&pool->lock, &pool->cv_done);
+    }
+    MUTEX_unlock(&pool->lock);
+}
@@ -0,0 +1,14 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+/* Job callback: process items [first, last) on worker number "worker" */
+typedef void (*threadpool_job_cb)(void *arg, int worker, int first, int last);
+
+typedef struct threadpool_t threadpool_t;
+
+threadpool_t *THREADPOOL_create(const int num_threads);
+void THREADPOOL_destroy(threadpool_t *pool);
+int  THREADPOOL_num_threads(const threadpool_t *pool);
+void THREADPOOL_run(threadpool_t *pool, const int num_items, const int chunk_size, threadpool_job_cb job, void *arg);
+
+#endif
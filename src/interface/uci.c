@@ -15,6 +15,9 @@ typedef struct {
     int moves_left_in_period;   /* Moves to go in current time control period       */
     int time_incremental_ms;    /* Seconds added per turn                           */
     int time_left_ms;           /* Time left in current control period (10^-2 sec)  */
+    int max_depth;              /* Depth limit of the search                        */
+    unsigned int max_nodes;     /* Node limit of the search, 0 for no limit         */
+    int mate_moves;             /* Look for a mate in this many moves, 0 for none   */
 } state_t;
 
 /* Reset state to known defaults */
@@ -26,6 +29,9 @@ void state_clear(state_t *state)
     state->moves_left_in_period = 0;
     state->time_incremental_ms = 0;
     state->time_left_ms = 0;
+    state->max_depth = 100;
+    state->max_nodes = 0;
+    state->mate_moves = 0;
 }
 
 void search_start(state_t *state)
@@ -61,14 +67,20 @@ void send_move(int pos_from, int pos_to, int promotion_type)
 }
 
 /* Send stats and PV to GUI while searching for move */
-void send_search_output(int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type)
+void send_search_output(void *arg, int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type)
 {
+    state_t *state = (state_t*)arg;
     int i;
 
     uint64_t nps = nodes;
     if(time_ms) nps = 1000 * nps / time_ms;
 
-    fprintf(stdout, "info depth %d score cp %d time %d nodes %d nps %ld pv", ply, score, time_ms, nodes, nps);
+    if(ENGINE_SCORE_IS_MATE(score)) {
+        fprintf(stdout, "info depth %d score mate %d", ply, ENGINE_SCORE_MATE_MOVES(score));
+    } else {
+        fprintf(stdout, "info depth %d score cp %d", ply, score);
+    }
+    fprintf(stdout, " time %d nodes %d nps %ld tbhits %u pv", time_ms, nodes, nps, ENGINE_tablebase_hits(state->engine));
     for(i = 0; i < pv_length; i++) {
         int from = pos_from[i];
         int to = pos_to[i];
@@ -153,11 +165,15 @@ void parse_position(state_t *state, const char *position)
 void parse_go(state_t *state, const char *parameters)
 {
     int side = ENGINE_playing_side(state->engine);
+    int time_limited = 0;
 
     /* Default parameters */
     state->moves_left_in_period = 0;
     state->time_left_ms = 100;
     state->time_incremental_ms = 0;
+    state->max_depth = 100;
+    state->max_nodes = 0;
+    state->mate_moves = 0;
 
     while((parameters = strchr(parameters, ' '))) {
         parameters++;
@@ -168,10 +184,12 @@ void parse_go(state_t *state, const char *parameters)
         }
         if(strncmp(parameters, "wtime ", 6) == 0) {
             parameters += 6;
+            time_limited = 1;
             if(side == 0) state->time_left_ms = parse_int(parameters);
         }
         else if(strncmp(parameters, "btime ", 6) == 0) {
             parameters += 6;
+            time_limited = 1;
             if(side == 1) state->time_left_ms = parse_int(parameters);
         }
         else if(strncmp(parameters, "winc ", 5) == 0) {
@@ -188,30 +206,43 @@ void parse_go(state_t *state, const char *parameters)
         }
         else if(strncmp(parameters, "depth ", 6) == 0) {
             parameters += 6;
-            /* TODO */
+            state->max_depth = parse_int(parameters);
+            if(state->max_depth < 1) state->max_depth = 1;
+            else if(state->max_depth > 100) state->max_depth = 100;
         }
         else if(strncmp(parameters, "nodes ", 6) == 0) {
             parameters += 6;
-            /* TODO */
+            state->max_nodes = (unsigned int)parse_int(parameters);
         }
         else if(strncmp(parameters, "mate ", 5) == 0) {
             parameters += 5;
-            /* TODO */
+            state->mate_moves = parse_int(parameters);
+            if(state->mate_moves < 1) state->mate_moves = 1;
+            else if(state->mate_moves > 50) state->mate_moves = 50;
         }
         else if(strncmp(parameters, "movetime ", 9) == 0) {
             parameters += 9;
+            time_limited = 1;
             state->moves_left_in_period = 1;
             state->time_left_ms = parse_int(parameters);
             state->time_incremental_ms = 0;
         }
         else if(strncmp(parameters, "infinite", 8) == 0) {
             parameters += 8;
+            time_limited = 1;
             state->moves_left_in_period = 1;
             state->time_left_ms = 2000000000;
             state->time_incremental_ms = 0;
         }
     }
 
+    /* Only the depth, node or mate limit stops the search */
+    if(!time_limited && (state->max_depth < 100 || state->max_nodes || state->mate_moves)) {
+        state->moves_left_in_period = 1;
+        state->time_left_ms = 2000000000;
+        state->time_incremental_ms = 0;
+    }
+
     search_start(state);
 }
 
@@ -225,6 +256,22 @@ void parse_option(state_t *state, const char *parameters)
         else if(size_mb > 1024) size_mb = 1024;
         ENGINE_resize_hashtable(state->engine, size_mb);
     }
+    else if(strncmp(parameters, "SyzygyPath value ", 17) == 0) {
+        char path[COMMAND_BUFFER_SIZE];
+        strcpy(path, parameters + 17);
+        path[strcspn(path, "\r\n")] = '\0';
+        if(strcmp(path, "<empty>") == 0) path[0] = '\0';
+        fprintf(stdout, "info string %d tablebases found\n", ENGINE_set_tablebase_path(state->engine, path));
+    }
+    else if(strncmp(parameters, "SyzygyProbeDepth value ", 23) == 0) {
+        ENGINE_set_tablebase_probe_depth(state->engine, parse_int(parameters + 23));
+    }
+    else if(strncmp(parameters, "KBNKBitbase value true", 22) == 0) {
+        ENGINE_load_kbnk_bitbase();
+    }
+    else if(strncmp(parameters, "SearchAlgorithm value ", 22) == 0) {
+        ENGINE_set_search_algorithm(state->engine, strncmp(parameters + 22, "PVS", 3) == 0 ? ENGINE_ALGORITHM_PVS : ENGINE_ALGORITHM_MTDF);
+    }
 }
 
 /* Process command from GUI */
@@ -235,6 +282,10 @@ static void process_command(char *command, state_t *state)
         fprintf(stdout, "id name Drosophila " _VERSION "\n");
         fprintf(stdout, "id author Gustaf Ullberg\n");
         fprintf(stdout, "option name Hash type spin default 64 min 1 max 1024\n");
+        fprintf(stdout, "option name SyzygyPath type string default <empty>\n");
+        fprintf(stdout, "option name SyzygyProbeDepth type spin default 1 min 0 max 100\n");
+        fprintf(stdout, "option name KBNKBitbase type check default false\n");
+        fprintf(stdout, "option name SearchAlgorithm type combo default MTDf var MTDf var PVS\n");
         fprintf(stdout, "uciok\n");
     }
     
@@ -295,7 +346,9 @@ void search(state_t *state)
     int pos_from, pos_to, promotion_type;
 
     /* Start searching */
-    ENGINE_search(state->engine, state->moves_left_in_period, state->time_left_ms, state->time_incremental_ms, 100, &pos_from, &pos_to, &promotion_type);
+    ENGINE_set_node_limit(state->engine, state->max_nodes);
+    ENGINE_set_mate_search(state->engine, state->mate_moves);
+    ENGINE_search(state->engine, state->moves_left_in_period, state->time_left_ms, state->time_incremental_ms, state->max_depth, &pos_from, &pos_to, &promotion_type);
 
     /* Handle result */
     send_move(pos_from, pos_to, promotion_type);
@@ -331,9 +384,13 @@ int main(int argc, char **argv)
     /* Disable buffering for stdout */
     setbuf(stdout, NULL);
     
-    /* Create engine instance */
-    ENGINE_create(&state.engine);
-    ENGINE_register_search_output_cb(state.engine, &send_search_output);
+    /* Create engine instance. Allocate the hashtable on the first search,
+     * after the GUI has had the chance to set its size. */
+    engine_config_t config;
+    ENGINE_config_default(&config);
+    config.lazy_alloc = 1;
+    ENGINE_create_ex(&state.engine, &config);
+    ENGINE_register_search_output_cb_ex(state.engine, &send_search_output, &state);
 
     /* Create mutex and condition variable */
     MUTEX_create(&state.mtx_engine);
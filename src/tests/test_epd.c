@@ -0,0 +1,84 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include "epd.h"
+#include "engine.h"
+
+void test_read()
+{
+    epd_position_t epd;
+
+    assert(EPD_read(&epd, "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id \"WAC.001\";"));
+    assert(strcmp(epd.id, "WAC.001") == 0);
+    assert(epd.num_best_moves == 1);
+    assert(epd.num_avoid_moves == 0);
+    assert(epd.state.player == WHITE);
+    assert(EPD_is_solution(&epd, 22, 46, ENGINE_PROMOTION_NONE));   /* g3g6 */
+    assert(!EPD_is_solution(&epd, 22, 30, ENGINE_PROMOTION_NONE));  /* g3g4 */
+
+    /* Several best moves, annotations, check marks and unknown opcodes */
+    assert(EPD_read(&epd, "r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - c0 \"a; b\"; bm Qxh7+! hxg6?; id \"WAC.004\";"));
+    assert(strcmp(epd.id, "WAC.004") == 0);
+    assert(epd.num_best_moves == 2);
+    assert(EPD_is_solution(&epd, 47, 55, ENGINE_PROMOTION_NONE));   /* h6h7 */
+    assert(EPD_is_solution(&epd, 39, 46, ENGINE_PROMOTION_NONE));   /* h5g6 */
+
+    /* Moves to avoid only */
+    assert(EPD_read(&epd, "8/7p/5k2/5p2/p1p2P2/Pr1pPK2/1P1R3P/8 b - - am Rxb2;"));
+    assert(epd.id[0] == '\0');
+    assert(epd.num_avoid_moves == 1);
+    assert(!EPD_is_solution(&epd, 17, 9, ENGINE_PROMOTION_NONE));   /* b3b2 */
+    assert(EPD_is_solution(&epd, 45, 36, ENGINE_PROMOTION_NONE));   /* f6e5 */
+
+    /* Promotion */
+    assert(EPD_read(&epd, "8/4P1k1/8/8/8/8/8/4K3 w - - bm e8=Q;"));
+    assert(EPD_is_solution(&epd, 52, 60, ENGINE_PROMOTION_QUEEN));
+    assert(!EPD_is_solution(&epd, 52, 60, ENGINE_PROMOTION_KNIGHT));
+
+    /* Illegal moves and broken FEN fields */
+    assert(!EPD_read(&epd, "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qh7;"));
+    assert(!EPD_read(&epd, "2rr3k/pp3pp1/1nnqbN1p w - - bm Qg6;"));
+}
+
+void test_node_limit()
+{
+    engine_state_t *engine;
+    engine_config_t config;
+    int pos_from, pos_to, promotion_type;
+    int pos_from2, pos_to2, promotion_type2;
+
+    ENGINE_config_default(&config);
+    config.hash_size_mb = 1;
+    config.book_path = NULL;
+    ENGINE_create_ex(&engine, &config);
+
+    /* Without a time or depth limit, the node limit stops the search */
+    ENGINE_set_node_limit(engine, 20000);
+    assert(ENGINE_set_board(engine, "r2q1rk1/1b1nbppp/p2ppn2/1p6/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 1") == 0);
+    ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from, &pos_to, &promotion_type);
+    assert(ENGINE_searched_nodes(engine) >= 20000);
+    assert(ENGINE_searched_nodes(engine) < 40000);
+    ENGINE_destroy(engine);
+
+    /* Same move from a fresh engine */
+    ENGINE_create_ex(&engine, &config);
+    ENGINE_set_node_limit(engine, 20000);
+    assert(ENGINE_set_board(engine, "r2q1rk1/1b1nbppp/p2ppn2/1p6/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 1") == 0);
+    ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from2, &pos_to2, &promotion_type2);
+    assert(pos_from == pos_from2 && pos_to == pos_to2 && promotion_type == promotion_type2);
+    ENGINE_destroy(engine);
+}
+
+int main()
+{
+    BITBOARD_init();
+
+    test_read();
+    test_node_limit();
+
+    return 0;
+}
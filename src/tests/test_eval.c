@@ -4,8 +4,75 @@
 #endif
 
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 #include "fen.h"
 #include "eval.h"
+#include "endgame.h"
+
+/* Parameters written like the tuner does are read back unchanged */
+void test_read_param()
+{
+    static char text[64 * 1024];
+    const int *values = (const int*)&EVAL_default_param;
+    eval_param_t param;
+    int len = 0;
+
+    len += sprintf(text + len, "const eval_param_t EVAL_default_param =\n{\n    /* Comment 1, 2 */\n");
+    for(int i = 0; i < EVAL_NUM_PARAMS; i++) {
+        len += sprintf(text + len, "        .pawn_shield_%d = %d,\n", i, values[i]);
+    }
+    len += sprintf(text + len, "};\n");
+
+    memset(&param, 0, sizeof(param));
+    assert(EVAL_read_param(&param, text));
+    assert(memcmp(&param, &EVAL_default_param, sizeof(param)) == 0);
+
+    /* A value missing */
+    param.positional.tempo = 12345;
+    sprintf(strrchr(text, '.'), "};\n");
+    assert(!EVAL_read_param(&param, text));
+    assert(param.positional.tempo == 12345);
+}
+
+static short evaluate(const char *fen)
+{
+    chess_state_t s;
+    assert(FEN_read(&s, fen));
+    return EVAL_evaluate_board(&s, &EVAL_default_param);
+}
+
+/* Known endgames are scored by their own evaluators */
+void test_endgames()
+{
+    EVAL_init();
+
+    /* A rook pawn with the defending king in the corner and a blocked pawn draw */
+    assert(evaluate("k7/8/8/8/8/8/P7/K7 w - - 0 1") == 0);
+    assert(evaluate("8/8/8/8/4k3/8/4P3/4K3 w - - 0 1") == 0);
+
+    /* The king ahead of its pawn wins for whoever moves */
+    assert(evaluate("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1") > ENDGAME_KNOWN_WIN);
+    assert(evaluate("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1") < -ENDGAME_KNOWN_WIN);
+
+    /* Lone kings are driven to the edge, for KBNK to a corner of the bishop's colour */
+    assert(evaluate("8/8/8/4k3/8/8/8/R3K3 w - - 0 1") > ENDGAME_KNOWN_WIN + ROOK_VALUE);
+    assert(evaluate("r7/8/8/8/8/8/8/4K1k1 b - - 0 1") > evaluate("r7/8/8/4K3/8/8/8/6k1 b - - 0 1"));
+    assert(evaluate("8/8/8/8/8/2K5/8/k1B1N3 w - - 0 1") > evaluate("8/8/8/8/8/5K2/8/2B1N2k w - - 0 1"));
+
+    /* Unless the lone king takes a piece, which the KBNK bitbase knows once it is loaded */
+    assert(evaluate("8/8/8/8/8/8/1k6/BN5K b - - 0 1") != 0);
+    ENDGAME_load_kbnk_bitbase(0);
+    assert(evaluate("8/8/8/8/8/8/1k6/BN5K b - - 0 1") == 0);
+    assert(evaluate("8/8/8/8/8/2K5/8/k1B1N3 w - - 0 1") > ENDGAME_KNOWN_WIN + KNIGHT_VALUE + BISHOP_VALUE);
+
+    /* A rook wins against a blocked pawn but not against an advanced, supported one */
+    assert(evaluate("6k1/8/8/8/4p3/8/8/R3K3 w - - 0 1") > ROOK_VALUE / 2);
+    assert(evaluate("7K/8/8/8/8/8/2pk4/R7 w - - 0 1") < ROOK_VALUE / 2);
+
+    /* Opposite coloured bishops are drawish */
+    assert(evaluate("4k3/8/8/3b4/8/8/PPP5/2B1K3 w - - 0 1") < evaluate("4k3/8/8/2b5/8/8/PPP5/2B1K3 w - - 0 1"));
+}
 
 int main()
 {
@@ -20,5 +87,8 @@ int main()
     assert(passedPawns == 0x1000000000);
     assert(isolatedPawns == 0x84011000000000);
 
+    test_read_param();
+    test_endgames();
+
     return 0;
 }
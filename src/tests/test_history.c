@@ -0,0 +1,100 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <assert.h>
+#include "history.h"
+#include "san.h"
+#include "fen.h"
+
+void apply_san(history_t *h, chess_state_t *s, const char *san)
+{
+    move_t move = SAN_parse_move(s, san);
+    assert(move);
+    STATE_apply_move(s, move);
+    HISTORY_push(h, s->hash);
+}
+
+void test_upcoming_repetition()
+{
+    history_t *h = HISTORY_create();
+    chess_state_t s;
+    STATE_reset(&s);
+
+    /* Ng8 would go back to the start position */
+    apply_san(h, &s, "Nf3");
+    apply_san(h, &s, "Nf6");
+    assert(!HISTORY_is_upcoming_repetition(h, &s, 100));
+    apply_san(h, &s, "Ng1");
+    assert(HISTORY_is_upcoming_repetition(h, &s, 100));
+    assert(!HISTORY_is_upcoming_repetition(h, &s, 2));
+    assert(!HISTORY_is_repetition(h, s.halfmove_clock));
+
+    apply_san(h, &s, "Ng8");
+    assert(HISTORY_is_repetition(h, s.halfmove_clock));
+
+    /* Only white could go back to the start position */
+    STATE_reset(&s);
+    HISTORY_reset(h);
+    apply_san(h, &s, "Nf3");
+    apply_san(h, &s, "Nf6");
+    apply_san(h, &s, "Ng5");
+    apply_san(h, &s, "Ng8");
+    apply_san(h, &s, "Nh3");
+    assert(!HISTORY_is_upcoming_repetition(h, &s, 100));
+
+    /* Not past an irreversible move */
+    STATE_reset(&s);
+    HISTORY_reset(h);
+    apply_san(h, &s, "Nf3");
+    apply_san(h, &s, "Nf6");
+    apply_san(h, &s, "Ng1");
+    s.halfmove_clock = 2;
+    assert(!HISTORY_is_upcoming_repetition(h, &s, 100));
+
+    /* The rook went from a8 to g8 by a detour, the knight blocks the way back */
+    const char *fens[] = { "r1n5/7k/8/8/8/8/8/4K3 w - - 0 1", "r7/7k/8/8/8/8/8/4K3 w - - 0 1" };
+    for(int i = 0; i < 2; i++) {
+        assert(FEN_read(&s, fens[i]));
+        HISTORY_reset_after_load(h, &s);
+        apply_san(h, &s, "Kd1");
+        apply_san(h, &s, "Ra6");
+        apply_san(h, &s, "Kc1");
+        apply_san(h, &s, "Rg6");
+        apply_san(h, &s, "Kd1");
+        apply_san(h, &s, "Rg8");
+        apply_san(h, &s, "Ke1");
+        assert(HISTORY_is_upcoming_repetition(h, &s, 100) == i);
+    }
+
+    HISTORY_destroy(h);
+}
+
+void test_long_game()
+{
+    history_t *h = HISTORY_create();
+    chess_state_t s;
+    STATE_reset(&s);
+
+    /* Far more positions than fit in the history */
+    const char *moves[] = { "Nf3", "Nf6", "Ng1", "Ng8" };
+    for(int i = 0; i < 5000; i++) {
+        apply_san(h, &s, moves[i % 4]);
+        s.halfmove_clock = 10;
+        assert(HISTORY_is_repetition(h, s.halfmove_clock) == (i >= 3));
+        assert(HISTORY_is_threefold_repetition(h, s.halfmove_clock) == (i >= 7));
+    }
+
+    HISTORY_destroy(h);
+}
+
+int main()
+{
+    BITBOARD_init();
+
+    test_upcoming_repetition();
+    test_long_game();
+
+    return 0;
+}
@@ -3,9 +3,14 @@
 #undef NDEBUG
 #endif
 
+#include <stddef.h>
+#include <string.h>
 #include <assert.h>
 #include "engine.h"
 #include "defines.h"
+#include "fen.h"
+#include "san.h"
+#include "search.h"
 
 void test_illegal_move1()
 {
@@ -147,11 +152,197 @@ void test_illegal_move2()
     ENGINE_destroy(engine);
 }
 
+void test_lightweight_engine()
+{
+    engine_state_t *engine;
+    engine_config_t config;
+    int pos_from, pos_to, promotion_type;
+
+    ENGINE_config_default(&config);
+    config.hash_size_mb = 0;
+    config.book_path = NULL;
+    config.lazy_alloc = 1;
+    ENGINE_create_ex(&engine, &config);
+
+    /* Nothing is allocated for searching yet */
+    ENGINE_search_stop(engine);
+    ENGINE_resize_hashtable(engine, 1);
+
+    assert(ENGINE_apply_move(engine, E2, E4, ENGINE_PROMOTION_NONE) == ENGINE_RESULT_NONE);
+    ENGINE_search(engine, 1, 1000000, 0, 4, &pos_from, &pos_to, &promotion_type);
+    assert(ENGINE_apply_move(engine, pos_from, pos_to, promotion_type) == ENGINE_RESULT_NONE);
+
+    /* Resize after the first search */
+    ENGINE_resize_hashtable(engine, 0);
+    ENGINE_search(engine, 1, 1000000, 0, 4, &pos_from, &pos_to, &promotion_type);
+    assert(ENGINE_apply_move(engine, pos_from, pos_to, promotion_type) == ENGINE_RESULT_NONE);
+    ENGINE_destroy(engine);
+}
+
+/* Both search drivers find the same mates and winning captures */
+void test_search_algorithms()
+{
+    static const struct { const char *fen; int pos_from, pos_to; } positions[] = {
+        { "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", D1, D8 },
+        { "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", H5, F7 },
+        { "4k3/8/8/3q4/8/8/3R4/3RK3 w - - 0 1", D2, D5 },
+        { "2kr3r/ppp2ppp/8/8/1n6/8/PPP2PPP/R1B1KB1R b KQ - 0 1", B4, C2 },
+    };
+    const int num_positions = (int)(sizeof(positions) / sizeof(positions[0]));
+    int scores[2][4];
+
+    for(int algorithm = ENGINE_ALGORITHM_MTDF; algorithm <= ENGINE_ALGORITHM_PVS; algorithm++) {
+        engine_state_t *engine;
+        engine_config_t config;
+        ENGINE_config_default(&config);
+        config.hash_size_mb = 1;
+        config.book_path = NULL;
+        config.search_algorithm = algorithm;
+        ENGINE_create_ex(&engine, &config);
+
+        for(int i = 0; i < num_positions; i++) {
+            int pos_from, pos_to, promotion_type;
+            assert(ENGINE_set_board(engine, positions[i].fen) == 0);
+            scores[algorithm][i] = ENGINE_search(engine, 1, 2000000000, 0, 6, &pos_from, &pos_to, &promotion_type);
+            assert(pos_from == positions[i].pos_from && pos_to == positions[i].pos_to);
+        }
+        ENGINE_destroy(engine);
+    }
+
+    /* Mate scores are exact */
+    assert(scores[ENGINE_ALGORITHM_MTDF][0] == scores[ENGINE_ALGORITHM_PVS][0]);
+    assert(scores[ENGINE_ALGORITHM_MTDF][1] == scores[ENGINE_ALGORITHM_PVS][1]);
+}
+
+/* Internal iterative reductions are counted, and none are made when disabled */
+void test_iir()
+{
+    search_param_t param = SEARCH_default_param;
+    const int iir_depths[2] = { 4, 0 };
+
+    for(int i = 0; i < 2; i++) {
+        const int iir_depth = iir_depths[i];
+        engine_state_t *engine;
+        engine_config_t config;
+        int pos_from, pos_to, promotion_type;
+
+        param.iir_depth = iir_depth;
+        ENGINE_config_default(&config);
+        config.hash_size_mb = 1;
+        config.book_path = NULL;
+        config.search_param = &param;
+        ENGINE_create_ex(&engine, &config);
+
+        ENGINE_search(engine, 1, 2000000000, 0, 8, &pos_from, &pos_to, &promotion_type);
+        assert(iir_depth ? ENGINE_iir_reductions(engine) > 0 : ENGINE_iir_reductions(engine) == 0);
+        ENGINE_destroy(engine);
+    }
+}
+
+/* The mate search finds the shortest mate, and without one a normal search picks the move */
+void test_mate_search()
+{
+    static const struct { const char *fen; int moves, pos_from, pos_to; } positions[] = {
+        { "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2, D5, F6 },
+        { "r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1", 3, F8, C5 },
+        { "3r1r1k/1p3p1p/p2p4/4n1NN/6bQ/1BPq4/P3p1PP/1R5K w - - 0 1", 3, G5, F7 },
+    };
+    const int num_positions = (int)(sizeof(positions) / sizeof(positions[0]));
+    engine_state_t *engine;
+    engine_config_t config;
+    int pos_from, pos_to, promotion_type;
+
+    ENGINE_config_default(&config);
+    config.hash_size_mb = 1;
+    config.book_path = NULL;
+    ENGINE_create_ex(&engine, &config);
+
+    for(int i = 0; i < num_positions; i++) {
+        assert(ENGINE_set_board(engine, positions[i].fen) == 0);
+        ENGINE_set_mate_search(engine, 5);
+        int score = ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from, &pos_to, &promotion_type);
+        assert(pos_from == positions[i].pos_from && pos_to == positions[i].pos_to);
+        assert(score == SEARCH_MAX_RESULT(2 * (5 - positions[i].moves) + 1));
+
+        /* Too few moves for a mate */
+        ENGINE_set_mate_search(engine, positions[i].moves - 1);
+        ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from, &pos_to, &promotion_type);
+        assert(ENGINE_apply_move(engine, pos_from, pos_to, promotion_type) == ENGINE_RESULT_NONE);
+    }
+
+    /* Kg6 Kg8 Ra8# unless the 50 move rule draws first */
+    assert(ENGINE_set_board(engine, "7k/8/5K2/8/8/8/8/R7 w - - 97 80") == 0);
+    ENGINE_set_mate_search(engine, 2);
+    assert(ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from, &pos_to, &promotion_type) == SEARCH_MAX_RESULT(1));
+    assert(ENGINE_set_board(engine, "7k/8/5K2/8/8/8/8/R7 w - - 98 80") == 0);
+    assert(ENGINE_search(engine, 1, 2000000000, 0, 100, &pos_from, &pos_to, &promotion_type) < SEARCH_MAX_RESULT(0));
+
+    ENGINE_destroy(engine);
+}
+
+/* Check that a move is written as expected and parsed back */
+void san_test(const char *fen, const char *expected)
+{
+    chess_state_t state;
+    char san[SAN_MAX_SIZE];
+    move_t move;
+
+    assert(FEN_read(&state, fen));
+    move = SAN_parse_move(&state, expected);
+    assert(move);
+    SAN_write_move(&state, move, san);
+    assert(strcmp(san, expected) == 0);
+}
+
+/* Every legal move must survive a write and parse */
+void san_round_trip(const char *fen)
+{
+    chess_state_t state;
+    move_t moves[256];
+    char san[SAN_MAX_SIZE];
+
+    assert(FEN_read(&state, fen));
+    int num_moves = STATE_generate_moves_simple(&state, moves);
+    for(int i = 0; i < num_moves; i++) {
+        SAN_write_move(&state, moves[i], san);
+        move_t move = SAN_parse_move(&state, san);
+        assert(MOVE_GET_POS_FROM(move) == MOVE_GET_POS_FROM(moves[i]));
+        assert(MOVE_GET_POS_TO(move) == MOVE_GET_POS_TO(moves[i]));
+        assert(MOVE_PROMOTION_TYPE(move) == MOVE_PROMOTION_TYPE(moves[i]));
+        assert(move == moves[i]);
+    }
+}
+
+void test_san_write()
+{
+    BITBOARD_init();
+
+    san_test("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "Nf3");
+    san_test("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "O-O-O");
+    san_test("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "O-O");
+    san_test("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", "exf6");
+    san_test("r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", "Qxf7#");
+    san_test("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1", "b8=Q+");
+    san_test("4k3/8/8/8/8/8/4K3/R6R w - - 0 1", "Rad1");
+    san_test("4k3/8/8/R7/8/8/8/R3K3 w - - 0 1", "R1a3");
+    san_test("k7/8/8/8/8/2Q1Q3/8/2Q1K3 w - - 0 1", "Qc3d2");
+
+    san_round_trip("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    san_round_trip("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1");
+    san_round_trip("k7/8/8/8/8/2Q1Q3/8/2Q1K3 w - - 0 1");
+    san_round_trip("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    san_round_trip("4k3/8/8/b7/8/2N5/8/4K1N1 w - - 0 1");
+}
 
 int main()
 {
     test_illegal_move1();
     test_illegal_move2();
+    test_lightweight_engine();
+    test_search_algorithms();
+    test_iir();
+    test_mate_search();
+    test_san_write();
     
     return 0;
 }
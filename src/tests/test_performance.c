@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "engine.h"
 
@@ -54,12 +55,16 @@ void send_search_output(int ply, int score, int time_ms, unsigned int nodes, int
 }
 
 
-int main()
+/* "test_performance pvs" searches with PVS instead of MTD(f) */
+int main(int argc, char **argv)
 {
     engine_state_t *engine;
-    ENGINE_create(&engine);
+    engine_config_t config;
+    ENGINE_config_default(&config);
+    config.random_seed = 1; /* Force opening book to always choose the same moves */
+    if(argc > 1 && strcmp(argv[1], "pvs") == 0) config.search_algorithm = ENGINE_ALGORITHM_PVS;
+    ENGINE_create_ex(&engine, &config);
     ENGINE_register_search_output_cb(engine, send_search_output);
-    srand(0); /* Force opening book to always choose the same moves */
     
     fprintf(stdout, "Score\t   Nodes\tMove\n");
     move(engine, "d4", "Nf6");
@@ -106,6 +106,81 @@ void test_perft6()
     test_perft(&s, 5, expected_results);
 }
 
+static int contains_move(const move_t *moves, int num_moves, move_t move)
+{
+    for(int i = 0; i < num_moves; i++) {
+        if(moves[i] == move) return 1;
+    }
+    return 0;
+}
+
+/* Walks the game tree and checks that the evasions are exactly the legal moves
+ * in check, and the quiet checks exactly the quiet moves giving direct check */
+void test_evasions_and_checks(chess_state_t *state, int depth, uint64_t *num_evasions, uint64_t *num_checks)
+{
+    chess_state_t next_state;
+    move_t moves[256], special_moves[256];
+    bitboard_t block_check, pinners, pinned;
+
+    int num_checkers = STATE_checkers_and_pinners(state, &block_check, &pinners, &pinned);
+    int num_moves = STATE_generate_moves(state, num_checkers, block_check, pinners, pinned, moves);
+
+    if(num_checkers) {
+        int num_special = STATE_generate_evasions(state, num_checkers, block_check, pinned, special_moves);
+        assert(num_special == num_moves);
+        for(int i = 0; i < num_special; i++) {
+            assert(contains_move(moves, num_moves, special_moves[i]));
+        }
+        *num_evasions += num_special;
+    } else {
+        int num_special = STATE_generate_checks(state, pinners, pinned, special_moves);
+        int num_expected = 0;
+        for(int i = 0; i < num_moves; i++) {
+            int special = MOVE_GET_SPECIAL_FLAGS(moves[i]);
+            if(MOVE_GET_TYPE(moves[i]) == KING || (special != MOVE_QUIET && special != MOVE_DOUBLE_PAWN_PUSH)) continue;
+
+            /* The moved piece itself gives check */
+            bitboard_t next_block_check, next_pinners, next_pinned;
+            next_state = *state;
+            STATE_apply_move(&next_state, moves[i]);
+            if(STATE_checkers_and_pinners(&next_state, &next_block_check, &next_pinners, &next_pinned) &&
+               (next_block_check & BITBOARD_POSITION(MOVE_GET_POS_TO(moves[i])))) {
+                assert(contains_move(special_moves, num_special, moves[i]));
+                num_expected++;
+            }
+        }
+        assert(num_special == num_expected);
+        *num_checks += num_special;
+    }
+
+    if(depth == 0) return;
+
+    for(int i = 0; i < num_moves; i++) {
+        next_state = *state;
+        STATE_apply_move(&next_state, moves[i]);
+        test_evasions_and_checks(&next_state, depth-1, num_evasions, num_checks);
+    }
+}
+
+void test_special_generators()
+{
+    const char *fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbqkb1r/pp1p1ppp/2p5/4P3/2B5/8/PPP1NnPP/RNBQK2R w KQkq - 0 6",
+    };
+    const int depths[] = { 3, 5, 4, 3 };
+
+    for(int i = 0; i < 4; i++) {
+        chess_state_t s;
+        uint64_t num_evasions = 0, num_checks = 0;
+        FEN_read(&s, fens[i]);
+        test_evasions_and_checks(&s, depths[i], &num_evasions, &num_checks);
+        assert(num_evasions > 0 && num_checks > 0);
+    }
+}
+
 int main()
 {
     BITBOARD_init();
@@ -116,6 +191,7 @@ int main()
     test_perft4();
     test_perft5();
     test_perft6();
+    test_special_generators();
     
     return 0;
 }
@@ -0,0 +1,177 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include "pgn.h"
+#include "san.h"
+#include "fen.h"
+#include "state.h"
+
+static const char games[] =
+    "[Event \"Paris\"]\n"
+    "[White \"Morphy, \\\"Paul\\\"\"]\n"
+    "[Result \"1-0\"]\n"
+    "\n"
+    "1. e4 e5 2. Nf3 d6 {Philidor} 3. d4 Bg4?! (3... exd4 4. Nxd4 (4. Qxd4) Nf6) 4. dxe5 Bxf3\n"
+    "5. Qxf3 dxe5 6. Bc4 Nf6 7. Qb3 $1 Qe7 8. Nc3 c6 9. Bg5 b5 10. Nxb5 cxb5\n"
+    "; Rest of line comment (with a parenthesis\n"
+    "11. Bxb5+ Nbd7 12. O-O-O Rd8 13. Rxd7 Rxd7 14. Rd1 Qe6 15. Bxd7+ Nxd7\n"
+    "16. Qb8+! Nxb8 17. Rd8# 1-0\n"
+    "\n"
+    "[Event \"No result tag\"]\n"
+    "[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]\n"
+    "\n"
+    "1.e4 Kd7 2.e5 Kc6 1/2-1/2\n"
+    "\n"
+    "[Event \"Missing termination marker\"]\n"
+    "\n"
+    "1. d4 d5 2. c4 e.p. 0-0\n"
+    "[Event \"Last\"]\n"
+    "[Result \"*\"]\n"
+    "\n"
+    "*\n";
+
+void test_tokens()
+{
+    const char text[] = "[Site \"?\"]\n1. e4 {c} e5!? $2 (1... c5) ; x\n0-1";
+    const int expected[] = { PGN_TOKEN_TAG, PGN_TOKEN_MOVE, PGN_TOKEN_COMMENT, PGN_TOKEN_MOVE, PGN_TOKEN_NAG, PGN_TOKEN_NAG,
+                             PGN_TOKEN_VARIATION_START, PGN_TOKEN_MOVE, PGN_TOKEN_VARIATION_END, PGN_TOKEN_COMMENT,
+                             PGN_TOKEN_RESULT, PGN_TOKEN_END };
+    pgn_reader_t reader;
+    pgn_token_t token;
+
+    PGN_open_buffer(&reader, text, strlen(text));
+    for(int i = 0; i < (int)(sizeof(expected) / sizeof(expected[0])); i++) {
+        assert(PGN_next_token(&reader, &token) == expected[i]);
+        if(i == 0) {
+            assert(token.length == 4 && strncmp(token.text, "Site", 4) == 0);
+            assert(token.value_length == 1 && token.value[0] == '?');
+        }
+        if(i == 3) assert(token.length == 2 && strncmp(token.text, "e5", 2) == 0);
+        if(i == 4) assert(token.length == 2 && strncmp(token.text, "!?", 2) == 0);
+        if(i == 9) assert(token.length == 2 && token.text[1] == 'x');
+    }
+    PGN_close(&reader);
+}
+
+void test_games()
+{
+    pgn_reader_t reader;
+    pgn_game_t game;
+    chess_state_t state;
+    char san[SAN_MAX_SIZE];
+    char value[64];
+    int num_moves;
+
+    BITBOARD_init();
+    PGN_open_buffer(&reader, games, strlen(games));
+
+    /* Comments, variations and NAGs are skipped */
+    assert(PGN_next_game(&reader, &game));
+    assert(game.result == PGN_RESULT_WHITE_WINS);
+    assert(!game.has_fen);
+    assert(PGN_read_tag(&game, "White", value, sizeof(value)));
+    assert(strcmp(value, "Morphy, \"Paul\"") == 0);
+    assert(!PGN_read_tag(&game, "Black", value, sizeof(value)));
+    STATE_reset(&state);
+    num_moves = 0;
+    while(PGN_next_move(&game, san)) {
+        move_t move = SAN_parse_move(&state, san);
+        assert(move);
+        STATE_apply_move(&state, move);
+        num_moves++;
+    }
+    assert(num_moves == 33);
+    assert(strcmp(san, "Rd8#") == 0);
+
+    /* Result from the termination marker, start position from the FEN tag */
+    assert(PGN_next_game(&reader, &game));
+    assert(game.result == PGN_RESULT_DRAW);
+    assert(game.has_fen);
+    assert(FEN_read(&state, game.fen));
+    num_moves = 0;
+    while(PGN_next_move(&game, san)) {
+        move_t move = SAN_parse_move(&state, san);
+        assert(move);
+        STATE_apply_move(&state, move);
+        num_moves++;
+    }
+    assert(num_moves == 4);
+
+    /* The game ends at the tags of the next one, castling may be written with zeros */
+    assert(PGN_next_game(&reader, &game));
+    assert(game.result == PGN_RESULT_UNKNOWN);
+    num_moves = 0;
+    while(PGN_next_move(&game, san)) num_moves++;
+    assert(num_moves == 4);
+    assert(strcmp(san, "0-0") == 0);
+
+    assert(PGN_next_game(&reader, &game));
+    assert(game.result == PGN_RESULT_UNKNOWN);
+    assert(!PGN_next_move(&game, san));
+
+    assert(!PGN_next_game(&reader, &game));
+    PGN_close(&reader);
+}
+
+void test_find_game_start()
+{
+    const size_t size = strlen(games);
+    const char *second = strstr(games, "[Event \"No result tag\"]");
+    const char *third = strstr(games, "[Event \"Missing");
+
+    assert(PGN_find_game_start(games, size, 0) == 0);
+    assert(PGN_find_game_start(games, size, 1) == (size_t)(second - games));
+    assert(PGN_find_game_start(games, size, second - games + 1) == (size_t)(third - games));
+    assert(PGN_find_game_start(games, size, size - 2) == size);
+}
+
+void test_san_parse()
+{
+    chess_state_t state;
+    move_t move;
+
+    BITBOARD_init();
+
+    /* The knight on c3 is pinned, Ne2 is not ambiguous */
+    assert(FEN_read(&state, "4k3/8/8/b7/8/2N5/8/4K1N1 w - -"));
+    move = SAN_parse_move(&state, "Ne2");
+    assert(move && MOVE_GET_POS_FROM(move) == G1);
+    assert(!SAN_parse_move(&state, "Nce2"));
+
+    /* Ambiguous without disambiguation */
+    assert(FEN_read(&state, "4k3/8/8/8/8/8/4K3/R6R w - -"));
+    assert(!SAN_parse_move(&state, "Rd1"));
+    assert(SAN_parse_move(&state, "Rad1"));
+    assert(SAN_parse_move(&state, "Rhf1"));
+
+    /* Missing capture mark, annotations and promotion without '=' */
+    assert(FEN_read(&state, "r3k3/1P6/8/8/8/8/8/4K3 w - -"));
+    move = SAN_parse_move(&state, "bxa8=N+!");
+    assert(move && MOVE_PROMOTION_TYPE(move) == KNIGHT && MOVE_GET_CAPTURE_TYPE(move) == ROOK);
+    assert(SAN_parse_move(&state, "ba8Q") == SAN_parse_move(&state, "bxa8=Q"));
+    assert(SAN_parse_move(&state, "b8=Q"));
+    assert(!SAN_parse_move(&state, "b8"));
+    assert(!SAN_parse_move(&state, "Kxe2"));
+    assert(!SAN_parse_move(&state, "Qe2"));
+    assert(!SAN_parse_move(&state, ""));
+
+    /* En passant */
+    assert(FEN_read(&state, "4k3/8/8/3pP3/8/8/8/4K3 w - d6"));
+    move = SAN_parse_move(&state, "exd6 e.p.");
+    assert(move && MOVE_GET_SPECIAL_FLAGS(move) == MOVE_EP_CAPTURE);
+    assert(!SAN_parse_move(&state, "d6"));
+}
+
+int main()
+{
+    test_tokens();
+    test_games();
+    test_find_game_start();
+    test_san_parse();
+
+    return 0;
+}
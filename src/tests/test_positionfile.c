@@ -0,0 +1,169 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "pack.h"
+#include "positionfile.h"
+#include "fen.h"
+#include "rng.h"
+
+#define FILENAME "test_positionfile.bin"
+
+static const char *fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "rnbqkbnr/pppp1ppp/8/8/3Pp3/8/PPP1PPPP/RNBQKBNR b Kq d3 0 3",
+    "4k3/8/8/8/8/8/8/4K3 b - - 0 1",
+};
+
+static void assert_same_state(const chess_state_t *a, const chess_state_t *b)
+{
+    assert(memcmp(a->bitboard, b->bitboard, sizeof(a->bitboard)) == 0);
+    assert(a->hash == b->hash);
+    assert(a->castling[WHITE] == b->castling[WHITE]);
+    assert(a->castling[BLACK] == b->castling[BLACK]);
+    assert(a->ep_file == b->ep_file);
+    assert(a->player == b->player);
+    assert(a->halfmove_clock == b->halfmove_clock);
+}
+
+static void assert_round_trip(const chess_state_t *state)
+{
+    packed_position_t p;
+    chess_state_t unpacked;
+
+    assert(PACK_position(state, &p));
+    assert(PACK_unpack(&p, &unpacked));
+    assert_same_state(state, &unpacked);
+}
+
+/* Positions from random games, the hash of each is updated incrementally */
+static int random_positions(packed_position_t *positions, const int max_positions)
+{
+    rng_t rng;
+    int num_positions = 0;
+
+    RNG_seed(&rng, 1);
+    while(num_positions < max_positions) {
+        chess_state_t state;
+        assert(FEN_read(&state, fens[RNG_next(&rng) % (sizeof(fens) / sizeof(fens[0]))]));
+
+        for(int ply = 0; ply < 200 && num_positions < max_positions; ply++) {
+            move_t moves[256];
+            int num_moves = STATE_generate_moves_simple(&state, moves);
+            if(num_moves == 0) break;
+            STATE_apply_move(&state, moves[RNG_next(&rng) % num_moves]);
+
+            assert_round_trip(&state);
+            assert(PACK_position(&state, &positions[num_positions]));
+            positions[num_positions].result = (uint8_t)(ply % 4);
+            positions[num_positions].score = (int16_t)(ply - 100);
+            num_positions++;
+        }
+    }
+
+    return num_positions;
+}
+
+void test_pack()
+{
+    chess_state_t state;
+    packed_position_t p;
+
+    for(int i = 0; i < (int)(sizeof(fens) / sizeof(fens[0])); i++) {
+        assert(FEN_read(&state, fens[i]));
+        assert_round_trip(&state);
+    }
+
+    /* Unknown result and score by default */
+    assert(FEN_read(&state, fens[0]));
+    assert(PACK_position(&state, &p));
+    assert(p.result == PACK_RESULT_UNKNOWN);
+    assert(p.score == PACK_SCORE_NONE);
+
+    /* Invalid piece */
+    p.pieces[0] = 0x6;
+    assert(!PACK_unpack(&p, &state));
+
+    /* More pieces than fit */
+    assert(FEN_read(&state, fens[0]));
+    state.bitboard[WHITE_PIECES+PAWN] |= BITBOARD_POSITION(A3);
+    state.bitboard[WHITE_PIECES+ALL] |= BITBOARD_POSITION(A3);
+    state.bitboard[OCCUPIED] |= BITBOARD_POSITION(A3);
+    assert(!PACK_position(&state, &p));
+}
+
+void test_container(const int compression)
+{
+    const int num_positions = 3 * POSITIONFILE_CHUNK_SIZE + 123;
+    packed_position_t *positions = malloc(num_positions * sizeof(packed_position_t));
+    packed_position_t *read = malloc(num_positions * sizeof(packed_position_t));
+    positionfile_t *f;
+
+    random_positions(positions, num_positions);
+
+    /* Written in uneven pieces */
+    f = POSITIONFILE_create(FILENAME, compression);
+    assert(f);
+    for(int i = 0; i < num_positions; i += 1000) {
+        int n = (num_positions - i < 1000) ? num_positions - i : 1000;
+        assert(POSITIONFILE_write(f, &positions[i], n));
+    }
+    assert(POSITIONFILE_num_positions(f) == (uint64_t)num_positions);
+    assert(POSITIONFILE_close(f));
+
+    /* Sequential */
+    f = POSITIONFILE_open(FILENAME);
+    assert(f);
+    assert(POSITIONFILE_num_positions(f) == (uint64_t)num_positions);
+    assert(POSITIONFILE_read(f, read, 10) == 10);
+    assert(POSITIONFILE_read(f, read + 10, num_positions) == num_positions - 10);
+    assert(POSITIONFILE_read(f, read, 1) == 0);
+    assert(memcmp(positions, read, num_positions * sizeof(packed_position_t)) == 0);
+
+    /* Random access */
+    rng_t rng;
+    RNG_seed(&rng, 2);
+    for(int i = 0; i < 100; i++) {
+        int index = (int)(RNG_next(&rng) % num_positions);
+        packed_position_t p;
+        chess_state_t state;
+        assert(POSITIONFILE_seek(f, index));
+        assert(POSITIONFILE_read(f, &p, 1) == 1);
+        assert(memcmp(&p, &positions[index], sizeof(p)) == 0);
+        assert(PACK_unpack(&p, &state));
+    }
+    assert(POSITIONFILE_seek(f, num_positions - 1));
+    assert(POSITIONFILE_read(f, read, 2) == 1);
+    assert(!POSITIONFILE_seek(f, num_positions));
+    assert(POSITIONFILE_close(f));
+
+    /* Not a position file */
+    FILE *out = fopen(FILENAME, "wb");
+    fputs("[Event \"?\"]\n", out);
+    fclose(out);
+    assert(!POSITIONFILE_open(FILENAME));
+
+    remove(FILENAME);
+    free(read);
+    free(positions);
+}
+
+int main()
+{
+    BITBOARD_init();
+
+    test_pack();
+    test_container(POSITIONFILE_COMPRESSION_NONE);
+    test_container(POSITIONFILE_COMPRESSION_ZLIB);
+
+    return 0;
+}
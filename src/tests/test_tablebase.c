@@ -0,0 +1,364 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "tablebase.h"
+#include "retrograde.h"
+#include "bitbase.h"
+#include "engine.h"
+#include "search.h"
+#include "fen.h"
+#include "rng.h"
+
+static const char *tables[] = { "KQvK", "KRvK", "KBvK", "KNvK", "KPvK" };
+#define NUM_TABLES ((int)(sizeof(tables) / sizeof(tables[0])))
+
+static void remove_tables()
+{
+    for(int i = 0; i < NUM_TABLES; i++) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "%s.rtbw", tables[i]);
+        remove(filename);
+        snprintf(filename, sizeof(filename), "%s.rtbz", tables[i]);
+        remove(filename);
+    }
+}
+
+static void assert_probe(const tablebase_t *tb, const char *fen, const int wdl, const int distance)
+{
+    chess_state_t state;
+    int w, d;
+    assert(FEN_read(&state, fen));
+    assert(TABLEBASE_probe_dtz(tb, &state, &w, &d));
+    assert(w == wdl);
+    assert(distance < 0 || d == distance);
+}
+
+void test_generate()
+{
+    char names[RETROGRADE_MAX_TABLES][RETROGRADE_NAME_SIZE];
+
+    /* Three piece tables first, the four piece tables by the number of pawns */
+    assert(RETROGRADE_list(names, 3) == NUM_TABLES);
+    for(int i = 0; i < NUM_TABLES; i++) {
+        assert(strcmp(names[i], tables[i]) == 0);
+    }
+    assert(RETROGRADE_list(names, 4) == 35);
+    assert(strcmp(names[5], "KQvKQ") == 0);
+    assert(strcmp(names[34], "KPPvK") == 0);
+
+    /* Malformed names, the weaker side as white and missing smaller tables */
+    remove_tables();
+    assert(!TABLEBASE_generate("", "KvK", 1));
+    assert(!TABLEBASE_generate("", "KQvKQR", 1));
+    assert(!TABLEBASE_generate("", "KvKQ", 1));
+    assert(!TABLEBASE_generate("", "KPvK", 1));
+
+    for(int i = 0; i < NUM_TABLES; i++) {
+        assert(TABLEBASE_generate("", tables[i], 0));
+    }
+}
+
+void test_probe()
+{
+    tablebase_t *tb = TABLEBASE_open("");
+    assert(TABLEBASE_num_tables(tb) == NUM_TABLES);
+    assert(TABLEBASE_max_pieces(tb) == 3);
+
+    /* Mate in one and mated, one ply from the mate */
+    assert_probe(tb, "7k/8/6K1/8/8/8/8/R7 w - - 0 1", TABLEBASE_WIN, 1);
+    assert_probe(tb, "R6k/8/6K1/8/8/8/8/8 b - - 0 1", TABLEBASE_LOSS, 1);
+
+    /* Either side may be the stronger one, boards are mirrored */
+    assert_probe(tb, "r7/8/8/8/8/6k1/8/7K b - - 0 1", TABLEBASE_WIN, 1);
+    assert_probe(tb, "8/8/8/8/8/1k6/8/K6q w - - 0 1", TABLEBASE_LOSS, 1);
+
+    /* The results are as if a capture or pawn move was just made */
+    assert_probe(tb, "7k/8/6K1/8/8/8/8/R7 w - - 99 80", TABLEBASE_WIN, 1);
+
+    /* Bare kings, a lone bishop and a rook pawn with the king in the corner draw */
+    assert_probe(tb, "8/8/8/8/8/8/8/K6k w - - 0 1", TABLEBASE_DRAW, 0);
+    assert_probe(tb, "8/8/8/3k4/8/8/8/KB6 w - - 0 1", TABLEBASE_DRAW, 0);
+    assert_probe(tb, "k7/8/8/8/8/8/P7/K7 w - - 0 1", TABLEBASE_DRAW, 0);
+
+    /* The king ahead of its pawn on the sixth rank wins whoever moves */
+    assert_probe(tb, "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", TABLEBASE_WIN, -1);
+    assert_probe(tb, "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", TABLEBASE_LOSS, -1);
+
+    /* Stalemate and a hanging queen */
+    assert_probe(tb, "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", TABLEBASE_DRAW, 0);
+    assert_probe(tb, "8/8/8/8/8/8/1k6/Q2K4 b - - 0 1", TABLEBASE_DRAW, 0);
+
+    /* Not covered: too many pieces and castling rights */
+    chess_state_t state;
+    int wdl;
+    assert(FEN_read(&state, "8/8/8/3k4/8/8/8/KR5r w - - 0 1"));
+    assert(!TABLEBASE_probe_wdl(tb, &state, &wdl));
+    assert(FEN_read(&state, "4k3/8/8/8/8/8/8/R3K3 w Q - 0 1"));
+    assert(!TABLEBASE_probe_wdl(tb, &state, &wdl));
+    TABLEBASE_close(tb);
+
+    /* Directories without tables are skipped */
+    tb = TABLEBASE_open("no_such_directory:.");
+    assert(TABLEBASE_num_tables(tb) == NUM_TABLES);
+    assert(FEN_read(&state, "7k/8/6K1/8/8/8/8/R7 w - - 0 1"));
+    assert(TABLEBASE_probe_wdl(tb, &state, &wdl) && wdl == TABLEBASE_WIN);
+    TABLEBASE_close(tb);
+    tb = TABLEBASE_open("no_such_directory");
+    assert(TABLEBASE_num_tables(tb) == 0);
+    TABLEBASE_close(tb);
+}
+
+/* Every probed result must match the best of the moves */
+void test_consistency()
+{
+    tablebase_t *tb = TABLEBASE_open("");
+    const int types[] = { QUEEN, ROOK, PAWN };
+    rng_t rng;
+    RNG_seed(&rng, 1);
+
+    for(int i = 0; i < 20000; i++) {
+        chess_state_t state;
+        memset(&state, 0, sizeof(state));
+        int type = types[RNG_next(&rng) % 3];
+        int color = (int)(RNG_next(&rng) % 2);
+        int squares[3];
+        squares[0] = (int)(RNG_next(&rng) % 64);
+        do squares[1] = (int)(RNG_next(&rng) % 64); while(squares[1] == squares[0]);
+        do squares[2] = (int)(RNG_next(&rng) % 64); while(squares[2] == squares[0] || squares[2] == squares[1] || (type == PAWN && (squares[2] < A2 || squares[2] > H7)));
+
+        state.bitboard[WHITE_PIECES+KING] = BITBOARD_POSITION(squares[0]);
+        state.bitboard[BLACK_PIECES+KING] = BITBOARD_POSITION(squares[1]);
+        state.bitboard[color*NUM_TYPES+type] |= BITBOARD_POSITION(squares[2]);
+        state.bitboard[WHITE_PIECES+ALL] = state.bitboard[WHITE_PIECES+KING] | state.bitboard[WHITE_PIECES+type];
+        state.bitboard[BLACK_PIECES+ALL] = state.bitboard[BLACK_PIECES+KING] | state.bitboard[BLACK_PIECES+type];
+        state.bitboard[OCCUPIED] = state.bitboard[WHITE_PIECES+ALL] | state.bitboard[BLACK_PIECES+ALL];
+        state.ep_file = STATE_EN_PASSANT_NONE;
+        state.player = (unsigned char)(RNG_next(&rng) % 2);
+        STATE_compute_hash(&state);
+        if(SEARCH_is_check(&state, state.player ^ 1)) continue;
+
+        int wdl, distance, root_wdl, root_distance;
+        assert(TABLEBASE_probe_dtz(tb, &state, &wdl, &distance));
+        move_t move = TABLEBASE_probe_root(tb, &state, &root_wdl, &root_distance);
+        if(!move) {
+            assert(SEARCH_is_mate(&state));
+            assert(wdl == (SEARCH_is_check(&state, state.player) ? TABLEBASE_LOSS : TABLEBASE_DRAW));
+            continue;
+        }
+        assert(root_wdl == wdl);
+        assert(root_distance == distance);
+    }
+
+    TABLEBASE_close(tb);
+}
+
+/* The in-memory bitbases agree with the tables on every probed result */
+void test_bitbases()
+{
+    tablebase_t *tb = TABLEBASE_open("");
+    bitbase_t *bb = BITBASE_create(tables, NUM_TABLES, 0);
+    const int types[] = { QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+    rng_t rng;
+    RNG_seed(&rng, 2);
+
+    assert(bb);
+    assert(BITBASE_num_tables(bb) == NUM_TABLES);
+
+    for(int i = 0; i < 20000; i++) {
+        chess_state_t state;
+        memset(&state, 0, sizeof(state));
+        int type = types[RNG_next(&rng) % 5];
+        int color = (int)(RNG_next(&rng) % 2);
+        int squares[3];
+        squares[0] = (int)(RNG_next(&rng) % 64);
+        do squares[1] = (int)(RNG_next(&rng) % 64); while(squares[1] == squares[0]);
+        do squares[2] = (int)(RNG_next(&rng) % 64); while(squares[2] == squares[0] || squares[2] == squares[1] || (type == PAWN && (squares[2] < A2 || squares[2] > H7)));
+
+        state.bitboard[WHITE_PIECES+KING] = BITBOARD_POSITION(squares[0]);
+        state.bitboard[BLACK_PIECES+KING] = BITBOARD_POSITION(squares[1]);
+        state.bitboard[color*NUM_TYPES+type] |= BITBOARD_POSITION(squares[2]);
+        state.bitboard[WHITE_PIECES+ALL] = state.bitboard[WHITE_PIECES+KING] | state.bitboard[WHITE_PIECES+type];
+        state.bitboard[BLACK_PIECES+ALL] = state.bitboard[BLACK_PIECES+KING] | state.bitboard[BLACK_PIECES+type];
+        state.bitboard[OCCUPIED] = state.bitboard[WHITE_PIECES+ALL] | state.bitboard[BLACK_PIECES+ALL];
+        state.ep_file = STATE_EN_PASSANT_NONE;
+        state.player = (unsigned char)(RNG_next(&rng) % 2);
+        STATE_compute_hash(&state);
+        if(SEARCH_is_check(&state, state.player ^ 1)) continue;
+
+        int wdl, bit_wdl;
+        assert(TABLEBASE_probe_wdl(tb, &state, &wdl));
+        assert(BITBASE_probe(bb, &state, &bit_wdl));
+        assert(wdl / 2 == bit_wdl);
+    }
+
+    /* Missing the tables a promotion leads to, KBvK and KNvK are not needed */
+    const char *names[] = { "KPvK" };
+    assert(!BITBASE_create(names, 1, 0));
+    const char *no_minors[] = { "KQvK", "KRvK", "KPvK" };
+    bitbase_t *bb_no_minors = BITBASE_create(no_minors, 3, 0);
+    assert(bb_no_minors);
+    assert(BITBASE_num_tables(bb_no_minors) == 3);
+    BITBASE_close(bb_no_minors);
+
+    BITBASE_close(bb);
+    TABLEBASE_close(tb);
+}
+
+/* Following the tables mates in exactly the probed number of plies */
+void test_play()
+{
+    tablebase_t *tb = TABLEBASE_open("");
+    chess_state_t state;
+    int wdl, distance;
+
+    assert(FEN_read(&state, "8/8/8/4k3/8/8/8/R3K3 w - - 0 1"));
+    assert(TABLEBASE_probe_dtz(tb, &state, &wdl, &distance));
+    assert(wdl == TABLEBASE_WIN);
+    for(int ply = 0; ply < distance; ply++) {
+        int w, d;
+        move_t move = TABLEBASE_probe_root(tb, &state, &w, &d);
+        assert(move);
+        assert(d == distance - ply);
+        STATE_apply_move(&state, move);
+    }
+    assert(SEARCH_is_mate(&state));
+    assert(SEARCH_is_check(&state, state.player));
+
+    /* A promotion is a conversion, followed in the queen table */
+    assert(FEN_read(&state, "8/8/8/8/8/4k3/4P3/4K3 w - - 0 1"));
+    assert(TABLEBASE_probe_dtz(tb, &state, &wdl, &distance));
+    for(int ply = 0; ply < 200; ply++) {
+        int w, d;
+        move_t move = TABLEBASE_probe_root(tb, &state, &w, &d);
+        if(!move) break;
+        STATE_apply_move(&state, move);
+    }
+    assert(SEARCH_is_mate(&state) == (wdl != TABLEBASE_DRAW));
+
+    TABLEBASE_close(tb);
+}
+
+/* Results that hold for any KRvK and KPvK tables, the generated ones and
+ * the official Syzygy files alike */
+static void test_known(const tablebase_t *tb)
+{
+    /* The longest KRvK win is a mate in 16, the DTZ of a table without
+     * pawns is the distance to the mate */
+    int longest = 0;
+    for(int king = 0; king < 64; king++) {
+        for(int rook = 0; rook < 64; rook++) {
+            for(int other = 0; other < 64; other++) {
+                if(rook == king || other == king || other == rook) continue;
+                if(abs((king & 7) - (other & 7)) <= 1 && abs((king >> 3) - (other >> 3)) <= 1) continue;
+
+                chess_state_t state;
+                memset(&state, 0, sizeof(state));
+                state.bitboard[WHITE_PIECES+KING] = BITBOARD_POSITION(king);
+                state.bitboard[WHITE_PIECES+ROOK] = BITBOARD_POSITION(rook);
+                state.bitboard[BLACK_PIECES+KING] = BITBOARD_POSITION(other);
+                state.bitboard[WHITE_PIECES+ALL] = state.bitboard[WHITE_PIECES+KING] | state.bitboard[WHITE_PIECES+ROOK];
+                state.bitboard[BLACK_PIECES+ALL] = state.bitboard[BLACK_PIECES+KING];
+                state.bitboard[OCCUPIED] = state.bitboard[WHITE_PIECES+ALL] | state.bitboard[BLACK_PIECES+ALL];
+                state.ep_file = STATE_EN_PASSANT_NONE;
+                state.player = WHITE;
+                STATE_compute_hash(&state);
+                if(SEARCH_is_check(&state, BLACK)) continue;
+
+                int wdl, distance;
+                assert(TABLEBASE_probe_dtz(tb, &state, &wdl, &distance));
+                if(wdl == TABLEBASE_WIN && distance > longest) longest = distance;
+            }
+        }
+    }
+    assert(longest == 31);
+
+    /* A rook the other king can take is a draw */
+    assert_probe(tb, "8/8/8/8/8/8/6kR/K7 b - - 0 1", TABLEBASE_DRAW, 0);
+    assert_probe(tb, "8/8/8/8/8/8/6kR/K7 w - - 0 1", TABLEBASE_WIN, -1);
+
+    /* The defending king in front of the pawn with the opposition draws,
+     * the king two squares ahead of its pawn, or on the sixth rank, wins */
+    assert_probe(tb, "8/8/8/8/8/4k3/4P3/4K3 w - - 0 1", TABLEBASE_DRAW, 0);
+    assert_probe(tb, "8/8/4k3/8/4K3/8/4P3/8 w - - 0 1", TABLEBASE_WIN, -1);
+    assert_probe(tb, "3k4/8/3K4/3P4/8/8/8/8 b - - 0 1", TABLEBASE_LOSS, -1);
+    assert_probe(tb, "k7/8/8/8/8/8/P7/K7 b - - 0 1", TABLEBASE_DRAW, 0);
+
+    /* A winning promotion zeroes at once, a pawn the other king can take draws */
+    assert_probe(tb, "8/4P3/8/8/8/8/k7/4K3 w - - 0 1", TABLEBASE_WIN, 1);
+    assert_probe(tb, "8/8/8/8/8/8/3kP3/7K b - - 0 1", TABLEBASE_DRAW, 0);
+}
+
+/* The official Syzygy tables, when the fixture directory has them */
+void test_syzygy()
+{
+    tablebase_t *tb = TABLEBASE_open(TEST_SYZYGY_PATH);
+    if(TABLEBASE_num_tables(tb) == 0) {
+        fprintf(stdout, "No Syzygy tables in %s, skipped\n", TEST_SYZYGY_PATH);
+        TABLEBASE_close(tb);
+        return;
+    }
+    test_known(tb);
+    TABLEBASE_close(tb);
+}
+
+void test_engine()
+{
+    engine_state_t *engine;
+    engine_config_t config;
+    int pos_from, pos_to, promotion_type;
+
+    ENGINE_config_default(&config);
+    config.hash_size_mb = 1;
+    config.book_path = NULL;
+    config.tablebase_path = ".";
+    ENGINE_create_ex(&engine, &config);
+
+    /* The root move comes from the tables */
+    assert(ENGINE_set_board(engine, "7k/8/6K1/8/8/8/8/R7 w - - 0 1") == 0);
+    assert(ENGINE_search(engine, 1, 2000000000, 0, 10, &pos_from, &pos_to, &promotion_type) == SEARCH_TABLEBASE_WIN(1));
+    assert(pos_from == A1 && pos_to == A8);
+    assert(ENGINE_searched_nodes(engine) == 0);
+    assert(ENGINE_tablebase_hits(engine) == 1);
+
+    /* Captures into the tables are probed in the search */
+    assert(ENGINE_set_board(engine, "7k/8/8/8/3n4/8/8/K2Q4 w - - 0 1") == 0);
+    assert(ENGINE_search(engine, 1, 2000000000, 0, 4, &pos_from, &pos_to, &promotion_type) >= SEARCH_TABLEBASE_WIN(MAX_SEARCH_DEPTH));
+    assert(pos_from == D1 && pos_to == D4);
+    assert(ENGINE_tablebase_hits(engine) > 0);
+
+    /* Unloaded */
+    assert(ENGINE_set_tablebase_path(engine, NULL) == 0);
+    assert(ENGINE_set_board(engine, "7k/8/6K1/8/8/8/8/R7 w - - 0 1") == 0);
+    ENGINE_search(engine, 1, 2000000000, 0, 3, &pos_from, &pos_to, &promotion_type);
+    assert(ENGINE_searched_nodes(engine) > 0);
+    assert(ENGINE_tablebase_hits(engine) == 0);
+    assert(ENGINE_set_tablebase_path(engine, ".") == NUM_TABLES);
+
+    ENGINE_destroy(engine);
+}
+
+int main()
+{
+    BITBOARD_init();
+
+    test_generate();
+    test_probe();
+    test_consistency();
+    test_bitbases();
+    test_play();
+    test_engine();
+
+    tablebase_t *tb = TABLEBASE_open("");
+    test_known(tb);
+    TABLEBASE_close(tb);
+    test_syzygy();
+    remove_tables();
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/* Make sure assert is not disabled */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <stddef.h>
+#include <assert.h>
+#include "engine.h"
+#include "eval.h"
+#include "thread.h"
+
+/* Run with -DENABLE_TSAN=ON to check that engines share no mutable state */
+
+#define NUM_ENGINES 64
+#define DEPTH 4
+
+static const char *fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 1",
+    "8/5pk1/6p1/3P4/2r5/5K2/5PP1/3R4 b - - 0 1",
+    "r2q1rk1/1b1nbppp/p2ppn2/1p6/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 1"
+};
+#define NUM_FENS ((int)(sizeof(fens) / sizeof(fens[0])))
+
+static eval_param_t shared_param;
+static struct hashtable_t *shared_hashtable;
+
+typedef struct {
+    int index;
+    int shared;
+    int pos_from;
+    int pos_to;
+    int promotion_type;
+    int score;
+} job_t;
+
+static void search(job_t *job)
+{
+    engine_state_t *engine;
+    engine_config_t config;
+
+    ENGINE_config_default(&config);
+    config.hash_size_mb = 1;
+    config.book_path = "book.bin";
+    config.lazy_alloc = 1;
+    config.random_seed = 1;
+    config.eval_param = (job->index & 1) ? &shared_param : NULL;
+    config.hashtable = job->shared ? shared_hashtable : NULL;
+    ENGINE_create_ex(&engine, &config);
+
+    assert(ENGINE_set_board(engine, fens[(job->index / 2) % NUM_FENS]) == 0);
+    job->score = ENGINE_search(engine, 1, 1000000, 0, DEPTH, &job->pos_from, &job->pos_to, &job->promotion_type);
+
+    /* The move must be legal, even when found through another engine's entries */
+    assert(ENGINE_apply_move(engine, job->pos_from, job->pos_to, job->promotion_type) == ENGINE_RESULT_NONE);
+    ENGINE_destroy(engine);
+}
+
+static void *search_thread(void *arg)
+{
+    search((job_t*)arg);
+    return NULL;
+}
+
+/* Batch evaluation gives the same scores regardless of the number of threads */
+static void test_evaluate_batch()
+{
+    const char *batch_fens[NUM_FENS * 64 + 1];
+    static int scores[4][NUM_FENS * 64 + 1];
+    const int num_positions = NUM_FENS * 64 + 1;
+
+    for(int i = 0; i < num_positions - 1; i++) {
+        batch_fens[i] = fens[i % NUM_FENS];
+    }
+    batch_fens[num_positions - 1] = "not a fen";
+
+    assert(ENGINE_evaluate_batch(batch_fens, num_positions, ENGINE_EVAL_STATIC, scores[0], 1) == 1);
+    assert(ENGINE_evaluate_batch(batch_fens, num_positions, 0, scores[1], 1) == 1);
+    assert(ENGINE_evaluate_batch(batch_fens, num_positions, 3, scores[2], 1) == 1);
+    for(int i = 0; i < num_positions - 1; i++) {
+        assert(scores[0][i] == scores[0][i % NUM_FENS]);
+        assert(scores[1][i] == scores[1][i % NUM_FENS]);
+        assert(scores[2][i] == scores[2][i % NUM_FENS]);
+
+        /* Quiescence score is never below stand-pat when not in check */
+        assert(scores[1][i] >= scores[0][i]);
+    }
+
+    const int depths[3] = { ENGINE_EVAL_STATIC, 0, 3 };
+    for(int d = 0; d < 3; d++) {
+        assert(ENGINE_evaluate_batch(batch_fens, num_positions, depths[d], scores[3], 4) == 1);
+        for(int i = 0; i < num_positions; i++) {
+            assert(scores[3][i] == scores[d][i]);
+        }
+    }
+}
+
+int main()
+{
+    thread_t threads[NUM_ENGINES];
+    job_t jobs[NUM_ENGINES];
+
+    /* A second parameter set, shared by half of the engines */
+    shared_param = EVAL_default_param;
+    shared_param.positional.tempo += 5;
+    shared_param.mobility.knight[8] += 10;
+
+    /* Engines are created concurrently, including the one-time initialisation */
+    for(int i = 0; i < NUM_ENGINES; i++) {
+        jobs[i].index = i;
+        jobs[i].shared = 0;
+        THREAD_create(&threads[i], search_thread, &jobs[i]);
+    }
+    for(int i = 0; i < NUM_ENGINES; i++) {
+        THREAD_join(threads[i]);
+    }
+
+    /* Same results as when searching one at a time */
+    for(int i = 0; i < NUM_ENGINES; i++) {
+        job_t reference;
+        reference.index = i;
+        reference.shared = 0;
+        search(&reference);
+        assert(jobs[i].pos_from == reference.pos_from);
+        assert(jobs[i].pos_to == reference.pos_to);
+        assert(jobs[i].promotion_type == reference.promotion_type);
+        assert(jobs[i].score == reference.score);
+    }
+
+    /* All engines share one hashtable. Results depend on the timing, only
+     * legality is checked. */
+    shared_hashtable = ENGINE_create_hashtable(1);
+    for(int i = 0; i < NUM_ENGINES; i++) {
+        jobs[i].shared = 1;
+        THREAD_create(&threads[i], search_thread, &jobs[i]);
+    }
+    for(int i = 0; i < NUM_ENGINES; i++) {
+        THREAD_join(threads[i]);
+    }
+    ENGINE_release_hashtable(shared_hashtable);
+
+    test_evaluate_batch();
+
+    return 0;
+}
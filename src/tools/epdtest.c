@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "engine.h"
+#include "search.h"
+#include "epd.h"
+#include "clock.h"
+#include "threadpool.h"
+
+#define MAX_LINE_LENGTH         1024
+
+typedef struct {
+    char            *line;
+    int             line_number;
+    epd_position_t  epd;
+
+    /* Result */
+    int             pos_from;
+    int             pos_to;
+    int             promotion_type;
+    int             solved;
+    int             depth;
+    int             score;
+    int             time_ms;
+    int             solution_time_ms;   /* When the solution was found and kept, -1 if not solved */
+    int             solution_depth;
+    unsigned int    nodes;
+    unsigned int    iir_reductions;
+} epd_job_t;
+
+typedef struct {
+    epd_job_t       *jobs;
+    int             time_ms;
+    unsigned int    max_nodes;
+    int             max_depth;
+    int             hash_size_mb;
+    search_param_t  search_param;
+} suite_t;
+
+/* Track at which iteration the engine settled on a solution */
+static void search_output(void *arg, int ply, int score, int time_ms, unsigned int nodes, int pv_length, int *pos_from, int *pos_to, int *promotion_type)
+{
+    epd_job_t *job = (epd_job_t*)arg;
+
+    job->depth = ply;
+    job->score = score;
+    job->nodes = nodes;
+    if(pv_length > 0 && EPD_is_solution(&job->epd, pos_from[0], pos_to[0], promotion_type[0])) {
+        if(job->solution_time_ms < 0) {
+            job->solution_time_ms = time_ms;
+            job->solution_depth = ply;
+        }
+    } else {
+        job->solution_time_ms = -1;
+        job->solution_depth = 0;
+    }
+}
+
+/* Solve positions [first, last) with a fresh engine each */
+static void solve(void *arg, int worker, int first, int last)
+{
+    suite_t *suite = (suite_t*)arg;
+    (void)worker;
+
+    for(int i = first; i < last; i++) {
+        epd_job_t *job = &suite->jobs[i];
+        engine_state_t *engine;
+        engine_config_t config;
+
+        ENGINE_config_default(&config);
+        config.hash_size_mb = suite->hash_size_mb;
+        config.book_path = NULL;
+        config.lazy_alloc = 1;
+        config.random_seed = 1;
+        config.search_param = &suite->search_param;
+        ENGINE_create_ex(&engine, &config);
+        ENGINE_set_board(engine, job->line);
+        ENGINE_set_node_limit(engine, suite->max_nodes);
+        ENGINE_register_search_output_cb_ex(engine, search_output, job);
+
+        job->solution_time_ms = -1;
+        int64_t start_time_ms = CLOCK_now();
+        if(suite->time_ms > 0) {
+            /* The engine keeps a 100 ms margin */
+            ENGINE_search(engine, 1, suite->time_ms + 100, 0, suite->max_depth, &job->pos_from, &job->pos_to, &job->promotion_type);
+        } else {
+            ENGINE_search(engine, 1, 2000000000, 0, suite->max_depth, &job->pos_from, &job->pos_to, &job->promotion_type);
+        }
+        job->time_ms = (int)CLOCK_time_passed(start_time_ms);
+        job->nodes = ENGINE_searched_nodes(engine);
+        job->iir_reductions = ENGINE_iir_reductions(engine);
+
+        job->solved = EPD_is_solution(&job->epd, job->pos_from, job->pos_to, job->promotion_type);
+        if(!job->solved) {
+            job->solution_time_ms = -1;
+            job->solution_depth = 0;
+        } else if(job->solution_time_ms < 0) {
+            /* Found during the last, unfinished iteration */
+            job->solution_time_ms = job->time_ms;
+            job->solution_depth = job->depth + 1;
+        }
+
+        ENGINE_destroy(engine);
+    }
+}
+
+static void print_json_string(const char *s)
+{
+    fputc('"', stdout);
+    for(; *s; s++) {
+        if(*s == '"' || *s == '\\') fputc('\\', stdout);
+        if((unsigned char)*s >= 0x20) fputc(*s, stdout);
+    }
+    fputc('"', stdout);
+}
+
+static void print_move(int pos_from, int pos_to, int promotion_type)
+{
+    const char promotion[] = { 0, 'n', 'b', 'r', 'q' };
+    fprintf(stdout, "\"%c%c%c%c", (pos_from%8)+'a', (pos_from/8)+'1', (pos_to%8)+'a', (pos_to/8)+'1');
+    if(promotion_type > 0 && promotion_type <= ENGINE_PROMOTION_QUEEN) fputc(promotion[promotion_type], stdout);
+    fputc('"', stdout);
+}
+
+/* Read all positions from an EPD file. Empty lines and lines starting with
+ * '#' are skipped. Returns -1 if the file cannot be read. */
+static int read_epd(const char *filename, epd_job_t **jobs, int *num_jobs, int *num_errors)
+{
+    char line[MAX_LINE_LENGTH];
+    int line_number = 0;
+    int capacity = *num_jobs;
+    FILE *f = fopen(filename, "r");
+    if(!f) return -1;
+
+    while(fgets(line, sizeof(line), f)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0' || line[0] == '#') continue;
+
+        if(*num_jobs == capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            *jobs = (epd_job_t*)realloc(*jobs, capacity * sizeof(epd_job_t));
+        }
+
+        epd_job_t *job = &(*jobs)[*num_jobs];
+        memset(job, 0, sizeof(epd_job_t));
+        if(!EPD_read(&job->epd, line)) {
+            fprintf(stderr, "%s:%d: Invalid EPD: %s\n", filename, line_number, line);
+            (*num_errors)++;
+            continue;
+        }
+        job->line = strdup(line);
+        job->line_number = line_number;
+        (*num_jobs)++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: epdtest [options] file.epd ...\n");
+    fprintf(stderr, "  -time <ms>        Search time per position (default: 1000 without other limits)\n");
+    fprintf(stderr, "  -nodes <n>        Node limit per position\n");
+    fprintf(stderr, "  -depth <n>        Depth limit per position\n");
+    fprintf(stderr, "  -hash <mb>        Hashtable size per engine (default: 16)\n");
+    fprintf(stderr, "  -threads <n>      Number of positions solved concurrently (default: number of cores)\n");
+    fprintf(stderr, "  -iir <depth>      Least depth of internal iterative reductions, 0 for none (default: %d)\n", SEARCH_default_param.iir_depth);
+    fprintf(stderr, "The summary is written to stdout as JSON.\n");
+}
+
+int main(int argc, char **argv)
+{
+    suite_t suite;
+    epd_job_t *jobs = NULL;
+    int num_jobs = 0;
+    int num_errors = 0;
+    int num_threads = 0;
+    int num_inputs = 0;
+    int i;
+
+    suite.time_ms = 0;
+    suite.max_nodes = 0;
+    suite.max_depth = 0;
+    suite.hash_size_mb = 16;
+    suite.search_param = SEARCH_default_param;
+    BITBOARD_init();
+
+    /* Settings */
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-time") == 0 && i + 1 < argc) suite.time_ms = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-nodes") == 0 && i + 1 < argc) suite.max_nodes = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-depth") == 0 && i + 1 < argc) suite.max_depth = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) suite.hash_size_mb = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) num_threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-iir") == 0 && i + 1 < argc) suite.search_param.iir_depth = atoi(argv[++i]);
+        else if(argv[i][0] == '-') {
+            print_usage();
+            return 1;
+        }
+        else {
+            if(read_epd(argv[i], &jobs, &num_jobs, &num_errors) < 0) {
+                fprintf(stderr, "Error: Could not open file: %s\n", argv[i]);
+                return 2;
+            }
+            num_inputs++;
+        }
+    }
+
+    if(num_inputs == 0) {
+        print_usage();
+        return 1;
+    }
+    if(suite.time_ms <= 0 && suite.max_nodes == 0 && suite.max_depth <= 0) suite.time_ms = 1000;
+    if(suite.max_depth <= 0 || suite.max_depth > 100) suite.max_depth = 100;
+    suite.jobs = jobs;
+
+    /* Solve one position per chunk, slow positions do not hold up others */
+    threadpool_t *pool = THREADPOOL_create(num_threads);
+    int64_t start_time_ms = CLOCK_now();
+    THREADPOOL_run(pool, num_jobs, 1, solve, &suite);
+    int64_t wall_time_ms = CLOCK_time_passed(start_time_ms);
+
+    /* Summary */
+    int num_solved = 0;
+    uint64_t total_nodes = 0;
+    uint64_t total_iir_reductions = 0;
+    int64_t total_time_ms = 0;
+    int64_t total_solution_time_ms = 0;
+    for(i = 0; i < num_jobs; i++) {
+        total_nodes += jobs[i].nodes;
+        total_iir_reductions += jobs[i].iir_reductions;
+        total_time_ms += jobs[i].time_ms;
+        if(jobs[i].solved) {
+            num_solved++;
+            total_solution_time_ms += jobs[i].solution_time_ms;
+        }
+    }
+
+    fprintf(stdout, "{\n");
+    fprintf(stdout, "  \"positions\": %d,\n", num_jobs);
+    fprintf(stdout, "  \"invalid\": %d,\n", num_errors);
+    fprintf(stdout, "  \"solved\": %d,\n", num_solved);
+    fprintf(stdout, "  \"threads\": %d,\n", THREADPOOL_num_threads(pool));
+    fprintf(stdout, "  \"limits\": { \"time_ms\": %d, \"nodes\": %u, \"depth\": %d },\n", suite.time_ms, suite.max_nodes, suite.max_depth);
+    fprintf(stdout, "  \"wall_time_ms\": %lld,\n", (long long)wall_time_ms);
+    fprintf(stdout, "  \"search_time_ms\": %lld,\n", (long long)total_time_ms);
+    fprintf(stdout, "  \"mean_solution_time_ms\": %lld,\n", (long long)(num_solved ? total_solution_time_ms / num_solved : 0));
+    fprintf(stdout, "  \"nodes\": %llu,\n", (unsigned long long)total_nodes);
+    fprintf(stdout, "  \"nps\": %llu,\n", (unsigned long long)(wall_time_ms ? 1000 * total_nodes / wall_time_ms : total_nodes));
+    fprintf(stdout, "  \"iir_reductions\": %llu,\n", (unsigned long long)total_iir_reductions);
+    fprintf(stdout, "  \"results\": [\n");
+    for(i = 0; i < num_jobs; i++) {
+        epd_job_t *job = &jobs[i];
+        fprintf(stdout, "    { \"id\": ");
+        print_json_string(job->epd.id);
+        fprintf(stdout, ", \"line\": %d, \"move\": ", job->line_number);
+        print_move(job->pos_from, job->pos_to, job->promotion_type);
+        fprintf(stdout, ", \"solved\": %s, \"solution_time_ms\": %d, \"solution_depth\": %d, \"depth\": %d, \"score\": %d, \"time_ms\": %d, \"nodes\": %u, \"iir_reductions\": %u }%s\n",
+            job->solved ? "true" : "false", job->solution_time_ms, job->solution_depth, job->depth, job->score, job->time_ms, job->nodes, job->iir_reductions, i + 1 < num_jobs ? "," : "");
+        free(job->line);
+    }
+    fprintf(stdout, "  ]\n");
+    fprintf(stdout, "}\n");
+
+    fprintf(stderr, "Solved %d of %d positions\n", num_solved, num_jobs);
+
+    THREADPOOL_destroy(pool);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,539 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "state.h"
+#include "san.h"
+#include "pgn.h"
+#include "openingbook.h"
+#include "thread.h"
+
+#define CHUNK_SIZE              (1024*1024)
+#define RUN_BUFFER_ENTRIES      4096
+#define MAX_MERGE_FAN_IN        64
+#define MAX_MOVES_PER_POSITION  256
+
+#define SIDE_BOTH               2
+
+/* One (position, move) pair and the games it was played in */
+typedef struct {
+    uint64_t    key;
+    uint32_t    num_games;
+    uint32_t    score;      /* 2 per win and 1 per draw for the moving side */
+    uint16_t    move;       /* Polyglot encoded move */
+} book_entry_t;
+
+/* Whole games of PGN text waiting to be parsed, points into a mapped file */
+typedef struct {
+    const char  *text;
+    size_t      len;
+    int         side;
+} chunk_t;
+
+typedef struct {
+    /* Settings */
+    int         max_ply;
+    int         min_game;
+    int         num_threads;
+    size_t      entries_per_thread;
+
+    /* Queue of chunks from the reader to the workers */
+    mutex_t     mtx;
+    cond_t      cv_not_empty;
+    cond_t      cv_not_full;
+    chunk_t     *queue;
+    int         queue_size;
+    int         queue_head;
+    int         queue_count;
+    int         done;
+
+    /* Input files, mapped until the workers are done */
+    pgn_reader_t *inputs;
+    int         num_inputs;
+
+    /* Sorted runs spilled to disk */
+    FILE        **runs;
+    int         num_runs;
+
+    /* Statistics */
+    uint64_t    num_games;
+    uint64_t    num_games_used;
+    uint64_t    num_positions;
+    uint64_t    num_errors;
+} book_builder_t;
+
+typedef struct {
+    book_builder_t  *builder;
+    book_entry_t    *entries;
+    size_t          num_entries;
+    uint64_t        num_games;
+    uint64_t        num_games_used;
+    uint64_t        num_positions;
+    uint64_t        num_errors;
+} worker_t;
+
+typedef struct {
+    FILE            *f;
+    book_entry_t    buf[RUN_BUFFER_ENTRIES];
+    size_t          pos;
+    size_t          count;
+} run_reader_t;
+
+static int compare_entries(const void *a, const void *b)
+{
+    const book_entry_t *x = (const book_entry_t*)a;
+    const book_entry_t *y = (const book_entry_t*)b;
+    if(x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    if(x->move != y->move) return (x->move < y->move) ? -1 : 1;
+    return 0;
+}
+
+static int compare_weight(const void *a, const void *b)
+{
+    const book_entry_t *x = (const book_entry_t*)a;
+    const book_entry_t *y = (const book_entry_t*)b;
+    if(x->score != y->score) return (x->score > y->score) ? -1 : 1;
+    return (x->move < y->move) ? -1 : (x->move > y->move);
+}
+
+static FILE *create_run_file()
+{
+    FILE *f = tmpfile();
+    if(!f) {
+        fprintf(stderr, "Error: Could not create temporary file\n");
+        exit(1);
+    }
+    return f;
+}
+
+static void write_entries(FILE *f, const book_entry_t *entries, size_t num_entries)
+{
+    if(fwrite(entries, sizeof(book_entry_t), num_entries, f) != num_entries) {
+        fprintf(stderr, "Error: Could not write temporary file\n");
+        exit(1);
+    }
+}
+
+static void add_run(book_builder_t *b, FILE *f)
+{
+    MUTEX_lock(&b->mtx);
+    b->runs = (FILE**)realloc(b->runs, (b->num_runs + 1) * sizeof(FILE*));
+    b->runs[b->num_runs++] = f;
+    MUTEX_unlock(&b->mtx);
+}
+
+/* Sort the entries of a worker, merge duplicates and write them to disk as a run */
+static void spill_run(worker_t *w)
+{
+    size_t i, n = 0;
+
+    if(w->num_entries == 0) return;
+
+    qsort(w->entries, w->num_entries, sizeof(book_entry_t), compare_entries);
+    for(i = 1; i < w->num_entries; i++) {
+        if(compare_entries(&w->entries[n], &w->entries[i]) == 0) {
+            w->entries[n].num_games += w->entries[i].num_games;
+            w->entries[n].score += w->entries[i].score;
+        } else {
+            w->entries[++n] = w->entries[i];
+        }
+    }
+
+    FILE *f = create_run_file();
+    write_entries(f, w->entries, n + 1);
+    add_run(w->builder, f);
+    w->num_entries = 0;
+}
+
+static void add_entry(worker_t *w, const uint64_t key, const move_t move, const int score)
+{
+    book_entry_t *e;
+
+    if(w->num_entries == w->builder->entries_per_thread) {
+        spill_run(w);
+    }
+
+    e = &w->entries[w->num_entries++];
+    e->key = key;
+    e->move = OPENINGBOOK_polyglot_move(move);
+    e->num_games = 1;
+    e->score = score;
+    w->num_positions++;
+}
+
+/* Add the moves of one game to the book */
+static void parse_game(worker_t *w, pgn_game_t *game, const int side)
+{
+    const book_builder_t *b = w->builder;
+    char san[SAN_MAX_SIZE];
+    int ply = 0;
+    chess_state_t state;
+
+    w->num_games++;
+
+    /* Only games from the initial position with a known result are used */
+    if(game->result == PGN_RESULT_UNKNOWN || game->has_fen) return;
+    STATE_reset(&state);
+
+    while(ply < b->max_ply && PGN_next_move(game, san)) {
+        move_t move = SAN_parse_move(&state, san);
+        if(!move) {
+            w->num_errors++;
+            break;
+        }
+
+        if(side == SIDE_BOTH || side == state.player) {
+            int score = (state.player == WHITE) ? game->result : 2 - game->result;
+            add_entry(w, state.hash, move, score);
+        }
+
+        STATE_apply_move(&state, move);
+        ply++;
+    }
+
+    if(ply > 0) w->num_games_used++;
+}
+
+static void *worker_thread(void *arg)
+{
+    worker_t *w = (worker_t*)arg;
+    book_builder_t *b = w->builder;
+
+    while(1) {
+        chunk_t chunk;
+
+        /* Get next chunk from the queue */
+        MUTEX_lock(&b->mtx);
+        while(b->queue_count == 0 && !b->done) {
+            MUTEX_cond_wait(&b->mtx, &b->cv_not_empty);
+        }
+        if(b->queue_count == 0) {
+            MUTEX_unlock(&b->mtx);
+            break;
+        }
+        chunk = b->queue[b->queue_head];
+        b->queue_head = (b->queue_head + 1) % b->queue_size;
+        b->queue_count--;
+        MUTEX_cond_signal(&b->cv_not_full);
+        MUTEX_unlock(&b->mtx);
+
+        /* Parse all games in the chunk */
+        pgn_reader_t reader;
+        pgn_game_t game;
+        PGN_open_buffer(&reader, chunk.text, chunk.len);
+        while(PGN_next_game(&reader, &game)) {
+            parse_game(w, &game, chunk.side);
+        }
+    }
+
+    spill_run(w);
+
+    MUTEX_lock(&b->mtx);
+    b->num_games += w->num_games;
+    b->num_games_used += w->num_games_used;
+    b->num_positions += w->num_positions;
+    b->num_errors += w->num_errors;
+    MUTEX_unlock(&b->mtx);
+
+    return NULL;
+}
+
+static void push_chunk(book_builder_t *b, const char *text, const size_t len, const int side)
+{
+    chunk_t chunk;
+    chunk.text = text;
+    chunk.len = len;
+    chunk.side = side;
+
+    MUTEX_lock(&b->mtx);
+    while(b->queue_count == b->queue_size) {
+        MUTEX_cond_wait(&b->mtx, &b->cv_not_full);
+    }
+    b->queue[(b->queue_head + b->queue_count) % b->queue_size] = chunk;
+    b->queue_count++;
+    MUTEX_cond_signal(&b->cv_not_empty);
+    MUTEX_unlock(&b->mtx);
+}
+
+/* Map a PGN file and queue it for the workers in chunks of whole games */
+static int read_pgn(book_builder_t *b, const char *filename, const int side)
+{
+    pgn_reader_t *reader = &b->inputs[b->num_inputs];
+
+    if(!PGN_open(reader, filename)) {
+        fprintf(stderr, "Error: Could not open file: %s\n", filename);
+        return 0;
+    }
+    b->num_inputs++;
+
+    const char *data = reader->p;
+    const size_t size = (size_t)(reader->end - reader->p);
+    size_t start = 0;
+    while(start < size) {
+        size_t next = PGN_find_game_start(data, size, start + CHUNK_SIZE);
+        push_chunk(b, data + start, next - start, side);
+        start = next;
+    }
+
+    return 1;
+}
+
+static int run_reader_next(run_reader_t *r, book_entry_t *entry)
+{
+    if(r->pos == r->count) {
+        r->count = fread(r->buf, sizeof(book_entry_t), RUN_BUFFER_ENTRIES, r->f);
+        r->pos = 0;
+        if(r->count == 0) return 0;
+    }
+    *entry = r->buf[r->pos++];
+    return 1;
+}
+
+typedef void (*emit_cb)(void *arg, const book_entry_t *entry);
+
+/* K-way merge of sorted runs. Equal (key, move) pairs are combined before they are emitted. */
+static void merge_runs(FILE **runs, const int num_runs, emit_cb emit, void *arg)
+{
+    run_reader_t *readers = (run_reader_t*)malloc(num_runs * sizeof(run_reader_t));
+    book_entry_t *head = (book_entry_t*)malloc(num_runs * sizeof(book_entry_t));
+    int *heap = (int*)malloc(num_runs * sizeof(int));
+    int heap_size = 0;
+    int i;
+
+    for(i = 0; i < num_runs; i++) {
+        readers[i].f = runs[i];
+        readers[i].pos = readers[i].count = 0;
+        rewind(runs[i]);
+        if(run_reader_next(&readers[i], &head[i])) {
+            /* Sift up */
+            int k = heap_size++;
+            while(k > 0 && compare_entries(&head[i], &head[heap[(k-1)/2]]) < 0) {
+                heap[k] = heap[(k-1)/2];
+                k = (k-1)/2;
+            }
+            heap[k] = i;
+        }
+    }
+
+    book_entry_t current;
+    int has_current = 0;
+    while(heap_size) {
+        int top = heap[0];
+
+        if(has_current && compare_entries(&current, &head[top]) == 0) {
+            current.num_games += head[top].num_games;
+            current.score += head[top].score;
+        } else {
+            if(has_current) emit(arg, &current);
+            current = head[top];
+            has_current = 1;
+        }
+
+        /* Replace the top of the heap with the next entry of the same run */
+        if(!run_reader_next(&readers[top], &head[top])) {
+            top = heap[--heap_size];
+        }
+
+        /* Sift down */
+        int k = 0;
+        while(2*k + 1 < heap_size) {
+            int child = 2*k + 1;
+            if(child + 1 < heap_size && compare_entries(&head[heap[child+1]], &head[heap[child]]) < 0) child++;
+            if(compare_entries(&head[heap[child]], &head[top]) >= 0) break;
+            heap[k] = heap[child];
+            k = child;
+        }
+        if(heap_size) heap[k] = top;
+    }
+    if(has_current) emit(arg, &current);
+
+    free(heap);
+    free(head);
+    free(readers);
+}
+
+static void emit_to_run(void *arg, const book_entry_t *entry)
+{
+    write_entries((FILE*)arg, entry, 1);
+}
+
+typedef struct {
+    FILE            *f;
+    int             min_game;
+    book_entry_t    moves[MAX_MOVES_PER_POSITION];
+    int             num_moves;
+    uint64_t        num_entries;
+} book_writer_t;
+
+static void write_polyglot_entry(FILE *f, const uint64_t key, const uint16_t move, const uint16_t weight)
+{
+    uint8_t buffer[16];
+    int i;
+
+    for(i = 0; i < 8; i++) buffer[i] = (uint8_t)(key >> (56 - 8*i));
+    buffer[8] = (uint8_t)(move >> 8);
+    buffer[9] = (uint8_t)move;
+    buffer[10] = (uint8_t)(weight >> 8);
+    buffer[11] = (uint8_t)weight;
+    memset(buffer + 12, 0, 4);
+
+    fwrite(buffer, 16, 1, f);
+}
+
+/* Write all moves of a position, the most successful first */
+static void flush_position(book_writer_t *bw)
+{
+    int i;
+    qsort(bw->moves, bw->num_moves, sizeof(book_entry_t), compare_weight);
+    for(i = 0; i < bw->num_moves; i++) {
+        uint32_t weight = bw->moves[i].score;
+        if(weight > 0xFFFF) weight = 0xFFFF;
+        write_polyglot_entry(bw->f, bw->moves[i].key, bw->moves[i].move, (uint16_t)weight);
+        bw->num_entries++;
+    }
+    bw->num_moves = 0;
+}
+
+static void emit_to_book(void *arg, const book_entry_t *entry)
+{
+    book_writer_t *bw = (book_writer_t*)arg;
+
+    /* Skip rare moves and moves that never scored */
+    if(entry->num_games < (uint32_t)bw->min_game || entry->score == 0) return;
+
+    if(bw->num_moves && (bw->moves[0].key != entry->key || bw->num_moves == MAX_MOVES_PER_POSITION)) {
+        flush_position(bw);
+    }
+    bw->moves[bw->num_moves++] = *entry;
+}
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: makebook [options] [-only-white|-only-black|-both] file.pgn ...\n");
+    fprintf(stderr, "  -bin <file>       Output Polyglot book (default: book.bin)\n");
+    fprintf(stderr, "  -max-ply <n>      Only use the first n plies of each game (default: 1024)\n");
+    fprintf(stderr, "  -min-game <n>     Only keep moves played in at least n games (default: 3)\n");
+    fprintf(stderr, "  -only-white       Only use moves by white from the following files\n");
+    fprintf(stderr, "  -only-black       Only use moves by black from the following files\n");
+    fprintf(stderr, "  -both             Use moves by both sides from the following files\n");
+    fprintf(stderr, "  -threads <n>      Number of parsing threads (default: number of cores)\n");
+    fprintf(stderr, "  -memory <mb>      Memory for sorting before spilling to disk (default: 256)\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *output_filename = "book.bin";
+    int memory_mb = 256;
+    int num_inputs = 0;
+    int side = SIDE_BOTH;
+    int i;
+    book_builder_t b;
+    memset(&b, 0, sizeof(b));
+
+    b.max_ply = 1024;
+    b.min_game = 3;
+    b.num_threads = THREAD_num_cores();
+
+    /* Settings */
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-bin") == 0 && i + 1 < argc) output_filename = argv[++i];
+        else if(strcmp(argv[i], "-max-ply") == 0 && i + 1 < argc) b.max_ply = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-min-game") == 0 && i + 1 < argc) b.min_game = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) b.num_threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-memory") == 0 && i + 1 < argc) memory_mb = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-only-white") == 0 || strcmp(argv[i], "-only-black") == 0 || strcmp(argv[i], "-both") == 0) continue;
+        else if(argv[i][0] == '-') {
+            print_usage();
+            return 1;
+        }
+        else num_inputs++;
+    }
+
+    if(num_inputs == 0) {
+        print_usage();
+        return 1;
+    }
+    if(b.num_threads < 1) b.num_threads = 1;
+    if(memory_mb < 1) memory_mb = 1;
+
+    BITBOARD_init();
+
+    b.entries_per_thread = (size_t)memory_mb * 1024 * 1024 / b.num_threads / sizeof(book_entry_t);
+    if(b.entries_per_thread < RUN_BUFFER_ENTRIES) b.entries_per_thread = RUN_BUFFER_ENTRIES;
+    b.queue_size = 2 * b.num_threads;
+    b.queue = (chunk_t*)malloc(b.queue_size * sizeof(chunk_t));
+    b.inputs = (pgn_reader_t*)malloc(num_inputs * sizeof(pgn_reader_t));
+    MUTEX_create(&b.mtx);
+    MUTEX_cond_create(&b.cv_not_empty);
+    MUTEX_cond_create(&b.cv_not_full);
+
+    /* Start workers */
+    thread_t *threads = (thread_t*)malloc(b.num_threads * sizeof(thread_t));
+    worker_t *workers = (worker_t*)calloc(b.num_threads, sizeof(worker_t));
+    for(i = 0; i < b.num_threads; i++) {
+        workers[i].builder = &b;
+        workers[i].entries = (book_entry_t*)malloc(b.entries_per_thread * sizeof(book_entry_t));
+        THREAD_create(&threads[i], worker_thread, &workers[i]);
+    }
+
+    /* Read input files. A side filter applies to all files following it. */
+    int status = 0;
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-only-white") == 0) side = WHITE;
+        else if(strcmp(argv[i], "-only-black") == 0) side = BLACK;
+        else if(strcmp(argv[i], "-both") == 0) side = SIDE_BOTH;
+        else if(argv[i][0] == '-') i++;
+        else if(!read_pgn(&b, argv[i], side)) status = 2;
+    }
+
+    /* Wait for workers to finish */
+    MUTEX_lock(&b.mtx);
+    b.done = 1;
+    MUTEX_cond_broadcast(&b.cv_not_empty);
+    MUTEX_unlock(&b.mtx);
+    for(i = 0; i < b.num_threads; i++) {
+        THREAD_join(threads[i]);
+        free(workers[i].entries);
+    }
+    free(workers);
+    free(threads);
+    for(i = 0; i < b.num_inputs; i++) PGN_close(&b.inputs[i]);
+    free(b.inputs);
+
+    fprintf(stderr, "Games: %llu (used: %llu), positions: %llu, illegal moves: %llu, runs: %d\n",
+        (unsigned long long)b.num_games, (unsigned long long)b.num_games_used,
+        (unsigned long long)b.num_positions, (unsigned long long)b.num_errors, b.num_runs);
+
+    /* Reduce the number of runs until they can be merged in one pass */
+    while(b.num_runs > MAX_MERGE_FAN_IN) {
+        FILE *f = create_run_file();
+        merge_runs(b.runs, MAX_MERGE_FAN_IN, emit_to_run, f);
+        for(i = 0; i < MAX_MERGE_FAN_IN; i++) fclose(b.runs[i]);
+        memmove(b.runs, b.runs + MAX_MERGE_FAN_IN, (b.num_runs - MAX_MERGE_FAN_IN) * sizeof(FILE*));
+        b.num_runs -= MAX_MERGE_FAN_IN;
+        b.runs[b.num_runs++] = f;
+    }
+
+    /* Final merge into the book */
+    book_writer_t *bw = (book_writer_t*)calloc(1, sizeof(book_writer_t));
+    bw->f = fopen(output_filename, "wb");
+    bw->min_game = b.min_game;
+    if(!bw->f) {
+        fprintf(stderr, "Error: Could not open file: %s\n", output_filename);
+        return 2;
+    }
+    merge_runs(b.runs, b.num_runs, emit_to_book, bw);
+    if(bw->num_moves) flush_position(bw);
+    fclose(bw->f);
+    fprintf(stderr, "Book entries: %llu\n", (unsigned long long)bw->num_entries);
+
+    for(i = 0; i < b.num_runs; i++) fclose(b.runs[i]);
+    free(b.runs);
+    free(bw);
+    free(b.queue);
+    MUTEX_cond_destroy(&b.cv_not_full);
+    MUTEX_cond_destroy(&b.cv_not_empty);
+    MUTEX_destroy(&b.mtx);
+
+    return status;
+}
@@ -0,0 +1,650 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "engine.h"
+#include "state.h"
+#include "history.h"
+#include "san.h"
+#include "fen.h"
+#include "eval.h"
+#include "epd.h"
+#include "pgn.h"
+#include "search.h"
+#include "openingbook.h"
+#include "filemap.h"
+#include "clock.h"
+#include "rng.h"
+#include "thread.h"
+#include "threadpool.h"
+
+#define MAX_GAME_PLIES          500
+#define MAX_OPENING_PLIES       32
+#define MOVETEXT_SIZE           (MAX_GAME_PLIES * (SAN_MAX_SIZE + 8) + 256)
+
+/* Game results from white's point of view */
+#define RESULT_BLACK_WINS       0
+#define RESULT_DRAW             1
+#define RESULT_WHITE_WINS       2
+
+typedef struct {
+    char        *fen;           /* NULL for the initial position */
+    move_t      moves[MAX_OPENING_PLIES];
+    int         num_moves;
+} opening_t;
+
+typedef struct {
+    const char      *name;
+    eval_param_t    param;
+} player_t;
+
+typedef struct {
+    /* Settings */
+    player_t        players[2];
+    opening_t       *openings;
+    int             num_openings;
+    unsigned int    max_nodes;
+    int             max_depth;
+    int             time_ms;
+    int             increment_ms;
+    int             hash_size_mb;
+    int             adjudicate;
+    int             sprt;
+    double          elo0;
+    double          elo1;
+    double          alpha;
+    double          beta;
+
+    /* Results from the first player's point of view */
+    mutex_t         mtx;
+    int             wins;
+    int             draws;
+    int             losses;
+    int             num_games;
+    int             stop;
+    FILE            *pgn;
+} match_t;
+
+typedef struct {
+    int             result;
+    const char      *termination;
+    char            movetext[MOVETEXT_SIZE];
+    int             movetext_length;
+    int             line_length;
+} game_t;
+
+/* Append a token to the movetext, wrapping lines at 80 characters */
+static void append_movetext(game_t *game, const char *token)
+{
+    int len = (int)strlen(token);
+    if(game->line_length && game->line_length + 1 + len > 80) {
+        game->movetext[game->movetext_length++] = '\n';
+        game->line_length = 0;
+    } else if(game->line_length) {
+        game->movetext[game->movetext_length++] = ' ';
+        game->line_length++;
+    }
+    memcpy(&game->movetext[game->movetext_length], token, len + 1);
+    game->movetext_length += len;
+    game->line_length += len;
+}
+
+/* Find the legal move matching an engine move */
+static move_t find_move(const chess_state_t *state, int pos_from, int pos_to, int promotion_type)
+{
+    move_t moves[256];
+    int num_moves = STATE_generate_moves_simple(state, moves);
+
+    for(int i = 0; i < num_moves; i++) {
+        if((int)MOVE_GET_POS_FROM(moves[i]) != pos_from) continue;
+        if((int)MOVE_GET_POS_TO(moves[i]) != pos_to) continue;
+        if((int)MOVE_PROMOTION_TYPE(moves[i]) != promotion_type) continue;
+        return moves[i];
+    }
+
+    return 0;
+}
+
+/* Play a move on the board, in the movetext and in both engines */
+static void play_move(game_t *game, chess_state_t *state, history_t *history, engine_state_t *engines[2], int ply, int first_player, move_t move)
+{
+    char token[SAN_MAX_SIZE + 16];
+    char san[SAN_MAX_SIZE];
+    int move_number = 1 + (ply + first_player) / 2;
+
+    SAN_write_move(state, move, san);
+    if(state->player == WHITE) {
+        sprintf(token, "%d. %s", move_number, san);
+    } else if(ply == 0) {
+        sprintf(token, "%d... %s", move_number, san);
+    } else {
+        strcpy(token, san);
+    }
+    append_movetext(game, token);
+
+    STATE_apply_move(state, move);
+    HISTORY_push(history, state->hash);
+    for(int i = 0; i < 2; i++) {
+        ENGINE_apply_move(engines[i], MOVE_GET_POS_FROM(move), MOVE_GET_POS_TO(move), MOVE_PROMOTION_TYPE(move));
+    }
+}
+
+/* Check if the game is over by the rules */
+static int game_over(game_t *game, const chess_state_t *state, const history_t *history)
+{
+    move_t moves[256];
+
+    if(STATE_generate_moves_simple(state, moves) == 0) {
+        if(SEARCH_is_check(state, state->player)) {
+            game->result = state->player == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+            game->termination = state->player == WHITE ? "Black mates" : "White mates";
+        } else {
+            game->result = RESULT_DRAW;
+            game->termination = "Stalemate";
+        }
+        return 1;
+    }
+
+    if(state->halfmove_clock >= 100) {
+        game->result = RESULT_DRAW;
+        game->termination = "Draw by fifty move rule";
+        return 1;
+    }
+
+    if(HISTORY_is_threefold_repetition(history, state->halfmove_clock)) {
+        game->result = RESULT_DRAW;
+        game->termination = "Draw by repetition";
+        return 1;
+    }
+
+    if(EVAL_draw(state)) {
+        game->result = RESULT_DRAW;
+        game->termination = "Draw by insufficient material";
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Play one game. white is the index of the player with the white pieces. */
+static void play_game(match_t *match, const opening_t *opening, int white, game_t *game)
+{
+    engine_state_t *engines[2];     /* Indexed by color */
+    chess_state_t state;
+    history_t *history = HISTORY_create();
+    int time_left_ms[2] = { match->time_ms, match->time_ms };
+    int resign_count[2] = { 0, 0 };
+    int draw_count = 0;
+    int first_player;
+    int ply = 0;
+
+    game->movetext_length = 0;
+    game->line_length = 0;
+    game->movetext[0] = '\0';
+    game->termination = NULL;
+
+    for(int color = WHITE; color <= BLACK; color++) {
+        engine_config_t config;
+        ENGINE_config_default(&config);
+        config.hash_size_mb = match->hash_size_mb;
+        config.book_path = NULL;
+        config.lazy_alloc = 1;
+        config.random_seed = 1;
+        config.eval_param = &match->players[color == WHITE ? white : 1 - white].param;
+        ENGINE_create_ex(&engines[color], &config);
+        ENGINE_set_node_limit(engines[color], match->max_nodes);
+        if(opening->fen) {
+            ENGINE_set_board(engines[color], opening->fen);
+        }
+    }
+
+    if(opening->fen) {
+        FEN_read(&state, opening->fen);
+        HISTORY_reset_after_load(history, &state);
+    } else {
+        STATE_reset(&state);
+        HISTORY_reset(history);
+    }
+    first_player = state.player;
+
+    for(int i = 0; i < opening->num_moves; i++) {
+        play_move(game, &state, history, engines, ply++, first_player, opening->moves[i]);
+    }
+
+    while(!game_over(game, &state, history)) {
+        int color = state.player;
+        int pos_from, pos_to, promotion_type;
+        int score;
+
+        if(ply >= MAX_GAME_PLIES) {
+            game->result = RESULT_DRAW;
+            game->termination = "Draw by adjudication: maximum game length";
+            break;
+        }
+
+        if(match->time_ms > 0) {
+            int64_t start_time_ms = CLOCK_now();
+            score = ENGINE_search(engines[color], 0, time_left_ms[color], match->increment_ms, match->max_depth, &pos_from, &pos_to, &promotion_type);
+            time_left_ms[color] -= (int)CLOCK_time_passed(start_time_ms);
+            if(time_left_ms[color] < 0) {
+                game->result = color == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+                game->termination = color == WHITE ? "White loses on time" : "Black loses on time";
+                break;
+            }
+            time_left_ms[color] += match->increment_ms;
+        } else {
+            score = ENGINE_search(engines[color], 1, 2000000000, 0, match->max_depth, &pos_from, &pos_to, &promotion_type);
+        }
+        score *= 5; /* Centipawns */
+
+        move_t move = find_move(&state, pos_from, pos_to, promotion_type);
+        if(!move) {
+            game->result = color == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+            game->termination = color == WHITE ? "White makes an illegal move" : "Black makes an illegal move";
+            break;
+        }
+        play_move(game, &state, history, engines, ply++, first_player, move);
+
+        if(match->adjudicate) {
+            /* Resign after three moves at a score of -10 pawns or worse */
+            resign_count[color] = (score <= -1000) ? resign_count[color] + 1 : 0;
+            if(resign_count[color] >= 3) {
+                game->result = color == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+                game->termination = color == WHITE ? "White resigns" : "Black resigns";
+                break;
+            }
+
+            /* Draw when both sides score within 0.1 pawns for eight moves each after move 40 */
+            draw_count = (ply >= 80 && score >= -10 && score <= 10) ? draw_count + 1 : 0;
+            if(draw_count >= 16) {
+                game->result = RESULT_DRAW;
+                game->termination = "Draw by adjudication";
+                break;
+            }
+        }
+    }
+
+    ENGINE_destroy(engines[WHITE]);
+    ENGINE_destroy(engines[BLACK]);
+    HISTORY_destroy(history);
+}
+
+/* Log-likelihood ratio of the results under elo1 versus elo0, using the
+ * normal approximation of the trinomial score distribution */
+static double sprt_llr(int wins, int draws, int losses, double elo0, double elo1)
+{
+    const int n = wins + draws + losses;
+    if(n == 0 || wins + draws == 0 || losses + draws == 0) return 0.0;
+
+    const double w = (double)wins / n, d = (double)draws / n, l = (double)losses / n;
+    const double s = w + d / 2;
+    const double var = w * (1 - s) * (1 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+    if(var <= 0) return 0.0;
+
+    const double s0 = 1 / (1 + pow(10, -elo0 / 400));
+    const double s1 = 1 / (1 + pow(10, -elo1 / 400));
+    return (s1 - s0) * (2 * s - s0 - s1) / (2 * var / n);
+}
+
+static void print_status(const match_t *match)
+{
+    const int n = match->wins + match->draws + match->losses;
+    const double s = n ? (match->wins + 0.5 * match->draws) / n : 0.5;
+    double elo = 0, error = 0;
+
+    if(s > 0 && s < 1) {
+        const double w = (double)match->wins / n, d = (double)match->draws / n, l = (double)match->losses / n;
+        const double var = w * (1 - s) * (1 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+        elo = -400 * log10(1 / s - 1);
+        error = 400 / log(10) * 1.96 * sqrt(var / n) / (s * (1 - s));
+    }
+
+    fprintf(stderr, "Games: %d, %s vs %s: %d - %d - %d [%.3f], Elo: %.1f +/- %.1f",
+        n, match->players[0].name, match->players[1].name, match->wins, match->losses, match->draws, s, elo, error);
+    if(match->sprt) {
+        fprintf(stderr, ", LLR: %.2f [%.2f, %.2f]", sprt_llr(match->wins, match->draws, match->losses, match->elo0, match->elo1),
+            log(match->beta / (1 - match->alpha)), log((1 - match->beta) / match->alpha));
+    }
+    fprintf(stderr, "\n");
+}
+
+static void write_pgn(match_t *match, const opening_t *opening, int white, int round, const game_t *game)
+{
+    const char *results[3] = { "0-1", "1/2-1/2", "1-0" };
+    FILE *f = match->pgn;
+
+    fprintf(f, "[Event \"Selfplay\"]\n");
+    fprintf(f, "[Site \"?\"]\n");
+    fprintf(f, "[Date \"????.??.??\"]\n");
+    fprintf(f, "[Round \"%d\"]\n", round);
+    fprintf(f, "[White \"%s\"]\n", match->players[white].name);
+    fprintf(f, "[Black \"%s\"]\n", match->players[1 - white].name);
+    fprintf(f, "[Result \"%s\"]\n", results[game->result]);
+    if(opening->fen) {
+        fprintf(f, "[FEN \"%s\"]\n", opening->fen);
+        fprintf(f, "[SetUp \"1\"]\n");
+    }
+    fprintf(f, "\n%s%s{%s} %s\n\n", game->movetext, game->movetext_length ? " " : "", game->termination, results[game->result]);
+    fflush(f);
+}
+
+/* Play rounds [first, last). Each round plays one opening with both colors. */
+static void play_rounds(void *arg, int worker, int first, int last)
+{
+    match_t *match = (match_t*)arg;
+    game_t *game = (game_t*)malloc(sizeof(game_t));
+    (void)worker;
+
+    for(int round = first; round < last; round++) {
+        const opening_t *opening = &match->openings[round % match->num_openings];
+
+        for(int white = 0; white < 2; white++) {
+            MUTEX_lock(&match->mtx);
+            int stop = match->stop;
+            MUTEX_unlock(&match->mtx);
+            if(stop) break;
+
+            play_game(match, opening, white, game);
+
+            MUTEX_lock(&match->mtx);
+            int first_player_result = white == 0 ? game->result : RESULT_WHITE_WINS - game->result;
+            if(first_player_result == RESULT_WHITE_WINS) match->wins++;
+            else if(first_player_result == RESULT_DRAW) match->draws++;
+            else match->losses++;
+            match->num_games++;
+            if(match->pgn) {
+                write_pgn(match, opening, white, match->num_games, game);
+            }
+            print_status(match);
+
+            if(match->sprt) {
+                double llr = sprt_llr(match->wins, match->draws, match->losses, match->elo0, match->elo1);
+                if(llr <= log(match->beta / (1 - match->alpha)) || llr >= log((1 - match->beta) / match->alpha)) {
+                    match->stop = 1;
+                }
+            }
+            MUTEX_unlock(&match->mtx);
+        }
+    }
+
+    free(game);
+}
+
+/* Whether any opening differs from the initial position. Otherwise every
+ * round replays the same pair of games. */
+static int openings_differ(const match_t *match)
+{
+    for(int i = 0; i < match->num_openings; i++) {
+        if(match->openings[i].fen || match->openings[i].num_moves) return 1;
+    }
+    return 0;
+}
+
+/* Random walks through the opening book. Fails if the book is missing or
+ * has no moves from the initial position. */
+static int book_openings(match_t *match, const char *filename, int num_openings, int num_plies, unsigned int seed)
+{
+    openingbook_t *book = OPENINGBOOK_create(filename);
+    rng_t rng;
+    if(!book) return 0;
+    if(num_plies > MAX_OPENING_PLIES) num_plies = MAX_OPENING_PLIES;
+
+    RNG_seed(&rng, seed);
+    match->openings = (opening_t*)calloc(num_openings, sizeof(opening_t));
+    match->num_openings = num_openings;
+    for(int i = 0; i < num_openings; i++) {
+        opening_t *opening = &match->openings[i];
+        chess_state_t state;
+        STATE_reset(&state);
+        while(opening->num_moves < num_plies) {
+            move_t move = OPENINGBOOK_get_move(book, &state, &rng);
+            if(!move) break;
+            opening->moves[opening->num_moves++] = move;
+            STATE_apply_move(&state, move);
+        }
+    }
+
+    OPENINGBOOK_destroy(book);
+    return openings_differ(match);
+}
+
+/* One opening per position in an EPD file */
+static int epd_openings(match_t *match, const char *filename)
+{
+    char line[1024 + 8];
+    int capacity = 0;
+    FILE *f = fopen(filename, "r");
+    if(!f) return 0;
+
+    while(fgets(line, 1024, f)) {
+        epd_position_t epd;
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0' || line[0] == '#') continue;
+        if(!EPD_read(&epd, line)) {
+            fprintf(stderr, "%s: Invalid EPD: %s\n", filename, line);
+            continue;
+        }
+
+        if(match->num_openings == capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            match->openings = (opening_t*)realloc(match->openings, capacity * sizeof(opening_t));
+        }
+        /* Keep the four FEN fields of the EPD, without operations */
+        int len = 0;
+        for(int field = 0; field < 4; field++) {
+            while(line[len] == ' ') len++;
+            while(line[len] && line[len] != ' ') len++;
+        }
+        strcpy(&line[len], " 0 1");
+
+        opening_t *opening = &match->openings[match->num_openings++];
+        memset(opening, 0, sizeof(opening_t));
+        opening->fen = strdup(line);
+    }
+
+    fclose(f);
+    return match->num_openings > 0;
+}
+
+/* The first plies of each game in a PGN file */
+static int pgn_openings(match_t *match, const char *filename, int num_plies)
+{
+    pgn_reader_t reader;
+    pgn_game_t game;
+    char san[SAN_MAX_SIZE];
+    int capacity = 0;
+    if(!PGN_open(&reader, filename)) return 0;
+    if(num_plies > MAX_OPENING_PLIES) num_plies = MAX_OPENING_PLIES;
+
+    while(PGN_next_game(&reader, &game)) {
+        chess_state_t state;
+        STATE_reset(&state);
+        if(game.has_fen && !FEN_read(&state, game.fen)) {
+            fprintf(stderr, "%s: Invalid FEN: %s\n", filename, game.fen);
+            continue;
+        }
+
+        if(match->num_openings == capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            match->openings = (opening_t*)realloc(match->openings, capacity * sizeof(opening_t));
+        }
+        opening_t *opening = &match->openings[match->num_openings++];
+        memset(opening, 0, sizeof(opening_t));
+        if(game.has_fen) opening->fen = strdup(game.fen);
+
+        while(opening->num_moves < num_plies && PGN_next_move(&game, san)) {
+            move_t move = SAN_parse_move(&state, san);
+            if(!move) {
+                fprintf(stderr, "%s: Invalid move: %s\n", filename, san);
+                break;
+            }
+            opening->moves[opening->num_moves++] = move;
+            STATE_apply_move(&state, move);
+        }
+    }
+
+    PGN_close(&reader);
+    return openings_differ(match);
+}
+
+/* Parameters from a file written by the tuner, or the defaults */
+static int read_player(player_t *player, const char *filename)
+{
+    filemap_t map;
+    char *text;
+    int success;
+
+    player->name = filename ? filename : "default";
+    player->param = EVAL_default_param;
+    if(!filename) return 1;
+
+    if(!FILEMAP_open(&map, filename)) return 0;
+    text = (char*)malloc(map.size + 1);
+    memcpy(text, map.data, map.size);
+    text[map.size] = '\0';
+    FILEMAP_close(&map);
+
+    success = EVAL_read_param(&player->param, text);
+    free(text);
+    return success;
+}
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: selfplay [options]\n");
+    fprintf(stderr, "  -a <file>             Evaluation parameters of the first player (default: built-in)\n");
+    fprintf(stderr, "  -b <file>             Evaluation parameters of the second player (default: built-in)\n");
+    fprintf(stderr, "  -games <n>            Maximum number of games, played in pairs (default: 1000)\n");
+    fprintf(stderr, "  -nodes <n>            Node limit per move (default: 20000 without other limits)\n");
+    fprintf(stderr, "  -depth <n>            Depth limit per move\n");
+    fprintf(stderr, "  -tc <s>[+<inc>]       Time control in seconds per game and increment per move\n");
+    fprintf(stderr, "  -hash <mb>            Hashtable size per engine (default: 16)\n");
+    fprintf(stderr, "  -book <file>          Opening book for random openings (default: book.bin)\n");
+    fprintf(stderr, "  -book-plies <n>       Plies to play from the opening book (default: 8)\n");
+    fprintf(stderr, "  -epd <file>           Play openings from an EPD file instead of the book\n");
+    fprintf(stderr, "  -pgn <file>           Play the first -book-plies plies of each game in a PGN file\n");
+    fprintf(stderr, "  -seed <n>             Seed for opening selection (default: 1)\n");
+    fprintf(stderr, "  -sprt <elo0> <elo1>   Stop when the SPRT accepts either hypothesis\n");
+    fprintf(stderr, "  -alpha <a>            SPRT false positive rate (default: 0.05)\n");
+    fprintf(stderr, "  -beta <b>             SPRT false negative rate (default: 0.05)\n");
+    fprintf(stderr, "  -noadjudication       Play all games to the end\n");
+    fprintf(stderr, "  -pgnout <file>        Write games as PGN, - for stdout\n");
+    fprintf(stderr, "  -threads <n>          Number of games played concurrently (default: number of cores)\n");
+}
+
+int main(int argc, char **argv)
+{
+    match_t match;
+    const char *param_files[2] = { NULL, NULL };
+    const char *book_filename = "book.bin";
+    const char *epd_filename = NULL;
+    const char *pgn_openings_filename = NULL;
+    const char *pgn_filename = NULL;
+    int num_games = 1000;
+    int book_plies = 8;
+    int num_threads = 0;
+    unsigned int seed = 1;
+    int i;
+
+    memset(&match, 0, sizeof(match));
+    match.adjudicate = 1;
+    match.hash_size_mb = 16;
+    match.alpha = 0.05;
+    match.beta = 0.05;
+
+    /* Settings */
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-a") == 0 && i + 1 < argc) param_files[0] = argv[++i];
+        else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) param_files[1] = argv[++i];
+        else if(strcmp(argv[i], "-games") == 0 && i + 1 < argc) num_games = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-nodes") == 0 && i + 1 < argc) match.max_nodes = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-depth") == 0 && i + 1 < argc) match.max_depth = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-tc") == 0 && i + 1 < argc) {
+            const char *tc = argv[++i];
+            const char *inc = strchr(tc, '+');
+            match.time_ms = (int)(1000 * atof(tc));
+            match.increment_ms = inc ? (int)(1000 * atof(inc + 1)) : 0;
+        }
+        else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) match.hash_size_mb = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-book") == 0 && i + 1 < argc) book_filename = argv[++i];
+        else if(strcmp(argv[i], "-book-plies") == 0 && i + 1 < argc) book_plies = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-epd") == 0 && i + 1 < argc) epd_filename = argv[++i];
+        else if(strcmp(argv[i], "-pgn") == 0 && i + 1 < argc) pgn_openings_filename = argv[++i];
+        else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-sprt") == 0 && i + 2 < argc) {
+            match.sprt = 1;
+            match.elo0 = atof(argv[++i]);
+            match.elo1 = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-alpha") == 0 && i + 1 < argc) match.alpha = atof(argv[++i]);
+        else if(strcmp(argv[i], "-beta") == 0 && i + 1 < argc) match.beta = atof(argv[++i]);
+        else if(strcmp(argv[i], "-noadjudication") == 0) match.adjudicate = 0;
+        else if(strcmp(argv[i], "-pgnout") == 0 && i + 1 < argc) pgn_filename = argv[++i];
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) num_threads = atoi(argv[++i]);
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if(match.time_ms <= 0 && match.max_nodes == 0 && match.max_depth <= 0) match.max_nodes = 20000;
+    if(match.max_depth <= 0 || match.max_depth > 100) match.max_depth = 100;
+    if(match.sprt && (match.alpha <= 0 || match.alpha >= 1 || match.beta <= 0 || match.beta >= 1)) {
+        print_usage();
+        return 1;
+    }
+    int num_rounds = (num_games + 1) / 2;
+
+    BITBOARD_init();
+
+    for(i = 0; i < 2; i++) {
+        if(!read_player(&match.players[i], param_files[i])) {
+            fprintf(stderr, "Error: Could not read parameters: %s\n", param_files[i]);
+            return 2;
+        }
+    }
+
+    if(epd_filename) {
+        if(!epd_openings(&match, epd_filename)) {
+            fprintf(stderr, "Error: Could not read openings: %s\n", epd_filename);
+            return 2;
+        }
+    } else if(pgn_openings_filename) {
+        if(!pgn_openings(&match, pgn_openings_filename, book_plies)) {
+            fprintf(stderr, "Error: Could not read openings, or they have no moves: %s\n", pgn_openings_filename);
+            return 2;
+        }
+    } else if(!book_openings(&match, book_filename, num_rounds, book_plies, seed)) {
+        fprintf(stderr, "Error: Could not open book, or it has no moves: %s\n", book_filename);
+        return 2;
+    }
+
+    if(pgn_filename) {
+        match.pgn = strcmp(pgn_filename, "-") == 0 ? stdout : fopen(pgn_filename, "w");
+        if(!match.pgn) {
+            fprintf(stderr, "Error: Could not open file: %s\n", pgn_filename);
+            return 2;
+        }
+    }
+
+    /* One round per chunk, rounds are handed out in order */
+    MUTEX_create(&match.mtx);
+    threadpool_t *pool = THREADPOOL_create(num_threads);
+    THREADPOOL_run(pool, num_rounds, 1, play_rounds, &match);
+    THREADPOOL_destroy(pool);
+    MUTEX_destroy(&match.mtx);
+
+    if(match.sprt) {
+        double llr = sprt_llr(match.wins, match.draws, match.losses, match.elo0, match.elo1);
+        if(llr >= log((1 - match.beta) / match.alpha)) fprintf(stderr, "SPRT: H1 accepted (elo >= %.1f)\n", match.elo1);
+        else if(llr <= log(match.beta / (1 - match.alpha))) fprintf(stderr, "SPRT: H0 accepted (elo <= %.1f)\n", match.elo0);
+        else fprintf(stderr, "SPRT: inconclusive\n");
+    }
+
+    if(match.pgn && match.pgn != stdout) fclose(match.pgn);
+    for(i = 0; i < match.num_openings; i++) free(match.openings[i].fen);
+    free(match.openings);
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "retrograde.h"
+#include "tablebase.h"
+#include "clock.h"
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: tbgen [options] [table ...]\n");
+    fprintf(stderr, "Writes Syzygy tables (.rtbw and .rtbz) for tests: the named tables (like KRvKP),\n");
+    fprintf(stderr, "or all tables up to -pieces pieces.\n");
+    fprintf(stderr, "  -path <dir>       Directory of the tables (default: current directory)\n");
+    fprintf(stderr, "  -pieces <n>       Most pieces including kings, 3 or 4 (default: 3)\n");
+    fprintf(stderr, "  -threads <n>      Number of threads (default: number of cores)\n");
+}
+
+static int generate(const char *path, const char *name, const int num_threads)
+{
+    int64_t start_time_ms = CLOCK_now();
+    if(!TABLEBASE_generate(path, name, num_threads)) {
+        fprintf(stderr, "Error: Could not generate %s, are the tables it depends on there?\n", name);
+        return 0;
+    }
+    fprintf(stderr, "%-8s %6.1f s\n", name, CLOCK_time_passed(start_time_ms) / 1000.0);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "";
+    int max_pieces = 3;
+    int num_threads = 0;
+    int num_names = 0;
+    int i;
+
+    /* Settings */
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-path") == 0 && i + 1 < argc) path = argv[++i];
+        else if(strcmp(argv[i], "-pieces") == 0 && i + 1 < argc) max_pieces = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) num_threads = atoi(argv[++i]);
+        else if(argv[i][0] == '-') {
+            print_usage();
+            return 1;
+        }
+        else num_names++;
+    }
+
+    if(max_pieces < 3 || max_pieces > RETROGRADE_MAX_PIECES) {
+        print_usage();
+        return 1;
+    }
+
+    /* Named tables in the given order */
+    if(num_names) {
+        for(i = 1; i < argc; i++) {
+            if(argv[i][0] == '-') i++;
+            else if(!generate(path, argv[i], num_threads)) return 2;
+        }
+        return 0;
+    }
+
+    /* All tables, those reached by captures and promotions first */
+    char names[RETROGRADE_MAX_TABLES][RETROGRADE_NAME_SIZE];
+    int num_tables = RETROGRADE_list(names, max_pieces);
+    for(i = 0; i < num_tables; i++) {
+        if(!generate(path, names[i], num_threads)) return 2;
+    }
+
+    return 0;
+}
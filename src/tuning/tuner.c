@@ -1,16 +1,53 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
-#include "engine.h"
 #include "state.h"
-#include "search.h"
-#include "thread.h"
 #include "eval.h"
+#include "see.h"
+#include "san.h"
+#include "fen.h"
+#include "pgn.h"
+#include "threadpool.h"
+#include "positionfile.h"
+#include "search.h"
+#include "hashtable.h"
+#include "history.h"
+#include "clock.h"
+
+/* Positions per work item handed to the thread pool */
+#define CHUNK_SIZE 4096
+#define PGN_CHUNK_SIZE (64*1024)
 
-#define NUM_THREADS 16
+static threadpool_t *pool;
 
-extern eval_param_t param;
+/* Parameters being tuned, starts from the defaults */
+static eval_param_t param;
+
+/* With -search the search parameters are tuned instead, scoring positions
+ * with a search limited to search_nodes nodes */
+static int tune_search = 0;
+static search_param_t search_param;
+static unsigned int search_nodes = 2000;
+static search_state_t **search_states;
+
+/* Step of each search parameter, 0 for parameters that are not tuned */
+static const search_param_t search_param_step =
+{
+    .razor_margin               = { 0, 5, 5, 5 },
+    .probcut_depth              = 1,
+    .probcut_margin             = 5,
+    .probcut_reduction          = 1,
+    .lmr_base                   = 10,
+    .lmr_scale                  = 5,
+    .lmr_history                = 10,
+    .lmr_not_improving          = 10,
+    .lmr_cut_node               = 10,
+    .lmr_pv_node                = 10,
+    .iir_depth                  = 1,
+    .quiescence_checks          = 0,
+};
 
 float sigmoid(float x)
 {
@@ -25,129 +62,258 @@ float error(float result, float score)
 }
 
 typedef struct {
-    int index;
-    const char *buf;
-    float error;
+    const packed_position_t *positions;
     int num_positions;
-} thread_arg_t;
+} dataset_t;
 
-void* worker_thread(void *_arg)
+/* A position is quiet if the side to move is not in check and has no winning capture or promotion */
+static int is_quiet(const chess_state_t *s)
 {
-    thread_arg_t *arg = (thread_arg_t*)_arg;
-    arg->error = 0;
-    arg->num_positions = 0;
-
-    engine_state_t *engine;
-    ENGINE_create(&engine);
-
-    char game[1024*100];
-    const char *game_end = arg->buf;
-    const char *game_start;
-    int game_number = 0;
-    do {
-        /* Find start of game */
-        game_start = strstr(game_end, "\n\n");
-        if(!game_start) break;
-        game_start += 2;
-
-        /* Find end of game */
-        game_end = strstr(game_start, "\n\n") + 2;
-
-        ENGINE_reset(engine);
-
-        /* Game result */
-        float result;
-        if(game_end[-3] == '0') result = 1.0f;
-        else if(game_end[-3] == '1') result = 0.0f;
-        else if(game_end[-3] == '2') result = 0.5f;
-        else {
-            fprintf(stderr, "Error: Could not parse file\n");
-            exit(1);
-        }
+    bitboard_t block_check, pinners, pinned;
+    move_t moves[256];
+
+    if(STATE_checkers_and_pinners(s, &block_check, &pinners, &pinned)) return 0;
+
+    int num_moves = STATE_generate_moves_quiescence(s, 0, block_check, pinners, pinned, moves);
+    for(int i = 0; i < num_moves; i++) {
+        if(MOVE_IS_PROMOTION(moves[i])) return 0;
+        if(see(s, moves[i]) > 0) return 0;
+    }
+
+    return 1;
+}
+
+/* Whole games of PGN text */
+typedef struct {
+    const char *start;
+    const char *end;
+} chunk_ref_t;
+
+/* Output of one chunk of games */
+typedef struct {
+    packed_position_t *positions;
+    int             num_positions;
+    int             max_positions;
+    int             num_games;
+    int             num_errors;
+} position_list_t;
+
+typedef struct {
+    const chunk_ref_t *chunks;
+    position_list_t   *lists;
+} extract_job_t;
+
+static void extract_game(pgn_game_t *game, position_list_t *list)
+{
+    char san[SAN_MAX_SIZE];
+    chess_state_t state;
+    int half_moves = 0;
+
+    /* Game result */
+    if(game->result == PGN_RESULT_UNKNOWN) return;
 
-        int game_len = game_end - game_start;
-        strncpy(game, game_start, game_len);
-        game[game_len] = '\0';
-        if(game_end - game_start - 2 > sizeof(game) ) {
-            fprintf(stderr, "\ntoo small game buffer\n");
-            exit(1);
+    if(game->has_fen) {
+        if(!FEN_read(&state, game->fen)) {
+            list->num_errors++;
+            return;
         }
+    } else {
+        STATE_reset(&state);
+    }
+    list->num_games++;
+
+    /* Replay game */
+    while(PGN_next_move(game, san)) {
+        move_t move = SAN_parse_move(&state, san);
+        if(!move) {
+            list->num_errors++;
+            return;
+        }
+        STATE_apply_move(&state, move);
 
-        ++game_number;
-        //if(game_number>1000) break;
-        if(game_number % NUM_THREADS != arg->index) continue;
-
-
-        /* Parse game */
-        char *s = game;
-        char *t;
-        int comment = 0;
-        int half_moves = 0;
-        char *save_ptr;
-        while((t = strtok_r(s, " \n", &save_ptr))) {
-            s = NULL;
-            int len = strlen(t);
-            if(len == 0) continue;
-            if(t[0] == '{') {
-                comment = 1;
-            }
-            if(t[len-1] == '}') {
-                comment = 0;
-                continue;
-            }
-            if(comment) continue;
+        half_moves++;
+        if(half_moves < 20) continue;
+        if(!is_quiet(&state)) continue;
 
-            if(t[0] >= '0' && t[0] <= '9') continue;
+        if(list->num_positions == list->max_positions) {
+            list->max_positions = list->max_positions ? 2 * list->max_positions : 1024;
+            list->positions = realloc(list->positions, list->max_positions * sizeof(packed_position_t));
+        }
+        packed_position_t *p = &list->positions[list->num_positions];
+        if(!PACK_position(&state, p)) continue;
+        p->result = (uint8_t)game->result;
+        list->num_positions++;
+    }
+}
 
-            int r = ENGINE_apply_move_san(engine, t);
-            if(r == ENGINE_RESULT_ILLEGAL_MOVE) {
-                fprintf(stderr, "\nInvalid move \"%s\"\n", t);
-                exit(1);
-            }
+static void extract_job(void *arg, int worker, int first, int last)
+{
+    extract_job_t *job = (extract_job_t*)arg;
+    (void)worker;
+
+    for(int i = first; i < last; i++) {
+        pgn_reader_t reader;
+        pgn_game_t game;
+        PGN_open_buffer(&reader, job->chunks[i].start, job->chunks[i].end - job->chunks[i].start);
+        while(PGN_next_game(&reader, &game)) {
+            extract_game(&game, &job->lists[i]);
+        }
+    }
+}
 
-            half_moves++;
-            if(half_moves < 20) continue;
+/* Replay all games in a PGN file once and write the quiet positions to a position file */
+int extract_positions(const char *pgn_filename, const char *out_filename)
+{
+    pgn_reader_t reader;
+    if(!PGN_open(&reader, pgn_filename) || reader.p == reader.end) {
+        fprintf(stderr, "Error: Could not open file: %s\n", pgn_filename);
+        return 2;
+    }
 
-            /* Evaluate position */
-            int pos_from, pos_to, promotion_type;
-            short score = ENGINE_search(engine, 1, 3600*1000, 0, 0, &pos_from, &pos_to, &promotion_type);
-            if(half_moves % 2 == 1) score = -score; /* Invert score for black */
+    positionfile_t *out = POSITIONFILE_create(out_filename, POSITIONFILE_COMPRESSION_ZLIB);
+    if(!out) {
+        fprintf(stderr, "Error: Could not open file: %s\n", out_filename);
+        PGN_close(&reader);
+        return 2;
+    }
 
-            arg->num_positions++;
+    /* Split the file into chunks of whole games */
+    const char *data = reader.p;
+    const size_t size = (size_t)(reader.end - reader.p);
+    chunk_ref_t *chunks = NULL;
+    int num_chunks = 0, max_chunks = 0;
+    for(size_t start = 0; start < size;) {
+        size_t next = PGN_find_game_start(data, size, start + PGN_CHUNK_SIZE);
+        if(num_chunks == max_chunks) {
+            max_chunks = max_chunks ? 2 * max_chunks : 1024;
+            chunks = realloc(chunks, max_chunks * sizeof(chunk_ref_t));
+        }
+        chunks[num_chunks].start = data + start;
+        chunks[num_chunks].end = data + next;
+        num_chunks++;
+        start = next;
+    }
 
-            float e2 = error(result, score);
-            arg->error += e2;
+    uint64_t num_positions = 0;
+    uint64_t num_games = 0;
+    uint64_t num_errors = 0;
+    int write_error = 0;
+
+    /* Replay the games in batches of chunks, written in game order */
+    const int chunks_per_batch = 256;
+    position_list_t *lists = calloc(chunks_per_batch, sizeof(position_list_t));
+    for(int batch = 0; batch < num_chunks; batch += chunks_per_batch) {
+        int batch_chunks = num_chunks - batch;
+        if(batch_chunks > chunks_per_batch) batch_chunks = chunks_per_batch;
+
+        extract_job_t job = { &chunks[batch], lists };
+        THREADPOOL_run(pool, batch_chunks, 1, extract_job, &job);
+
+        for(int i = 0; i < batch_chunks; i++) {
+            if(!POSITIONFILE_write(out, lists[i].positions, lists[i].num_positions)) write_error = 1;
+            num_positions += lists[i].num_positions;
+            num_games += lists[i].num_games;
+            num_errors += lists[i].num_errors;
+            lists[i].num_positions = 0;
+            lists[i].num_games = 0;
+            lists[i].num_errors = 0;
         }
-    } while(1);
+    }
+
+    if(!POSITIONFILE_close(out)) write_error = 1;
+
+    for(int i = 0; i < chunks_per_batch; i++) free(lists[i].positions);
+    free(lists);
+    free(chunks);
+    PGN_close(&reader);
+
+    if(write_error) {
+        fprintf(stderr, "Error: Could not write file: %s\n", out_filename);
+        return 2;
+    }
 
-    ENGINE_destroy(engine);
+    fprintf(stderr, "Extracted %llu quiet positions from %llu games, %llu invalid games\n",
+        (unsigned long long)num_positions, (unsigned long long)num_games, (unsigned long long)num_errors);
     return 0;
 }
 
-float run_test(const char *buf)
+typedef struct {
+    const dataset_t *data;
+    double          *error;     /* Per chunk, summed in order for reproducible results */
+} test_job_t;
+
+static void test_job(void *arg, int worker, int first, int last)
 {
-    thread_arg_t t_arg[NUM_THREADS];
-    thread_t t[NUM_THREADS];
+    test_job_t *job = (test_job_t*)arg;
+    chess_state_t state;
+    double e2 = 0.0;
+    (void)worker;
+
+    for(int i = first; i < last; i++) {
+        const packed_position_t *p = &job->data->positions[i];
+        PACK_unpack(p, &state);
+
+        /* Evaluate position from white's perspective */
+        short score = EVAL_evaluate_board(&state, &param);
+        if(state.player == BLACK) score = -score;
 
-    for(int i = 0; i < NUM_THREADS; i++) {
-        t_arg[i].index = i;
-        t_arg[i].buf = buf;
-        THREAD_create(&t[i], worker_thread, &t_arg[i]);
+        e2 += error(p->result * 0.5f, score);
     }
 
-    float e2_tot = 0.0f;
-    int num_pos = 0;
-    for(int i = 0; i < NUM_THREADS; i++) {
-        THREAD_join(t[i]);
-        e2_tot += t_arg[i].error;
-        num_pos += t_arg[i].num_positions;
+    job->error[first / CHUNK_SIZE] = e2;
+}
+
+/* Like test_job, with the score of a search from scratch */
+static void search_test_job(void *arg, int worker, int first, int last)
+{
+    test_job_t *job = (test_job_t*)arg;
+    search_state_t *search_state = search_states[worker];
+    chess_state_t state;
+    double e2 = 0.0;
+
+    search_state->start_time_ms = CLOCK_now();
+    search_state->time_for_move_ms = INT64_MAX / 4;
+    search_state->next_clock_check = SEARCH_ITERATIONS_BETWEEN_CLOCK_CHECK;
+
+    for(int i = first; i < last; i++) {
+        const packed_position_t *p = &job->data->positions[i];
+        PACK_unpack(p, &state);
+
+        HASHTABLE_clear(search_state->hashtable);
+        HISTORY_reset_after_load(search_state->history, &state);
+        memset(search_state->killer_move, 0, sizeof(search_state->killer_move));
+        memset(&search_state->stats, 0, sizeof(search_state->stats));
+        search_state->abort_search = 0;
+        search_state->num_nodes_searched = 0;
+
+        short score;
+        SEARCH_perform_search(&state, search_state, &score);
+        if(state.player == BLACK) score = -score;
+
+        e2 += error(p->result * 0.5f, score);
+    }
+
+    job->error[first / CHUNK_SIZE] = e2;
+}
+
+float run_test(const dataset_t *data)
+{
+    int num_chunks = (data->num_positions + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    test_job_t job = { data, malloc(num_chunks * sizeof(double)) };
+
+    THREADPOOL_run(pool, data->num_positions, CHUNK_SIZE, tune_search ? search_test_job : test_job, &job);
+
+    double e2_tot = 0.0;
+    for(int i = 0; i < num_chunks; i++) {
+        e2_tot += job.error[i];
     }
+    free(job.error);
 
-    float mse = sqrtf(e2_tot/num_pos);
+    float mse = sqrtf(e2_tot/data->num_positions);
     return mse;
 }
 
-float optimize(const char *buf, int *x, int idx, float mse_start, int min, int max)
+float optimize(const dataset_t *data, int *x, int idx, float mse_start, int min, int max)
 {
     int max_diff = 1;
     int x_init = x[idx];
@@ -160,7 +326,7 @@ float optimize(const char *buf, int *x, int idx, float mse_start, int min, int m
     // Step upwards
     while(x[idx] < max) {
         x[idx]++;
-        float mse = run_test(buf);
+        float mse = run_test(data);
         fprintf(stderr, ", %d=>%f", x[idx], mse);
         if(mse >= mse_best) {
             x[idx]--;
@@ -177,7 +343,7 @@ float optimize(const char *buf, int *x, int idx, float mse_start, int min, int m
     // Step downwards
     while(x[idx] > min) {
         x[idx]--;
-        float mse = run_test(buf);
+        float mse = run_test(data);
         fprintf(stderr, ", %d=>%f", x[idx], mse);
         if(mse >= mse_best) {
             x[idx]++;
@@ -194,7 +360,7 @@ float optimize(const char *buf, int *x, int idx, float mse_start, int min, int m
     return mse_best;
 }
 
-float tune_array(const char *buf, int *x, int len, float mse, int min, int max)
+float tune_array(const dataset_t *data, int *x, int len, float mse, int min, int max)
 {
     int *tuned = calloc(len, sizeof(int));
     int num_left = len;
@@ -206,7 +372,7 @@ float tune_array(const char *buf, int *x, int len, float mse, int min, int max)
         } while(tuned[idx] != 0);
         num_left--;
         tuned[idx] = 1;
-        mse = optimize(buf, x, idx, mse, min, max);
+        mse = optimize(data, x, idx, mse, min, max);
     }
 
     return mse;
@@ -249,7 +415,7 @@ void print_mob(char *name, int *mob, int size)
 
 void print_params()
 {
-    printf("eval_param_t param =\n{\n");
+    printf("const eval_param_t EVAL_default_param =\n{\n");
     printf("    .psq = {\n");
     print_psq("pawn", param.psq.pawn);
     print_psq("knight", param.psq.knight);
@@ -307,30 +473,10 @@ void print_params()
     printf("};\n");
     fflush(stdout);
 }
-int main(int argc, char **argv)
+/* Coordinate descent, one parameter at a time with exact evaluation */
+void tune_local(const dataset_t *data)
 {
-    if(argc < 2) {
-        fprintf(stderr, "Error: No input file\n");
-        return 1;
-    }
-
-    FILE *f = fopen(argv[1], "r");
-    if(!f) {
-        fprintf(stderr, "Error: Could not open file: %s\n", argv[1]);
-        return 2;
-    }
-
-    /* File size */
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    /* Read and close file */
-    char *buf = malloc(file_size);
-    fread(buf, 1, file_size, f);
-    fclose(f);
-
-    float mse_initial = run_test(buf);
+    float mse_initial = run_test(data);
     float mse_start = mse_initial;
     float mse_best = mse_start;
     fprintf(stderr, "Initial => %f\n", mse_initial);
@@ -338,47 +484,392 @@ int main(int argc, char **argv)
     for(int iter = 0; iter < 10; iter++) {
 #if 0
         fprintf(stderr, "Optimizing mobility\n");
-        mse_best = tune_array(buf, (int*)&param.mobility, sizeof(param.mobility)/sizeof(int), mse_best, -10, 10);
+        mse_best = tune_array(data, (int*)&param.mobility, sizeof(param.mobility)/sizeof(int), mse_best, -10, 10);
 #endif
 #if 1
         fprintf(stderr, "Optimizing threat\n");
-        mse_best = tune_array(buf, (int*)&param.threat, sizeof(param.threat)/sizeof(int), mse_best, -10, 10);
+        mse_best = tune_array(data, (int*)&param.threat, sizeof(param.threat)/sizeof(int), mse_best, -10, 10);
 #endif
 #if 0
         fprintf(stderr, "Optimizing king pressure\n");
-        mse_best = tune_array(buf, (int*)&param.pressure.knight, sizeof(param.pressure.knight)/sizeof(int), mse_best, 0, 15);
-        mse_best = tune_array(buf, (int*)&param.pressure.bishop, sizeof(param.pressure.bishop)/sizeof(int), mse_best, 0, 15);
-        mse_best = tune_array(buf, (int*)&param.pressure.rook, sizeof(param.pressure.rook)/sizeof(int), mse_best, 0, 15);
-        mse_best = tune_array(buf, (int*)&param.pressure.queen, sizeof(param.pressure.queen)/sizeof(int), mse_best, 0, 15);
-        mse_best = tune_array(buf, (int*)&param.pressure.scaling_midgame, sizeof(param.pressure.scaling_midgame)/sizeof(int), mse_best, 0, 64);
-        mse_best = tune_array(buf, (int*)&param.pressure.scaling_endgame, sizeof(param.pressure.scaling_endgame)/sizeof(int), mse_best, 0, 64);
+        mse_best = tune_array(data, (int*)&param.pressure.knight, sizeof(param.pressure.knight)/sizeof(int), mse_best, 0, 15);
+        mse_best = tune_array(data, (int*)&param.pressure.bishop, sizeof(param.pressure.bishop)/sizeof(int), mse_best, 0, 15);
+        mse_best = tune_array(data, (int*)&param.pressure.rook, sizeof(param.pressure.rook)/sizeof(int), mse_best, 0, 15);
+        mse_best = tune_array(data, (int*)&param.pressure.queen, sizeof(param.pressure.queen)/sizeof(int), mse_best, 0, 15);
+        mse_best = tune_array(data, (int*)&param.pressure.scaling_midgame, sizeof(param.pressure.scaling_midgame)/sizeof(int), mse_best, 0, 64);
+        mse_best = tune_array(data, (int*)&param.pressure.scaling_endgame, sizeof(param.pressure.scaling_endgame)/sizeof(int), mse_best, 0, 64);
 #endif
 #if 0
         fprintf(stderr, "Optimizing positional parameters\n");
-        mse_best = tune_array(buf, (int*)&param.positional, sizeof(param.positional)/sizeof(int), mse_best, -25, 300);
+        mse_best = tune_array(data, (int*)&param.positional, sizeof(param.positional)/sizeof(int), mse_best, -25, 300);
 #endif
 #if 0
         fprintf(stderr, "Optimizing PSQ pawn\n");
-        mse_best = tune_array(buf, param.psq.pawn, 64, mse_best, -10, 20);
+        mse_best = tune_array(data, param.psq.pawn, 64, mse_best, -10, 20);
         fprintf(stderr, "Optimizing PSQ knight\n");
-        mse_best = tune_array(buf, param.psq.knight, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.knight, 64, mse_best, -10, 10);
         fprintf(stderr, "Optimizing PSQ bishop\n");
-        mse_best = tune_array(buf, param.psq.bishop, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.bishop, 64, mse_best, -10, 10);
         fprintf(stderr, "Optimizing PSQ rook\n");
-        mse_best = tune_array(buf, param.psq.rook, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.rook, 64, mse_best, -10, 10);
         fprintf(stderr, "Optimizing PSQ queen\n");
-        mse_best = tune_array(buf, param.psq.queen, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.queen, 64, mse_best, -10, 10);
         fprintf(stderr, "Optimizing PSQ king_midgame\n");
-        mse_best = tune_array(buf, param.psq.king_midgame, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.king_midgame, 64, mse_best, -10, 10);
         fprintf(stderr, "Optimizing PSQ king_endgame\n");
-        mse_best = tune_array(buf, param.psq.king_endgame, 64, mse_best, -10, 10);
+        mse_best = tune_array(data, param.psq.king_endgame, 64, mse_best, -10, 10);
 #endif
         print_params();
         fprintf(stderr, "\nMSE reduction in iteration %d: %f. Total reduction: %f.\n\n", iter, mse_start - mse_best, mse_initial - mse_best);
         if(mse_best >= mse_start) break;
         mse_start = mse_best;
     }
-    free(buf);
+}
+
+/* Cached linearised evaluation of a position */
+typedef struct {
+    float constant;
+    float result;
+    int   first_term;
+    int   num_terms;
+} trace_entry_t;
+
+/* Traces of one chunk of positions */
+typedef struct {
+    trace_entry_t     *entries;
+    int               num_entries;
+    eval_trace_term_t *terms;
+    int               num_terms;
+    int               max_terms;
+} trace_chunk_t;
+
+typedef struct {
+    const dataset_t *data;
+    trace_chunk_t   *chunks;
+    eval_trace_t    **traces;       /* Scratch per worker */
+    const float     *weights;
+    double          *gradient;      /* Per chunk */
+    double          *error;         /* Per chunk */
+} adam_job_t;
+
+static void trace_job(void *arg, int worker, int first, int last)
+{
+    adam_job_t *job = (adam_job_t*)arg;
+    trace_chunk_t *chunk = &job->chunks[first / CHUNK_SIZE];
+    eval_trace_t *trace = job->traces[worker];
+    chess_state_t state;
+
+    chunk->num_entries = 0;
+    chunk->num_terms = 0;
+    for(int i = first; i < last; i++) {
+        PACK_unpack(&job->data->positions[i], &state);
+        EVAL_evaluate_board_trace(&state, &param, trace);
+
+        if(chunk->num_terms + trace->num_terms > chunk->max_terms) {
+            chunk->max_terms = 2 * (chunk->num_terms + trace->num_terms);
+            chunk->terms = realloc(chunk->terms, chunk->max_terms * sizeof(eval_trace_term_t));
+        }
+        memcpy(&chunk->terms[chunk->num_terms], trace->terms, trace->num_terms * sizeof(eval_trace_term_t));
+
+        trace_entry_t *entry = &chunk->entries[chunk->num_entries++];
+        entry->constant = trace->constant;
+        entry->result = job->data->positions[i].result * 0.5f;
+        entry->first_term = chunk->num_terms;
+        entry->num_terms = trace->num_terms;
+        chunk->num_terms += trace->num_terms;
+    }
+}
+
+static void gradient_job(void *arg, int worker, int first, int last)
+{
+    adam_job_t *job = (adam_job_t*)arg;
+    const trace_chunk_t *chunk = &job->chunks[first / CHUNK_SIZE];
+    double *gradient = &job->gradient[(first / CHUNK_SIZE) * EVAL_NUM_PARAMS];
+    const float *w = job->weights;
+    const float K = 5.0f / 400.0f * logf(10.0f);
+    double e2 = 0.0;
+    (void)worker;
+    (void)last;
+
+    memset(gradient, 0, EVAL_NUM_PARAMS * sizeof(double));
+    for(int i = 0; i < chunk->num_entries; i++) {
+        const trace_entry_t *entry = &chunk->entries[i];
+        const eval_trace_term_t *terms = &chunk->terms[entry->first_term];
+
+        float score = entry->constant;
+        for(int j = 0; j < entry->num_terms; j++) {
+            score += terms[j].coeff * w[terms[j].index];
+        }
+
+        float s = sigmoid(score);
+        float e = entry->result - s;
+        e2 += e*e;
+
+        /* Derivative of the squared error with respect to the score */
+        float g = -2.0f * e * s * (1.0f - s) * K;
+        for(int j = 0; j < entry->num_terms; j++) {
+            gradient[terms[j].index] += g * terms[j].coeff;
+        }
+    }
+
+    job->error[first / CHUNK_SIZE] = e2;
+}
+
+/* Gradient descent with Adam over all parameters at once. The traces are
+ * recomputed from the rounded parameters at regular intervals, which also
+ * moves the linearisation point of the scaled terms and the game phase. */
+void tune_adam(const dataset_t *data, int epochs, float learning_rate)
+{
+    const int refresh_interval = 50;
+    const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    const int num_chunks = (data->num_positions + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const int num_workers = THREADPOOL_num_threads(pool);
+    float w[EVAL_NUM_PARAMS];
+    double gradient[EVAL_NUM_PARAMS];
+    double m[EVAL_NUM_PARAMS] = { 0 };
+    double v[EVAL_NUM_PARAMS] = { 0 };
+    int *x = (int*)&param;
+    adam_job_t job;
+
+    job.data = data;
+    job.chunks = calloc(num_chunks, sizeof(trace_chunk_t));
+    job.traces = malloc(num_workers * sizeof(eval_trace_t*));
+    job.weights = w;
+    job.gradient = malloc((size_t)num_chunks * EVAL_NUM_PARAMS * sizeof(double));
+    job.error = malloc(num_chunks * sizeof(double));
+    for(int i = 0; i < num_chunks; i++) {
+        job.chunks[i].entries = malloc(CHUNK_SIZE * sizeof(trace_entry_t));
+    }
+    for(int i = 0; i < num_workers; i++) {
+        job.traces[i] = malloc(sizeof(eval_trace_t));
+    }
+
+    for(int i = 0; i < EVAL_NUM_PARAMS; i++) w[i] = (float)x[i];
+
+    float mse_initial = run_test(data);
+    float mse_best = mse_initial;
+    fprintf(stderr, "Initial => %f\n", mse_initial);
+
+    for(int epoch = 0; epoch < epochs; epoch++) {
+        if(epoch % refresh_interval == 0) {
+            for(int i = 0; i < EVAL_NUM_PARAMS; i++) x[i] = (int)lroundf(w[i]);
+            if(epoch) {
+                float mse = run_test(data);
+                fprintf(stderr, "Epoch %d => %f\n", epoch, mse);
+                if(mse < mse_best) {
+                    mse_best = mse;
+                    print_params();
+                }
+            }
+
+            THREADPOOL_run(pool, data->num_positions, CHUNK_SIZE, trace_job, &job);
+        }
+
+        THREADPOOL_run(pool, data->num_positions, CHUNK_SIZE, gradient_job, &job);
+
+        memset(gradient, 0, sizeof(gradient));
+        double e2_tot = 0.0;
+        for(int i = 0; i < num_chunks; i++) {
+            e2_tot += job.error[i];
+            for(int j = 0; j < EVAL_NUM_PARAMS; j++) gradient[j] += job.gradient[i * EVAL_NUM_PARAMS + j];
+        }
+
+        for(int i = 0; i < EVAL_NUM_PARAMS; i++) {
+            double g = gradient[i] / data->num_positions;
+            m[i] = beta1 * m[i] + (1.0 - beta1) * g;
+            v[i] = beta2 * v[i] + (1.0 - beta2) * g * g;
+            double m_hat = m[i] / (1.0 - pow(beta1, epoch + 1));
+            double v_hat = v[i] / (1.0 - pow(beta2, epoch + 1));
+            w[i] -= (float)(learning_rate * m_hat / (sqrt(v_hat) + epsilon));
+        }
+
+        if(epoch % 10 == 0) {
+            fprintf(stderr, "Epoch %d: linearised => %f\n", epoch, sqrt(e2_tot / data->num_positions));
+        }
+    }
+
+    for(int i = 0; i < EVAL_NUM_PARAMS; i++) x[i] = (int)lroundf(w[i]);
+    float mse = run_test(data);
+    fprintf(stderr, "Final => %f. Total reduction: %f.\n", mse, mse_initial - mse);
+    print_params();
+
+    for(int i = 0; i < num_chunks; i++) {
+        free(job.chunks[i].entries);
+        free(job.chunks[i].terms);
+    }
+    for(int i = 0; i < num_workers; i++) {
+        free(job.traces[i]);
+    }
+    free(job.chunks);
+    free(job.traces);
+    free(job.gradient);
+    free(job.error);
+}
+
+void print_search_params()
+{
+    printf("const search_param_t SEARCH_default_param =\n{\n");
+    printf("    .razor_margin               = {");
+    for(int i = 0; i <= SEARCH_RAZOR_DEPTH; i++) {
+        printf(" %d%s", search_param.razor_margin[i], i < SEARCH_RAZOR_DEPTH ? "," : "");
+    }
+    printf(" },\n");
+    printf("    .probcut_depth              = %d,\n", search_param.probcut_depth);
+    printf("    .probcut_margin             = %d,\n", search_param.probcut_margin);
+    printf("    .probcut_reduction          = %d,\n", search_param.probcut_reduction);
+    printf("    .lmr_base                   = %d,\n", search_param.lmr_base);
+    printf("    .lmr_scale                  = %d,\n", search_param.lmr_scale);
+    printf("    .lmr_history                = %d,\n", search_param.lmr_history);
+    printf("    .lmr_not_improving          = %d,\n", search_param.lmr_not_improving);
+    printf("    .lmr_cut_node               = %d,\n", search_param.lmr_cut_node);
+    printf("    .lmr_pv_node                = %d,\n", search_param.lmr_pv_node);
+    printf("    .iir_depth                  = %d,\n", search_param.iir_depth);
+    printf("    .quiescence_checks          = %d,\n", search_param.quiescence_checks);
+    printf("};\n");
+    fflush(stdout);
+}
+
+/* Coordinate descent over the search parameters. The error of a node limited
+ * search falls when the nodes are spent better, so pruning too much or too
+ * little both show. */
+void tune_search_local(const dataset_t *data)
+{
+    const int num_workers = THREADPOOL_num_threads(pool);
+    int *x = (int*)&search_param;
+    const int *step = (const int*)&search_param_step;
+
+    search_states = malloc(num_workers * sizeof(search_state_t*));
+    for(int i = 0; i < num_workers; i++) {
+        search_states[i] = calloc(1, sizeof(search_state_t));
+        search_states[i]->hashtable = HASHTABLE_create(1);
+        search_states[i]->history = HISTORY_create();
+        search_states[i]->eval_param = &param;
+        search_states[i]->search_param = &search_param;
+        search_states[i]->max_depth = MAX_SEARCH_DEPTH;
+        search_states[i]->max_nodes = search_nodes;
+    }
+
+    float mse_initial = run_test(data);
+    float mse_best = mse_initial;
+    fprintf(stderr, "Initial => %f\n", mse_initial);
+
+    for(int iter = 0; iter < 10; iter++) {
+        float mse_start = mse_best;
+        for(int idx = 0; idx < SEARCH_NUM_PARAMS; idx++) {
+            if(!step[idx]) continue;
+            int x_init = x[idx];
+            fprintf(stderr, "[%d] = %d=>%f", idx, x_init, mse_best);
+
+            /* Upwards first, downwards if that did not help */
+            for(int dir = 1; dir >= -1 && x[idx] == x_init; dir -= 2) {
+                while(x[idx] + dir * step[idx] >= 0) {
+                    x[idx] += dir * step[idx];
+                    float mse = run_test(data);
+                    fprintf(stderr, ", %d=>%f", x[idx], mse);
+                    if(mse >= mse_best) {
+                        x[idx] -= dir * step[idx];
+                        break;
+                    }
+                    mse_best = mse;
+                }
+            }
+
+            if(x[idx] != x_init) {
+                fprintf(stderr, "  CHANGED from %d to %d - MSE %f\n", x_init, x[idx], mse_best);
+            } else {
+                fprintf(stderr, "\n");
+            }
+        }
+        print_search_params();
+
+        fprintf(stderr, "\nMSE reduction in iteration %d: %f. Total reduction: %f.\n\n", iter, mse_start - mse_best, mse_initial - mse_best);
+        if(mse_best >= mse_start) break;
+    }
+
+    for(int i = 0; i < num_workers; i++) {
+        HASHTABLE_release(search_states[i]->hashtable);
+        HISTORY_destroy(search_states[i]->history);
+        free(search_states[i]);
+    }
+    free(search_states);
+}
+
+int main(int argc, char **argv)
+{
+    int local = 0;
+    int epochs = 1000;
+    int num_threads = 0;
+    int max_positions = 0;
+    float learning_rate = 1.0f;
+    const char *extract_pgn = NULL;
+    const char *filename = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-extract") == 0 && i + 1 < argc) {
+            extract_pgn = argv[++i];
+        } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-local") == 0) {
+            local = 1;
+        } else if(strcmp(argv[i], "-epochs") == 0 && i + 1 < argc) {
+            epochs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-lr") == 0 && i + 1 < argc) {
+            learning_rate = (float)atof(argv[++i]);
+        } else if(strcmp(argv[i], "-search") == 0) {
+            tune_search = 1;
+        } else if(strcmp(argv[i], "-nodes") == 0 && i + 1 < argc) {
+            search_nodes = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-positions") == 0 && i + 1 < argc) {
+            max_positions = atoi(argv[++i]);
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if(!filename) {
+        fprintf(stderr, "Error: No input file\n");
+        return 1;
+    }
+
+    EVAL_init();
+    pool = THREADPOOL_create(num_threads);
+    param = EVAL_default_param;
+    search_param = SEARCH_default_param;
+
+    if(extract_pgn) {
+        int r = extract_positions(extract_pgn, filename);
+        THREADPOOL_destroy(pool);
+        return r;
+    }
+
+    positionfile_t *in = POSITIONFILE_open(filename);
+    if(!in) {
+        fprintf(stderr, "Error: Could not open position file: %s (create it with -extract)\n", filename);
+        return 2;
+    }
+
+    dataset_t data;
+    packed_position_t *positions = malloc(POSITIONFILE_num_positions(in) * sizeof(packed_position_t));
+    data.positions = positions;
+    data.num_positions = (int)POSITIONFILE_num_positions(in);
+    if(POSITIONFILE_read(in, positions, data.num_positions) != data.num_positions || data.num_positions == 0) {
+        fprintf(stderr, "Error: Corrupt position file: %s\n", filename);
+        return 2;
+    }
+    POSITIONFILE_close(in);
+    fprintf(stderr, "Loaded %d positions\n", data.num_positions);
+    if(max_positions > 0 && max_positions < data.num_positions) {
+        data.num_positions = max_positions;
+    }
+
+    if(tune_search) {
+        tune_search_local(&data);
+    } else if(local) {
+        tune_local(&data);
+    } else {
+        tune_adam(&data, epochs, learning_rate);
+    }
+    THREADPOOL_destroy(pool);
+    free(positions);
 
     return 0;
 }